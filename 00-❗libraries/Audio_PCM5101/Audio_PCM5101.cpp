@@ -4,10 +4,14 @@ Audio audio;
 uint8_t Volume = Volume_MAX;
 bool audio_initialized = false;
 
-void IRAM_ATTR example_increase_audio_tick(void *arg)
+static void Audio_DecodeTask(void *arg)
 {
-  if (audio_initialized) {
-    audio.loop();
+  // reads and decodes into the PCM ring of the library, its output task writes to I2S
+  while (true) {
+    if (audio_initialized) {
+      audio.loop();
+    }
+    audio.waitForWork(EXAMPLE_Audio_TICK_PERIOD_MS); // woken by the I2S DMA, at the latest after the period
   }
 }
 
@@ -20,23 +24,15 @@ esp_err_t Audio_Init() {
     audio.setPinout(I2S_BCLK, I2S_LRC, I2S_DOUT);
     audio.setVolume(21); // 0...21    
 
-    esp_timer_handle_t audio_tick_timer = NULL;
-    const esp_timer_create_args_t audio_tick_timer_args = {
-      .callback = &example_increase_audio_tick,
-      .dispatch_method = ESP_TIMER_TASK,  
-      .name = "audio_tick",
-      .skip_unhandled_events = true       
-    };
-    
-    esp_err_t timer_result = esp_timer_create(&audio_tick_timer_args, &audio_tick_timer);
-    if (timer_result != ESP_OK) {
-      Serial.printf("Failed to create audio timer: %d\n", timer_result);
-      return ESP_FAIL;
+    // Decoder task (SD card and network reads) and the I2S output task of the library
+    if (!audio.startOutputTask(EXAMPLE_Audio_RING_MS, 1)) {
+      Serial.println("Audio output task not available, I2S is written by the decoder task");
     }
-    
-    timer_result = esp_timer_start_periodic(audio_tick_timer, EXAMPLE_Audio_TICK_PERIOD_MS * 1000);
-    if (timer_result != ESP_OK) {
-      Serial.printf("Failed to start audio timer: %d\n", timer_result);
+    if (!audio.startReadAhead(EXAMPLE_Audio_READ_AHEAD_S)) {
+      Serial.println("SD read-ahead not available, the decoder task reads the card");
+    }
+    if (xTaskCreatePinnedToCore(Audio_DecodeTask, "audioDecode", 4096, NULL, 3, NULL, 1) != pdPASS) {
+      Serial.println("Failed to create audio decoder task");
       return ESP_FAIL;
     }
     
@@ -102,12 +98,6 @@ void Play_Music(const char* directory, const char* fileName) {
     return;
   }
   
-  // SD Card
-  if (!File_Search(directory, fileName)) {
-    printf("%s file not found.\r\n", fileName);
-    return;
-  }
-  
   const int maxPathLength = 100; 
   char filePath[maxPathLength];
   if (strcmp(directory, "/") == 0) {                                               
@@ -116,11 +106,13 @@ void Play_Music(const char* directory, const char* fileName) {
     snprintf(filePath, maxPathLength, "%s/%s", directory, fileName);
   }
   
-  // Safely play the file
+  // Safely play the file, it is opened directly (the folder is only searched if that fails)
   audio.pauseResume();     
   bool ret = audio.connecttoFS(SD_MMC, (char*)filePath);
   if(ret) 
     printf("Music Read OK\r\n");
+  else if (!SD_MMC.exists(filePath))
+    printf("%s file not found.\r\n", fileName);
   else
     printf("Music Read Failed\r\n");
   
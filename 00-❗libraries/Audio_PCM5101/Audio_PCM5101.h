@@ -12,6 +12,8 @@
 #define I2S_LRC       38      // I2S_WS
 
 #define EXAMPLE_Audio_TICK_PERIOD_MS  20
+#define EXAMPLE_Audio_RING_MS         150   // decoded audio between the decoder and the output task
+#define EXAMPLE_Audio_READ_AHEAD_S    2     // compressed audio read from the SD card ahead of the decoder
 #define Volume_MAX  21
 
 extern Audio audio;
@@ -15,126 +15,13 @@
 #include "opus_decoder/opus_decoder.h"
 #include "vorbis_decoder/vorbis_decoder.h"
 
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-AudioBuffer::AudioBuffer(size_t maxBlockSize) {
-    // if maxBlockSize isn't set use defaultspace (1600 bytes) is enough for aac and mp3 player
-    if(maxBlockSize) m_resBuffSizeRAM = maxBlockSize;
-    if(maxBlockSize) m_maxBlockSize = maxBlockSize;
-}
-
-AudioBuffer::~AudioBuffer() {
-    if(m_buffer) free(m_buffer);
-    m_buffer = NULL;
-}
-
-void AudioBuffer::setBufsize(int ram, int psram) {
-    if(ram > -1) // -1 == default / no change
-        m_buffSizeRAM = ram;
-    if(psram > -1) m_buffSizePSRAM = psram;
-}
-
-int32_t AudioBuffer::getBufsize() { return m_buffSize; }
-
-size_t AudioBuffer::init() {
-    if(m_buffer) free(m_buffer);
-    m_buffer = NULL;
-    if(psramInit() && m_buffSizePSRAM > 0) {
-        // PSRAM found, AudioBuffer will be allocated in PSRAM
-        m_f_psram = true;
-        m_buffSize = m_buffSizePSRAM;
-        m_buffer = (uint8_t*)ps_calloc(m_buffSize, sizeof(uint8_t));
-        m_buffSize = m_buffSizePSRAM - m_resBuffSizePSRAM;
-    }
-    if(m_buffer == NULL) {
-        // PSRAM not found, not configured or not enough available
-        m_f_psram = false;
-        m_buffer = (uint8_t*)heap_caps_calloc(m_buffSizeRAM, sizeof(uint8_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
-        m_buffSize = m_buffSizeRAM - m_resBuffSizeRAM;
-    }
-    if(!m_buffer) return 0;
-    m_f_init = true;
-    resetBuffer();
-    return m_buffSize;
-}
-
-void AudioBuffer::changeMaxBlockSize(uint16_t mbs) {
-    m_maxBlockSize = mbs;
-    return;
-}
-
-uint16_t AudioBuffer::getMaxBlockSize() { return m_maxBlockSize; }
-
-size_t AudioBuffer::freeSpace() {
-    if(m_readPtr >= m_writePtr) { m_freeSpace = (m_readPtr - m_writePtr); }
-    else { m_freeSpace = (m_endPtr - m_writePtr) + (m_readPtr - m_buffer); }
-    if(m_f_start) m_freeSpace = m_buffSize;
-    return m_freeSpace - 1;
-}
-
-size_t AudioBuffer::writeSpace() {
-    if(m_readPtr >= m_writePtr) {
-        m_writeSpace = (m_readPtr - m_writePtr - 1); // readPtr must not be overtaken
-    }
-    else {
-        if(getReadPos() == 0) m_writeSpace = (m_endPtr - m_writePtr - 1);
-        else m_writeSpace = (m_endPtr - m_writePtr);
-    }
-    if(m_f_start) m_writeSpace = m_buffSize - 1;
-    return m_writeSpace;
-}
-
-size_t AudioBuffer::bufferFilled() {
-    if(m_writePtr >= m_readPtr) { m_dataLength = (m_writePtr - m_readPtr); }
-    else { m_dataLength = (m_endPtr - m_readPtr) + (m_writePtr - m_buffer); }
-    return m_dataLength;
-}
-
-size_t AudioBuffer::getMaxAvailableBytes() {
-    if(m_writePtr >= m_readPtr) { m_dataLength = (m_writePtr - m_readPtr - 1); }
-    else { m_dataLength = (m_endPtr - m_readPtr); }
-    return m_dataLength;
-}
-
-void AudioBuffer::bytesWritten(size_t bw) {
-    m_writePtr += bw;
-    if(m_writePtr == m_endPtr) { m_writePtr = m_buffer; }
-    if(bw && m_f_start) m_f_start = false;
-}
-
-void AudioBuffer::bytesWasRead(size_t br) {
-    m_readPtr += br;
-    if(m_readPtr >= m_endPtr) {
-        size_t tmp = m_readPtr - m_endPtr;
-        m_readPtr = m_buffer + tmp;
-    }
-}
-
-uint8_t* AudioBuffer::getWritePtr() { return m_writePtr; }
-
-uint8_t* AudioBuffer::getReadPtr() {
-    size_t len = m_endPtr - m_readPtr;
-    if(len < m_maxBlockSize) {                            // be sure the last frame is completed
-        memcpy(m_endPtr, m_buffer, m_maxBlockSize - len); // cpy from m_buffer to m_endPtr with len
-    }
-    return m_readPtr;
-}
-
-void AudioBuffer::resetBuffer() {
-    m_writePtr = m_buffer;
-    m_readPtr = m_buffer;
-    m_endPtr = m_buffer + m_buffSize;
-    m_f_start = true;
-    // memset(m_buffer, 0, m_buffSize); //Clear Inputbuffer
-}
-
-uint32_t AudioBuffer::getWritePos() { return m_writePtr - m_buffer; }
-
-uint32_t AudioBuffer::getReadPos() { return m_readPtr - m_buffer; }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // clang-format off
 Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_SLOT_MODE_STEREO */, uint8_t i2sPort) {
 
     mutex_audio = xSemaphoreCreateMutex();
+    mutex_out = xSemaphoreCreateMutex();
+    mutex_ra = xSemaphoreCreateMutex();
 
 #ifdef AUDIO_LOG
     m_f_Log = true;
@@ -150,8 +37,16 @@ Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_SLO
     m_outBuff = (int16_t*)__malloc_heap_psram(m_outbuffSize);
     m_chbuf = (char*)__malloc_heap_psram(m_chbufSize);
     m_ibuff = (char*)__malloc_heap_psram(m_ibuffSize);
+    m_i2sStage = (uint32_t*)heap_caps_malloc(m_i2sStageFrames * sizeof(uint32_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
 
-    if(!m_chbuf || !m_lastHost || !m_outBuff || !m_ibuff) log_e("oom");
+    if(!m_chbuf || !m_lastHost || !m_outBuff || !m_ibuff || !m_i2sStage) log_e("oom");
+    if(m_f_psramFound) m_seekMap = (sm_map_t*)heap_caps_malloc(sizeof(sm_map_t), MALLOC_CAP_SPIRAM); // 8 KB, without it MP3 files are seeked by the bitrate
+    if(m_seekMap) SM_reset(m_seekMap);
+    BQ_init(&m_eq);
+    for(uint8_t i = 0; i < 3; i++) m_toneCoef[i] = BQ_quantize(1, 0, 0, 0, 0); // flat until the samplerate is known
+    XF_buildCurve(m_xfCurve, XF_EQUAL_POWER);
+    LIM_init(&m_lim, 44100, -1.0f, 2000, 80);
+    VOL_setRamp(&m_volRamp, 44100, m_volRampMs, VOL_RAMP_LINEAR);
 
 #define AUDIO_INFO(...)                     \
     {                                       \
@@ -192,6 +87,11 @@ Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_SLO
     m_i2s_std_cfg.clk_cfg.clk_src        = I2S_CLK_SRC_DEFAULT;        // Select PLL_F160M as the default source clock
     m_i2s_std_cfg.clk_cfg.mclk_multiple  = I2S_MCLK_MULTIPLE_128;      // mclk = sample_rate * 256
     i2s_channel_init_std_mode(m_i2s_tx_handle, &m_i2s_std_cfg);
+    i2s_event_callbacks_t i2s_cbs = {};
+    i2s_cbs.on_sent = i2sSentCb;       // wakes the task in waitForWork()
+    i2s_cbs.on_send_q_ovf = i2sOvfCb;  // all descriptors sent, nothing new written: underrun
+    i2s_channel_register_event_callback(m_i2s_tx_handle, &i2s_cbs, this); // before the channel is enabled
+    m_wakeDescs = m_i2s_chan_cfg.dma_desc_num / 4;
     I2Sstart(0);
     m_sampleRate = 44100;
 #else
@@ -234,12 +134,14 @@ Audio::Audio(bool internalDAC /* = false */, uint8_t channelEnabled /* = I2S_SLO
         m_filter[i].b1 = 0;
         m_filter[i].b2 = 0;
     }
-    computeLimit();  // first init, vol = 21, vol_steps = 21
+    setVolumeSteps(m_vol_steps);  // first init, vol = 21, vol_steps = 21, volume tables
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 Audio::~Audio() {
     // I2Sstop(m_i2s_num);
     // InBuff.~AudioBuffer(); #215 the AudioBuffer is automatically destroyed by the destructor
+    stopOutputTask();
+    stopReadAhead();
     setDefaults();
     if(m_playlistBuff) {
         free(m_playlistBuff);
@@ -253,10 +155,29 @@ Audio::~Audio() {
     if(m_chbuf)       {free(m_chbuf);        m_chbuf        = NULL;}
     if(m_lastHost)    {free(m_lastHost);     m_lastHost     = NULL;}
     if(m_outBuff)     {free(m_outBuff);      m_outBuff      = NULL; }
+    if(m_i2sStage)    {free(m_i2sStage);     m_i2sStage     = NULL;}
+    if(m_eqSets)      {free(m_eqSets);       m_eqSets       = NULL;}
+    if(m_rsCoef)      {free(m_rsCoef);       m_rsCoef       = NULL;}
+    if(m_rsIn)        {free(m_rsIn);         m_rsIn         = NULL;}
+    if(m_strBuf)      {free(m_strBuf);       m_strBuf       = NULL;}
+    if(m_strIn)       {free(m_strIn);        m_strIn        = NULL;}
+    if(m_nextHead)    {free(m_nextHead);     m_nextHead     = NULL;}
+    if(m_xfRing.buff) {free(m_xfRing.buff);  m_xfRing.buff  = NULL;}
+    if(m_xfTmp)       {free(m_xfTmp);        m_xfTmp        = NULL;}
+    if(m_lt)          {free(m_lt);           m_lt           = NULL;}
+    if(m_ltPath)      {free(m_ltPath);       m_ltPath       = NULL;}
+    if(m_r128Hist)    {free(m_r128Hist);     m_r128Hist     = NULL;}
+    if(m_seekMap)     {free(m_seekMap);      m_seekMap      = NULL;}
+    if(m_limWork)     {free(m_limWork);      m_limWork      = NULL;}
+    if(m_spTask)      {vTaskDelete(m_spTask);  m_spTask       = NULL;}
+    if(m_spFft)       {free(m_spFft);        m_spFft        = NULL;}
+    for(int i = 0; i < 2; i++) {if(m_spCapture[i]) {free(m_spCapture[i]); m_spCapture[i] = NULL;}}
     if(m_ibuff)       {free(m_ibuff);        m_ibuff        = NULL;}
     if(m_lastM3U8host){free(m_lastM3U8host); m_lastM3U8host = NULL;}
 
     vSemaphoreDelete(mutex_audio);
+    vSemaphoreDelete(mutex_out);
+    vSemaphoreDelete(mutex_ra);
 }
 // clang-format on
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -363,6 +284,25 @@ void Audio::setDefaults() {
     m_streamTitleHash = 0;
     m_file_size = 0;
     m_ID3Size = 0;
+    GL_reset(&m_glInfo);
+    GL_start(&m_trim, NULL);
+    if(m_seekMap) SM_reset(m_seekMap);
+    m_seekMs = -1;
+    m_f_seekTrim = false;
+    memset(&m_rgTag, 0, sizeof(rg_info_t));
+    m_f_r128 = false;
+    m_f_r128Arm = false;
+    m_rgXfB = 0;
+    if(m_rgGain != 1.0) { // web streams and the first part of a file play without ReplayGain
+        m_rgDb = 0;
+        setRgGain(1.0);
+    }
+    if(m_f_muted) { // fadeOut() before, the new stream fades in
+        m_f_muted = false;
+        m_f_mfIn = true;
+        m_mfLen = (uint32_t)m_mfMs * outputRate() / 1000;
+        m_mfPos = 0;
+    }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -823,7 +763,8 @@ bool Audio::connecttoFS(fs::FS& fs, const char* path, int32_t resumeFilePos) {
         const char *audioName = nullptr; // pointer for the final file path
         char *audioNameAlternative = nullptr; // possible buffer for alternative versions of the audioName
 
-        if (fs.exists(path)) { // use given path if it exists (issue #86)
+        audiofile = fs.open(path); // use given path if it exists (issue #86), exists() would open it as well
+        if (audiofile) {
             audioName = path;
         }
         else { // try alternative path variants
@@ -870,7 +811,7 @@ bool Audio::connecttoFS(fs::FS& fs, const char* path, int32_t resumeFilePos) {
         AUDIO_INFO("Reading file: \"%s\"", audioName);
         vTaskDelay(2);
 
-        audiofile = fs.open(audioName);
+        if (!audiofile) audiofile = fs.open(audioName);
 
         // free audioNameAlternative if used
         if (audioNameAlternative) {
@@ -889,34 +830,143 @@ bool Audio::connecttoFS(fs::FS& fs, const char* path, int32_t resumeFilePos) {
 
     setDatamode(AUDIO_LOCALFILE);
     m_file_size = audiofile.size(); // TEST loop
+    m_filePos = 0;
 
-    char* afn = NULL; // audioFileName
-    afn = strdup(audiofile.name());
+    m_codec = codecFromFileName(audiofile.name());
+
+    bool ret = initializeDecoder();
+    if(ret) {
+        m_f_running = true;
+        raOpen(&fs, audiofile.path()); // the read-ahead task opens its own handle
+    }
+    else audiofile.close();
+    xSemaphoreGiveRecursive(mutex_audio);
+    return ret;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t Audio::codecFromFileName(const char* name) {
+    uint8_t codec = CODEC_NONE;
+    char*   afn = strdup(name); // audioFileName
+    if(!afn) return codec;
 
     uint8_t dotPos = lastIndexOf(afn, ".");
     for(uint8_t i = dotPos + 1; i < strlen(afn); i++) { afn[i] = toLowerCase(afn[i]); }
 
-    if(endsWith(afn, ".mp3")) m_codec = CODEC_MP3; // m_codec is by default CODEC_NONE
-    if(endsWith(afn, ".m4a")) m_codec = CODEC_M4A;
-    if(endsWith(afn, ".aac")) m_codec = CODEC_AAC;
-    if(endsWith(afn, ".wav")) m_codec = CODEC_WAV;
-    if(endsWith(afn, ".flac")) m_codec = CODEC_FLAC;
-    if(endsWith(afn, ".opus")) m_codec = CODEC_OPUS;
-    if(endsWith(afn, ".ogg")) m_codec = CODEC_OGG;
-    if(endsWith(afn, ".oga")) m_codec = CODEC_OGG;
+    if(endsWith(afn, ".mp3")) codec = CODEC_MP3;
+    if(endsWith(afn, ".m4a")) codec = CODEC_M4A;
+    if(endsWith(afn, ".aac")) codec = CODEC_AAC;
+    if(endsWith(afn, ".wav")) codec = CODEC_WAV;
+    if(endsWith(afn, ".flac")) codec = CODEC_FLAC;
+    if(endsWith(afn, ".opus")) codec = CODEC_OPUS;
+    if(endsWith(afn, ".ogg")) codec = CODEC_OGG;
+    if(endsWith(afn, ".oga")) codec = CODEC_OGG;
+
+    if(codec == CODEC_NONE) AUDIO_INFO("The %s format is not supported", afn + dotPos);
+    free(afn);
+    return codec;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setNextFile(fs::FS& fs, const char* path) {
+    // gapless playback, call while the current file plays: the next file is opened and its head is read now,
+    // at the end of the current file processLocalFile() switches over without stopping the output
+    if(!path) return false;
+    if(getDatamode() != AUDIO_LOCALFILE) return false;
+    uint8_t codec = codecFromFileName(path);
+    if(codec == CODEC_NONE) return false;
+
+    File file = fs.open(path);
+    if(!file) {
+        AUDIO_INFO("Failed to open next file \"%s\"", path);
+        return false;
+    }
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    if(m_nextFile) m_nextFile.close(); // the audio task does not touch m_nextHead while m_nextFile is closed
+    if(!m_nextHead) m_nextHead = (uint8_t*)__malloc_heap_psram(m_nextHeadSize);
+    xSemaphoreGive(mutex_audio);
+    if(!m_nextHead) {
+        log_e("oom");
+        file.close();
+        return false;
+    }
+    uint32_t len = file.read(m_nextHead, m_nextHeadSize); // SD access outside the mutex
 
-    if(m_codec == CODEC_NONE) AUDIO_INFO("The %s format is not supported", afn + dotPos);
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    m_nextFile = file;
+    m_nextFs = &fs;
+    m_nextHeadLen = len;
+    m_nextCodec = codec;
+    xSemaphoreGive(mutex_audio);
+    AUDIO_INFO("Next file: \"%s\"", path);
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::clearNextFile() {
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    if(m_nextFile) m_nextFile.close();
+    xSemaphoreGive(mutex_audio);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::startNextFile() {
+    // end of audiofile, m_nextFile takes over the input side: new header, new decoder
+    // the output side (DMA, EQ, resampler, level meter) runs on, I2S is only touched if the samplerate changes
+    // and setOutputRate() is not used, the splice is sample accurate if the trimming data (LAME, iTunSMPB) are known
+    char* afn = strdup(audiofile.name());
+    audiofile.close();
+    MP3Decoder_FreeBuffers();
+    FLACDecoder_FreeBuffers();
+    AACDecoder_FreeBuffers();
+    OPUSDecoder_FreeBuffers();
+    VORBISDecoder_FreeBuffers();
+
+    audiofile = m_nextFile;
+    m_nextFile = File();
+    m_codec = m_nextCodec;
+    m_file_size = audiofile.size();
+
+    InBuff.resetBuffer();
+    uint32_t n = min(m_nextHeadLen, (uint32_t)InBuff.writeSpace());
+    memcpy(InBuff.getWritePtr(), m_nextHead, n);
+    InBuff.bytesWritten(n);
+    if(n < m_nextHeadLen) audiofile.seek(n);
+    m_filePos = n;
+    raOpen(m_nextFs, audiofile.path());
+
+    m_f_firstCall = true;
+    m_f_playing = false;
+    m_f_m4aID3dataAreRead = false;
+    m_controlCounter = 0;
+    m_resumeFilePos = 0;
+    m_audioCurrentTime = 0;
+    m_audioFileDuration = 0;
+    m_audioDataStart = 0;
+    m_audioDataSize = 0;
+    m_avr_bitrate = 0;
+    m_bitRate = 0;
+    m_bytesNotDecoded = 0;
+    m_contentlength = 0;
+    m_ID3Size = 0;
+    GL_reset(&m_glInfo);
+    GL_start(&m_trim, NULL);
+    if(m_seekMap) SM_reset(m_seekMap);
+    m_seekMs = -1;
+    m_f_seekTrim = false;
+    memset(&m_rgTag, 0, sizeof(rg_info_t)); // the gain changes when the header is read, rgTrackStart()
+
+    m_f_gaplessPrime = true;
+    m_gaplessT0 = micros();
+    m_f_spliceArmed = true;
+    if(xfActive() && m_xfFrames) { // crossfade over the end of the last track that is still in the ring
+        m_xfLen = XF_ringFill(&m_xfRing);
+        m_xfPos = 0;
+        m_f_spliceArmed = false; // overlapped, not spliced
+    }
+    if(!initializeDecoder()) m_f_gaplessPrime = false; // stopSong(), the application sees the end of playback
 
     if(afn) {
+        if(audio_eof_mp3) audio_eof_mp3(afn);
+        AUDIO_INFO("End of file \"%s\"", afn);
         free(afn);
-        afn = NULL;
     }
-
-    bool ret = initializeDecoder();
-    if(ret) m_f_running = true;
-    else audiofile.close();
-    xSemaphoreGiveRecursive(mutex_audio);
-    return ret;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::connecttospeech(const char* speech, const char* lang) {
@@ -1586,6 +1636,8 @@ int Audio::read_FLAC_Header(uint8_t* data, size_t len) {
         int        offset;
         size_t     l = bigEndian(data, 3);
 
+        RG_parse(data, min(l + 3, len), &m_rgTag); // REPLAYGAIN_*
+
         for(int i = 0; i < 7; i++) {
             offset = specialIndexOf(data, fn[i], len);
             if(offset >= 0) {
@@ -1799,6 +1851,7 @@ int Audio::read_ID3_Header(uint8_t* data, size_t len) {
 
         if( // any lyrics embedded in file, passing it to external function
             startsWith(tag, "SYLT") || startsWith(tag, "TXXX") || startsWith(tag, "USLT")) {
+            if(startsWith(tag, "TXXX")) RG_parse(data, min((size_t)framesize, len), &m_rgTag); // REPLAYGAIN_*
             if(getDatamode() == AUDIO_LOCALFILE) {
                 SYLT_seen = true;
                 SYLT_pos = id3Size - remainingHeaderBytes;
@@ -1809,6 +1862,7 @@ int Audio::read_ID3_Header(uint8_t* data, size_t len) {
 
         size_t fs = framesize;
         if(fs > 1024) fs = 1024;
+        if(startsWith(tag, "COMM")) GL_parseSmpb(data, fs, &m_glInfo); // iTunes gapless info
         for(int i = 0; i < fs; i++) { m_ibuff[i] = *(data + i); }
         framesize -= fs;
         remainingHeaderBytes -= fs;
@@ -2260,6 +2314,7 @@ size_t Audio::process_m3u8_ID3_Header(uint8_t* packet) {
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::stopSong() {
     uint32_t pos = 0;
+    outputFlush(!m_f_running && m_f_eofDrain); // at the end of a file the ring is played out, else dropped
     if(m_f_running) {
         m_f_running = false;
         if(getDatamode() == AUDIO_LOCALFILE) {
@@ -2269,6 +2324,9 @@ uint32_t Audio::stopSong() {
             AUDIO_INFO("Closing audio file");
         }
     }
+    raOpen(NULL, NULL);
+    if(m_nextFile) m_nextFile.close();
+    m_f_gaplessPrime = false;
     if(audiofile) {
         // added this before putting 'm_f_localfile = false' in stopSong(); shoulf never occur....
         audiofile.close();
@@ -2276,8 +2334,21 @@ uint32_t Audio::stopSong() {
         log_w("Closing audio file"); // for debug
     }
     memset(m_outBuff, 0, m_outbuffSize); // Clear OutputBuffer
-    memset(m_filterBuff, 0, sizeof(m_filterBuff)); // Clear FilterBuffer
+    BQ_reset(&m_eq); // Clear FilterBuffer
+    LM_reset(&m_meterAcc, &m_meterHold);
     m_validSamples = 0;
+    m_i2sStageBytes = 0;
+    m_i2sStageSent = 0;
+    resetResampler();
+    XF_ringReset(&m_xfRing);
+    m_xfLen = 0;
+    xSemaphoreTake(mutex_out, portMAX_DELAY);
+    LIM_reset(&m_lim);
+    xSemaphoreGive(mutex_out);
+    if(m_rgXfB) {
+        setRgGain(m_rgXfB);
+        m_rgXfB = 0;
+    }
     return pos;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -2287,9 +2358,12 @@ bool Audio::pauseResume() {
     if(getDatamode() == AUDIO_LOCALFILE || m_streamType == ST_WEBSTREAM || m_streamType == ST_WEBFILE) {
         m_f_running = !m_f_running;
         retVal = true;
-        if(!m_f_running) {
+        if(!m_f_running && !xfActive()) { // the ring keeps the decoded samples for resume
             memset(m_outBuff, 0, m_outbuffSize); // Clear OutputBuffer
             m_validSamples = 0;
+            m_i2sStageBytes = 0;
+            m_i2sStageSent = 0;
+            resetResampler();
         }
     }
     xSemaphoreGive(mutex_audio);
@@ -2298,6 +2372,324 @@ bool Audio::pauseResume() {
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::playChunk() {
 
+    uint32_t t0 = micros();
+    if(m_eqSelect != m_eqActive) applyEqualizer(); // preset switch, between two blocks
+    if(!m_f_blockOutput && !m_outRate && !m_outTask) { // the resampler and the output task need the block path
+        playChunkSamplewise();
+        m_statsOutputUs.fetch_add(micros() - t0, std::memory_order_relaxed);
+        return;
+    }
+
+    int16_t* blk = (int16_t*)m_i2sStage; // frames are processed in place as interleaved L/R int16
+    bool     ring = xfActive();
+    if(ring) xfFill();                   // the decoder runs ahead, I2S is fed from the ring
+
+    bool     task = m_outTask != NULL;   // the output task applies the volume and writes to I2S
+
+    while(task ? ringSpace() : flushI2SStage()) { // false: DMA (ring) is full, the rest is sent next time
+        uint16_t frames = ring ? xfBlock(blk) : sourceBlock(blk);
+        if(!frames) break;
+        if(ring && m_spOn) spectrumFeed(blk, frames, 2, outputRate()); // what is heard, not what is decoded
+        masterFade(blk, frames);
+        trackSilence(blk, frames);
+        processBlock(blk, frames);
+        if(task) {
+            if(m_f_limiter) PR_write(&m_pcmRing, m_limWork, frames);
+            else PR_write16(&m_pcmRing, blk, frames);
+        }
+        else {
+            m_i2sStageBytes = packBlock(blk, frames) * sizeof(uint32_t);
+            m_i2sStageSent = 0;
+        }
+        if(m_rgXfB && !m_xfLen) { // the crossfade ended in this block, it was scaled for the larger gain (xfBlock)
+            setRgGain(m_rgXfB);
+            m_rgXfB = 0;
+        }
+    }
+    m_statsOutputUs.fetch_add(micros() - t0, std::memory_order_relaxed);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::trackSilence(const int16_t* blk, uint16_t frames) {
+    // length of the digital silence around a gapless track change (stats.gaplessSilentFrames), 0 if the splice is
+    // seamless, the trailing zeros of every block are counted, usually the backward scan stops at the last frame
+    uint16_t i = frames;
+    while(i && !blk[2 * i - 2] && !blk[2 * i - 1]) i--;
+    if(!i) {
+        m_zeroRun += frames;
+        return;
+    }
+    if(m_f_spliceArmed && !m_f_gaplessPrime) {
+        uint16_t lead = 0;
+        while(!blk[2 * lead] && !blk[2 * lead + 1]) lead++;
+        m_stats.gaplessSilentFrames = m_zeroRun + lead;
+        m_f_spliceArmed = false;
+    }
+    m_zeroRun = frames - i;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t Audio::sourceBlock(int16_t* blk) {
+    // up to m_i2sStageFrames decoded frames at the output rate
+    if(m_outRate) return resampleBlock(blk);
+    return m_validSamples ? fillI2SStage(blk) : 0;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::xfFill() {
+    // the ring holds the next seconds of the output, so the end of a track is still there when the next one starts
+    if(!m_xfTmp || !m_xfFrames || m_xfLen) return; // off, or crossfading: the incoming track goes to the mixer
+    while(XF_ringFree(&m_xfRing) >= m_i2sStageFrames) {
+        uint16_t n = sourceBlock(m_xfTmp);
+        if(!n) break;
+        XF_ringWrite(&m_xfRing, m_xfTmp, n);
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t Audio::xfBlock(int16_t* blk) {
+    if(!m_xfLen) {
+        uint16_t n = XF_ringRead(&m_xfRing, blk, m_i2sStageFrames);
+        if(n || m_xfFrames) return n;
+        free(m_xfRing.buff); // crossfade switched off and the ring is played out
+        m_xfRing.buff = NULL;
+        return sourceBlock(blk);
+    }
+    // crossfade: the ring holds the end of the last track, the decoder delivers the next one
+    uint32_t c0 = ESP.getCycleCount();
+    uint16_t n = sourceBlock(m_xfTmp);
+    if(!n) return 0; // the next track is not decoded yet, the DMA plays on
+    uint16_t na = min((uint32_t)n, XF_ringFill(&m_xfRing));
+    XF_ringRead(&m_xfRing, blk, na);
+    uint32_t p0 = m_xfPos, p1 = m_xfPos + na;
+    double   ka = 1.0, kb = 1.0; // ReplayGain, the volume has the larger of both gains
+    if(m_rgXfB) {
+        ka = m_rgXfA / m_rgGain;
+        kb = m_rgXfB / m_rgGain;
+    }
+    XF_mix(blk, m_xfTmp, na, ka * XF_gain(m_xfCurve, m_xfLen - p0, m_xfLen), ka * XF_gain(m_xfCurve, m_xfLen - p1, m_xfLen),
+           kb * XF_gain(m_xfCurve, p0, m_xfLen), kb * XF_gain(m_xfCurve, p1, m_xfLen));
+    memcpy(blk + 2 * na, m_xfTmp + 2 * na, (n - na) * 2 * sizeof(int16_t)); // the fade is over
+    if(kb < 1.0) XF_ramp(blk + 2 * na, n - na, kb * XF_UNITY, kb * XF_UNITY);
+    m_xfPos = p1;
+    if(!XF_ringFill(&m_xfRing)) m_xfLen = 0; // the gain of the next track follows this block, see playChunk()
+    m_statsXfCycles += ESP.getCycleCount() - c0;
+    m_statsXfBlocks++;
+    return n;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::masterFade(int16_t* blk, uint16_t frames) {
+    // fadeOut() and the fade in of the next stream, before the EQ and the volume
+    if(m_f_muted) {
+        memset(blk, 0, frames * 2 * sizeof(int16_t));
+        return;
+    }
+    if(!m_mfLen) return;
+    uint32_t p0 = m_mfPos, p1 = min(m_mfPos + frames, m_mfLen);
+    if(m_f_mfIn) XF_ramp(blk, frames, XF_gain(m_xfCurve, p0, m_mfLen), XF_gain(m_xfCurve, p1, m_mfLen));
+    else XF_ramp(blk, frames, XF_gain(m_xfCurve, m_mfLen - p0, m_mfLen), XF_gain(m_xfCurve, m_mfLen - p1, m_mfLen));
+    m_mfPos = p1;
+    if(m_mfPos < m_mfLen) return;
+    m_mfLen = 0;
+    if(!m_f_mfIn) m_f_muted = true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t Audio::resampleBlock(int16_t* blk) {
+    // fills blk with up to m_i2sStageFrames frames at m_outRate, the decoded frames pass m_rsIn
+    uint16_t frames = 0;
+    uint32_t c0 = ESP.getCycleCount();
+    while(frames < m_i2sStageFrames) {
+        if(m_rsInPos == m_rsInFrames) {
+            if(!m_validSamples && m_strInPos == m_strInFrames) break;
+            m_rsInFrames = stretchBlock(m_rsIn);
+            m_rsInPos = 0;
+            if(!m_rsInFrames) break;
+        }
+        uint16_t used = 0;
+        frames += RS_process(&m_rs, m_rsIn + m_rsInPos * 2, m_rsInFrames - m_rsInPos, &used, blk + frames * 2,
+                             m_i2sStageFrames - frames);
+        m_rsInPos += used;
+    }
+    if(!m_rs.bypass || m_speedQ16 != 65536) {
+        m_statsRsCycles += ESP.getCycleCount() - c0;
+        m_statsRsFrames += frames;
+    }
+    return frames;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t Audio::stretchBlock(int16_t* blk) {
+    // audioFileSeek(speed) in fixed-rate mode, the decoded frames pass m_strIn and the WSOLA stage at the stream rate
+    if(!m_strBuf || (m_str.speedQ16 == 65536 && m_strInPos == m_strInFrames)) return fillI2SStage(blk);
+    uint16_t frames = 0;
+    while(frames < m_i2sStageFrames) {
+        if(m_strInPos == m_strInFrames) {
+            if(!m_validSamples) break;
+            m_strInFrames = fillI2SStage(m_strIn);
+            m_strInPos = 0;
+            if(!m_strInFrames) break;
+        }
+        uint16_t used = 0;
+        frames += TS_process(&m_str, m_strIn + m_strInPos * 2, m_strInFrames - m_strInPos, &used, blk + frames * 2,
+                             m_i2sStageFrames - frames);
+        m_strInPos += used;
+    }
+    return frames;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::resetResampler() {
+    m_rsInFrames = 0;
+    m_rsInPos = 0;
+    if(m_rsCoef) RS_reset(&m_rs);
+    m_strInFrames = 0;
+    m_strInPos = 0;
+    if(m_strBuf) TS_reset(&m_str);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t Audio::fillI2SStage(int16_t* blk) {
+    // copies up to one DMA descriptor of frames from m_outBuff into blk (L/R int16), 8 bit samples are expanded here
+    // m_curSample and m_validSamples count m_outBuff units (8bit: words, 16bit: samples per channel)
+
+    uint16_t frames = 0;
+    uint8_t  bps = getBitsPerSample();
+    uint8_t  ch = getChannels();
+
+    while(m_validSamples && frames < m_i2sStageFrames) {
+        int16_t* s = blk + frames * 2;
+        if(bps == 8) {
+            uint16_t w = m_outBuff[m_curSample];
+            int16_t  x = ((w & 0x00FF) - 128) << 8; // upsample from unsigned 8 bits to signed 16 bits
+            int16_t  y = (((w & 0xFF00) >> 8) - 128) << 8;
+            if(ch == 1) {
+                if(frames + 2 > m_i2sStageFrames) break; // one word holds two mono samples
+                s[LEFTCHANNEL] = x; s[RIGHTCHANNEL] = x;
+                s[LEFTCHANNEL + 2] = y; s[RIGHTCHANNEL + 2] = y;
+                frames += 2;
+            }
+            else {
+                if(!m_f_forceMono) { s[RIGHTCHANNEL] = x; s[LEFTCHANNEL] = y; }
+                else { s[RIGHTCHANNEL] = (x + y) / 2; s[LEFTCHANNEL] = s[RIGHTCHANNEL]; }
+                frames++;
+            }
+        }
+        else {
+            if(ch == 1) {
+                s[RIGHTCHANNEL] = m_outBuff[m_curSample];
+                s[LEFTCHANNEL] = m_outBuff[m_curSample];
+            }
+            else if(!m_f_forceMono) { // stereo mode
+                s[RIGHTCHANNEL] = m_outBuff[m_curSample * 2];
+                s[LEFTCHANNEL] = m_outBuff[m_curSample * 2 + 1];
+            }
+            else { // mono mode, #100
+                int16_t xy = (m_outBuff[m_curSample * 2] + m_outBuff[m_curSample * 2 + 1]) / 2;
+                s[RIGHTCHANNEL] = xy;
+                s[LEFTCHANNEL] = xy;
+            }
+            frames++;
+        }
+        m_validSamples--;
+        m_curSample++;
+    }
+    return frames;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::processBlock(int16_t* blk, uint16_t frames) {
+    // same chain as playSample(), one pass over the whole block
+    if(m_f_limiter) { // 32 bit from here on, an EQ boost above full scale goes to the limiter
+        uint32_t c0 = ESP.getCycleCount();
+        BQ_processWide(&m_eq, blk, m_limWork, frames);
+        if(m_eq.numStages) {
+            m_statsEqCycles += ESP.getCycleCount() - c0;
+            m_statsEqFrames += frames;
+        }
+        LM_accumulate32(&m_meterAcc, m_limWork, frames);
+        publishLevel();
+        return;
+    }
+    if(m_eq.numStages) { // else all gains 0 dB
+        uint32_t c0 = ESP.getCycleCount();
+        BQ_process(&m_eq, blk, frames); // the correction factor (m_corr) is part of the first stage
+        m_statsEqCycles += ESP.getCycleCount() - c0;
+        m_statsEqFrames += frames;
+    }
+    LM_accumulate(&m_meterAcc, blk, frames); // level after the EQ, before the volume
+    publishLevel();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::volumeTarget() {
+    // the volume moves to m_volQ16 over m_volRampMs, a knob that is turned does not zip
+    int32_t tl = m_volQ16[LEFTCHANNEL], tr = m_volQ16[RIGHTCHANNEL];
+    if(!m_f_limiter) { // without the limiter a ReplayGain boost is limited by the volume headroom
+        tl = min(tl, (int32_t)VOL_UNITY_Q16);
+        tr = min(tr, (int32_t)VOL_UNITY_Q16);
+    }
+    if(tl != m_volRamp.target[LEFTCHANNEL] || tr != m_volRamp.target[RIGHTCHANNEL]) VOL_setTarget(&m_volRamp, tl, tr);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t Audio::packBlock(int16_t* blk, uint16_t frames) {
+    // applies the volume, packs the frames to 32 bit I2S words (in place) and returns the number of frames to send
+    if(m_f_limiter) gainBlock(m_limWork, blk, frames); // m_limWork from processBlock()
+    else {
+        volumeTarget();
+        VOL_process16(&m_volRamp, blk, frames);
+    }
+    return packWords(blk, m_i2sStage, frames);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::gainBlock(int32_t* work, int16_t* blk, uint16_t frames) {
+    // 32 bit frames: volume and ReplayGain without the 1.0 limit, then the limiter (saturation if it is off) to blk
+    volumeTarget();
+    if(!m_f_limiter) {
+        VOL_process32(&m_volRamp, work, frames);
+        for(uint16_t i = 0; i < frames * 2; i++) blk[i] = (work[i] > 32767) ? 32767 : (work[i] < -32768) ? -32768 : work[i];
+        return;
+    }
+    uint32_t c0 = ESP.getCycleCount();
+    VOL_process32(&m_volRamp, work, frames);
+    LIM_process(&m_lim, work, blk, frames);
+    uint16_t g = LIM_takeMinGain(&m_lim);
+    m_limGain.store(g, std::memory_order_relaxed);
+    if(g < m_statsLimMin) m_statsLimMin = g;
+    m_statsLimCycles += ESP.getCycleCount() - c0;
+    m_statsLimFrames += frames;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t Audio::packWords(int16_t* blk, uint32_t* out, uint16_t frames) {
+    // L/R int16 -> 32 bit I2S words, out may be blk, returns the number of words
+    uint16_t n = 0;
+    for(uint16_t i = 0; i < frames; i++) {
+        uint32_t s32 = ((uint32_t)blk[i * 2] << 16) | (uint16_t)blk[i * 2 + 1];
+        if(audio_process_i2s) {
+            bool continueI2S = false;
+            audio_process_i2s(&s32, &continueI2S);
+            if(!continueI2S) continue; // consumed by the callback
+        }
+        if(m_f_internalDAC) { s32 += 0x80008000; }
+        out[n++] = s32;
+    }
+    return n;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::flushI2SStage() {
+    // returns true if the stage is empty, a partial write is continued at the next call
+    while(m_i2sStageSent < m_i2sStageBytes) {
+        m_i2s_bytesWritten = 0;
+#if(ESP_IDF_VERSION_MAJOR == 5)
+        esp_err_t err = i2s_channel_write(m_i2s_tx_handle, (const char*)m_i2sStage + m_i2sStageSent, m_i2sStageBytes - m_i2sStageSent, &m_i2s_bytesWritten, 0);
+#else
+        esp_err_t err = i2s_write((i2s_port_t)m_i2s_num, (const char*)m_i2sStage + m_i2sStageSent, m_i2sStageBytes - m_i2sStageSent, &m_i2s_bytesWritten, 0); // no wait
+#endif
+        m_statsI2sWrites++;
+        m_i2sStageSent += m_i2s_bytesWritten;
+        if(err != ESP_OK) {
+            if(err != ESP_ERR_TIMEOUT) { log_e("ESP32 Errorcode: %i", err); }
+            return false;
+        }
+        if(!m_i2s_bytesWritten) return false; // no more space in dma buffer --> try it later
+    }
+    m_i2sStageBytes = 0;
+    m_i2sStageSent = 0;
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::playChunkSamplewise() {
+
     int16_t sample[2];
 
     auto pc = [&](int16_t* s16) { // lambda, inner function
@@ -2360,13 +2752,20 @@ void Audio::playChunk() {
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::loop() {
+    m_statsLoops++;
     if(!m_f_running) return;
 
     xSemaphoreTake(mutex_audio, portMAX_DELAY);
 
     if(m_playlistFormat != FORMAT_M3U8) { // normal process
         switch(getDatamode()) {
-            case AUDIO_LOCALFILE: processLocalFile(); break;
+            case AUDIO_LOCALFILE:
+                processLocalFile();
+                for(uint8_t i = 0; i < 32 && m_f_gaplessPrime && m_f_running; i++) processLocalFile(); // header of the next file
+                for(uint8_t i = 0; i < 16 && m_outTask && m_f_running && PR_fill(&m_pcmRing) < m_pcmRing.size / 2; i++) {
+                    processLocalFile(); // decode ahead, the output task runs on its own
+                }
+                break;
             case HTTP_RESPONSE_HEADER: parseHttpResponseHeader(); break;
             case AUDIO_PLAYLISTINIT: readPlayListData(); break;
             case AUDIO_PLAYLISTDATA:
@@ -2415,9 +2814,441 @@ void Audio::loop() {
                 break;
         }
     }
+    updateAudioStats();
+    xSemaphoreGive(mutex_audio);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t Audio::waitForWork(uint32_t maxMs) {
+    // the task that calls loop() sleeps until the output needs data: a quarter of the I2S DMA descriptors was sent
+    // or, with the output task, the PCM ring is below half, returns at once while the input buffer is below its
+    // low water mark and more data can be read, maxMs covers the network and the state machine
+    // returns the number of wakes from the I2S interrupt (0: timeout or input)
+    m_wakeTask = xTaskGetCurrentTaskHandle();
+    if(m_wakeBurst < 8 && inputLow()) {
+        m_wakeBurst++;
+        m_statsWakeInput++;
+        return 0;
+    }
+    m_wakeBurst = 0;
+    m_dmaSent = 0;
+    uint32_t n = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(maxMs));
+    if(n) m_statsWakeEvent++;
+    else m_statsWakeTimeout++;
+    return n;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::inputLow() {
+    // less than two frames in the input buffer and the source has more
+    if(!m_f_running || InBuff.bufferFilled() >= 2u * InBuff.getMaxBlockSize()) return false;
+    if(getDatamode() == AUDIO_LOCALFILE) {
+        if(m_raTask) return audiofile && RA_fill(&m_raRing) > 0; // loop() would only copy from the ring
+        return audiofile && audiofile.position() < audiofile.size();
+    }
+    if(getDatamode() == AUDIO_DATA) return _client && _client->available() > 0;
+    return false;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#if ESP_IDF_VERSION_MAJOR == 5
+bool IRAM_ATTR Audio::i2sSentCb(i2s_chan_handle_t handle, i2s_event_data_t* event, void* ctx) {
+    Audio*       a = (Audio*)ctx;
+    TaskHandle_t t = a->m_wakeTask;
+    if(!t || !a->m_f_running) return false; // auto_clear keeps the DMA running when idle
+    if(a->m_outTask) {
+        // the ring is the low water mark, its counters are read here: PR_fill() is not in IRAM if it isn't inlined
+        uint32_t fill = a->m_pcmRing.wr.load(std::memory_order_relaxed) - a->m_pcmRing.rd.load(std::memory_order_relaxed);
+        if(fill >= a->m_pcmRing.size / 2) return false;
+    }
+    else if(++a->m_dmaSent < a->m_wakeDescs) return false;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(t, &woken);
+    return woken == pdTRUE;
+}
+
+bool IRAM_ATTR Audio::i2sOvfCb(i2s_chan_handle_t handle, i2s_event_data_t* event, void* ctx) {
+    Audio* a = (Audio*)ctx;
+    if(a->m_f_running) a->m_dmaUnderruns++;
+    return false;
+}
+#endif
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::updateAudioStats() {
+    uint32_t now = millis();
+    if(now - m_statsTime < 1000) return;
+    uint32_t dt = now - m_statsTime;
+    m_statsTime = now;
+    xSemaphoreTake(mutex_out, portMAX_DELAY); // counters of the output task
+    m_stats.i2sWritesPerSec = (uint64_t)m_statsI2sWrites * 1000 / dt;
+    m_stats.wakeupsPerSec = (uint64_t)m_statsLoops * 1000 / dt;
+    m_stats.wakeEventPerSec = (uint64_t)m_statsWakeEvent * 1000 / dt;
+    m_stats.wakeInputPerSec = (uint64_t)m_statsWakeInput * 1000 / dt;
+    m_stats.wakeTimeoutPerSec = (uint64_t)m_statsWakeTimeout * 1000 / dt;
+    m_stats.dmaUnderruns = m_dmaUnderruns;
+    m_stats.framesPerSec = (uint64_t)m_statsFrames * 1000 / dt;
+    uint32_t outputUs = m_statsOutputUs.exchange(0); // the decoder task adds to it without the mutex
+    m_stats.cpuUsPerFrame = m_statsFrames ? (m_statsDecodeUs + outputUs) / m_statsFrames : 0;
+    m_stats.outputUsPerFrame = m_statsFrames ? outputUs / m_statsFrames : 0;
+    m_stats.eqCyclesPerSample = m_statsEqFrames ? m_statsEqCycles / m_statsEqFrames : 0;
+    m_stats.resamplerCyclesPerSample = m_statsRsFrames ? m_statsRsCycles / m_statsRsFrames : 0;
+    m_stats.mixCyclesPerBlock = m_statsXfBlocks ? m_statsXfCycles / m_statsXfBlocks : 0;
+    m_stats.loudnessCyclesPerSample = m_statsLnFrames ? m_statsLnCycles / m_statsLnFrames : 0;
+    m_stats.limiterCyclesPerSample = m_statsLimFrames ? m_statsLimCycles / m_statsLimFrames : 0;
+    m_stats.limiterMaxReduction = lroundf(-200 * log10f(m_statsLimMin / (float)LIM_UNITY));
+    if(m_outTask) {
+        uint32_t fill = PR_fill(&m_pcmRing);
+        uint32_t low = m_ringMin.exchange(UINT32_MAX);
+        m_stats.ringFrames = fill;
+        m_stats.ringUnderruns = m_ringUnderruns;
+        m_stats.decodeAheadMs = (uint64_t)min(low, fill) * 1000 / outputRate();
+    }
+    if(m_raTask) {
+        uint32_t us = m_raUs.exchange(0);
+        uint32_t bytes = m_raBytes.exchange(0);
+        uint32_t br = m_avr_bitrate ? m_avr_bitrate : m_bitRate;
+        m_stats.sdReadKBytesPerSec = us ? (uint64_t)bytes * 1000000 / 1024 / us : 0;
+        m_stats.sdReadMaxUs = m_raMaxUs.exchange(0);
+        m_stats.readAheadMs = br ? (uint64_t)RA_fill(&m_raRing) * 8000 / br : 0;
+    }
+    m_statsI2sWrites = 0;
+    m_statsLoops = 0;
+    m_statsWakeEvent = m_statsWakeInput = m_statsWakeTimeout = 0;
+    m_statsFrames = 0;
+    m_statsDecodeUs = 0;
+    m_statsEqCycles = 0;
+    m_statsEqFrames = 0;
+    m_statsRsCycles = 0;
+    m_statsRsFrames = 0;
+    m_statsXfCycles = 0;
+    m_statsXfBlocks = 0;
+    m_statsLnCycles = 0;
+    m_statsLnFrames = 0;
+    m_statsLimCycles = 0;
+    m_statsLimFrames = 0;
+    m_statsLimMin = LIM_UNITY;
+    xSemaphoreGive(mutex_out);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::getAudioStats(audio_stats_t* stats) {
+    if(!stats) return;
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    *stats = m_stats;
+    xSemaphoreGive(mutex_audio);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setBlockOutput(bool block) {
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    while(!block && m_i2sStageBytes && !flushI2SStage()) { vTaskDelay(1); } // don't lose staged frames
+    m_f_blockOutput = block;
+    xSemaphoreGive(mutex_audio);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::startOutputTask(uint16_t ringMs, uint8_t core, uint8_t prio) {
+    // two stages: loop() reads and decodes into a PCM ring (PSRAM), a task on 'core' takes the frames, applies the
+    // volume and the limiter and blocks in the I2S driver, a slow SD card or network read only costs ring fill
+    // the ring holds at least ringMs at 48 kHz (power of two), levels and spectrum are ahead by the fill
+    if(m_outTask) return true;
+    if(ringMs < 50) ringMs = 50;
+    if(ringMs > 2000) ringMs = 2000;
+    uint32_t frames = m_i2sStageFrames * 2;
+    while(frames < (uint32_t)ringMs * 48) frames <<= 1;
+    int32_t* buff = (int32_t*)heap_caps_malloc(frames * 2 * sizeof(int32_t), MALLOC_CAP_SPIRAM);
+    if(!buff) buff = (int32_t*)heap_caps_malloc(frames * 2 * sizeof(int32_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+    m_outWork = (int32_t*)heap_caps_malloc(m_i2sStageFrames * 2 * sizeof(int32_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+    m_outStage = (uint32_t*)heap_caps_malloc(m_i2sStageFrames * sizeof(uint32_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+    if(!buff || !m_outWork || !m_outStage) {
+        if(buff) free(buff);
+        if(m_outWork) {free(m_outWork); m_outWork = NULL;}
+        if(m_outStage) {free(m_outStage); m_outStage = NULL;}
+        log_e("oom");
+        return false;
+    }
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    while(m_i2sStageBytes && !flushI2SStage()) { vTaskDelay(1); } // the staged frames go first
+    PR_init(&m_pcmRing, buff, frames);
+    m_rgMarkRd = m_rgMarkWr = 0;
+    m_f_outFlush = false;
+    m_f_outExit = false;
+    m_f_outRun = true;
+    m_ringUnderruns = 0;
+    if(xTaskCreatePinnedToCore(outputTask, "audioOut", 3072, this, prio, &m_outTask, core) != pdPASS) {
+        m_outTask = NULL;
+        m_f_outRun = false;
+    }
+    xSemaphoreGive(mutex_audio);
+    if(!m_outTask) {
+        free(buff);
+        m_pcmRing.buff = NULL;
+        log_e("output task not created");
+        return false;
+    }
+    AUDIO_INFO("output task, ring %lu frames", (long unsigned int)frames);
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::stopOutputTask() {
+    if(!m_outTask) return;
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    m_f_outRun = false;
+    while(!m_f_outExit) vTaskDelay(1); // at most one DMA buffer
+    m_outTask = NULL;
+    xSemaphoreTake(mutex_out, portMAX_DELAY);
+    m_rgQ16 = min(m_rgGain, 16.0) * VOL_UNITY_Q16; // a change that is still in the ring
+    computeLimit();
+    xSemaphoreGive(mutex_out);
+    free(m_pcmRing.buff);
+    m_pcmRing.buff = NULL;
+    free(m_outWork);
+    m_outWork = NULL;
+    free(m_outStage);
+    m_outStage = NULL;
+    xSemaphoreGive(mutex_audio);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::outputFlush(bool drain) {
+    // decoder side, the ring is empty when this returns, drain: the output task plays it out first
+    if(!m_outTask) return;
+    uint32_t t0 = millis();
+    uint32_t maxMs = (uint64_t)m_pcmRing.size * 1000 / outputRate() + 100;
+    while(drain && PR_fill(&m_pcmRing) && millis() - t0 < maxMs) vTaskDelay(1);
+    m_f_outFlush = true;
+    t0 = millis();
+    while(m_f_outFlush && millis() - t0 < 200) vTaskDelay(1);
+    m_f_eofDrain = false;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::outputTask(void* param) {
+    Audio* a = (Audio*)param;
+    a->outputLoop();
+    a->m_f_outExit = true;
+    vTaskDelete(NULL);
+}
+
+void Audio::outputLoop() {
+    // consumer of m_pcmRing, never takes mutex_audio, the I2S driver paces the task
+    int16_t* blk = (int16_t*)m_outStage; // packed in place
+    bool     primed = false;              // frames were sent since the last flush / underrun
+    while(m_f_outRun) {
+        if(m_f_outFlush) {
+            PR_drop(&m_pcmRing);
+            primed = false;
+            m_f_outFlush = false;
+        }
+        uint32_t next = rgMarkers(m_pcmRing.rd.load(std::memory_order_relaxed)); // a gain change is not mixed into a block
+        bool     play = m_f_running || m_f_eofDrain; // paused: the ring is kept for resume
+        uint32_t fill = PR_fill(&m_pcmRing);
+        if(play && fill < m_ringMin) m_ringMin = fill;
+        if(!play || !fill) {
+            if(!fill) {
+                if(primed && m_f_running) m_ringUnderruns++;
+                primed = false;
+                m_f_eofDrain = false;
+            }
+            vTaskDelay(1);
+            continue;
+        }
+        primed = true;
+        uint16_t frames = PR_read(&m_pcmRing, m_outWork, min(min(fill, next), (uint32_t)m_i2sStageFrames));
+        xSemaphoreTake(mutex_out, portMAX_DELAY);
+        uint32_t t0 = micros();
+        gainBlock(m_outWork, blk, frames);
+        size_t bytes = packWords(blk, m_outStage, frames) * sizeof(uint32_t);
+        size_t sent = 0;
+        while(sent < bytes && !m_f_outFlush && m_f_outRun) {
+            size_t written = 0;
+#if(ESP_IDF_VERSION_MAJOR == 5)
+            esp_err_t err = i2s_channel_write(m_i2s_tx_handle, (const char*)m_outStage + sent, bytes - sent, &written, 20);
+#else
+            esp_err_t err = i2s_write((i2s_port_t)m_i2s_num, (const char*)m_outStage + sent, bytes - sent, &written, 20);
+#endif
+            m_statsI2sWrites++;
+            sent += written;
+            if(err != ESP_OK) {
+                if(err != ESP_ERR_TIMEOUT) log_e("ESP32 Errorcode: %i", err);
+                if(!written) break; // the channel is stopped, drop the block
+            }
+        }
+        m_statsOutputUs.fetch_add(micros() - t0, std::memory_order_relaxed);
+        xSemaphoreGive(mutex_out);
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::startReadAhead(uint8_t seconds, uint16_t chunkKB, uint8_t core, uint8_t prio) {
+    // local files: a task on 'core' reads ahead into a PSRAM ring with its own handle of the file, every read ends on
+    // a multiple of the chunk size (32 ... 128 KB) in the file, that is whole sectors and clusters for FAT, loop() only
+    // copies from the ring, a cluster chain walk or a slow card costs ring fill instead of decode time
+    // 'seconds' of compressed audio are kept ahead, the ring holds them for CD quality WAV
+    if(m_raTask) return true;
+    if(seconds < 1) seconds = 1;
+    if(seconds > 10) seconds = 10;
+    uint32_t chunk = 32 * 1024;
+    while(chunk < chunkKB * 1024u && chunk < 128 * 1024) chunk <<= 1;
+    uint32_t size = chunk * 4;
+    while(size < (uint32_t)seconds * 176400) size <<= 1;
+    uint8_t* buff = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    uint32_t stageSize = chunk; // the SD driver reads into PSRAM sector by sector, the stage takes one DMA transfer
+    uint8_t* stage = NULL;
+    while(!(stage = (uint8_t*)heap_caps_malloc(stageSize, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL)) && stageSize > 4096) stageSize >>= 1;
+    if(!buff || !stage) {
+        if(buff) free(buff);
+        if(stage) free(stage);
+        log_e("oom");
+        return false;
+    }
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    RA_init(&m_raRing, buff, size);
+    m_raStage = stage;
+    m_raStageSize = stageSize;
+    m_raChunk = chunk;
+    m_raSeconds = seconds;
+    m_raTarget = size;
+    m_raFs = NULL;
+    m_raReqPos = RA_NO_POS;
+    m_raReqGen = 0;
+    m_raAckGen = 0;
+    m_f_raFailed = false;
+    m_f_raExit = false;
+    m_f_raRun = true;
+    if(xTaskCreatePinnedToCore(readAheadTask, "audioRead", 4096, this, prio, &m_raTask, core) != pdPASS) {
+        m_raTask = NULL;
+        m_f_raRun = false;
+    }
+    xSemaphoreGive(mutex_audio);
+    if(!m_raTask) {
+        free(buff);
+        free(stage);
+        m_raRing.buff = NULL;
+        m_raStage = NULL;
+        log_e("read-ahead task not created");
+        return false;
+    }
+    AUDIO_INFO("read-ahead task, ring %lu KB, chunk %lu KB, stage %lu KB", (long unsigned int)size / 1024,
+               (long unsigned int)chunk / 1024, (long unsigned int)stageSize / 1024);
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::stopReadAhead() {
+    if(!m_raTask) return;
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    m_f_raRun = false;
+    xTaskNotifyGive(m_raTask);
+    while(!m_f_raExit) vTaskDelay(1); // at most one stage read
+    m_raTask = NULL;
+    free(m_raRing.buff);
+    m_raRing.buff = NULL;
+    free(m_raStage);
+    m_raStage = NULL;
+    if(audiofile) audiofile.seek(m_filePos); // loop() reads the file itself again
     xSemaphoreGive(mutex_audio);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+int32_t Audio::readLocal(uint8_t* dst, uint32_t len, uint32_t pos) {
+    // processLocalFile(): up to len bytes of audiofile from pos, with the read-ahead task out of its ring, 0 while the
+    // task is on its way (the input and PCM buffers cover that), a seek costs a new request
+    if(!m_raTask) return audiofile.read(dst, len);
+    uint32_t br = m_avr_bitrate ? m_avr_bitrate : m_bitRate;
+    m_raTarget = br ? min((uint32_t)((uint64_t)br * m_raSeconds / 8), m_raRing.size) : m_raRing.size;
+    bool    ready = m_raAckGen.load(std::memory_order_acquire) == m_raReqGen.load(std::memory_order_relaxed) && m_raReqPos != RA_NO_POS;
+    int32_t n = 0;
+    if(ready && m_f_raFailed) { // the task can't read this file, do it here
+        if(audiofile.position() != pos) audiofile.seek(pos);
+        n = audiofile.read(dst, len);
+    }
+    else if(ready && RA_seek(&m_raRing, pos)) {
+        n = RA_read(&m_raRing, dst, len);
+        if(n && RA_fill(&m_raRing) + m_raChunk <= m_raTarget) xTaskNotifyGive(m_raTask); // room for a chunk
+    }
+    else if(ready || m_raReqPos != pos) raRequest(pos);
+    if(n > 0) m_filePos = pos + n;
+    return n;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::raOpen(fs::FS* fs, const char* path) {
+    // the read-ahead task (re)opens path, NULL closes its file, the position follows with the first readLocal()
+    if(!m_raTask) return;
+    xSemaphoreTake(mutex_ra, portMAX_DELAY);
+    m_raFs = path ? fs : NULL;
+    if(path) strlcpy(m_raPath, path, sizeof(m_raPath));
+    m_raFileGen++;
+    m_raReqPos = RA_NO_POS;
+    m_raReqGen++;
+    xSemaphoreGive(mutex_ra);
+    xTaskNotifyGive(m_raTask);
+}
+
+void Audio::raRequest(uint32_t pos) {
+    xSemaphoreTake(mutex_ra, portMAX_DELAY);
+    m_raReqPos = pos;
+    m_raReqGen++;
+    xSemaphoreGive(mutex_ra);
+    xTaskNotifyGive(m_raTask);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::readAheadTask(void* param) {
+    Audio* a = (Audio*)param;
+    a->readAheadLoop();
+    a->m_f_raExit = true;
+    vTaskDelete(NULL);
+}
+
+void Audio::readAheadLoop() {
+    // producer of m_raRing, never takes mutex_audio, a new request discards what is being read
+    File     file;
+    uint32_t size = 0;
+    uint32_t gen = 0;     // request the ring belongs to
+    uint32_t fileGen = 0;
+    bool     idle = true; // no position, error or end of file
+    char     path[sizeof(m_raPath)];
+    while(m_f_raRun) {
+        uint32_t req = m_raReqGen.load(std::memory_order_acquire);
+        if(req != gen) {
+            xSemaphoreTake(mutex_ra, portMAX_DELAY);
+            req = m_raReqGen;
+            fs::FS*  fs = m_raFs;
+            uint32_t fg = m_raFileGen;
+            uint32_t pos = m_raReqPos;
+            if(fg != fileGen) strcpy(path, m_raPath);
+            xSemaphoreGive(mutex_ra);
+            if(fg != fileGen) { // directory lookup and FAT access here, not in loop()
+                if(file) file.close();
+                if(fs) file = fs->open(path);
+                size = file ? file.size() : 0;
+                fileGen = fg;
+            }
+            bool ok = file && pos != RA_NO_POS && pos <= size && file.seek(pos);
+            RA_reset(&m_raRing, ok ? pos : 0);
+            m_f_raFailed = !ok && pos != RA_NO_POS;
+            idle = !ok;
+            gen = req;
+            m_raAckGen.store(gen, std::memory_order_release);
+            continue;
+        }
+        uint32_t wr = m_raRing.wr.load(std::memory_order_relaxed);
+        uint32_t n = m_raChunk - (wr & (m_raChunk - 1)); // up to the next chunk boundary of the file
+        if(!idle && n > size - wr) n = size - wr;
+        if(idle || !n || RA_fill(&m_raRing) >= m_raTarget || RA_free(&m_raRing) < n) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            continue;
+        }
+        uint32_t t0 = micros();
+        uint32_t got = 0;
+        while(got < n && m_raReqGen.load(std::memory_order_relaxed) == gen) {
+            uint32_t len = min(n - got, m_raStageSize);
+            int32_t  r = file.read(m_raStage, len);
+            if(r > 0 && m_raReqGen.load(std::memory_order_acquire) == gen) RA_write(&m_raRing, m_raStage, r);
+            if(r > 0) got += r;
+            if(r < (int32_t)len) { // the size was checked, a short read is an error
+                log_w("read-ahead: read error at %lu, the decoder reads the file itself", (long unsigned int)(wr + got));
+                m_f_raFailed = true;
+                idle = true;
+                break;
+            }
+        }
+        uint32_t us = micros() - t0;
+        m_raBytes += got;
+        m_raUs += us;
+        if(us > m_raMaxUs) m_raMaxUs = us;
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::readPlayListData() {
     if(getDatamode() != AUDIO_PLAYLISTINIT) return false;
     if(_client->available() == 0) return false;
@@ -3023,10 +3854,11 @@ void Audio::processLocalFile() {
         m_f_firstCall = false;
         f_stream = false;
         f_fileDataComplete = false;
-        byteCounter = 0;
+        byteCounter = InBuff.bufferFilled(); // not 0 if the head was read ahead by setNextFile()
         ctime = millis();
         if(m_codec == CODEC_M4A) seek_m4a_stsz(); // determine the pos of atom stsz
         if(m_codec == CODEC_M4A) seek_m4a_ilst(); // looking for metadata
+        if(m_codec == CODEC_M4A) audiofile.seek(byteCounter); // both leave the file at pos 0
         if(m_resumeFilePos == 0) m_resumeFilePos = -1; // parkposition
         return;
     }
@@ -3040,7 +3872,7 @@ void Audio::processLocalFile() {
     }
     if(m_audioDataSize) { availableBytes = min(availableBytes, m_audioDataSize + m_audioDataStart - byteCounter); }
 
-    int32_t bytesAddedToBuffer = audiofile.read(InBuff.getWritePtr(), availableBytes);
+    int32_t bytesAddedToBuffer = readLocal(InBuff.getWritePtr(), availableBytes, byteCounter);
 
     if(bytesAddedToBuffer > 0) {
         byteCounter += bytesAddedToBuffer; // Pull request #42
@@ -3079,17 +3911,42 @@ void Audio::processLocalFile() {
             return;
         }
         else {
-            if((InBuff.freeSpace() > maxFrameSize) && (m_file_size - byteCounter) > maxFrameSize && availableBytes) {
-                // fill the buffer before playing
+            if(!m_f_gaplessPrime && (InBuff.freeSpace() > maxFrameSize) && (m_file_size - byteCounter) > maxFrameSize && availableBytes) {
+                // fill the buffer before playing, not at a gapless track change, the DMA is draining
                 return;
             }
 
             f_stream = true;
+            bool afterSeek = m_f_seekTrim; // the same file again, its gain is set
+            if(m_codec == CODEC_MP3) GL_parseMP3Info(InBuff.getReadPtr(), min(InBuff.bufferFilled(), (size_t)maxFrameSize), &m_glInfo);
+            if(m_f_seekTrim) { // behind a seek
+                m_trim = m_seekTrim;
+                m_f_seekTrim = false;
+            }
+            else {
+                GL_start(&m_trim, &m_glInfo);
+                if(m_codec == CODEC_MP3 && m_seekMap && m_seekMap->kind != SM_FRAMES) { // TOC, unless setSeekMap() was first
+                    SM_fromInfo(m_seekMap, InBuff.getReadPtr(), min(InBuff.bufferFilled(), (size_t)maxFrameSize), m_audioDataStart,
+                                m_audioDataStart + m_audioDataSize, m_file_size);
+                }
+            }
+            if(!afterSeek) rgTrackStart(m_resumeFilePos < 0 && m_seekMs < 0); // a resume position: no measurement
+            if(m_glInfo.skip || m_glInfo.total) AUDIO_INFO("gapless: skip %lu, length %llu samples", (long unsigned int)m_glInfo.skip, (long long unsigned int)m_glInfo.total);
+            if(m_f_gaplessPrime) {
+                m_f_gaplessPrime = false;
+                m_stats.gaplessPrimeUs = micros() - m_gaplessT0;
+                AUDIO_INFO("gapless: next file ready after %lu us", (long unsigned int)m_stats.gaplessPrimeUs);
+            }
             AUDIO_INFO("stream ready_1");
             if(m_f_Log) log_i("m_audioDataStart %d", m_audioDataStart);
         }
     }
     if(m_resumeFilePos >= 0) {
+        bool byTime = (m_seekMs >= 0);
+        GL_start(&m_seekTrim, NULL); // not at the start of the audio data, play everything
+        m_f_seekTrim = true;
+        if(byTime) m_resumeFilePos = seekFilePos(m_seekMs); // a frame index also sets the samples to drop
+        m_seekMs = -1;
         if(m_resumeFilePos < m_audioDataStart) m_resumeFilePos = m_audioDataStart;
         if(m_resumeFilePos > m_file_size) m_resumeFilePos = m_file_size;
         if(m_codec == CODEC_M4A) m_resumeFilePos = m4a_correctResumeFilePos(m_resumeFilePos);
@@ -3101,10 +3958,14 @@ void Audio::processLocalFile() {
             FLACDecoderReset();
         }
         if(m_codec == CODEC_MP3) { m_resumeFilePos = mp3_correctResumeFilePos(m_resumeFilePos); }
-        if(m_avr_bitrate) m_audioCurrentTime = ((double)(m_resumeFilePos - m_audioDataStart) / m_avr_bitrate) * 8;
+        if(!byTime) { // else set by seekFilePos()
+            if(seekMapValid()) m_audioCurrentTime = seekMapTime(m_resumeFilePos);
+            else if(m_avr_bitrate) m_audioCurrentTime = ((double)(m_resumeFilePos - m_audioDataStart) / m_avr_bitrate) * 8;
+        }
         audiofile.seek(m_resumeFilePos);
         InBuff.resetBuffer();
         byteCounter = m_resumeFilePos;
+        m_filePos = m_resumeFilePos;
         f_fileDataComplete = false; // #570
 
         if(m_f_Log) {
@@ -3115,12 +3976,14 @@ void Audio::processLocalFile() {
         }
         m_resumeFilePos = -1;
         f_stream = false;
+        m_f_r128 = false; // not at the start of the audio data, measure nothing
+        m_f_r128Arm = false;
     }
     // end of file reached? - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(f_fileDataComplete && InBuff.bufferFilled() < InBuff.getMaxBlockSize()) {
         if(InBuff.bufferFilled()) {
             if(!readID3V1Tag()) {
-                if(m_validSamples) {
+                if(outputPending()) {
                     playChunk();
                     return;
                 } // play samples first
@@ -3147,11 +4010,29 @@ void Audio::processLocalFile() {
             return;
         } // loop
 
+        rgTrackEnd();
+
+        if(m_nextFile) { // gapless
+            if(outputPending()) {
+                playChunk();
+                return;
+            } // the last samples go to the DMA first
+            startNextFile();
+            return;
+        }
+
+        if(xfActive() && (outputPending() || XF_ringFill(&m_xfRing))) { // the ring holds the last seconds
+            playChunk();
+            return;
+        }
+
         char* afn = NULL;
         if(audiofile) afn = strdup(audiofile.name()); // store temporary the name
+        if(m_outTask) m_f_eofDrain = true; // the output task plays the ring out
         m_f_running = false;
         m_streamType = ST_NONE;
         audiofile.close();
+        raOpen(NULL, NULL);
         AUDIO_INFO("Closing audio file");
 
         if(m_codec == CODEC_MP3) MP3Decoder_FreeBuffers();
@@ -3348,7 +4229,7 @@ void Audio::processWebFile() {
     if(f_webFileDataComplete && InBuff.bufferFilled() < InBuff.getMaxBlockSize()) {
         if(InBuff.bufferFilled()) {
             if(!readID3V1Tag()) {
-                if(m_validSamples) {
+                if(outputPending()) {
                     playChunk();
                     return;
                 } // play samples first
@@ -3623,7 +4504,7 @@ void Audio::processWebStreamHLS() {
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::playAudioData() {
-    if(m_validSamples) {
+    if(outputPending()) {
         playChunk();
         return;
     } // play samples first
@@ -4368,6 +5249,13 @@ void Audio::setDecoderItems() {
         AUDIO_INFO("Num of channels must be 1 or 2, found %i", getChannels());
         stopSong();
     }
+    if(m_f_r128Arm) { // first frame of a file that is measured, see rgTrackStart()
+        m_f_r128Arm = false;
+        if(getBitsPerSample() == 16) {
+            R128_init(&m_r128, getSampleRate(), getChannels(), m_r128Hist);
+            m_f_r128 = true;
+        }
+    }
     showCodecParams();
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -4386,6 +5274,7 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
     bytesLeft = len;
     m_decodeError = 0;
     int bytesDecoded = 0;
+    uint32_t t0 = micros();
 
     switch(m_codec) {
         case CODEC_WAV:  m_decodeError = 0; bytesLeft = 0; break;
@@ -4408,6 +5297,11 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
 
     if(m_decodeError < 0) { // Error, skip the frame...
                             //        i2s_zero_dma_buffer((i2s_port_t)m_i2s_num);
+        if(m_decodeError == ERR_MP3_MAINDATA_UNDERFLOW && m_trim.skip && seekMapValid()) {
+            // behind a seek the bit reservoir is empty, the frame has no output but counts for the samples to drop
+            uint32_t spf = m_seekMap->samplesPerFrame;
+            m_trim.skip = (m_trim.skip > spf) ? m_trim.skip - spf : 0;
+        }
         if(!getChannels() && m_codec == CODEC_MP3 && (m_decodeError == -2)) {
             ; // at the beginning this doesn't have to be a mistake, suppress errorcode MAINDATA_UNDERFLOW
         }
@@ -4504,9 +5398,22 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
         setDecoderItems();
         m_PlayingStartTime = millis();
     }
+    if(getBitsPerSample() == 16) m_validSamples = GL_trim(&m_trim, m_outBuff, m_validSamples, getChannels()); // encoder delay, padding
+    if(m_f_r128 && m_validSamples) { // loudness of a file without ReplayGain tags
+        uint32_t c0 = ESP.getCycleCount();
+        R128_process(&m_r128, m_outBuff, m_validSamples);
+        m_statsLnCycles += ESP.getCycleCount() - c0;
+        m_statsLnFrames += m_validSamples;
+    }
+    m_statsDecodeUs += micros() - t0;
+    if(m_validSamples) m_statsFrames++;
 
     compute_audioCurrentTime(bytesDecoded);
 
+    if(m_spOn && !xfActive() && getBitsPerSample() == 16) { // copies only, the FFT runs in spectrumTask
+        spectrumFeed(m_outBuff, m_validSamples, getChannels(), getSampleRate());
+    }
+
     if(audio_process_extern) {
         bool continueI2S = false;
         audio_process_extern(m_outBuff, m_validSamples, &continueI2S);
@@ -4554,10 +5461,14 @@ void Audio::compute_audioCurrentTime(int bd) {
         loop_counter++;
     }
 
-    m_audioCurrentTime += ((float)bd / m_avr_bitrate) * 8;
-
-    if(cnt == 1) {
-        m_audioCurrentTime = ((float)(getFilePos() - m_audioDataStart - inBufferFilled()) / m_avr_bitrate) * 8; // #293
+    if(seekMapValid()) { // MP3 with a TOC or frame index: the time of the file position, VBR doesn't drift
+        if(!m_trim.skip) m_audioCurrentTime = seekMapTime(getFilePos() - inBufferFilled()); // not in front of a seek target
+    }
+    else {
+        m_audioCurrentTime += ((float)bd / m_avr_bitrate) * 8;
+        if(cnt == 1) {
+            m_audioCurrentTime = ((float)(getFilePos() - m_audioDataStart - inBufferFilled()) / m_avr_bitrate) * 8; // #293
+        }
     }
     cnt++;
     if(cnt == 100) cnt = 0;
@@ -4691,9 +5602,11 @@ bool Audio::setPinout(uint8_t BCLK, uint8_t LRC, uint8_t DOUT, int8_t MCLK) {
     gpio_cfg.dout = (gpio_num_t)DOUT;
     gpio_cfg.mclk = (gpio_num_t)MCLK;
     gpio_cfg.ws = (gpio_num_t)LRC;
+    xSemaphoreTake(mutex_out, portMAX_DELAY);
     I2Sstop(0);
     result = i2s_channel_reconfig_std_gpio(m_i2s_tx_handle, &gpio_cfg);
     I2Sstart(0);
+    xSemaphoreGive(mutex_out);
 #else
     m_pin_config.bck_io_num = BCLK;
     m_pin_config.ws_io_num = LRC; //  wclk = lrc
@@ -4718,6 +5631,7 @@ uint32_t Audio::getFileSize() {
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::getFilePos() {
     if(!audiofile) return 0;
+    if(m_raTask) return m_filePos;
     return audiofile.position();
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -4734,7 +5648,8 @@ uint32_t Audio::getAudioFileDuration() {
         if(!m_contentlength) return 0;
     }
 
-    if(m_avr_bitrate && m_codec == CODEC_MP3) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate); // #289
+    if(seekMapValid()) m_audioFileDuration = (m_glInfo.total ? m_glInfo.total : SM_totalSamples(m_seekMap)) / m_seekMap->sampleRate;
+    else if(m_avr_bitrate && m_codec == CODEC_MP3) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate); // #289
     else if(m_avr_bitrate && m_codec == CODEC_WAV) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate);
     else if(m_avr_bitrate && m_codec == CODEC_M4A) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate);
     else if(m_avr_bitrate && m_codec == CODEC_AAC) m_audioFileDuration = 8 * ((float)m_audioDataSize / m_avr_bitrate);
@@ -4744,6 +5659,10 @@ uint32_t Audio::getAudioFileDuration() {
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::getAudioCurrentTime() { // return current time in seconds
+    if(xfActive() && !m_xfLen) { // the decoder is ahead by the content of the crossfade ring
+        float ahead = (float)XF_ringFill(&m_xfRing) / outputRate();
+        return (m_audioCurrentTime > ahead) ? (uint32_t)(m_audioCurrentTime - ahead) : 0;
+    }
     return (uint32_t)m_audioCurrentTime;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -4752,17 +5671,78 @@ bool Audio::setAudioPlayPosition(uint16_t sec) {
     if(m_codec == CODEC_VORBIS) return false; // not impl. yet
     // Jump to an absolute position in time within an audio file
     // e.g. setAudioPlayPosition(300) sets the pointer at pos 5 min
-    if(sec > getAudioFileDuration()) sec = getAudioFileDuration();
-    uint32_t filepos = m_audioDataStart + (m_avr_bitrate * sec / 8);
-    return setFilePos(filepos);
+    uint32_t duration = getAudioFileDuration(); // 0 before the header is read
+    if(duration && sec > duration) sec = duration;
+    return seekTime((uint32_t)sec * 1000);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setSeekMap(const uint8_t* data, size_t len) {
+    // a frame index of the current file (SM_scan...(), stored by the application), replaces the TOC
+    if(!m_seekMap || !data) return false;
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    bool ret = (getDatamode() == AUDIO_LOCALFILE && m_codec == CODEC_MP3 && SM_load(m_seekMap, data, len) &&
+                m_seekMap->kind == SM_FRAMES && m_seekMap->fileSize == m_file_size);
+    if(!ret) SM_reset(m_seekMap);
+    xSemaphoreGive(mutex_audio);
+    if(ret) AUDIO_INFO("seek map: %u frames, %u entries", (unsigned)m_seekMap->totalFrames, (unsigned)m_seekMap->count);
+    return ret;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::seekMapValid() {
+    return m_codec == CODEC_MP3 && m_seekMap && m_seekMap->kind != SM_NONE && m_seekMap->fileSize == m_file_size;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+float Audio::seekMapTime(uint32_t pos) {
+    // play time at a file position, the gapless start (info frame, encoder delay) is not played
+    uint64_t sample = SM_sample(m_seekMap, pos);
+    sample = (sample > m_glInfo.skip) ? sample - m_glInfo.skip : 0;
+    return (float)sample / m_seekMap->sampleRate;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::seekTime(uint32_t ms) {
+    // the file position is found in processLocalFile() (seekFilePos()), the header may not be read yet
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    m_seekMs = ms;
+    bool ret = setFilePos(m_audioDataStart);
+    if(!ret) m_seekMs = -1;
+    xSemaphoreGive(mutex_audio);
+    return ret;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t Audio::seekFilePos(uint32_t ms) {
+    // file position of a play time: frame index (exact), TOC (interpolated) or the average bitrate
+    // a frame index: decoding starts a few frames in front of the target, m_seekTrim drops the samples up to it
+    m_audioCurrentTime = (float)ms / 1000;
+    if(seekMapValid()) {
+        uint64_t sample = (uint64_t)ms * m_seekMap->sampleRate / 1000;
+        uint32_t skip = 0;
+        uint32_t pos = SM_seek(m_seekMap, sample + m_glInfo.skip, &skip);
+        if(m_seekMap->kind == SM_FRAMES) {
+            m_seekTrim.skip = skip;
+            if(m_glInfo.total > sample) { // the padding is still trimmed
+                m_seekTrim.remain = m_glInfo.total - sample;
+                m_seekTrim.limited = true;
+            }
+        }
+        return pos;
+    }
+    uint32_t br = m_avr_bitrate ? m_avr_bitrate : getBitRate();
+    return m_audioDataStart + (uint64_t)br * ms / 8000;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::setVolumeSteps(uint8_t steps) {
+void Audio::setVolumeSteps(uint16_t steps) {
+    xSemaphoreTake(mutex_out, portMAX_DELAY); // the output task reads the tables in computeLimit()
     m_vol_steps = steps;
     if(steps < 1) m_vol_steps = 64; /* avoid div-by-zero :-) */
+    if(steps > VOL_MAX_STEPS) m_vol_steps = VOL_MAX_STEPS;
+    VOL_buildTable(m_volTable[VOL_CURVE_SQUARE], m_vol_steps, VOL_CURVE_SQUARE); // the only floating point work
+    VOL_buildTable(m_volTable[VOL_CURVE_LOG], m_vol_steps, VOL_CURVE_LOG);
+    if(m_vol > m_vol_steps) m_vol = m_vol_steps;
+    computeLimit();
+    xSemaphoreGive(mutex_out);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-uint8_t Audio::maxVolume() { return m_vol_steps; };
+uint16_t Audio::maxVolume() { return m_vol_steps; };
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::getTotalPlayingTime() {
     // Is set to zero by a connectToXXX() and starts as soon as the first audio data is available,
@@ -4776,6 +5756,10 @@ bool Audio::setTimeOffset(int sec) {
     // fast forward or rewind the current position in seconds
     // audiosource must be a mp3, aac or wav file
 
+    if(audiofile && seekMapValid()) { // MP3 with a TOC or frame index, from the time of the decoder position
+        int32_t ms = (int32_t)(seekMapTime(getFilePos() - inBufferFilled()) * 1000) + sec * 1000;
+        return seekTime(ms > 0 ? ms : 0);
+    }
     if(!audiofile || !m_avr_bitrate) return false;
 
     uint32_t oneSec = m_avr_bitrate / 8;                 // bytes decoded in one sec
@@ -4803,6 +5787,11 @@ bool Audio::setFilePos(uint32_t pos) {
     m_resumeFilePos = pos;
     memset(m_outBuff, 0, m_outbuffSize);
     m_validSamples = 0;
+    m_i2sStageBytes = 0;
+    m_i2sStageSent = 0;
+    resetResampler();
+    XF_ringReset(&m_xfRing);
+    m_xfLen = 0;
     return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -4812,15 +5801,28 @@ bool Audio::audioFileSeek(const float speed) {
     // 1.5 is one and half speed
     if((speed > 1.5f) || (speed < 0.25f)) return false;
 
-    uint32_t srate = getSampleRate() * speed;
-#if ESP_IDF_VERSION_MAJOR == 5
-    I2Sstop(0);
-    m_i2s_std_cfg.clk_cfg.sample_rate_hz = srate;
-    i2s_channel_reconfig_std_clock(m_i2s_tx_handle, &m_i2s_std_cfg.clk_cfg);
-    I2Sstart(0);
-#else
-    i2s_set_sample_rates((i2s_port_t)m_i2s_num, srate);
-#endif
+    if(m_outRate) { // fixed output rate: WSOLA time stretching, the pitch and the I2S clock stay
+        uint32_t q = (uint32_t)(speed * 65536 + 0.5f);
+        xSemaphoreTake(mutex_audio, portMAX_DELAY);
+        if(q != 65536 && !m_strBuf) {
+            m_strBuf = (int16_t*)heap_caps_malloc(TS_bufSize(), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+            m_strIn = (int16_t*)heap_caps_malloc(m_i2sStageFrames * 2 * sizeof(int16_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+            if(!m_strBuf || !m_strIn) {
+                if(m_strBuf) {free(m_strBuf); m_strBuf = NULL;}
+                if(m_strIn)  {free(m_strIn);  m_strIn  = NULL;}
+                xSemaphoreGive(mutex_audio);
+                log_e("oom");
+                return false;
+            }
+            m_strInFrames = m_strInPos = 0;
+            TS_init(&m_str, m_strBuf, getSampleRate());
+        }
+        m_speedQ16 = q;
+        if(m_strBuf) TS_setSpeed(&m_str, q);
+        xSemaphoreGive(mutex_audio);
+        return true;
+    }
+    setI2SClock(getSampleRate() * speed); // varispeed, the pitch follows the speed
     return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -4828,19 +5830,306 @@ bool Audio::setSampleRate(uint32_t sampRate) {
     if(!sampRate) sampRate = 44100; // fuse, if there is no value -> set default #209
     if(m_sampleRate == sampRate) return true;
     m_sampleRate = sampRate;
+    if(m_outRate) { // I2S keeps running without a gap, the EQ already works at m_outRate
+        RS_setRatio(&m_rs, m_sampleRate, m_outRate, 65536);
+        if(m_strBuf) { // the windows are sized in ms
+            TS_init(&m_str, m_strBuf, m_sampleRate);
+            TS_setSpeed(&m_str, m_speedQ16);
+        }
+        return true;
+    }
+    setI2SClock(sampRate);
+    BQ_reset(&m_eq); // Clear FilterBuffer
+    IIR_calculateCoefficients(m_gain0, m_gain1, m_gain2); // must be recalculated after each samplerate change
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setI2SClock(uint32_t rate) {
+    outputFlush(true); // what is in the ring has the old rate
+    xSemaphoreTake(mutex_out, portMAX_DELAY);
+    LIM_setRate(&m_lim, rate); // the look-ahead and release are times
+    VOL_setRamp(&m_volRamp, rate, m_volRampMs, m_volRamp.shape);
 #if ESP_IDF_VERSION_MAJOR == 5
-    m_i2s_std_cfg.clk_cfg.sample_rate_hz = sampRate;
+    m_i2s_std_cfg.clk_cfg.sample_rate_hz = rate;
     I2Sstop(0);
     i2s_channel_reconfig_std_clock(m_i2s_tx_handle, &m_i2s_std_cfg.clk_cfg);
     I2Sstart(0);
 #else
-    i2s_set_sample_rates((i2s_port_t)m_i2s_num, sampRate);
+    i2s_set_sample_rates((i2s_port_t)m_i2s_num, rate);
 #endif
-    memset(m_filterBuff, 0, sizeof(m_filterBuff)); // Clear FilterBuffer
-    IIR_calculateCoefficients(m_gain0, m_gain1, m_gain2); // must be recalculated after each samplerate change
+    xSemaphoreGive(mutex_out);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setOutputRate(uint32_t rate, uint8_t quality) {
+    // rate != 0: the I2S clock is locked to rate, streams with other samplerates pass the resampler (no clock
+    // changes, no gaps between tracks), rate == 0: the I2S clock follows the stream as before
+    if(rate && (rate < 8000 || rate > 96000)) return false;
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    if(rate && !m_rsIn) m_rsIn = (int16_t*)heap_caps_malloc(m_i2sStageFrames * 2 * sizeof(int16_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+    if(rate && (!m_rsCoef || quality != m_rs.quality)) {
+        if(m_rsCoef) free(m_rsCoef);
+        m_rsCoef = (int16_t*)heap_caps_malloc(RS_coefSize(quality), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL); // read per sample
+        if(m_rsCoef) RS_init(&m_rs, quality, m_rsCoef);
+    }
+    if(rate && (!m_rsIn || !m_rsCoef)) {
+        xSemaphoreGive(mutex_audio);
+        log_e("oom");
+        return false;
+    }
+    m_i2sStageBytes = 0; // the staged frames have the old rate
+    m_i2sStageSent = 0;
+    if(m_xfRing.buff && rate != m_outRate) { // the ring has the old rate
+        free(m_xfRing.buff);
+        m_xfRing.buff = NULL;
+        m_xfFrames = m_xfLen = 0;
+        log_w("crossfade is off, call setCrossfade() again");
+    }
+    m_outRate = rate;
+    resetResampler();
+    if(rate) RS_setRatio(&m_rs, m_sampleRate, m_outRate, 65536); // the speed is time stretched, see stretchBlock()
+    setI2SClock(outputRate());
+    BQ_reset(&m_eq);
+    IIR_calculateCoefficients(m_gain0, m_gain1, m_gain2); // the EQ runs at the output rate
+    xSemaphoreGive(mutex_audio);
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setCrossfade(uint8_t seconds, uint8_t shape) {
+    // overlap of the end of a track with the start of the next one (setNextFile()), 0: off
+    // the decoder runs up to 'seconds' ahead into a ring in PSRAM (seconds * rate * 4 bytes), at the end of a file the
+    // ring still holds its last seconds and is mixed with the next file, the Helix decoders exist only once
+    if(seconds > 12) seconds = 12;
+    if(seconds && !m_outRate) {
+        log_w("crossfade needs a fixed output rate, setOutputRate()");
+        return false;
+    }
+    uint32_t frames = seconds * m_outRate;
+    int16_t* buff = NULL;
+    if(frames) {
+        buff = (int16_t*)heap_caps_malloc(frames * 2 * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        if(!m_xfTmp) m_xfTmp = (int16_t*)heap_caps_malloc(m_i2sStageFrames * 2 * sizeof(int16_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+        if(!buff || !m_xfTmp) {
+            if(buff) free(buff);
+            log_e("oom");
+            return false;
+        }
+    }
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    if(buff) {
+        xf_ring_t ring;
+        XF_ringInit(&ring, buff, frames);
+        if(m_xfRing.buff) { // keep what is decoded ahead
+            ring.wr = XF_ringRead(&m_xfRing, buff, frames);
+            free(m_xfRing.buff);
+        }
+        m_xfRing = ring;
+    }
+    m_xfFrames = frames; // 0: the ring is played out and freed by the audio task
+    m_xfLen = 0;
+    XF_buildCurve(m_xfCurve, shape);
+    xSemaphoreGive(mutex_audio);
+    AUDIO_INFO("crossfade %u s", seconds);
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::fadeOut(uint16_t ms) {
+    // fades the output to silence in ms (the audio task must keep calling loop()), silent until the next connecttoXXX(),
+    // which fades in over the same time, e.g. a fade-through between two web radio stations
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    m_mfMs = ms;
+    m_mfLen = max((uint32_t)ms * outputRate() / 1000, (uint32_t)1);
+    m_mfPos = 0;
+    m_f_mfIn = false;
+    xSemaphoreGive(mutex_audio);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setReplayGain(uint8_t mode, int8_t preampDb) {
+    // loudness normalization of local files, from the tags or from the gain table, applied from the next file on
+    m_rgMode = (mode > RG_ALBUM) ? RG_OFF : mode;
+    m_rgPreamp = preampDb;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setGainTable(fs::FS& fs, const char* path) {
+    // binary file: "RGT1", then lt_entry_t records, a record is appended when a file without ReplayGain tags was played
+    // from the start to the end, the meter runs in the audio task while the file plays (no second decoder)
+    lt_entry_t* table = NULL;
+    uint32_t    n = 0, cap = 0;
+    if(path) {
+        File f = fs.open(path, FILE_READ);
+        char magic[4] = {0};
+        bool valid = f && f.read((uint8_t*)magic, 4) == 4 && !memcmp(magic, "RGT1", 4);
+        if(valid) n = (f.size() - 4) / sizeof(lt_entry_t);
+        cap = n + 64;
+        table = (lt_entry_t*)heap_caps_malloc(cap * sizeof(lt_entry_t), MALLOC_CAP_SPIRAM);
+        if(!table) table = (lt_entry_t*)malloc(cap * sizeof(lt_entry_t));
+        if(!m_r128Hist) m_r128Hist = (uint32_t*)heap_caps_malloc(R128_HIST_BINS * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+        if(!m_r128Hist) m_r128Hist = (uint32_t*)malloc(R128_HIST_BINS * sizeof(uint32_t));
+        if(!table || !m_r128Hist) {
+            if(f) f.close();
+            if(table) free(table);
+            log_e("oom");
+            return false;
+        }
+        if(n) n = f.read((uint8_t*)table, n * sizeof(lt_entry_t)) / sizeof(lt_entry_t);
+        if(f) f.close();
+        if(!valid) { // new or unknown format
+            File w = fs.open(path, FILE_WRITE);
+            if(!w) {
+                free(table);
+                log_e("can't create %s", path);
+                return false;
+            }
+            w.write((const uint8_t*)"RGT1", 4);
+            w.close();
+        }
+    }
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    if(m_lt) free(m_lt);
+    if(m_ltPath) free(m_ltPath);
+    m_lt = table;
+    m_ltCount = n;
+    m_ltCap = cap;
+    m_ltUnsaved = 0;
+    m_ltFs = &fs;
+    m_ltPath = path ? strdup(path) : NULL;
+    m_f_r128 = false;
+    m_f_r128Arm = false;
+    xSemaphoreGive(mutex_audio);
+    if(path) AUDIO_INFO("gain table: %lu files", (long unsigned int)n);
     return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::rgTrackStart(bool fromStart) {
+    // gain of the new file: tags, else the gain table, files without both are measured while they play if they
+    // are decoded from the start, setDecoderItems() starts the meter with the rate and channels of the file
+    const char*       path = audiofile.path();
+    const char*       slash = strrchr(path, '/');
+    uint32_t          ph = LT_hash(path, strlen(path));
+    uint32_t          dh = LT_hash(path, slash ? slash - path : 0);
+    const lt_entry_t* e = m_lt ? LT_find(m_lt, m_ltCount, ph) : NULL;
+    float             db = 0, peak = 0, lufs = 0;
+    bool              known = true;
+
+    if(m_rgMode == RG_ALBUM && m_rgTag.hasAlbum) {
+        db = m_rgTag.albumGain;
+        peak = m_rgTag.albumPeak;
+    }
+    else if(m_rgMode == RG_ALBUM && !m_rgTag.hasTrack && m_lt && LT_album(m_lt, m_ltCount, dh, &lufs, &peak)) {
+        db = RG_REFERENCE_LUFS - lufs; // the measured files of this directory
+    }
+    else if(m_rgTag.hasTrack) {
+        db = m_rgTag.trackGain;
+        peak = m_rgTag.trackPeak;
+    }
+    else if(e) {
+        db = RG_REFERENCE_LUFS - e->lufs / 100.0f;
+        peak = e->peak / 65535.0f;
+    }
+    else known = false;
+
+    m_f_r128 = false;
+    m_f_r128Arm = false;
+    if(fromStart && !e && !m_rgTag.hasTrack && m_lt) {
+        m_r128Path = ph;
+        m_r128Dir = dh;
+        m_f_r128Arm = true;
+    }
+
+    double g = 1.0;
+    if(known && m_rgMode != RG_OFF) {
+        g = pow(10.0, (db + m_rgPreamp) / 20.0);
+        if(peak > 0 && g * peak > 1.0) g = 1.0 / peak; // no clipping
+    }
+    m_rgDb = 20.0 * log10(g);
+    if(known && m_rgMode != RG_OFF) AUDIO_INFO("ReplayGain %.2f dB", m_rgDb);
+    if(m_xfLen && g != m_rgGain) { // crossfading, the end of the last file still needs its own gain, see xfBlock()
+        m_rgXfA = m_rgGain;
+        m_rgXfB = g;
+        g = max(m_rgXfA, m_rgXfB);
+    }
+    setRgGain(g);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::rgTrackEnd() {
+    // the file was measured from the start to the end, the result goes to the gain table
+    if(!m_f_r128) return;
+    m_f_r128 = false;
+    float lufs;
+    if(!R128_integrated(&m_r128, &lufs)) return; // silence
+    if(m_ltCount == m_ltCap) {
+        lt_entry_t* t = (lt_entry_t*)heap_caps_realloc(m_lt, (m_ltCap + 64) * sizeof(lt_entry_t), MALLOC_CAP_SPIRAM);
+        if(!t) t = (lt_entry_t*)realloc(m_lt, (m_ltCap + 64) * sizeof(lt_entry_t));
+        if(!t) {
+            log_e("oom");
+            return;
+        }
+        m_lt = t;
+        m_ltCap += 64;
+    }
+    lt_entry_t* e = &m_lt[m_ltCount++];
+    memset(e, 0, sizeof(lt_entry_t));
+    e->path = m_r128Path;
+    e->dir = m_r128Dir;
+    e->lufs = lroundf(lufs * 100);
+    e->peak = (uint32_t)m_r128.peak * 65535 / 32767;
+    e->seconds = R128_seconds(&m_r128);
+    m_ltUnsaved++; // written by flushGainTable(), a file open here could stall the decoder on a card wake-up
+    AUDIO_INFO("loudness %.1f LUFS, peak %.1f dBFS", lufs, 20 * log10((m_r128.peak + 1) / 32768.0));
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::flushGainTable() {
+    // appends the measured entries that are not in the file yet, they are copied under the mutex and written without
+    // it, the audio task does not wait for the card
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    uint32_t     n = m_ltUnsaved;
+    fs::FS*      fs = m_ltFs;
+    char*        path = (n && m_ltPath) ? strdup(m_ltPath) : NULL;
+    lt_entry_t*  add = path ? (lt_entry_t*)malloc(n * sizeof(lt_entry_t)) : NULL;
+    if(add) memcpy(add, &m_lt[m_ltCount - n], n * sizeof(lt_entry_t));
+    xSemaphoreGive(mutex_audio);
+    bool ok = (n == 0 || !m_ltPath);
+    if(add && fs) {
+        File f = fs->open(path, FILE_APPEND);
+        ok = f && f.write((const uint8_t*)add, n * sizeof(lt_entry_t)) == n * sizeof(lt_entry_t);
+        if(f) f.close();
+    }
+    if(ok && n) {
+        xSemaphoreTake(mutex_audio, portMAX_DELAY);
+        if(m_ltUnsaved >= n) m_ltUnsaved -= n; // the newer ones stay unsaved
+        xSemaphoreGive(mutex_audio);
+    }
+    free(add);
+    free(path);
+    return ok;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setLimiter(bool on, float ceilingDb, uint8_t lookaheadMs, uint16_t releaseMs) {
+    // look-ahead peak limiter behind the volume (block output only): EQ boosts and ReplayGain are no longer
+    // clipped or limited to full scale, no output sample exceeds the ceiling, the output is delayed by the look-ahead
+    if(lookaheadMs < 1) lookaheadMs = 1;
+    if(lookaheadMs > 5) lookaheadMs = 5;
+    if(on && !m_limWork) {
+        m_limWork = (int32_t*)heap_caps_malloc(m_i2sStageFrames * 2 * sizeof(int32_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+        if(!m_limWork) {
+            log_e("oom");
+            return false;
+        }
+    }
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    xSemaphoreTake(mutex_out, portMAX_DELAY);
+    LIM_init(&m_lim, outputRate(), ceilingDb, lookaheadMs * 1000, releaseMs);
+    m_f_limiter = on;
+    m_limGain.store(LIM_UNITY, std::memory_order_relaxed);
+    xSemaphoreGive(mutex_out);
+    xSemaphoreGive(mutex_audio);
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+float Audio::getLimiterReduction() {
+    uint16_t g = m_limGain.load(std::memory_order_relaxed);
+    return (g >= LIM_UNITY) ? 0 : -20 * log10f(g / (float)LIM_UNITY);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::getSampleRate() { return m_sampleRate; }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::setBitsPerSample(int bits) {
@@ -4892,72 +6181,124 @@ void Audio::setI2SCommFMT_LSB(bool commFMT) {
 #endif
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::computeVUlevel(int16_t sample[2]) {
-    static uint8_t sampleArray[2][4][8] = {0};
-    static uint8_t cnt0 = 0, cnt1 = 0, cnt2 = 0, cnt3 = 0, cnt4 = 0;
-    static bool    f_vu = false;
-
-    auto avg = [&](uint8_t* sampArr) { // lambda, inner function, compute the average of 8 samples
-        uint16_t av = 0;
-        for(int i = 0; i < 8; i++) { av += sampArr[i]; }
-        return av >> 3;
-    };
-
-    auto largest = [&](uint8_t* sampArr) { // lambda, inner function, compute the largest of 8 samples
-        uint16_t maxValue = 0;
-        for(int i = 0; i < 8; i++) {
-            if(maxValue < sampArr[i]) maxValue = sampArr[i];
-        }
-        return maxValue;
-    };
-
-    if(cnt0 == 64) {
-        cnt0 = 0;
-        cnt1++;
-    }
-    if(cnt1 == 8) {
-        cnt1 = 0;
-        cnt2++;
-    }
-    if(cnt2 == 8) {
-        cnt2 = 0;
-        cnt3++;
+void Audio::publishLevel() {
+    // once per output block, the reader (UI task) never takes mutex_audio
+    audio_level_t lv;
+    LM_finish(&m_meterAcc, &m_meterHold, outputRate() * 3 / 2, &lv); // peak hold 1.5s
+    uint32_t seq = m_levelSeq.load(std::memory_order_relaxed);
+    m_levelSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_level = lv;
+    m_levelSeq.store(seq + 2, std::memory_order_release);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::getAudioLevel(audio_level_t* level) {
+    if(!level) return;
+    if(!m_f_running) {
+        memset(level, 0, sizeof(audio_level_t));
+        return;
     }
-    if(cnt3 == 8) {
-        cnt3 = 0;
-        cnt4++;
-        f_vu = true;
+    for(uint8_t i = 0; i < 8; i++) { // a block is published every ~10ms, one retry is the most to expect
+        uint32_t seq = m_levelSeq.load(std::memory_order_acquire);
+        if(seq & 1) continue;
+        *level = m_level;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(m_levelSeq.load(std::memory_order_relaxed) == seq) return;
     }
-    if(cnt4 == 8) { cnt4 = 0; }
+    *level = m_level;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setSpectrum(uint16_t points, uint8_t bands, uint16_t intervalMs) {
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    m_spOn = false; // the tap stops feeding
+    xSemaphoreGive(mutex_audio);
+    while(m_spBusy) vTaskDelay(1); // a running FFT finishes first
+    if(points == 0) return true;
 
-    if(!cnt0) { // store every 64th sample in the array[0]
-        sampleArray[LEFTCHANNEL][0][cnt1] = abs(sample[LEFTCHANNEL] >> 7);
-        sampleArray[RIGHTCHANNEL][0][cnt1] = abs(sample[RIGHTCHANNEL] >> 7);
+    if(!m_spFft) m_spFft = (sp_fft_t*)__malloc_heap_psram(sizeof(sp_fft_t));
+    for(int i = 0; i < 2; i++) {
+        if(!m_spCapture[i]) m_spCapture[i] = (int16_t*)__malloc_heap_psram(SP_MAX_POINTS * sizeof(int16_t));
     }
-    if(!cnt1) { // store argest from 64 * 8 samples in the array[1]
-        sampleArray[LEFTCHANNEL][1][cnt2] = largest(sampleArray[LEFTCHANNEL][0]);
-        sampleArray[RIGHTCHANNEL][1][cnt2] = largest(sampleArray[RIGHTCHANNEL][0]);
+    if(!m_spFft || !m_spCapture[0] || !m_spCapture[1]) {
+        log_e("oom");
+        return false;
     }
-    if(!cnt2) { // store avg from 64 * 8 * 8 samples in the array[2]
-        sampleArray[LEFTCHANNEL][2][cnt3] = largest(sampleArray[LEFTCHANNEL][1]);
-        sampleArray[RIGHTCHANNEL][2][cnt3] = largest(sampleArray[RIGHTCHANNEL][1]);
+    if(!SP_init(m_spFft, points, bands, 22050)) {
+        log_e("spectrum: %u points, %u bands not supported", points, bands);
+        return false;
     }
-    if(!cnt3) { // store avg from 64 * 8 * 8 * 8 samples in the array[3]
-        sampleArray[LEFTCHANNEL][3][cnt4] = avg(sampleArray[LEFTCHANNEL][2]);
-        sampleArray[RIGHTCHANNEL][3][cnt4] = avg(sampleArray[RIGHTCHANNEL][2]);
+    if(!m_spTask) {
+        // low priority, the output path is never delayed by the FFT
+        xTaskCreatePinnedToCore(spectrumTask, "spectrum", 3072, this, 1, &m_spTask, tskNO_AFFINITY);
+        if(!m_spTask) {
+            log_e("spectrum task not created");
+            return false;
+        }
     }
-    if(f_vu) {
-        f_vu = false;
-        m_vuLeft = avg(sampleArray[LEFTCHANNEL][3]);
-        m_vuRight = avg(sampleArray[RIGHTCHANNEL][3]);
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    memset(m_spBands, 0, sizeof(m_spBands));
+    m_spFill = 0;
+    m_spDecCnt = 0;
+    m_spDecAcc = 0;
+    m_spInterval = intervalMs;
+    m_spOn = true;
+    xSemaphoreGive(mutex_audio);
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t Audio::getSpectrum(uint8_t* bands, uint8_t maxBands) {
+    if(!m_spOn || !bands) return 0;
+    uint8_t n = min(maxBands, m_spFft->numBands);
+    if(!m_f_running) memset(bands, 0, n);
+    else memcpy(bands, m_spBands[m_spPublished], n);
+    return n;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::spectrumFeed(const int16_t* buff, uint16_t frames, uint8_t ch, uint32_t rate) {
+    // decimated mono mix of the decoded samples, a full capture is handed over to spectrumTask
+    if(m_spFill == 0 && m_spDecCnt == 0) {
+        if(millis() - m_spLast < m_spInterval) return; // bounded rate
+        m_spDecim = max(rate / 16000, (uint32_t)1); // 44.1k -> 22.05k, 48k -> 16k
+    }
+    int16_t* cap = m_spCapture[m_spWrite];
+    for(uint16_t i = 0; i < frames; i++) {
+        m_spDecAcc += (ch == 2) ? (buff[2 * i] + buff[2 * i + 1]) >> 1 : buff[i];
+        if(++m_spDecCnt < m_spDecim) continue;
+        cap[m_spFill++] = m_spDecAcc / m_spDecim; // box filter, good enough for a visualizer
+        m_spDecAcc = 0;
+        m_spDecCnt = 0;
+        if(m_spFill < m_spFft->points) continue;
+        m_spFill = 0;
+        m_spLast = millis();
+        if(m_spBusy) return; // the task is late, drop this capture
+        m_spRate[m_spWrite] = rate / m_spDecim;
+        m_spReady = m_spWrite;
+        m_spWrite ^= 1;
+        m_spBusy = true;
+        xTaskNotifyGive(m_spTask);
+        return;
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::spectrumTask(void* param) {
+    Audio* a = (Audio*)param;
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if(!a->m_spBusy) continue;
+        uint8_t idx = a->m_spReady;
+        uint8_t pub = a->m_spPublished ^ 1;
+        SP_setRate(a->m_spFft, a->m_spRate[idx]);
+        SP_compute(a->m_spFft, a->m_spCapture[idx], a->m_spBands[pub]);
+        a->m_spPublished = pub;
+        a->m_spBusy = false;
     }
-    cnt1++;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint16_t Audio::getVUlevel() {
-    // avg 0 ... 127
-    if(!m_f_running) return 0;
-    return (m_vuLeft << 8) + m_vuRight;
+    // 0 ... 127 per channel, left in the high byte
+    audio_level_t lv;
+    getAudioLevel(&lv);
+    return ((lv.peak[LEFTCHANNEL] >> 8) << 8) + (lv.peak[RIGHTCHANNEL] >> 8);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::playSample(int16_t sample[2]) {
@@ -4966,20 +6307,13 @@ bool Audio::playSample(int16_t sample[2]) {
         sample[RIGHTCHANNEL] = ((sample[RIGHTCHANNEL] & 0xff) - 128) << 8;
     }
 
-    // set a correction factor if filter have positive amplification
-    if(m_corr > 1) {
-        sample[LEFTCHANNEL] = sample[LEFTCHANNEL] / m_corr;
-        sample[RIGHTCHANNEL] = sample[RIGHTCHANNEL] / m_corr;
-    }
-
-    computeVUlevel(sample);
-
-    // Filterchain, can commented out if not used
-    sample = IIR_filterChain0(sample);
-    sample = IIR_filterChain1(sample);
-    sample = IIR_filterChain2(sample);
+    // Filterchain incl. correction factor, bypassed if all gains are 0 dB
+    BQ_process(&m_eq, sample, 1);
     //-------------------------------------------
 
+    LM_accumulate(&m_meterAcc, sample, 1);
+    if(m_meterAcc.frames >= m_i2sStageFrames) publishLevel();
+
     uint32_t s32 = Gain(sample); // sample2volume;
 
     if(audio_process_i2s) {
@@ -4996,6 +6330,7 @@ bool Audio::playSample(int16_t sample[2]) {
 #else
     esp_err_t err = i2s_write((i2s_port_t)m_i2s_num, (const char*)&s32, sizeof(uint32_t), &m_i2s_bytesWritten, 0); // no wait
 #endif
+    m_statsI2sWrites++;
     if(err != ESP_OK) {
         if(err != 263) { log_e("ESP32 Errorcode: %i", err); }
         return false;
@@ -5010,6 +6345,7 @@ void Audio::setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass
     // see https://www.earlevel.com/main/2013/10/13/biquad-calculator-v2/
     // values can be between -40 ... +6 (dB)
 
+    xSemaphoreTake(mutex_audio, portMAX_DELAY); // the coefficients are read by the output stage
     m_gain0 = gainLowPass;
     m_gain1 = gainBandPass;
     m_gain2 = gainHighPass;
@@ -5019,6 +6355,7 @@ void Audio::setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass
     m_corr = pow10f((float)db / 20);
 
     IIR_calculateCoefficients(m_gain0, m_gain1, m_gain2);
+    xSemaphoreGive(mutex_audio);
 
     /*
           This will cause a clicking sound when adjusting the EQ.
@@ -5026,14 +6363,94 @@ void Audio::setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass
           mixed in the audio data frame, and a click-like sound will be produced.
       */
     /*
-      int16_t tmp[2]; tmp[0] = 0; tmp[1]= 0;
-
-      IIR_filterChain0(tmp, true ); // flush the filter
-      IIR_filterChain1(tmp, true ); // flush the filter
-      IIR_filterChain2(tmp, true ); // flush the filter
+      BQ_reset(&m_eq); // flush the filter
       */
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::loadEqualizerPresets(fs::FS& fs, const char* path) {
+    File file = fs.open(path);
+    if(!file) {
+        log_w("equalizer presets %s not found", path);
+        return false;
+    }
+    size_t size = file.size();
+    if(size > 16384) size = 16384; // a few presets, never a big file
+    char* text = (char*)__malloc_heap_psram(size + 1);
+    if(!text) {
+        file.close();
+        log_e("oom");
+        return false;
+    }
+    size_t len = file.read((uint8_t*)text, size);
+    text[len] = '\0';
+    file.close();
+    bool res = setEqualizerPresets(text);
+    free(text);
+    return res;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setEqualizerPresets(const char* text) {
+    // parsing and the coefficient design for all samplerates run in the calling task, not in the audio task
+    if(!text) return false;
+    peq_preset_t* presets = (peq_preset_t*)__malloc_heap_psram(PEQ_MAX_PRESETS * sizeof(peq_preset_t));
+    if(!presets) {
+        log_e("oom");
+        return false;
+    }
+    uint8_t        n = PEQ_parse(text, presets, PEQ_MAX_PRESETS);
+    peq_bankset_t* sets = NULL;
+    if(n) {
+        sets = (peq_bankset_t*)__malloc_heap_psram(n * sizeof(peq_bankset_t));
+        if(!sets) {
+            free(presets);
+            log_e("oom");
+            return false;
+        }
+        for(uint8_t i = 0; i < n; i++) PEQ_buildBanks(&presets[i], &sets[i]);
+    }
+    free(presets);
+
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    peq_bankset_t* old = m_eqSets;
+    m_eqSets = sets;
+    m_eqNumSets = n;
+    if(m_eqSelect >= n) m_eqSelect = -1;
+    applyEqualizer(); // the banks of the running preset are new
+    AUDIO_INFO("%u equalizer presets loaded", n);
+    xSemaphoreGive(mutex_audio);
+    if(old) free(old);
+    return n > 0;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setEqualizerPreset(int8_t preset) {
+    // only the request is stored, the audio task loads the precomputed bank before the next block
+    if(preset < -1 || preset >= m_eqNumSets) return false;
+    m_eqSelect = preset;
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::getEqualizerPresetName(uint8_t preset, char* buf, size_t len) {
+    if(!buf || !len) return false;
+    xSemaphoreTake(mutex_audio, portMAX_DELAY); // the sets are replaced by setEqualizerPresets()
+    bool found = preset < m_eqNumSets;
+    strlcpy(buf, found ? m_eqSets[preset].name : "", len);
+    xSemaphoreGive(mutex_audio);
+    return found;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::applyEqualizer() {
+    // loads the cascade for the current samplerate into m_eq, no float math here
+    int8_t sel = m_eqSelect;
+    if(sel >= m_eqNumSets) sel = -1;
+    m_eqActive = sel;
+    if(sel < 0) {
+        BQ_setStages(&m_eq, m_toneCoef, 3);
+        return;
+    }
+    const peq_bank_t* bank = &m_eqSets[sel].bank[PEQ_rateIndex(outputRate())];
+    BQ_setStages(&m_eq, bank->coef, bank->numStages);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::forceMono(bool m) { // #100 mono option
     m_f_forceMono = m;          // false stereo, true mono
 }
@@ -5041,16 +6458,18 @@ void Audio::forceMono(bool m) { // #100 mono option
 void Audio::setBalance(int8_t bal) { // bal -16...16
     if(bal < -16) bal = -16;
     if(bal > 16) bal = 16;
+    xSemaphoreTake(mutex_out, portMAX_DELAY);
     m_balance = bal;
-
     computeLimit();
+    xSemaphoreGive(mutex_out);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::setVolume(uint8_t vol, uint8_t curve) { // curve 0: default, curve 1: flat at the beginning
+void Audio::setVolume(uint16_t vol, uint8_t curve) { // curve 0: default, curve 1: flat at the beginning
 
     uint16_t v = ESP_ARDUINO_VERSION_MAJOR * 100 + ESP_ARDUINO_VERSION_MINOR * 10 + ESP_ARDUINO_VERSION_PATCH;
     if(v < 207) AUDIO_INFO("Do not use this ancient Adruino version V%d.%d.%d", ESP_ARDUINO_VERSION_MAJOR, ESP_ARDUINO_VERSION_MINOR, ESP_ARDUINO_VERSION_PATCH);
 
+    xSemaphoreTake(mutex_out, portMAX_DELAY);
     if(vol > m_vol_steps) m_vol = m_vol_steps;
     else m_vol = vol;
 
@@ -5058,44 +6477,77 @@ void Audio::setVolume(uint8_t vol, uint8_t curve) { // curve 0: default, curve 1
     else m_curve = curve;
 
     computeLimit();
+    xSemaphoreGive(mutex_out);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-uint8_t Audio::getVolume() { return m_vol; }
+uint16_t Audio::getVolume() { return m_vol; }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint8_t Audio::getI2sPort() { return m_i2s_num; }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::computeLimit() {    // is calculated when the volume or balance changes
-    double l = 1, r = 1, v = 1; // assume 100%
-
-    /* balance is left -16...+16 right */
-    /* TODO: logarithmic scaling of balance, too? */
-    if(m_balance < 0) { r -= (double)abs(m_balance) / 16; }
-    else if(m_balance > 0) { l -= (double)abs(m_balance) / 16; }
-
-    switch(m_curve) {
-        case 0:
-            v = (double)pow(m_vol, 2) / pow(m_vol_steps, 2); // square (default)
-            break;
-        case 1: // logarithmic
-            double log1 = log(1);
-            if(m_vol > 0) { v = m_vol * ((std::exp(log1 + (m_vol - 1) * (std::log(m_vol_steps) - log1) / (m_vol_steps - 1))) / m_vol_steps) / m_vol_steps; }
-            else { v = 0; }
-            break;
+void Audio::computeLimit() {    // is calculated when the volume, balance or ReplayGain changes, integer only
+    // the caller holds mutex_out: the UI task (volume, balance), the decoder or the output task (ReplayGain)
+    uint32_t v = m_volTable[m_curve][m_vol];  // Q15
+    uint32_t l = VOL_balance(m_balance > 0 ? m_balance : 0); // balance is left -16...+16 right
+    uint32_t r = VOL_balance(m_balance < 0 ? m_balance : 0);
+    uint64_t gl = (((uint64_t)v * l >> 14) * m_rgQ16) >> 16; // Q16
+    uint64_t gr = (((uint64_t)v * r >> 14) * m_rgQ16) >> 16;
+    m_volQ16[LEFTCHANNEL] = min(gl, (uint64_t)16 * VOL_UNITY_Q16); // read by packBlock(), one aligned word each
+    m_volQ16[RIGHTCHANNEL] = min(gr, (uint64_t)16 * VOL_UNITY_Q16);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setRgGain(double g) {
+    // with the output task the new gain starts with the next frame written to the ring, the frames in the ring
+    // were decoded (and crossfaded) for the old one, the output task applies it at that position: rgMarkers()
+    m_rgGain = g;
+    int32_t q16 = min(g, 16.0) * VOL_UNITY_Q16;
+    if(!m_outTask) {
+        xSemaphoreTake(mutex_out, portMAX_DELAY);
+        m_rgQ16 = q16;
+        computeLimit();
+        xSemaphoreGive(mutex_out);
+        return;
     }
-
-    m_limit_left = l * v;
-    m_limit_right = r * v;
-
-    // log_i("m_limit_left %f,  m_limit_right %f ",m_limit_left, m_limit_right);
+    uint32_t w = m_rgMarkWr.load(std::memory_order_relaxed);
+    if(w - m_rgMarkRd.load(std::memory_order_acquire) == 4) { // full, the newest change takes the gain (one word)
+        m_rgMarkQ16[(w - 1) % 4] = q16;
+        return;
+    }
+    m_rgMarkAt[w % 4] = m_pcmRing.wr.load(std::memory_order_relaxed);
+    m_rgMarkQ16[w % 4] = q16;
+    m_rgMarkWr.store(w + 1, std::memory_order_release);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-
-int32_t Audio::Gain(int16_t s[2]) {
+uint32_t Audio::rgMarkers(uint32_t rd) {
+    // output task: applies the ReplayGain changes the ring has reached, returns the frames up to the next one
+    uint32_t r = m_rgMarkRd.load(std::memory_order_relaxed);
+    while(r != m_rgMarkWr.load(std::memory_order_acquire)) {
+        if((int32_t)(m_rgMarkAt[r % 4] - rd) > 0) return m_rgMarkAt[r % 4] - rd;
+        xSemaphoreTake(mutex_out, portMAX_DELAY);
+        m_rgQ16 = m_rgMarkQ16[r % 4];
+        computeLimit();
+        xSemaphoreGive(mutex_out);
+        m_rgMarkRd.store(++r, std::memory_order_release);
+    }
+    return UINT32_MAX;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setVolumeRamp(uint16_t ms, uint8_t shape) {
+    if(ms > 1000) ms = 1000;
+    xSemaphoreTake(mutex_audio, portMAX_DELAY);
+    xSemaphoreTake(mutex_out, portMAX_DELAY);
+    m_volRampMs = ms;
+    VOL_setRamp(&m_volRamp, outputRate(), ms, shape);
+    xSemaphoreGive(mutex_out);
+    xSemaphoreGive(mutex_audio);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+int32_t Audio::Gain(int16_t s[2]) { // sample by sample output, without ramp
     int32_t v[2];
-
-    /* important: these multiplications must all be signed ints, or the result will be invalid */
-    v[LEFTCHANNEL] = s[LEFTCHANNEL] * m_limit_left;
-    v[RIGHTCHANNEL] = s[RIGHTCHANNEL] * m_limit_right;
+    /* without the limiter a ReplayGain boost is limited by the volume headroom */
+    int32_t gl = min(m_volQ16[LEFTCHANNEL], (int32_t)VOL_UNITY_Q16);
+    int32_t gr = min(m_volQ16[RIGHTCHANNEL], (int32_t)VOL_UNITY_Q16);
+    v[LEFTCHANNEL] = (s[LEFTCHANNEL] * gl) >> 16;
+    v[RIGHTCHANNEL] = (s[RIGHTCHANNEL] * gr) >> 16;
 
     return (v[LEFTCHANNEL] << 16) | (v[RIGHTCHANNEL] & 0xffff);
 }
@@ -5124,7 +6576,7 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
     // G3 - gain high shelf  set between -40 ... +6 dB
     // https://www.earlevel.com/main/2012/11/26/biquad-c-source-code/
 
-    if(getSampleRate() < 1000) return; // fuse
+    if(outputRate() < 1000) return; // fuse
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
@@ -5139,8 +6591,8 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
     const float FcPKEQ = 3000; // Frequency PeakEQ[Hz]
     float       FcHS = 6000;   // Frequency HighShelf[Hz]
 
-    if(getSampleRate() < FcHS * 2 - 100) { // Prevent HighShelf filter from clogging
-        FcHS = getSampleRate() / 2 - 100;
+    if(outputRate() < FcHS * 2 - 100) { // Prevent HighShelf filter from clogging
+        FcHS = outputRate() / 2 - 100;
         // according to the sampling theorem, the sample rate must be at least 2 * 6000 >= 12000Hz for a filter
         // frequency of 6000Hz. If this is not the case, the filter frequency (plus a reserve of 100Hz) is lowered
         AUDIO_INFO("Highshelf frequency lowered, from 6000Hz to %luHz", (long unsigned int)FcHS);
@@ -5148,7 +6600,7 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
     float K, norm, Q, Fc, V;
 
     // LOWSHELF
-    Fc = (float)FcLS / (float)getSampleRate(); // Cutoff frequency
+    Fc = (float)FcLS / (float)outputRate(); // Cutoff frequency
     K = tanf((float)PI * Fc);
     V = powf(10, fabs(G0) / 20.0);
 
@@ -5170,7 +6622,7 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
     }
 
     // PEAK EQ
-    Fc = (float)FcPKEQ / (float)getSampleRate(); // Cutoff frequency
+    Fc = (float)FcPKEQ / (float)outputRate(); // Cutoff frequency
     K = tanf((float)PI * Fc);
     V = powf(10, fabs(G1) / 20.0);
     Q = 2.5;      // Quality factor
@@ -5192,7 +6644,7 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
     }
 
     // HIGHSHELF
-    Fc = (float)FcHS / (float)getSampleRate(); // Cutoff frequency
+    Fc = (float)FcHS / (float)outputRate(); // Cutoff frequency
     K = tanf((float)PI * Fc);
     V = powf(10, fabs(G2) / 20.0);
     if(G2 >= 0) { // boost
@@ -5212,6 +6664,14 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
         m_filter[HIFGSHELF].b2 = (V - sqrtf(2 * V) * K + K * K) * norm;
     }
 
+    // fixed point cascade, the correction factor for positive amplification is folded into the first stage
+    float corr = (m_corr > 1) ? 1 / m_corr : 1;
+    for(uint8_t i = 0; i < 3; i++) {
+        float g = (i == 0) ? corr : 1;
+        m_toneCoef[i] = BQ_quantize(m_filter[i].a0 * g, m_filter[i].a1 * g, m_filter[i].a2 * g, m_filter[i].b1, m_filter[i].b2);
+    }
+    applyEqualizer();
+
     //    log_i("LS a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", m_filter[0].a0, m_filter[0].a1, m_filter[0].a2,
     //                                                  m_filter[0].b1, m_filter[0].b2);
     //    log_i("EQ a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", m_filter[1].a0, m_filter[1].a1, m_filter[1].a2,
@@ -5219,143 +6679,6 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
     //    log_i("HS a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", m_filter[2].a0, m_filter[2].a1, m_filter[2].a2,
     //                                                  m_filter[2].b1, m_filter[2].b2);
 }
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-// clang-format off
-int16_t* Audio::IIR_filterChain0(int16_t iir_in[2], bool clear) { // Infinite Impulse Response (IIR) filters
-
-    uint8_t z1 = 0, z2 = 1;
-    enum : uint8_t { in = 0, out = 1 };
-    float          inSample[2];
-    float          outSample[2];
-    static int16_t iir_out[2];
-
-    if(clear) {
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // zero IIR filterbuffer
-        iir_out[0] = 0;
-        iir_out[1] = 0;
-        iir_in[0] = 0;
-        iir_in[1] = 0;
-    }
-
-    inSample[LEFTCHANNEL] = (float)(iir_in[LEFTCHANNEL]);
-    inSample[RIGHTCHANNEL] = (float)(iir_in[RIGHTCHANNEL]);
-
-    outSample[LEFTCHANNEL] =
-        m_filter[0].a0 * inSample[LEFTCHANNEL] + m_filter[0].a1 * m_filterBuff[0][z1][in][LEFTCHANNEL] +
-        m_filter[0].a2 * m_filterBuff[0][z2][in][LEFTCHANNEL] - m_filter[0].b1 * m_filterBuff[0][z1][out][LEFTCHANNEL] -
-        m_filter[0].b2 * m_filterBuff[0][z2][out][LEFTCHANNEL];
-
-    m_filterBuff[0][z2][in][LEFTCHANNEL] = m_filterBuff[0][z1][in][LEFTCHANNEL];
-    m_filterBuff[0][z1][in][LEFTCHANNEL] = inSample[LEFTCHANNEL];
-    m_filterBuff[0][z2][out][LEFTCHANNEL] = m_filterBuff[0][z1][out][LEFTCHANNEL];
-    m_filterBuff[0][z1][out][LEFTCHANNEL] = outSample[LEFTCHANNEL];
-    iir_out[LEFTCHANNEL] = (int16_t)outSample[LEFTCHANNEL];
-
-    outSample[RIGHTCHANNEL] = m_filter[0].a0 * inSample[RIGHTCHANNEL] +
-                              m_filter[0].a1 * m_filterBuff[0][z1][in][RIGHTCHANNEL] +
-                              m_filter[0].a2 * m_filterBuff[0][z2][in][RIGHTCHANNEL] -
-                              m_filter[0].b1 * m_filterBuff[0][z1][out][RIGHTCHANNEL] -
-                              m_filter[0].b2 * m_filterBuff[0][z2][out][RIGHTCHANNEL];
-
-    m_filterBuff[0][z2][in][RIGHTCHANNEL] = m_filterBuff[0][z1][in][RIGHTCHANNEL];
-    m_filterBuff[0][z1][in][RIGHTCHANNEL] = inSample[RIGHTCHANNEL];
-    m_filterBuff[0][z2][out][RIGHTCHANNEL] = m_filterBuff[0][z1][out][RIGHTCHANNEL];
-    m_filterBuff[0][z1][out][RIGHTCHANNEL] = outSample[RIGHTCHANNEL];
-    iir_out[RIGHTCHANNEL] = (int16_t)outSample[RIGHTCHANNEL];
-
-    return iir_out;
-}
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-int16_t* Audio::IIR_filterChain1(int16_t iir_in[2], bool clear) { // Infinite Impulse Response (IIR) filters
-
-    uint8_t z1 = 0, z2 = 1;
-    enum : uint8_t { in = 0, out = 1 };
-    float          inSample[2];
-    float          outSample[2];
-    static int16_t iir_out[2];
-
-    if(clear) {
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // zero IIR filterbuffer
-        iir_out[0] = 0;
-        iir_out[1] = 0;
-        iir_in[0] = 0;
-        iir_in[1] = 0;
-    }
-
-    inSample[LEFTCHANNEL] = (float)(iir_in[LEFTCHANNEL]);
-    inSample[RIGHTCHANNEL] = (float)(iir_in[RIGHTCHANNEL]);
-
-    outSample[LEFTCHANNEL] =
-        m_filter[1].a0 * inSample[LEFTCHANNEL] + m_filter[1].a1 * m_filterBuff[1][z1][in][LEFTCHANNEL] +
-        m_filter[1].a2 * m_filterBuff[1][z2][in][LEFTCHANNEL] - m_filter[1].b1 * m_filterBuff[1][z1][out][LEFTCHANNEL] -
-        m_filter[1].b2 * m_filterBuff[1][z2][out][LEFTCHANNEL];
-
-    m_filterBuff[1][z2][in][LEFTCHANNEL] = m_filterBuff[1][z1][in][LEFTCHANNEL];
-    m_filterBuff[1][z1][in][LEFTCHANNEL] = inSample[LEFTCHANNEL];
-    m_filterBuff[1][z2][out][LEFTCHANNEL] = m_filterBuff[1][z1][out][LEFTCHANNEL];
-    m_filterBuff[1][z1][out][LEFTCHANNEL] = outSample[LEFTCHANNEL];
-    iir_out[LEFTCHANNEL] = (int16_t)outSample[LEFTCHANNEL];
-
-    outSample[RIGHTCHANNEL] = m_filter[1].a0 * inSample[RIGHTCHANNEL] +
-                              m_filter[1].a1 * m_filterBuff[1][z1][in][RIGHTCHANNEL] +
-                              m_filter[1].a2 * m_filterBuff[1][z2][in][RIGHTCHANNEL] -
-                              m_filter[1].b1 * m_filterBuff[1][z1][out][RIGHTCHANNEL] -
-                              m_filter[1].b2 * m_filterBuff[1][z2][out][RIGHTCHANNEL];
-
-    m_filterBuff[1][z2][in][RIGHTCHANNEL] = m_filterBuff[1][z1][in][RIGHTCHANNEL];
-    m_filterBuff[1][z1][in][RIGHTCHANNEL] = inSample[RIGHTCHANNEL];
-    m_filterBuff[1][z2][out][RIGHTCHANNEL] = m_filterBuff[1][z1][out][RIGHTCHANNEL];
-    m_filterBuff[1][z1][out][RIGHTCHANNEL] = outSample[RIGHTCHANNEL];
-    iir_out[RIGHTCHANNEL] = (int16_t)outSample[RIGHTCHANNEL];
-
-    return iir_out;
-}
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-int16_t* Audio::IIR_filterChain2(int16_t iir_in[2], bool clear) { // Infinite Impulse Response (IIR) filters
-
-    uint8_t z1 = 0, z2 = 1;
-    enum : uint8_t { in = 0, out = 1 };
-    float          inSample[2];
-    float          outSample[2];
-    static int16_t iir_out[2];
-
-    if(clear) {
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // zero IIR filterbuffer
-        iir_out[0] = 0;
-        iir_out[1] = 0;
-        iir_in[0] = 0;
-        iir_in[1] = 0;
-    }
-
-    inSample[LEFTCHANNEL] = (float)(iir_in[LEFTCHANNEL]);
-    inSample[RIGHTCHANNEL] = (float)(iir_in[RIGHTCHANNEL]);
-
-    outSample[LEFTCHANNEL] =
-        m_filter[2].a0 * inSample[LEFTCHANNEL] + m_filter[2].a1 * m_filterBuff[2][z1][in][LEFTCHANNEL] +
-        m_filter[2].a2 * m_filterBuff[2][z2][in][LEFTCHANNEL] - m_filter[2].b1 * m_filterBuff[2][z1][out][LEFTCHANNEL] -
-        m_filter[2].b2 * m_filterBuff[2][z2][out][LEFTCHANNEL];
-
-    m_filterBuff[2][z2][in][LEFTCHANNEL] = m_filterBuff[2][z1][in][LEFTCHANNEL];
-    m_filterBuff[2][z1][in][LEFTCHANNEL] = inSample[LEFTCHANNEL];
-    m_filterBuff[2][z2][out][LEFTCHANNEL] = m_filterBuff[2][z1][out][LEFTCHANNEL];
-    m_filterBuff[2][z1][out][LEFTCHANNEL] = outSample[LEFTCHANNEL];
-    iir_out[LEFTCHANNEL] = (int16_t)outSample[LEFTCHANNEL];
-
-    outSample[RIGHTCHANNEL] = m_filter[2].a0 * inSample[RIGHTCHANNEL] +
-                              m_filter[2].a1 * m_filterBuff[2][z1][in][RIGHTCHANNEL] +
-                              m_filter[2].a2 * m_filterBuff[2][z2][in][RIGHTCHANNEL] -
-                              m_filter[2].b1 * m_filterBuff[2][z1][out][RIGHTCHANNEL] -
-                              m_filter[2].b2 * m_filterBuff[2][z2][out][RIGHTCHANNEL];
-
-    m_filterBuff[2][z2][in][RIGHTCHANNEL] = m_filterBuff[2][z1][in][RIGHTCHANNEL];
-    m_filterBuff[2][z1][in][RIGHTCHANNEL] = inSample[RIGHTCHANNEL];
-    m_filterBuff[2][z2][out][RIGHTCHANNEL] = m_filterBuff[2][z1][out][RIGHTCHANNEL];
-    m_filterBuff[2][z1][out][RIGHTCHANNEL] = outSample[RIGHTCHANNEL];
-    iir_out[RIGHTCHANNEL] = (int16_t)outSample[RIGHTCHANNEL];
-
-    return iir_out;
-}
-// clang-format on
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 //    AAC - T R A N S P O R T S T R E A M
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -5861,6 +7184,8 @@ void Audio::seek_m4a_ilst() {
     len -= 4;
     audiofile.seek(seekpos);
     audiofile.read(data, len);
+    GL_parseSmpb(data, len, &m_glInfo); // gapless info, freeform atom "----"
+    RG_parse(data, len, &m_rgTag);      // freeform atoms "replaygain_*"
 
     int offset = 0;
     for(int i = 0; i < 12; i++) {
@@ -22,6 +22,21 @@
 #include <FS.h>
 #include <FFat.h>
 #include <atomic>
+#include "dsp/biquad_eq.h"
+#include "dsp/param_eq.h"
+#include "dsp/level_meter.h"
+#include "dsp/spectrum.h"
+#include "dsp/resampler.h"
+#include "dsp/time_stretch.h"
+#include "dsp/gapless.h"
+#include "dsp/crossfade.h"
+#include "dsp/loudness.h"
+#include "dsp/limiter.h"
+#include "dsp/volume.h"
+#include "dsp/pcm_ring.h"
+#include "dsp/read_ahead.h"
+#include "dsp/seek_map.h"
+#include "AudioBuffer.h"
 
 #if ESP_IDF_VERSION_MAJOR == 5
 #include <driver/i2s_std.h>
@@ -55,73 +70,34 @@ extern __attribute__((weak)) void audio_process_i2s(uint32_t* sample, bool *cont
 
 //----------------------------------------------------------------------------------------------------------------------
 
-class AudioBuffer {
-// AudioBuffer will be allocated in PSRAM, If PSRAM not available or has not enough space AudioBuffer will be
-// allocated in FlashRAM with reduced size
-//
-//  m_buffer            m_readPtr                 m_writePtr                 m_endPtr
-//   |                       |<------dataLength------->|<------ writeSpace ----->|
-//   ▼                       ▼                         ▼                         ▼
-//   ---------------------------------------------------------------------------------------------------------------
-//   |                     <--m_buffSize-->                                      |      <--m_resBuffSize -->     |
-//   ---------------------------------------------------------------------------------------------------------------
-//   |<-----freeSpace------->|                         |<------freeSpace-------->|
-//
-//
-//
-//   if the space between m_readPtr and buffend < m_resBuffSize copy data from the beginning to resBuff
-//   so that the mp3/aac/flac frame is always completed
-//
-//  m_buffer                      m_writePtr                 m_readPtr        m_endPtr
-//   |                                 |<-------writeSpace------>|<--dataLength-->|
-//   ▼                                 ▼                         ▼                ▼
-//   ---------------------------------------------------------------------------------------------------------------
-//   |                        <--m_buffSize-->                                    |      <--m_resBuffSize -->     |
-//   ---------------------------------------------------------------------------------------------------------------
-//   |<---  ------dataLength--  ------>|<-------freeSpace------->|
-//
-//
+typedef struct _audio_stats{
+    uint32_t i2sWritesPerSec;   // calls into the I2S driver during the last second
+    uint32_t framesPerSec;      // decoded frames during the last second
+    uint32_t cpuUsPerFrame;     // decode + output processing time per decoded frame [us]
+    uint32_t outputUsPerFrame;  // output processing (DSP + I2S) share of cpuUsPerFrame [us]
+    uint32_t eqCyclesPerSample; // CPU cycles of the tone filter per stereo frame, 0 if bypassed
+    uint32_t resamplerCyclesPerSample; // CPU cycles of the resampler and time stretching per output frame, 0 if not used
+    uint32_t gaplessPrimeUs;    // last gapless track change: end of file -> next file ready to decode [us]
+    uint32_t gaplessSilentFrames; // last gapless track change: digital silence around the splice [frames]
+    uint32_t mixCyclesPerBlock; // CPU cycles per crossfaded output block (512 frames), 0 if no crossfade ran
+    uint32_t loudnessCyclesPerSample; // CPU cycles of the R128 meter per decoded frame, 0 if no track is measured
+    uint32_t limiterCyclesPerSample; // CPU cycles of the limiter per output frame, 0 if off
+    uint32_t limiterMaxReduction; // largest gain reduction of the limiter during the last second [0.1 dB]
+    uint32_t ringFrames;        // decoded frames waiting for the output task, 0 without startOutputTask()
+    uint32_t ringUnderruns;     // the output task found the ring empty while playing, since startOutputTask()
+    uint32_t decodeAheadMs;     // lowest fill of the ring during the last second [ms]
+    uint32_t wakeupsPerSec;     // calls of loop() during the last second
+    uint32_t wakeEventPerSec;   // waitForWork() woken by the I2S DMA or the PCM ring during the last second
+    uint32_t wakeInputPerSec;   // waitForWork() returned at once (input buffer low) during the last second
+    uint32_t wakeTimeoutPerSec; // waitForWork() slept maxMs without an event during the last second
+    uint32_t dmaUnderruns;      // all I2S DMA descriptors ran empty while playing (IDF5), since start
+    uint32_t sdReadKBytesPerSec; // read-ahead: card throughput while reading during the last second, 0 without startReadAhead()
+    uint32_t sdReadMaxUs;       // read-ahead: slowest chunk during the last second [us]
+    uint32_t readAheadMs;       // read-ahead: compressed audio in the ring, from the bitrate [ms]
+} audio_stats_t;
+
+typedef lm_level_t audio_level_t;   // rms, peak, peakHold [LEFT/RIGHT], linear 0 ... 32767
 
-public:
-    AudioBuffer(size_t maxBlockSize = 0);       // constructor
-    ~AudioBuffer();                             // frees the buffer
-    size_t   init();                            // set default values
-    bool     isInitialized() { return m_f_init; };
-    void     setBufsize(int ram, int psram);
-    int32_t  getBufsize();
-    void     changeMaxBlockSize(uint16_t mbs);  // is default 1600 for mp3 and aac, set 16384 for FLAC
-    uint16_t getMaxBlockSize();                 // returns maxBlockSize
-    size_t   freeSpace();                       // number of free bytes to overwrite
-    size_t   writeSpace();                      // space fom writepointer to bufferend
-    size_t   bufferFilled();                    // returns the number of filled bytes
-    size_t   getMaxAvailableBytes();            // max readable bytes in one block
-    void     bytesWritten(size_t bw);           // update writepointer
-    void     bytesWasRead(size_t br);           // update readpointer
-    uint8_t* getWritePtr();                     // returns the current writepointer
-    uint8_t* getReadPtr();                      // returns the current readpointer
-    uint32_t getWritePos();                     // write position relative to the beginning
-    uint32_t getReadPos();                      // read position relative to the beginning
-    void     resetBuffer();                     // restore defaults
-    bool     havePSRAM() { return m_f_psram; };
-
-protected:
-    size_t   m_buffSizePSRAM    = UINT16_MAX * 10;   // most webstreams limit the advance to 100...300Kbytes
-    size_t   m_buffSizeRAM      = 1600 * 10;
-    size_t   m_buffSize         = 0;
-    size_t   m_freeSpace        = 0;
-    size_t   m_writeSpace       = 0;
-    size_t   m_dataLength       = 0;
-    size_t   m_resBuffSizeRAM   = 2048;     // reserved buffspace, >= one wav  frame
-    size_t   m_resBuffSizePSRAM = 4096 * 4; // reserved buffspace, >= one flac frame
-    size_t   m_maxBlockSize     = 1600;
-    uint8_t* m_buffer           = NULL;
-    uint8_t* m_writePtr         = NULL;
-    uint8_t* m_readPtr          = NULL;
-    uint8_t* m_endPtr           = NULL;
-    bool     m_f_start          = true;
-    bool     m_f_init           = false;
-    bool     m_f_psram          = false;    // PSRAM is available (and used...)
-};
 //----------------------------------------------------------------------------------------------------------------------
 
 class Audio : private AudioBuffer{
@@ -136,23 +112,28 @@ public:
     bool connecttohost(const char* host, const char* user = "", const char* pwd = "");
     bool connecttospeech(const char* speech, const char* lang);
     bool connecttoFS(fs::FS &fs, const char* path, int32_t resumeFilePos = -1);
+    bool setNextFile(fs::FS &fs, const char* path); // gapless, call while a file plays, starts at its end
+    void clearNextFile();
     bool setFileLoop(bool input);//TEST loop
     void setConnectionTimeout(uint16_t timeout_ms, uint16_t timeout_ms_ssl);
-    bool setAudioPlayPosition(uint16_t sec);
+    bool setAudioPlayPosition(uint16_t sec); // also right after connecttoFS(), MP3: Xing/VBRI TOC or setSeekMap()
+    bool setSeekMap(const uint8_t* data, size_t len); // MP3 frame index of the current file (SM_size() bytes), exact seeks
     bool setFilePos(uint32_t pos);
-    bool audioFileSeek(const float speed);
+    bool audioFileSeek(const float speed); // setOutputRate(): time stretched, the pitch stays, otherwise varispeed
     bool setTimeOffset(int sec);
     bool setPinout(uint8_t BCLK, uint8_t LRC, uint8_t DOUT, int8_t MCLK = I2S_GPIO_UNUSED);
     bool pauseResume();
     bool isRunning() {return m_f_running;}
     void loop();
+    uint32_t waitForWork(uint32_t maxMs = 20); // call after loop(), sleeps until the output needs data or maxMs
     uint32_t stopSong();
     void forceMono(bool m);
     void setBalance(int8_t bal = 0);
-    void setVolumeSteps(uint8_t steps);
-    void setVolume(uint8_t vol, uint8_t curve = 0);
-    uint8_t getVolume();
-    uint8_t maxVolume();
+    void setVolumeSteps(uint16_t steps);                   // 1 ... 256
+    void setVolume(uint16_t vol, uint8_t curve = 0);       // curve: VOL_CURVE_SQUARE, VOL_CURVE_LOG, any task
+    void setVolumeRamp(uint16_t ms, uint8_t shape = VOL_RAMP_LINEAR); // block output, a new volume is reached after ms
+    uint16_t getVolume();
+    uint16_t maxVolume();
     uint8_t getI2sPort();
 
     uint32_t getAudioDataStartPos();
@@ -166,12 +147,37 @@ public:
     uint32_t getAudioCurrentTime();
     uint32_t getTotalPlayingTime();
     uint16_t getVUlevel();
+    void getAudioLevel(audio_level_t* level); // lock-free, any task, values of the last output block
+    bool setSpectrum(uint16_t points, uint8_t bands, uint16_t intervalMs = 33); // points 256 or 512, 0: off
+    uint8_t getSpectrum(uint8_t* bands, uint8_t maxBands);  // log spaced bands 0 ... 255, returns their number
 
     uint32_t inBufferFilled(); // returns the number of stored bytes in the inputbuffer
     uint32_t inBufferFree();   // returns the number of free bytes in the inputbuffer
     uint32_t inBufferSize();   // returns the size of the inputbuffer in bytes
     void setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass);
+    bool loadEqualizerPresets(fs::FS& fs, const char* path);  // text file, format see dsp/param_eq.h
+    bool setEqualizerPresets(const char* text);
+    bool setEqualizerPreset(int8_t preset);                   // -1: tone control (setTone), O(1), any task
+    int8_t getEqualizerPreset() {return m_eqSelect;}
+    uint8_t getEqualizerPresetCount() {return m_eqNumSets;}
+    bool getEqualizerPresetName(uint8_t preset, char* buf, size_t len); // copied, setEqualizerPresets() frees the names
     void setI2SCommFMT_LSB(bool commFMT);
+    void setBlockOutput(bool block);  // true (default): process and write whole frames, false: sample by sample
+    bool startOutputTask(uint16_t ringMs = 150, uint8_t core = 1, uint8_t prio = 18); // loop() decodes into a ring, a task feeds I2S
+    void stopOutputTask();
+    bool startReadAhead(uint8_t seconds = 4, uint16_t chunkKB = 32, uint8_t core = 0, uint8_t prio = 2); // local files: a task reads ahead
+    void stopReadAhead();
+    bool setOutputRate(uint32_t rate, uint8_t quality = RS_QUALITY_MEDIUM); // I2S locked to rate, 0: follows the stream
+    bool setCrossfade(uint8_t seconds, uint8_t shape = XF_EQUAL_POWER); // 0...12 s, needs setOutputRate() and PSRAM
+    void fadeOut(uint16_t ms); // output -> silence, the next stream fades in over the same time
+    void setReplayGain(uint8_t mode, int8_t preampDb = 0);  // RG_OFF, RG_TRACK, RG_ALBUM, part of the volume
+    bool setGainTable(fs::FS& fs, const char* path);        // loudness of files without ReplayGain tags, measured once
+    bool flushGainTable();                                  // writes new measurements (not from the audio task)
+    float getReplayGain() {return m_rgDb;}                  // applied to the current track [dB]
+    bool setLimiter(bool on, float ceilingDb = -1.0, uint8_t lookaheadMs = 2, uint16_t releaseMs = 80); // block output
+    float getLimiterReduction();                            // gain reduction of the last output block [dB], any task
+    uint32_t getOutputRate() {return m_outRate;}
+    void getAudioStats(audio_stats_t* stats);
     int getCodec() {return m_codec;}
     const char *getCodecname() {return codecname[m_codec];}
     void unicode2utf8(char* buff, uint32_t len);
@@ -208,6 +214,10 @@ private:
     int  sendBytes(uint8_t* data, size_t len);
     void setDecoderItems();
     void compute_audioCurrentTime(int bd);
+    bool seekMapValid();
+    float seekMapTime(uint32_t pos);
+    bool seekTime(uint32_t ms);
+    uint32_t seekFilePos(uint32_t ms);
     void printDecodeError(int r);
     void showID3Tag(const char* tag, const char* val);
     size_t readAudioHeader(uint32_t bytes);
@@ -221,24 +231,65 @@ private:
     bool setChannels(int channels);
     bool setBitrate(int br);
     void playChunk();
+    void playChunkSamplewise();
     bool playSample(int16_t sample[2]);
-    void computeVUlevel(int16_t sample[2]);
+    uint16_t fillI2SStage(int16_t* blk);
+    void processBlock(int16_t* blk, uint16_t frames);
+    uint16_t packBlock(int16_t* blk, uint16_t frames);
+    void gainBlock(int32_t* work, int16_t* blk, uint16_t frames);
+    uint16_t packWords(int16_t* blk, uint32_t* out, uint16_t frames);
+    void volumeTarget();
+    bool flushI2SStage();
+    inline bool ringSpace(){ return !m_f_outFlush && PR_free(&m_pcmRing) >= m_i2sStageFrames; }
+    void outputFlush(bool drain);
+    static void outputTask(void* param);
+    bool inputLow();
+#if ESP_IDF_VERSION_MAJOR == 5
+    static bool i2sSentCb(i2s_chan_handle_t handle, i2s_event_data_t* event, void* ctx);
+    static bool i2sOvfCb(i2s_chan_handle_t handle, i2s_event_data_t* event, void* ctx);
+#endif
+    void outputLoop();
+    uint32_t rgMarkers(uint32_t rd);
+    int32_t readLocal(uint8_t* dst, uint32_t len, uint32_t pos);
+    void raOpen(fs::FS* fs, const char* path);
+    void raRequest(uint32_t pos);
+    static void readAheadTask(void* param);
+    void readAheadLoop();
+    void updateAudioStats();
+    inline bool outputPending(){ return m_validSamples || m_rsInPos < m_rsInFrames || m_strInPos < m_strInFrames || (m_i2sStageBytes && !xfActive()); }
+    inline bool xfActive(){ return m_xfRing.buff && getDatamode() == AUDIO_LOCALFILE; } // output comes from the ring
+    inline uint32_t outputRate(){ return m_outRate ? m_outRate : m_sampleRate; } // rate of the DSP chain and I2S
+    void setI2SClock(uint32_t rate);
+    uint16_t resampleBlock(int16_t* blk);
+    uint16_t stretchBlock(int16_t* blk);
+    uint16_t sourceBlock(int16_t* blk);
+    void xfFill();
+    uint16_t xfBlock(int16_t* blk);
+    void masterFade(int16_t* blk, uint16_t frames);
+    void resetResampler();
+    void publishLevel();
+    void spectrumFeed(const int16_t* buff, uint16_t frames, uint8_t ch, uint32_t rate);
+    static void spectrumTask(void* param);
     void computeLimit();
+    void setRgGain(double g);
     int32_t Gain(int16_t s[2]);
     void showstreamtitle(const char* ml);
     bool parseContentType(char* ct);
     bool parseHttpResponseHeader();
     bool initializeDecoder();
+    uint8_t codecFromFileName(const char* name);
+    void startNextFile();
+    void rgTrackStart(bool fromStart);
+    void rgTrackEnd();
+    void trackSilence(const int16_t* blk, uint16_t frames);
     esp_err_t I2Sstart(uint8_t i2s_num);
     esp_err_t I2Sstop(uint8_t i2s_num);
     void urlencode(char* buff, uint16_t buffLen, bool spacesOnly = false);
-    int16_t* IIR_filterChain0(int16_t iir_in[2], bool clear = false);
-    int16_t* IIR_filterChain1(int16_t iir_in[2], bool clear = false);
-    int16_t* IIR_filterChain2(int16_t iir_in[2], bool clear = false);
     inline void setDatamode(uint8_t dm){m_datamode=dm;}
     inline uint8_t getDatamode(){return m_datamode;}
     inline uint32_t streamavail(){ return _client ? _client->available() : 0;}
     void IIR_calculateCoefficients(int8_t G1, int8_t G2, int8_t G3);
+    void applyEqualizer();
     bool ts_parsePacket(uint8_t* packet, uint8_t* packetStart, uint8_t* packetLength);
 
 //+++ W E B S T R E A M  -  H E L P   F U N C T I O N S +++
@@ -456,6 +507,8 @@ private:
     WiFiClientSecure      clientsecure; // @suppress("Abstract class cannot be instantiated")
     WiFiClient*           _client = nullptr;
     SemaphoreHandle_t     mutex_audio;
+    SemaphoreHandle_t     mutex_out;    // output stage (volume ramp, limiter, I2S clock), one block long, after mutex_audio
+    SemaphoreHandle_t     mutex_ra;     // read-ahead request (file, position), held for a copy only
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wmissing-field-initializers"
@@ -480,6 +533,7 @@ private:
     const size_t    m_frameSizeOPUS   = 1024;
     const size_t    m_frameSizeVORBIS = 4096 * 2;
     const size_t    m_outbuffSize     = 4096 * 2;
+    static const uint16_t m_i2sStageFrames = 512;   // = dma_frame_num, one DMA descriptor
 
     static const uint8_t m_tsPacketSize  = 188;
     static const uint8_t m_tsHeaderSize  = 4;
@@ -502,9 +556,16 @@ private:
     int             m_controlCounter = 0;           // Status within readID3data() and readWaveHeader()
     int8_t          m_balance = 0;                  // -16 (mute left) ... +16 (mute right)
     uint16_t        m_vol = 21;                     // volume
-    uint8_t         m_vol_steps = 21;               // default
-    double          m_limit_left = 0;               // limiter 0 ... 1, left channel
-    double          m_limit_right = 0;              // limiter 0 ... 1, right channel
+    uint16_t        m_vol_steps = 21;               // default
+    uint16_t        m_volTable[2][VOL_MAX_STEPS + 1]; // [curve][vol] gain, Q15, built by setVolumeSteps()
+    int32_t         m_volQ16[2] = {0, 0};           // [LEFT/RIGHT] volume, balance and ReplayGain, max 16.0, Q16
+    int32_t         m_rgQ16 = VOL_UNITY_Q16;        // m_rgGain of the frames that are played (behind the ring)
+    vol_ramp_t      m_volRamp = {};                 // the block output moves to m_volQ16 over some ms
+    uint16_t        m_volRampMs = 5;
+    lim_t           m_lim;                          // look-ahead peak limiter, last stage of the block output
+    int32_t*        m_limWork = NULL;               // one block, 32 bit
+    bool            m_f_limiter = false;
+    std::atomic<uint16_t> m_limGain{LIM_UNITY};     // lowest gain of the last block, Q15
     uint8_t         m_curve = 0;                    // volume characteristic
     uint8_t         m_bitsPerSample = 16;           // bitsPerSample
     uint8_t         m_channels = 2;
@@ -516,9 +577,30 @@ private:
     uint8_t         m_filterType[2];                // lowpass, highpass
     uint8_t         m_streamType = ST_NONE;
     uint8_t         m_ID3Size = 0;                  // lengt of ID3frame - ID3header
-    uint8_t         m_vuLeft = 0;                   // average value of samples, left channel
-    uint8_t         m_vuRight = 0;                  // average value of samples, right channel
+    lm_acc_t        m_meterAcc = {};                // level meter, sums of the current block
+    lm_hold_t       m_meterHold = {};
+    audio_level_t   m_level = {};                   // published snapshot, guarded by m_levelSeq
+    std::atomic<uint32_t> m_levelSeq{0};            // seqlock, odd while m_level is written
+    sp_fft_t*       m_spFft = NULL;                 // spectrum analyzer, computed in m_spTask
+    TaskHandle_t    m_spTask = NULL;
+    int16_t*        m_spCapture[2] = {NULL, NULL};  // decimated mono mix, double buffered
+    uint32_t        m_spRate[2] = {0, 0};           // samplerate of the capture
+    uint8_t         m_spWrite = 0;                  // capture buffer filled by the audio task
+    uint8_t         m_spReady = 0;                  // capture buffer handed over to m_spTask
+    uint16_t        m_spFill = 0;
+    uint8_t         m_spDecim = 1;
+    uint8_t         m_spDecCnt = 0;
+    int32_t         m_spDecAcc = 0;
+    uint16_t        m_spInterval = 33;              // ms between two captures
+    uint32_t        m_spLast = 0;
+    uint8_t         m_spBands[2][SP_MAX_BANDS];     // double buffered result
+    std::atomic<uint8_t> m_spPublished{0};          // index of the valid result
+    std::atomic<bool> m_spBusy{false};              // m_spTask works on m_spCapture[m_spReady]
+    bool            m_spOn = false;
     int16_t*        m_outBuff = NULL;               // Interleaved L/R
+    uint32_t*       m_i2sStage = NULL;              // processed frames, ready for the I2S driver
+    size_t          m_i2sStageBytes = 0;            // bytes in m_i2sStage
+    size_t          m_i2sStageSent = 0;             // bytes of m_i2sStage already accepted by the driver
     std::atomic<int16_t>  m_validSamples = {0};     // #144
     std::atomic<int16_t>  m_curSample{0};
     std::atomic<uint16_t> m_datamode{0};            // Statemaschine
@@ -565,12 +647,76 @@ private:
     bool            m_f_m4aID3dataAreRead = false;  // has the m4a-ID3data already been read?
     bool            m_f_psramFound = false;         // set in constructor, result of psramInit()
     bool            m_f_timeout = false;            //
+    bool            m_f_blockOutput = true;         // write whole blocks to I2S instead of single samples
+    uint32_t        m_outRate = 0;                  // fixed I2S rate, 0: I2S follows the samplerate of the stream
+    uint32_t        m_speedQ16 = 65536;             // playback speed (audioFileSeek), 1.0 = 65536
+    ts_t            m_str;                          // time stretching, decoded frames -> m_speedQ16, before m_rs
+    int16_t*        m_strBuf = NULL;                // TS_bufSize(), allocated by the first audioFileSeek() != 1.0
+    int16_t*        m_strIn = NULL;                 // decoded frames waiting for the time stretching, L/R
+    uint16_t        m_strInFrames = 0;
+    uint16_t        m_strInPos = 0;
+    rs_t            m_rs;                           // resampler, decoded frames -> m_outRate
+    int16_t*        m_rsCoef = NULL;                // polyphase table, RS_coefSize()
+    int16_t*        m_rsIn = NULL;                  // decoded frames waiting for the resampler, L/R
+    uint16_t        m_rsInFrames = 0;
+    uint16_t        m_rsInPos = 0;
+    File            m_nextFile;                     // gapless: opened by setNextFile(), played after audiofile
+    fs::FS*         m_nextFs = NULL;
+    uint8_t*        m_nextHead = NULL;              // first bytes of m_nextFile, read ahead
+    uint32_t        m_nextHeadLen = 0;
+    const size_t    m_nextHeadSize = 16 * 1024;
+    uint8_t         m_nextCodec = CODEC_NONE;
+    bool            m_f_gaplessPrime = false;       // header of the next file is being read, the DMA plays the last one
+    uint32_t        m_gaplessT0 = 0;
+    gl_info_t       m_glInfo;                       // encoder delay / padding of the current file
+    gl_trim_t       m_trim;
+    sm_map_t*       m_seekMap = NULL;               // frame offsets of the current MP3 file (TOC or frame index), PSRAM
+    int32_t         m_seekMs = -1;                  // seek by time, the file position is found in processLocalFile()
+    gl_trim_t       m_seekTrim;                     // trimming behind a seek, the target sample of a frame index
+    bool            m_f_seekTrim = false;
+    bool            m_f_spliceArmed = false;        // measure the silence at the next non-zero output frame
+    uint32_t        m_zeroRun = 0;                  // zero frames at the end of the output so far
+    xf_ring_t       m_xfRing = {};                  // crossfade: decoded ahead, holds the end of the last track, PSRAM
+    int16_t*        m_xfTmp = NULL;                 // one block of the incoming track
+    uint16_t        m_xfCurve[XF_CURVE_POINTS + 1]; // fade in gain, also used by fadeOut()
+    uint32_t        m_xfFrames = 0;                 // crossfade length, 0: off (a remaining ring is played out)
+    uint32_t        m_xfLen = 0;                    // running crossfade, 0: none
+    uint32_t        m_xfPos = 0;
+    uint32_t        m_mfLen = 0;                    // running fade of the whole output, 0: none
+    uint32_t        m_mfPos = 0;
+    uint16_t        m_mfMs = 0;
+    bool            m_f_mfIn = false;
+    bool            m_f_muted = false;              // after fadeOut(), until the next stream starts
+    uint8_t         m_rgMode = RG_OFF;
+    int8_t          m_rgPreamp = 0;                 // dB
+    rg_info_t       m_rgTag = {};                   // ReplayGain tags of the current file
+    double          m_rgGain = 1.0;                 // current track, folded into m_volQ16 (m_rgQ16)
+    double          m_rgXfA = 0;                    // while crossfading: gains of the last and the next track
+    double          m_rgXfB = 0;                    // 0: no gain change pending
+    float           m_rgDb = 0;
+    lt_entry_t*     m_lt = NULL;                    // gain table, PSRAM
+    uint32_t        m_ltCount = 0;
+    uint32_t        m_ltUnsaved = 0;                // last entries, not in the file yet
+    uint32_t        m_ltCap = 0;
+    fs::FS*         m_ltFs = NULL;
+    char*           m_ltPath = NULL;
+    r128_t          m_r128;                         // loudness of the current file if it is not in the gain table
+    uint32_t*       m_r128Hist = NULL;
+    uint32_t        m_r128Path = 0;                 // hashes of the measured file
+    uint32_t        m_r128Dir = 0;
+    bool            m_f_r128 = false;               // measuring, invalid after a seek
+    bool            m_f_r128Arm = false;            // measure from the first decoded frame on (its rate, channels)
     uint8_t         m_f_channelEnabled = 3;         // internal DAC, both channels
     uint32_t        m_audioFileDuration = 0;
     float           m_audioCurrentTime = 0;
     uint32_t        m_audioDataStart = 0;           // in bytes
     size_t          m_audioDataSize = 0;            //
-    float           m_filterBuff[3][2][2][2];       // IIR filters memory for Audio DSP
+    bq_eq_t         m_eq;                           // fixed point biquad cascade, tone control or parametric EQ
+    bq_coef_t       m_toneCoef[3];                  // setTone() curve for the current sample rate
+    peq_bankset_t*  m_eqSets = NULL;                // parametric EQ presets, banks for all sample rates
+    uint8_t         m_eqNumSets = 0;
+    std::atomic<int8_t> m_eqSelect{-1};             // requested preset, -1: tone control
+    int8_t          m_eqActive = -1;                // preset loaded into m_eq, audio task only
     float           m_corr = 1.0;					// correction factor for level adjustment
     size_t          m_i2s_bytesWritten = 0;         // set in i2s_write() but not used
     size_t          m_file_size = 0;                // size of the file
@@ -578,6 +724,66 @@ private:
     int8_t          m_gain0 = 0;                    // cut or boost filters (EQ)
     int8_t          m_gain1 = 0;
     int8_t          m_gain2 = 0;
+    uint32_t        m_statsTime = 0;                // start of the current statistics interval (millis)
+    uint32_t        m_statsI2sWrites = 0;           // counters of the current statistics interval
+    uint32_t        m_statsFrames = 0;
+    uint32_t        m_statsDecodeUs = 0;
+    std::atomic<uint32_t> m_statsOutputUs{0};       // playChunk() (decoder task) and the output task add to it
+    uint32_t        m_statsEqCycles = 0;
+    uint32_t        m_statsEqFrames = 0;
+    uint32_t        m_statsRsCycles = 0;
+    uint32_t        m_statsRsFrames = 0;
+    uint32_t        m_statsXfCycles = 0;
+    uint32_t        m_statsXfBlocks = 0;
+    uint32_t        m_statsLnCycles = 0;
+    uint32_t        m_statsLnFrames = 0;
+    uint32_t        m_statsLimCycles = 0;
+    uint32_t        m_statsLimFrames = 0;
+    uint16_t        m_statsLimMin = LIM_UNITY;
+    audio_stats_t   m_stats = {};                   // values of the last complete interval
+    pcm_ring_t      m_pcmRing{};                    // loop() -> output task, startOutputTask()
+    TaskHandle_t    m_outTask = NULL;
+    int32_t*        m_outWork = NULL;               // output task: one block from the ring
+    uint32_t*       m_outStage = NULL;              // output task: I2S words
+    std::atomic<bool> m_f_outRun{false};            // cleared by stopOutputTask()
+    std::atomic<bool> m_f_outExit{false};           // set by the output task when it ends
+    std::atomic<bool> m_f_outFlush{false};          // the output task drops the ring and clears the flag
+    std::atomic<bool> m_f_eofDrain{false};          // end of file, the ring is played out although !m_f_running
+    std::atomic<uint32_t> m_ringUnderruns{0};
+    std::atomic<uint32_t> m_ringMin{UINT32_MAX};    // lowest fill of the current statistics interval
+    uint32_t        m_rgMarkAt[4] = {};             // ReplayGain changes at ring positions (wr), see setRgGain()
+    int32_t         m_rgMarkQ16[4] = {};
+    std::atomic<uint32_t> m_rgMarkWr{0};            // the decoder side adds a change, the output task applies it
+    std::atomic<uint32_t> m_rgMarkRd{0};
+    TaskHandle_t    m_wakeTask = NULL;              // sleeps in waitForWork(), woken from the I2S interrupt
+    volatile uint8_t m_dmaSent = 0;                 // DMA descriptors sent since the last waitForWork()
+    uint8_t         m_wakeDescs = 4;                // wake after this many (no output task), a quarter of the DMA
+    uint8_t         m_wakeBurst = 0;                // waitForWork() returned at once (input low)
+    uint32_t        m_statsLoops = 0;
+    uint32_t        m_statsWakeEvent = 0;           // waitForWork() returns, by cause
+    uint32_t        m_statsWakeInput = 0;
+    uint32_t        m_statsWakeTimeout = 0;
+    std::atomic<uint32_t> m_dmaUnderruns{0};
+    ra_ring_t       m_raRing{};                     // SD card -> loop(), startReadAhead()
+    TaskHandle_t    m_raTask = NULL;
+    uint8_t*        m_raStage = NULL;               // read-ahead task: DMA capable, the card does not read into PSRAM
+    uint32_t        m_raStageSize = 0;
+    uint32_t        m_raChunk = 0;                  // reads end on a multiple of this file offset (sectors, clusters)
+    uint8_t         m_raSeconds = 0;                // kept ahead, the ring is filled up while the bitrate is unknown
+    fs::FS*         m_raFs = NULL;                  // request, mutex_ra: file of the task, NULL: none
+    char            m_raPath[256] = {0};
+    uint32_t        m_raFileGen = 0;                // a new file
+    uint32_t        m_raReqPos = RA_NO_POS;         // the task refills from here
+    std::atomic<uint32_t> m_raReqGen{0};            // bumped with every request
+    std::atomic<uint32_t> m_raAckGen{0};            // request the ring belongs to
+    std::atomic<uint32_t> m_raTarget{0};            // bytes to keep ahead
+    std::atomic<bool> m_f_raFailed{false};          // the task can't open or read the file, loop() reads it
+    std::atomic<bool> m_f_raRun{false};
+    std::atomic<bool> m_f_raExit{false};
+    std::atomic<uint32_t> m_raBytes{0};             // counters of the current statistics interval
+    std::atomic<uint32_t> m_raUs{0};
+    std::atomic<uint32_t> m_raMaxUs{0};
+    uint32_t        m_filePos = 0;                  // next byte of audiofile for the decoder, audiofile.position() lags
 
     pid_array       m_pidsOfPMT;
     int16_t         m_pidOfAAC;
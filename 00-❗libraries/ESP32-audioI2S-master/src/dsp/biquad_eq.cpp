@@ -0,0 +1,125 @@
+/*
+ * biquad_eq.cpp
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  The recursion leaves only the L/R pair as independent lanes, so the kernel stays scalar: stage by stage over the
+ *  whole block with the filter memory held in registers, 32x32->64 bit MACs (MULL/MULSH on Xtensa).
+ */
+#include "biquad_eq.h"
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+void BQ_init(bq_eq_t* eq) {
+    eq->numStages = 0;
+    memset(eq->coef, 0, sizeof(eq->coef));
+    BQ_reset(eq);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BQ_reset(bq_eq_t* eq) {
+    memset(eq->state, 0, sizeof(eq->state));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static int32_t bq_qcoef(float v) {
+    float q = roundf(v * (float)(1L << BQ_COEF_SHIFT));
+    if(q >  2147483647.0f) return INT32_MAX;
+    if(q < -2147483648.0f) return INT32_MIN;
+    return (int32_t)q;
+}
+
+bq_coef_t BQ_quantize(float a0, float a1, float a2, float b1, float b2) {
+    bq_coef_t c;
+    c.a0 = bq_qcoef(a0);
+    c.a1 = bq_qcoef(a1);
+    c.a2 = bq_qcoef(a2);
+    c.b1 = bq_qcoef(b1);
+    c.b2 = bq_qcoef(b2);
+    return c;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool BQ_isIdentity(const bq_coef_t* c) {
+    // a flat shelf or peak (0 dB) quantizes to a0 = 1 and a1 == b1, a2 == b2 (pole/zero cancellation)
+    const int32_t one = 1L << BQ_COEF_SHIFT;
+    const int32_t tol = 1 << (BQ_COEF_SHIFT - 21); // float design rounding
+    if(abs(c->a0 - one) > tol) return false;
+    if(abs(c->a1 - c->b1) > tol) return false;
+    if(abs(c->a2 - c->b2) > tol) return false;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BQ_setStages(bq_eq_t* eq, const bq_coef_t* coef, uint8_t numStages) {
+    uint8_t n = 0;
+    if(numStages > BQ_MAX_STAGES) numStages = BQ_MAX_STAGES;
+    for(uint8_t i = 0; i < numStages; i++) {
+        if(BQ_isIdentity(&coef[i])) continue;
+        eq->coef[n++] = coef[i];
+    }
+    // direct form I keeps signal history only, the memory of the running stages stays valid for the new
+    // coefficients (no click), stages that join the cascade start from silence
+    for(uint8_t i = eq->numStages; i < n; i++) memset(&eq->state[i], 0, sizeof(bq_state_t));
+    eq->numStages = n;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void bq_stage(const bq_coef_t* c, bq_state_t* z, int32_t* w, uint16_t frames) {
+    const int64_t rnd = 1LL << (BQ_COEF_SHIFT - 1);
+    for(uint8_t ch = 0; ch < 2; ch++) {
+        int32_t x1 = z->x1[ch], x2 = z->x2[ch], y1 = z->y1[ch], y2 = z->y2[ch];
+        int32_t* p = w + ch;
+        for(uint16_t i = 0; i < frames; i++) {
+            int32_t x0 = *p;
+            int64_t acc = rnd;
+            acc += (int64_t)c->a0 * x0;
+            acc += (int64_t)c->a1 * x1;
+            acc += (int64_t)c->a2 * x2;
+            acc -= (int64_t)c->b1 * y1;
+            acc -= (int64_t)c->b2 * y2;
+            int32_t y0 = (int32_t)(acc >> BQ_COEF_SHIFT);
+            x2 = x1; x1 = x0;
+            y2 = y1; y1 = y0;
+            *p = y0;
+            p += 2;
+        }
+        z->x1[ch] = x1; z->x2[ch] = x2; z->y1[ch] = y1; z->y2[ch] = y2;
+    }
+}
+
+void BQ_process(bq_eq_t* eq, int16_t* buff, uint16_t frames) {
+    if(eq->numStages == 0) return; // all gains flat, bypass
+    const int32_t rnd = 1L << (BQ_SIG_SHIFT - 1);
+
+    while(frames) {
+        uint16_t n = frames > BQ_BLOCK_FRAMES ? BQ_BLOCK_FRAMES : frames;
+        for(uint16_t i = 0; i < n * 2; i++) eq->work[i] = (int32_t)buff[i] << BQ_SIG_SHIFT;
+        for(uint8_t s = 0; s < eq->numStages; s++) bq_stage(&eq->coef[s], &eq->state[s], eq->work, n);
+        for(uint16_t i = 0; i < n * 2; i++) {
+            int32_t v = (eq->work[i] + rnd) >> BQ_SIG_SHIFT;
+            if(v > INT16_MAX) v = INT16_MAX;
+            if(v < INT16_MIN) v = INT16_MIN;
+            buff[i] = (int16_t)v;
+        }
+        buff += n * 2;
+        frames -= n;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void BQ_processWide(bq_eq_t* eq, const int16_t* in, int32_t* out, uint16_t frames) {
+    // for the limiter: a boost above full scale is kept, no stages: copy
+    const int32_t rnd = 1L << (BQ_SIG_SHIFT - 1);
+
+    while(frames) {
+        uint16_t n = frames > BQ_BLOCK_FRAMES ? BQ_BLOCK_FRAMES : frames;
+        if(eq->numStages == 0) {
+            for(uint16_t i = 0; i < n * 2; i++) out[i] = in[i];
+        }
+        else {
+            for(uint16_t i = 0; i < n * 2; i++) eq->work[i] = (int32_t)in[i] << BQ_SIG_SHIFT;
+            for(uint8_t s = 0; s < eq->numStages; s++) bq_stage(&eq->coef[s], &eq->state[s], eq->work, n);
+            for(uint16_t i = 0; i < n * 2; i++) out[i] = (eq->work[i] + rnd) >> BQ_SIG_SHIFT;
+        }
+        in += n * 2;
+        out += n * 2;
+        frames -= n;
+    }
+}
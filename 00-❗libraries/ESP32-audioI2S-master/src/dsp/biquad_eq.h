@@ -0,0 +1,53 @@
+/*
+ * biquad_eq.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  fixed point biquad cascade (direct form I) for the output stage
+ *  works on interleaved stereo blocks (L/R int16), no Arduino dependencies, builds on a Linux host
+ *
+ *  coefficients: Q5.27, signal between the stages: Q8 (16 bit sample << 8), accumulator: 64 bit
+ *  the numerators of +15 dB shelves with a high Q reach 11.3, Q3.29 (< 4) saturated them from about +6.5 dB
+ *  compared with the former float chain (IIR_filterChain0..2, truncation to int16 after every stage)
+ *  the output differs by at most +-8 LSB for gains between -40 and +6 dB, the correction factor folded into stage 0
+ */
+#pragma once
+#pragma GCC optimize ("Ofast")
+
+#include <stdint.h>
+
+#define BQ_MAX_STAGES   10
+#define BQ_BLOCK_FRAMES 512     // frames per internal pass, longer blocks are split
+#define BQ_COEF_SHIFT   27      // Q5.27, |coefficient| < 16
+#define BQ_SIG_SHIFT    8       // fractional bits of the signal between the stages
+
+typedef struct _bq_coef{        // earlevel naming: y = a0*x0 + a1*x1 + a2*x2 - b1*y1 - b2*y2
+    int32_t a0;
+    int32_t a1;
+    int32_t a2;
+    int32_t b1;
+    int32_t b2;
+} bq_coef_t;
+
+typedef struct _bq_state{
+    int32_t x1[2];              // [LEFT/RIGHT], Q8
+    int32_t x2[2];
+    int32_t y1[2];
+    int32_t y2[2];
+} bq_state_t;
+
+typedef struct _bq_eq{
+    uint8_t    numStages;       // 0: bypass, the block is not touched
+    bq_coef_t  coef[BQ_MAX_STAGES];
+    bq_state_t state[BQ_MAX_STAGES];
+    int32_t    work[BQ_BLOCK_FRAMES * 2];
+} bq_eq_t;
+
+void      BQ_init(bq_eq_t* eq);
+void      BQ_reset(bq_eq_t* eq);                                                          // clear the filter memory
+bq_coef_t BQ_quantize(float a0, float a1, float a2, float b1, float b2);
+bool      BQ_isIdentity(const bq_coef_t* c);
+void      BQ_setStages(bq_eq_t* eq, const bq_coef_t* coef, uint8_t numStages);            // identity stages are dropped
+                                                                                          // call between two blocks
+void      BQ_process(bq_eq_t* eq, int16_t* buff, uint16_t frames);                         // in place, interleaved L/R
+void      BQ_processWide(bq_eq_t* eq, const int16_t* in, int32_t* out, uint16_t frames);  // not saturated, 16 bit scale
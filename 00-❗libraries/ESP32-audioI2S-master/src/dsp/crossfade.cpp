@@ -0,0 +1,97 @@
+/*
+ * crossfade.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "crossfade.h"
+#include <string.h>
+#include <math.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+void XF_buildCurve(uint16_t* curve, uint8_t shape) {
+    // fade in gain g(x), the fade out uses g(1 - x): equal power keeps g_in^2 + g_out^2 = 1 (uncorrelated material),
+    // linear keeps g_in + g_out = 1 (dips 3 dB in the middle), the S-curve (raised cosine) starts and ends smoothly
+    for(uint16_t i = 0; i <= XF_CURVE_POINTS; i++) {
+        float x = (float)i / XF_CURVE_POINTS;
+        float g;
+        switch(shape) {
+            case XF_LINEAR: g = x; break;
+            case XF_SCURVE: g = 0.5f - 0.5f * cosf((float)M_PI * x); break;
+            default:        g = sinf((float)M_PI / 2 * x); break;
+        }
+        curve[i] = (uint16_t)lroundf(g * XF_UNITY);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t XF_gain(const uint16_t* curve, uint32_t pos, uint32_t len) {
+    if(!len || pos >= len) return XF_UNITY;
+    uint32_t x = (uint32_t)(((uint64_t)pos << 16) * XF_CURVE_POINTS / len); // index, 16 fractional bits
+    uint32_t i = x >> 16, f = x & 0xFFFF;
+    return curve[i] + (int32_t)(((int64_t)(curve[i + 1] - curve[i]) * f) >> 16);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static inline int16_t xf_sat(int32_t v) {
+    if(v > 32767) return 32767;
+    if(v < -32768) return -32768;
+    return v;
+}
+
+void XF_mix(int16_t* a, const int16_t* b, uint16_t frames, int32_t gA0, int32_t gA1, int32_t gB0, int32_t gB1) {
+    if(!frames) return;
+    int32_t ga = gA0 << 12, gb = gB0 << 12; // Q27 while ramping
+    int32_t da = ((gA1 - gA0) << 12) / frames;
+    int32_t db = ((gB1 - gB0) << 12) / frames;
+    for(uint16_t i = 0; i < 2 * frames; i += 2) {
+        int32_t ka = ga >> 12, kb = gb >> 12;
+        a[i]     = xf_sat(((a[i] * ka >> 1) + (b[i] * kb >> 1) + (1 << 13)) >> 14); // the sum of two products needs 32 bits
+        a[i + 1] = xf_sat(((a[i + 1] * ka >> 1) + (b[i + 1] * kb >> 1) + (1 << 13)) >> 14);
+        ga += da;
+        gb += db;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void XF_ramp(int16_t* buff, uint16_t frames, int32_t g0, int32_t g1) {
+    if(!frames) return;
+    int32_t g = g0 << 12;
+    int32_t d = ((g1 - g0) << 12) / frames;
+    for(uint16_t i = 0; i < 2 * frames; i += 2) {
+        int32_t k = g >> 12;
+        buff[i]     = (buff[i] * k + (1 << 14)) >> 15;
+        buff[i + 1] = (buff[i + 1] * k + (1 << 14)) >> 15;
+        g += d;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void XF_ringInit(xf_ring_t* ring, int16_t* buff, uint32_t frames) {
+    ring->buff = buff;
+    ring->size = frames;
+    ring->rd = ring->wr = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t XF_ringWrite(xf_ring_t* ring, const int16_t* src, uint32_t frames) {
+    uint32_t n = XF_ringFree(ring);
+    if(frames > n) frames = n;
+    uint32_t pos = ring->wr % ring->size;
+    uint32_t first = ring->size - pos;
+    if(first > frames) first = frames;
+    memcpy(ring->buff + 2 * pos, src, first * 2 * sizeof(int16_t));
+    memcpy(ring->buff, src + 2 * first, (frames - first) * 2 * sizeof(int16_t));
+    ring->wr += frames;
+    return frames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t XF_ringRead(xf_ring_t* ring, int16_t* dst, uint32_t frames) {
+    uint32_t n = XF_ringFill(ring);
+    if(frames > n) frames = n;
+    uint32_t pos = ring->rd % ring->size;
+    uint32_t first = ring->size - pos;
+    if(first > frames) first = frames;
+    memcpy(dst, ring->buff + 2 * pos, first * 2 * sizeof(int16_t));
+    memcpy(dst + 2 * first, ring->buff, (frames - first) * 2 * sizeof(int16_t));
+    ring->rd += frames;
+    if(ring->rd >= ring->size) { // keep the counters small, wr - rd stays the same
+        ring->rd -= ring->size;
+        ring->wr -= ring->size;
+    }
+    return frames;
+}
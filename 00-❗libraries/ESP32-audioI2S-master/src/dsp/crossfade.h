@@ -0,0 +1,38 @@
+/*
+ * crossfade.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  crossfade between two tracks and fades of the whole output, block based, Q15 gains
+ *  the outgoing track is played from a PCM ring (decoded ahead), the incoming one comes from the decoder,
+ *  XF_mix() ramps both gains linearly over a block, the curve is sampled once per block
+ *  no Arduino dependencies, builds on a Linux host
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define XF_CURVE_POINTS 256
+#define XF_UNITY        32768   // gain 1.0
+
+enum : uint8_t { XF_EQUAL_POWER = 0, XF_LINEAR = 1, XF_SCURVE = 2 };
+
+typedef struct _xf_ring{        // interleaved L/R frames, one reader and one writer in the same task
+    int16_t* buff;
+    uint32_t size;              // frames
+    uint32_t rd;                // free running frame counters
+    uint32_t wr;
+} xf_ring_t;
+
+void     XF_buildCurve(uint16_t* curve, uint8_t shape);                        // fade in gain, XF_CURVE_POINTS + 1 values
+int32_t  XF_gain(const uint16_t* curve, uint32_t pos, uint32_t len);           // fade in gain at pos / len, 0 ... XF_UNITY
+void     XF_mix(int16_t* a, const int16_t* b, uint16_t frames, int32_t gA0, int32_t gA1, int32_t gB0, int32_t gB1); // a = a*gA + b*gB
+void     XF_ramp(int16_t* buff, uint16_t frames, int32_t g0, int32_t g1);
+
+void     XF_ringInit(xf_ring_t* ring, int16_t* buff, uint32_t frames);
+inline uint32_t XF_ringFill(const xf_ring_t* ring) { return ring->wr - ring->rd; }
+inline uint32_t XF_ringFree(const xf_ring_t* ring) { return ring->size - (ring->wr - ring->rd); }
+inline void     XF_ringReset(xf_ring_t* ring) { ring->rd = ring->wr = 0; }
+uint32_t XF_ringWrite(xf_ring_t* ring, const int16_t* src, uint32_t frames);
+uint32_t XF_ringRead(xf_ring_t* ring, int16_t* dst, uint32_t frames);
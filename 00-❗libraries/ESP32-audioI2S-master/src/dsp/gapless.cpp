@@ -0,0 +1,121 @@
+/*
+ * gapless.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "gapless.h"
+#include <string.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+void GL_reset(gl_info_t* info) {
+    info->skip = 0;
+    info->total = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool GL_parseMP3Info(const uint8_t* data, size_t len, gl_info_t* info) {
+    // the first layer III frame of a LAME (or ffmpeg) file is an info frame: no audio, but the Helix decoder outputs
+    // one frame of silence for it, the LAME extension holds the encoder delay and the padding (12 bits each)
+    size_t i = 0;
+    while(i + 4 <= len && !(data[i] == 0xFF && (data[i + 1] & 0xE0) == 0xE0)) i++;
+    if(i + 4 > len) return false;
+    const uint8_t* h = data + i;
+    uint8_t version = (h[1] >> 3) & 3;                  // 3: MPEG1, 2: MPEG2, 0: MPEG2.5
+    uint8_t layer = (h[1] >> 1) & 3;                    // 1: layer III
+    if(version == 1 || layer != 1) return false;
+    if((h[2] >> 4) == 0x0F || ((h[2] >> 2) & 3) == 3) return false;
+    bool     mono = ((h[3] >> 6) == 3);
+    uint16_t spf = (version == 3) ? 1152 : 576;
+    size_t   pos = 4 + ((version == 3) ? (mono ? 17 : 32) : (mono ? 9 : 17));
+    if(i + pos + 8 > len) return false;
+    const uint8_t* x = h + pos;
+    if(memcmp(x, "Xing", 4) && memcmp(x, "Info", 4)) return false;
+
+    uint32_t flags = ((uint32_t)x[4] << 24) | ((uint32_t)x[5] << 16) | ((uint32_t)x[6] << 8) | x[7];
+    uint32_t frames = 0;
+    pos += 8;
+    if(flags & 1) {
+        if(i + pos + 4 > len) return false;
+        const uint8_t* f = h + pos;
+        frames = ((uint32_t)f[0] << 24) | ((uint32_t)f[1] << 16) | ((uint32_t)f[2] << 8) | f[3];
+        pos += 4;
+    }
+    if(flags & 2) pos += 4;     // bytes
+    if(flags & 4) pos += 100;   // TOC
+    if(flags & 8) pos += 4;     // quality
+
+    const uint8_t* l = h + pos;
+    bool lame = (i + pos + 24 <= len) && (!memcmp(l, "LAME", 4) || !memcmp(l, "Lavc", 4) || !memcmp(l, "Lavf", 4));
+    if(!lame) { // info frame only (e.g. iTunes), keep the iTunSMPB values if any
+        info->skip += spf;
+        return true;
+    }
+    uint32_t delay = ((uint32_t)l[21] << 4) | (l[22] >> 4);
+    uint32_t padding = ((uint32_t)(l[22] & 0x0F) << 8) | l[23];
+    info->skip = spf + delay + GL_MP3_DECODER_DELAY;
+    info->total = 0;
+    if(frames && (uint64_t)frames * spf > delay + padding) info->total = (uint64_t)frames * spf - delay - padding;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static int gl_hex(uint8_t c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool GL_parseSmpb(const uint8_t* data, size_t len, gl_info_t* info) {
+    // value: " 00000000 00000840 0000037C 0000000000A2C0B4 ...", fields 1 (delay), 2 (padding), 3 (original length)
+    // zero bytes are skipped everywhere, so UTF-16 text (ID3 COMM, encoding 1 or 2) works as well
+    static const char key[] = "iTunSMPB";
+    size_t i = 0, k = 0;
+    for(; i < len && key[k]; i++) {
+        if(!data[i]) continue;
+        if(data[i] == key[k]) k++;
+        else k = (data[i] == key[0]) ? 1 : 0;
+    }
+    if(key[k]) return false;
+    while(i < len && data[i] != ' ') i++;   // MP4: the data atom header follows the name
+
+    uint64_t field[4] = {0};
+    uint8_t  n = 0;
+    bool     inField = false;
+    for(; i < len && n < 4; i++) {
+        if(!data[i]) continue;
+        int v = gl_hex(data[i]);
+        if(v >= 0) {
+            field[n] = (field[n] << 4) | v;
+            inField = true;
+        }
+        else if(data[i] == ' ') {
+            if(inField) n++;
+            inField = false;
+        }
+        else break;
+    }
+    if(inField && n < 4) n++;
+    if(n < 4) return false;
+    info->skip = field[1];
+    info->total = field[3];
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void GL_start(gl_trim_t* trim, const gl_info_t* info) {
+    trim->skip = info ? info->skip : 0;
+    trim->remain = info ? info->total : 0;
+    trim->limited = info && info->total;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t GL_trim(gl_trim_t* trim, int16_t* buff, uint16_t frames, uint8_t channels) {
+    if(trim->skip) {
+        uint16_t n = (trim->skip < frames) ? trim->skip : frames;
+        trim->skip -= n;
+        frames -= n;
+        if(frames) memmove(buff, buff + n * channels, frames * channels * sizeof(int16_t));
+    }
+    if(trim->limited) {
+        if(frames > trim->remain) frames = trim->remain;
+        trim->remain -= frames;
+    }
+    return frames;
+}
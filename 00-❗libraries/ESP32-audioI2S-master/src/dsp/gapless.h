@@ -0,0 +1,32 @@
+/*
+ * gapless.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  gapless playback: encoder delay and padding from the LAME tag (Xing/Info frame) or iTunSMPB,
+ *  the decoded stream is trimmed to the original samples, so two tracks can be spliced sample accurate
+ *  no Arduino dependencies, builds on a Linux host
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define GL_MP3_DECODER_DELAY 529    // samples, the Helix (and every other) layer III decoder adds this
+
+typedef struct _gl_info{
+    uint32_t skip;                  // frames to drop at the start of the decoded stream (info frame, encoder + decoder delay)
+    uint64_t total;                 // frames to play after that, 0: unknown, play everything
+} gl_info_t;
+
+typedef struct _gl_trim{
+    uint32_t skip;
+    uint64_t remain;
+    bool     limited;               // false: no end trimming (unknown length, or after a seek)
+} gl_trim_t;
+
+void     GL_reset(gl_info_t* info);
+bool     GL_parseMP3Info(const uint8_t* data, size_t len, gl_info_t* info);     // first frame of the audio data, Xing/Info + LAME
+bool     GL_parseSmpb(const uint8_t* data, size_t len, gl_info_t* info);        // iTunSMPB, ID3 COMM frame or MP4 ilst
+void     GL_start(gl_trim_t* trim, const gl_info_t* info);                      // info NULL: no trimming
+uint16_t GL_trim(gl_trim_t* trim, int16_t* buff, uint16_t frames, uint8_t channels); // returns the frames left, moved to the front
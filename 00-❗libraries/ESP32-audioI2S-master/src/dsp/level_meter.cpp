@@ -0,0 +1,92 @@
+/*
+ * level_meter.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "level_meter.h"
+#include <string.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+void LM_reset(lm_acc_t* acc, lm_hold_t* hold) {
+    memset(acc, 0, sizeof(lm_acc_t));
+    memset(hold, 0, sizeof(lm_hold_t));
+}
+//----------------------------------------------------------------------------------------------------------------------
+void LM_accumulate(lm_acc_t* acc, const int16_t* buff, uint16_t frames) {
+    for(uint8_t ch = 0; ch < 2; ch++) {
+        const int16_t* p = buff + ch;
+        uint64_t       sum = 0;
+        uint32_t       peak = acc->peak[ch];
+        for(uint16_t i = 0; i < frames; i++) {
+            int32_t  s = *p;
+            uint32_t a = (s < 0) ? -s : s;
+            sum += (uint32_t)(s * s); // <= 2^30, a block of 512 frames fits easily in 64 bit
+            if(a > peak) peak = a;
+            p += 2;
+        }
+        acc->sumSq[ch] += sum;
+        acc->peak[ch] = (peak > 32767) ? 32767 : peak; // -32768
+    }
+    acc->frames += frames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void LM_accumulate32(lm_acc_t* acc, const int32_t* buff, uint16_t frames) {
+    // samples above full scale (EQ boost in front of the limiter) count as full scale
+    for(uint8_t ch = 0; ch < 2; ch++) {
+        const int32_t* p = buff + ch;
+        uint64_t       sum = 0;
+        uint32_t       peak = acc->peak[ch];
+        for(uint16_t i = 0; i < frames; i++) {
+            int32_t  s = *p;
+            uint32_t a = (s < 0) ? -s : s;
+            if(a > 32767) a = 32767;
+            sum += a * a;
+            if(a > peak) peak = a;
+            p += 2;
+        }
+        acc->sumSq[ch] += sum;
+        acc->peak[ch] = peak;
+    }
+    acc->frames += frames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t LM_isqrt64(uint64_t v) { // bitwise integer square root, floor(sqrt(v))
+    uint64_t res = 0;
+    uint64_t bit = 1ULL << 62;
+    while(bit > v) bit >>= 2;
+    while(bit) {
+        if(v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else { res >>= 1; }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void LM_finish(lm_acc_t* acc, lm_hold_t* hold, uint32_t holdFrames, lm_level_t* level) {
+    uint32_t frames = acc->frames;
+    for(uint8_t ch = 0; ch < 2; ch++) {
+        uint32_t rms = frames ? LM_isqrt64(acc->sumSq[ch] / frames) : 0;
+        uint16_t peak = acc->peak[ch];
+        level->rms[ch] = (rms > 32767) ? 32767 : rms;
+        level->peak[ch] = peak;
+
+        if(peak >= hold->level[ch]) { // new maximum
+            hold->level[ch] = peak;
+            hold->age[ch] = 0;
+        }
+        else {
+            hold->age[ch] += frames;
+            if(hold->age[ch] > holdFrames) { // fall back, 2^-14 per frame
+                uint32_t dec = ((uint32_t)hold->level[ch] * frames) >> 14;
+                if(dec == 0) dec = 1;
+                hold->level[ch] = (hold->level[ch] > peak + dec) ? hold->level[ch] - dec : peak;
+                hold->age[ch] = holdFrames + 1; // no overflow
+            }
+        }
+        level->peakHold[ch] = hold->level[ch];
+    }
+    memset(acc, 0, sizeof(lm_acc_t));
+}
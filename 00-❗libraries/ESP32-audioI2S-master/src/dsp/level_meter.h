@@ -0,0 +1,35 @@
+/*
+ * level_meter.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  RMS, peak and peak hold per channel, integer only
+ *  the audio task accumulates whole output blocks, LM_finish() turns the sums into levels once per block
+ *  levels are linear, 0 ... 32767 (full scale), dBFS = 20 * log10(level / 32767)
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef struct _lm_acc{
+    uint64_t sumSq[2];          // [LEFT/RIGHT]
+    uint16_t peak[2];
+    uint32_t frames;
+} lm_acc_t;
+
+typedef struct _lm_hold{
+    uint16_t level[2];
+    uint32_t age[2];            // frames since the last new maximum
+} lm_hold_t;
+
+typedef struct _lm_level{
+    uint16_t rms[2];            // true RMS of the last block
+    uint16_t peak[2];           // largest |sample| of the last block
+    uint16_t peakHold[2];       // held for holdFrames, then falls back (about 23 dB/s at 44.1 kHz)
+} lm_level_t;
+
+void     LM_reset(lm_acc_t* acc, lm_hold_t* hold);
+void     LM_accumulate(lm_acc_t* acc, const int16_t* buff, uint16_t frames);                   // interleaved L/R
+void     LM_accumulate32(lm_acc_t* acc, const int32_t* buff, uint16_t frames);                 // 16 bit scale, clipped
+void     LM_finish(lm_acc_t* acc, lm_hold_t* hold, uint32_t holdFrames, lm_level_t* level);    // clears acc
+uint32_t LM_isqrt64(uint64_t v);
@@ -0,0 +1,140 @@
+/*
+ * limiter.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "limiter.h"
+#include <string.h>
+#include <math.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+void LIM_init(lim_t* lim, uint32_t rate, float ceilingDb, uint16_t lookaheadUs, uint16_t releaseMs) {
+    if(ceilingDb > 0) ceilingDb = 0;
+    if(ceilingDb < -12) ceilingDb = -12;
+    lim->ceiling = (int32_t)(32767 * powf(10, ceilingDb / 20));
+    lim->knee = (int32_t)(lim->ceiling * powf(10, -0.5f / 20));
+    lim->lookaheadUs = lookaheadUs;
+    lim->releaseMs = releaseMs ? releaseMs : 1;
+    for(uint8_t p = 0; p < 3; p++) { // Hann windowed sinc, point p between hist[4] and hist[3]
+        float f = (p + 1) / 4.0f;
+        float sum = 0, c[LIM_TP_TAPS];
+        for(uint8_t k = 0; k < LIM_TP_TAPS; k++) {
+            float x = (LIM_TP_TAPS / 2 - k) - f;  // distance from hist[k] (x = 0 at tap 4 - f)
+            float w = 0.5f + 0.5f * cosf((float)M_PI * x / (LIM_TP_TAPS / 2));
+            c[k] = w * sinf((float)M_PI * x) / ((float)M_PI * x);
+            sum += c[k];
+        }
+        for(uint8_t k = 0; k < LIM_TP_TAPS; k++) lim->tp[p][k] = (int16_t)lroundf(c[k] / sum * 16384);
+    }
+    LIM_setRate(lim, rate);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void LIM_setRate(lim_t* lim, uint32_t rate) {
+    uint32_t len = (uint64_t)lim->lookaheadUs * rate / 1000000;
+    if(len < 1) len = 1;
+    if(len > LIM_MAX_LOOKAHEAD) len = LIM_MAX_LOOKAHEAD;
+    lim->len = len;
+    double rel = 1.0 - exp(-1000.0 / ((double)lim->releaseMs * rate)); // time constant releaseMs
+    lim->relCoef = (uint32_t)(rel * (1 << 30));
+    if(!lim->relCoef) lim->relCoef = 1;
+    LIM_reset(lim);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void LIM_reset(lim_t* lim) {
+    memset(lim->delay, 0, sizeof(lim->delay));
+    memset(lim->hist, 0, sizeof(lim->hist));
+    lim->dPos = 0;
+    lim->qHead = lim->qTail = 0;
+    lim->time = 0;
+    lim->env = 1 << 30;
+    for(uint16_t i = 0; i < LIM_MAX_LOOKAHEAD; i++) lim->box[i] = LIM_UNITY;
+    lim->boxSum = (uint32_t)LIM_UNITY * lim->len;
+    lim->bPos = 0;
+    lim->minGain = LIM_UNITY;
+    lim->clipped = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static inline int32_t lim_abs(int32_t v) { return v < 0 ? -v : v; }
+
+static inline int16_t lim_clip(lim_t* lim, int32_t v) {
+    // |v| <= knee: unchanged, knee ... knee + 2 * range: y = knee + range * (t - t^2 / 4), t = (|v| - knee) / range
+    int32_t a = lim_abs(v);
+    if(a <= lim->knee) return v;
+    lim->clipped++;
+    int32_t range = lim->ceiling - lim->knee;
+    int32_t y = lim->ceiling;
+    int32_t d = a - lim->knee;
+    if(d < 2 * range) {
+        int64_t t = ((int64_t)d << 15) / range; // Q15, 0 ... 2
+        y = lim->knee + (int32_t)(((t - ((t * t) >> 17)) * range) >> 15);
+    }
+    return v < 0 ? -y : y;
+}
+
+void LIM_process(lim_t* lim, const int32_t* in, int16_t* out, uint16_t frames) {
+    const uint16_t len = lim->len;
+    const uint16_t win = len + LIM_TP_DELAY + 1; // the interpolated points are LIM_TP_DELAY frames late
+    const uint16_t dLen = len + LIM_TP_DELAY;
+    const int32_t  one = 1 << 30;
+    uint16_t       minGain = lim->minGain;
+
+    for(uint16_t i = 0; i < frames; i++) {
+        int32_t l = in[2 * i], r = in[2 * i + 1];
+
+        // detector: sample peak and three points between hist[4] and hist[3]
+        int32_t pk = lim_abs(l);
+        if(lim_abs(r) > pk) pk = lim_abs(r);
+        for(uint8_t ch = 0; ch < 2; ch++) {
+            int32_t* h = lim->hist[ch];
+            memmove(h + 1, h, (LIM_TP_TAPS - 1) * sizeof(int32_t));
+            h[0] = ch ? r : l;
+            for(uint8_t p = 0; p < 3; p++) {
+                const int16_t* c = lim->tp[p];
+                int64_t        acc = 0;
+                for(uint8_t k = 0; k < LIM_TP_TAPS; k++) acc += (int64_t)c[k] * h[k];
+                int32_t v = lim_abs((int32_t)(acc >> 14));
+                if(v > pk) pk = v;
+            }
+        }
+
+        // sliding maximum over win frames
+        uint32_t now = lim->time++;
+        while(lim->qHead != lim->qTail && lim->qVal[(lim->qTail - 1) & (LIM_QSIZE - 1)] <= pk) lim->qTail--;
+        lim->qVal[lim->qTail & (LIM_QSIZE - 1)] = pk;
+        lim->qTime[lim->qTail & (LIM_QSIZE - 1)] = now;
+        lim->qTail++;
+        while(now - lim->qTime[lim->qHead & (LIM_QSIZE - 1)] >= win) lim->qHead++;
+        int32_t peak = lim->qVal[lim->qHead & (LIM_QSIZE - 1)];
+
+        // required gain, instant attack, exponential release
+        int32_t want = one;
+        if(peak > lim->ceiling) want = (int32_t)(((int64_t)lim->ceiling << 30) / peak);
+        if(want < lim->env) lim->env = want;
+        else lim->env += (int32_t)(((int64_t)(want - lim->env) * lim->relCoef) >> 30);
+
+        // moving average over len frames, the gain ramps down before the peak leaves the delay line
+        uint16_t g = lim->env >> 15;
+        lim->boxSum += g - lim->box[lim->bPos];
+        lim->box[lim->bPos] = g;
+        if(++lim->bPos >= len) lim->bPos = 0;
+        uint32_t gain = lim->boxSum / len;
+        if(gain < minGain) minGain = gain;
+
+        // delay line: len + LIM_TP_DELAY frames
+        int32_t* d = lim->delay[lim->dPos];
+        int32_t  ol = d[0], or_ = d[1];
+        d[0] = l;
+        d[1] = r;
+        if(++lim->dPos >= dLen) lim->dPos = 0;
+
+        out[2 * i]     = lim_clip(lim, (int32_t)(((int64_t)ol * gain) >> 15));
+        out[2 * i + 1] = lim_clip(lim, (int32_t)(((int64_t)or_ * gain) >> 15));
+    }
+    lim->minGain = minGain;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t LIM_takeMinGain(lim_t* lim) {
+    uint16_t g = lim->minGain;
+    lim->minGain = LIM_UNITY;
+    return g;
+}
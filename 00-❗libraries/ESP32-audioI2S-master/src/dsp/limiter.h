@@ -0,0 +1,57 @@
+/*
+ * limiter.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  look-ahead peak limiter and soft clipper, the last stage before I2S, integer only, interleaved stereo blocks
+ *  input: 32 bit samples in 16 bit scale (EQ boost, volume and ReplayGain may exceed +-32767), output: int16
+ *
+ *  detector: |x| and three points between two samples (4x oversampling, 8 tap polyphase interpolation), max of
+ *  both channels, an estimate of the true peak as in ITU-R BS.1770 (which uses 12 taps per phase)
+ *  gain:     ceiling / (max of the detector over the look-ahead window), instant attack, exponential release,
+ *            smoothed by a moving average over the look-ahead length, the audio is delayed by the same length,
+ *            so the gain has reached its value when the peak leaves the delay line: no sample above the ceiling
+ *  soft clip: what is left (rounding, inter-sample estimate) is bent into the last 0.5 dB below the ceiling
+ *
+ *  the cost per frame is stats.limiterCyclesPerSample (Audio::getAudioStats())
+ */
+#pragma once
+#pragma GCC optimize ("O3")
+
+#include <stdint.h>
+
+#define LIM_MAX_LOOKAHEAD   256         // frames, 5 ms at 48 kHz
+#define LIM_UNITY           32768       // gain 1.0, Q15
+#define LIM_QSIZE           512         // sliding maximum, power of two > LIM_MAX_LOOKAHEAD + LIM_TP_DELAY + 1
+#define LIM_TP_TAPS         8           // true peak interpolation
+#define LIM_TP_DELAY        3           // the interpolated points lie between x[n - 4] and x[n - 3]
+
+typedef struct _lim{
+    int32_t  ceiling;                   // 16 bit scale
+    int32_t  knee;                      // the soft clipper starts here
+    uint16_t lookaheadUs;
+    uint16_t releaseMs;
+    uint16_t len;                       // look-ahead [frames]
+    uint32_t relCoef;                   // release per frame, Q30
+    int16_t  tp[3][LIM_TP_TAPS];        // interpolation at 1/4, 2/4, 3/4, Q14
+    int32_t  delay[LIM_MAX_LOOKAHEAD + LIM_TP_DELAY][2];
+    uint16_t dPos;
+    int32_t  hist[2][LIM_TP_TAPS];      // [LEFT/RIGHT] last input samples, [0] newest
+    int32_t  qVal[LIM_QSIZE];           // sliding maximum of the detector (monotonic queue)
+    uint32_t qTime[LIM_QSIZE];
+    uint16_t qHead;
+    uint16_t qTail;
+    uint32_t time;                      // frame counter
+    int32_t  env;                       // gain after attack / release, Q30
+    uint16_t box[LIM_MAX_LOOKAHEAD];    // moving average of env, Q15
+    uint32_t boxSum;
+    uint16_t bPos;
+    uint16_t minGain;                   // lowest applied gain since LIM_takeMinGain(), Q15
+    uint32_t clipped;                   // samples changed by the soft clipper
+} lim_t;
+
+void     LIM_init(lim_t* lim, uint32_t rate, float ceilingDb, uint16_t lookaheadUs, uint16_t releaseMs);
+void     LIM_setRate(lim_t* lim, uint32_t rate);                                // keeps the settings, resets
+void     LIM_reset(lim_t* lim);
+void     LIM_process(lim_t* lim, const int32_t* in, int16_t* out, uint16_t frames);      // out is delayed by len + LIM_TP_DELAY frames
+uint16_t LIM_takeMinGain(lim_t* lim);                                          // Q15, restarts at LIM_UNITY
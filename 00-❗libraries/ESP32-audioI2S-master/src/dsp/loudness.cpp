@@ -0,0 +1,214 @@
+/*
+ * loudness.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "loudness.h"
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+static int rg_find(const uint8_t* data, size_t len, const char* key) {
+    // case insensitive, zero bytes are skipped (UTF-16 text), returns the position behind the key or -1
+    for(size_t s = 0; s < len; s++) {
+        size_t i = s, k = 0;
+        while(i < len && key[k]) {
+            uint8_t c = data[i++];
+            if(!c) continue;
+            if(c >= 'a' && c <= 'z') c -= 32;
+            if(c != (uint8_t)key[k]) break;
+            k++;
+        }
+        if(!key[k]) return i;
+    }
+    return -1;
+}
+
+static bool rg_value(const uint8_t* data, size_t len, int pos, float* value) {
+    // the number follows within a few bytes (ID3: '\0', Vorbis: '=', MP4: the data atom header)
+    char   num[16];
+    size_t n = 0, i = pos, end = pos + 24;
+    for(; i < len && i < end; i++) {
+        uint8_t c = data[i];
+        if((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.') break;
+    }
+    for(; i < len && n < sizeof(num) - 1; i++) {
+        uint8_t c = data[i];
+        if(!c) continue;
+        if(!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.')) break;
+        num[n++] = c;
+    }
+    num[n] = 0;
+    if(!n) return false;
+    char* e;
+    *value = strtof(num, &e);
+    return e != num;
+}
+
+bool RG_parse(const uint8_t* data, size_t len, rg_info_t* rg) {
+    bool  found = false;
+    float v;
+    int   p;
+    if((p = rg_find(data, len, "REPLAYGAIN_TRACK_GAIN")) >= 0 && rg_value(data, len, p, &v)) {
+        rg->trackGain = v;
+        rg->hasTrack = found = true;
+    }
+    if((p = rg_find(data, len, "REPLAYGAIN_TRACK_PEAK")) >= 0 && rg_value(data, len, p, &v)) {
+        rg->trackPeak = v;
+        found = true;
+    }
+    if((p = rg_find(data, len, "REPLAYGAIN_ALBUM_GAIN")) >= 0 && rg_value(data, len, p, &v)) {
+        rg->albumGain = v;
+        rg->hasAlbum = found = true;
+    }
+    if((p = rg_find(data, len, "REPLAYGAIN_ALBUM_PEAK")) >= 0 && rg_value(data, len, p, &v)) {
+        rg->albumPeak = v;
+        found = true;
+    }
+    return found;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void R128_init(r128_t* r, uint32_t rate, uint8_t channels, uint32_t* hist) {
+    // BS.1770-4 K-weighting for any samplerate, the 48 kHz coefficients of the standard are reproduced exactly
+    memset(r, 0, sizeof(r128_t));
+    double f0 = 1681.974450955533, G = 3.999843853973347, Q = 0.7071752369554196;
+    double K = tan(M_PI * f0 / rate);
+    double Vh = pow(10.0, G / 20.0);
+    double Vb = pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+    r->b1[0] = (Vh + Vb * K / Q + K * K) / a0;
+    r->b1[1] = 2.0 * (K * K - Vh) / a0;
+    r->b1[2] = (Vh - Vb * K / Q + K * K) / a0;
+    r->a1[0] = 2.0 * (K * K - 1.0) / a0;
+    r->a1[1] = (1.0 - K / Q + K * K) / a0;
+
+    f0 = 38.13547087602444;
+    Q = 0.5003270373238773;
+    K = tan(M_PI * f0 / rate);
+    a0 = 1.0 + K / Q + K * K;
+    r->b2[0] = 1.0f;
+    r->b2[1] = -2.0f;
+    r->b2[2] = 1.0f;
+    r->a2[0] = 2.0 * (K * K - 1.0) / a0;
+    r->a2[1] = (1.0 - K / Q + K * K) / a0;
+
+    r->channels = (channels == 1) ? 1 : 2;
+    r->subLen = rate / 10;
+    r->hist = hist;
+    memset(hist, 0, R128_HIST_BINS * sizeof(uint32_t));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static inline float r128_filter(r128_t* r, float* z, float x) {
+    // two transposed direct form II biquads, input scaled to +-1.0
+    float y = r->b1[0] * x + z[0];
+    z[0] = r->b1[1] * x - r->a1[0] * y + z[1];
+    z[1] = r->b1[2] * x - r->a1[1] * y;
+    float w = y + z[2]; // b2 = 1, -2, 1
+    z[2] = -2.0f * y - r->a2[0] * w + z[3];
+    z[3] = y - r->a2[1] * w;
+    return w;
+}
+
+static void r128_block(r128_t* r, float sum) {
+    // one 400 ms block: the three last 100 ms sums and this one
+    float ms = (r->sub[0] + r->sub[1] + r->sub[2] + sum) / (4.0f * r->subLen);
+    r->sub[0] = r->sub[1];
+    r->sub[1] = r->sub[2];
+    r->sub[2] = sum;
+    if(r->subCount < 3) {
+        r->subCount++;
+        return;
+    }
+    if(ms <= 0) return;
+    float l = -0.691f + 10.0f * log10f(ms);
+    if(l < -70.0f) return; // absolute gate
+    int bin = (int)((l + 70.0f) * 10.0f + 0.5f);
+    if(bin >= R128_HIST_BINS) bin = R128_HIST_BINS - 1;
+    r->hist[bin]++;
+    r->blocks++;
+}
+
+void R128_process(r128_t* r, const int16_t* buff, uint32_t frames) {
+    const float scale = 1.0f / 32768.0f;
+    uint32_t    peak = r->peak;
+    for(uint32_t i = 0; i < frames; i++) {
+        for(uint8_t ch = 0; ch < r->channels; ch++) {
+            int32_t s = *buff++;
+            uint32_t a = (s < 0) ? -s : s;
+            if(a > peak) peak = a;
+            float y = r128_filter(r, r->z[ch], s * scale);
+            r->subSum += y * y; // channel weight 1.0 for L and R
+        }
+        if(++r->subPos == r->subLen) {
+            r128_block(r, r->subSum);
+            r->subPos = 0;
+            r->subSum = 0;
+        }
+    }
+    r->peak = (peak > 32767) ? 32767 : peak;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static inline double r128_energy(int bin) { // mean square of the bin center
+    return pow(10.0, (bin / 10.0 - 70.0 + 0.691) / 10.0);
+}
+
+bool R128_integrated(const r128_t* r, float* lufs) {
+    if(!r->blocks) return false;
+    double sum = 0;
+    for(int i = 0; i < R128_HIST_BINS; i++) {
+        if(r->hist[i]) sum += r->hist[i] * r128_energy(i);
+    }
+    double rel = -0.691 + 10.0 * log10(sum / r->blocks) - 10.0; // relative gate
+    int    first = (int)ceil((rel + 70.0) * 10.0);              // bins with the center above the gate
+    if(first < 0) first = 0;
+    sum = 0;
+    uint32_t n = 0;
+    for(int i = first; i < R128_HIST_BINS; i++) {
+        if(!r->hist[i]) continue;
+        sum += r->hist[i] * r128_energy(i);
+        n += r->hist[i];
+    }
+    if(!n) return false;
+    *lufs = -0.691 + 10.0 * log10(sum / n);
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t R128_seconds(const r128_t* r) {
+    uint32_t s = r->blocks / 10; // a block every 100 ms
+    return (s > 65535) ? 65535 : s;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t LT_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < len && s[i]; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+//----------------------------------------------------------------------------------------------------------------------
+const lt_entry_t* LT_find(const lt_entry_t* t, uint32_t n, uint32_t path) {
+    for(uint32_t i = n; i > 0; i--) { // the newest record wins
+        if(t[i - 1].path == path) return &t[i - 1];
+    }
+    return NULL;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool LT_album(const lt_entry_t* t, uint32_t n, uint32_t dir, float* lufs, float* peak) {
+    // mean power of the tracks of a directory weighted with their gated length, close to the loudness of the whole
+    // album as long as the tracks have a similar level (the relative gate is applied per track)
+    double   sum = 0;
+    uint32_t sec = 0, pk = 0;
+    for(uint32_t i = 0; i < n; i++) {
+        if(t[i].dir != dir || !t[i].seconds) continue;
+        if(LT_find(t + i + 1, n - i - 1, t[i].path)) continue; // measured again later
+        sum += t[i].seconds * pow(10.0, t[i].lufs / 1000.0);
+        sec += t[i].seconds;
+        if(t[i].peak > pk) pk = t[i].peak;
+    }
+    if(!sec) return false;
+    *lufs = 10.0 * log10(sum / sec);
+    *peak = pk / 65535.0f;
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * loudness.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  loudness normalization: ReplayGain tags and an EBU R128 / ITU-R BS.1770-4 integrated loudness meter
+ *  the meter: K-weighting (two biquads per channel, float), 400 ms blocks with 75 % overlap, absolute gate -70 LUFS,
+ *  relative gate -10 LU, the gated blocks go to a histogram of 0.1 LU bins, so the memory does not grow with the length
+ *  the gain table: measured tracks, 16 bytes per file, keyed by hashes of the path and of its directory (album)
+ *  no Arduino dependencies, builds on a Linux host
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RG_REFERENCE_LUFS   -18.0f      // ReplayGain 2.0 reference level
+#define R128_HIST_BINS      750         // -70 ... +5 LUFS in 0.1 LU
+
+enum : uint8_t { RG_OFF = 0, RG_TRACK = 1, RG_ALBUM = 2 };
+
+typedef struct _rg_info{
+    float trackGain;                    // dB
+    float trackPeak;                    // linear, 1.0 = full scale, 0: unknown
+    float albumGain;
+    float albumPeak;
+    bool  hasTrack;
+    bool  hasAlbum;
+} rg_info_t;
+
+typedef struct _r128{
+    float     b1[3], a1[2];             // K-weighting: high shelf
+    float     b2[3], a2[2];             // K-weighting: high pass
+    float     z[2][4];                  // [LEFT/RIGHT] filter states
+    uint8_t   channels;
+    uint32_t  subLen;                   // frames per 100 ms
+    uint32_t  subPos;
+    float     subSum;                   // weighted mean square sum of the running 100 ms
+    float     sub[3];                   // the last three 100 ms sums
+    uint8_t   subCount;
+    uint32_t* hist;                     // R128_HIST_BINS counts of gated 400 ms blocks, owned by the caller
+    uint32_t  blocks;
+    uint16_t  peak;                     // largest |sample|
+} r128_t;
+
+typedef struct _lt_entry{               // gain table record
+    uint32_t path;                      // LT_hash() of the full path
+    uint32_t dir;                       // LT_hash() of the directory
+    int16_t  lufs;                      // integrated loudness * 100
+    uint16_t peak;                      // sample peak, 65535 = full scale
+    uint16_t seconds;                   // gated length, weights the album loudness
+    uint16_t reserved;
+} lt_entry_t;
+
+bool     RG_parse(const uint8_t* data, size_t len, rg_info_t* rg);  // REPLAYGAIN_* in ID3 TXXX, Vorbis comments, MP4 "----"
+
+void     R128_init(r128_t* r, uint32_t rate, uint8_t channels, uint32_t* hist);
+void     R128_process(r128_t* r, const int16_t* buff, uint32_t frames);                  // interleaved, 1 or 2 channels
+bool     R128_integrated(const r128_t* r, float* lufs);                                  // false: nothing above -70 LUFS
+uint16_t R128_seconds(const r128_t* r);                                                 // gated length
+
+uint32_t LT_hash(const char* s, size_t len);                                            // FNV-1a
+const lt_entry_t* LT_find(const lt_entry_t* t, uint32_t n, uint32_t path);
+bool     LT_album(const lt_entry_t* t, uint32_t n, uint32_t dir, float* lufs, float* peak); // power mean of the tracks
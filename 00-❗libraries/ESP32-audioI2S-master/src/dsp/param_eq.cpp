@@ -0,0 +1,176 @@
+/*
+ * param_eq.cpp
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  https://www.w3.org/TR/audio-eq-cookbook/
+ */
+#include "param_eq.h"
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+
+const uint32_t PEQ_rates[PEQ_NUM_RATES] = {8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000};
+
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t PEQ_rateIndex(uint32_t sampleRate) {
+    uint8_t  best = PEQ_NUM_RATES - 1;
+    uint32_t bestDiff = UINT32_MAX;
+    for(uint8_t i = 0; i < PEQ_NUM_RATES; i++) {
+        uint32_t diff = (sampleRate > PEQ_rates[i]) ? sampleRate - PEQ_rates[i] : PEQ_rates[i] - sampleRate;
+        if(diff < bestDiff) { bestDiff = diff; best = i; }
+    }
+    return best;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static float peq_clamp(float v, float lo, float hi) {
+    if(v < lo) return lo;
+    if(v > hi) return hi;
+    return v;
+}
+
+bq_coef_t PEQ_design(const peq_band_t* band, float sampleRate, bool* valid) {
+    // cookbook naming is b (numerator) / a (denominator), biquad_eq uses the earlevel naming a / b
+    float f = peq_clamp(band->freq, 20, 20000);
+    float q = peq_clamp(band->q, 0.1f, 10);
+    float g = peq_clamp(band->gain, -15, 15);
+    float fMax = sampleRate * 0.45f;
+
+    *valid = true;
+    if(f > fMax) {
+        if(band->type == PEQ_PEAK) { *valid = false; return BQ_quantize(1, 0, 0, 0, 0); } // not representable
+        f = fMax; // a shelf still acts on the upper end, as the former HighShelf did
+    }
+
+    float A = powf(10, g / 40);
+    float w0 = 2 * (float)M_PI * f / sampleRate;
+    float cs = cosf(w0);
+    float alpha = sinf(w0) / (2 * q);
+    float sqA = 2 * sqrtf(A) * alpha;
+    float b0, b1, b2, a0, a1, a2;
+
+    switch(band->type) {
+        case PEQ_LOWSHELF:
+            b0 = A * ((A + 1) - (A - 1) * cs + sqA);
+            b1 = 2 * A * ((A - 1) - (A + 1) * cs);
+            b2 = A * ((A + 1) - (A - 1) * cs - sqA);
+            a0 = (A + 1) + (A - 1) * cs + sqA;
+            a1 = -2 * ((A - 1) + (A + 1) * cs);
+            a2 = (A + 1) + (A - 1) * cs - sqA;
+            break;
+        case PEQ_HIGHSHELF:
+            b0 = A * ((A + 1) + (A - 1) * cs + sqA);
+            b1 = -2 * A * ((A - 1) + (A + 1) * cs);
+            b2 = A * ((A + 1) + (A - 1) * cs - sqA);
+            a0 = (A + 1) - (A - 1) * cs + sqA;
+            a1 = 2 * ((A - 1) - (A + 1) * cs);
+            a2 = (A + 1) - (A - 1) * cs - sqA;
+            break;
+        default: // PEQ_PEAK
+            b0 = 1 + alpha * A;
+            b1 = -2 * cs;
+            b2 = 1 - alpha * A;
+            a0 = 1 + alpha / A;
+            a1 = -2 * cs;
+            a2 = 1 - alpha / A;
+            break;
+    }
+    return BQ_quantize(b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void PEQ_buildBanks(const peq_preset_t* preset, peq_bankset_t* set) {
+    const int32_t one = 1L << BQ_COEF_SHIFT;
+    float         pre = powf(10, peq_clamp(preset->preamp, -24, 0) / 20);
+    int32_t       preQ = (int32_t)lroundf(pre * one);
+
+    strncpy(set->name, preset->name, PEQ_NAME_LEN - 1);
+    set->name[PEQ_NAME_LEN - 1] = '\0';
+
+    for(uint8_t r = 0; r < PEQ_NUM_RATES; r++) {
+        peq_bank_t* bank = &set->bank[r];
+        uint8_t     n = 0;
+        for(uint8_t i = 0; i < preset->numBands && i < PEQ_MAX_BANDS; i++) {
+            bool      valid;
+            bq_coef_t c = PEQ_design(&preset->band[i], (float)PEQ_rates[r], &valid);
+            if(!valid || BQ_isIdentity(&c)) continue;
+            bank->coef[n++] = c;
+        }
+        if(preQ != one) {
+            if(n == 0) bank->coef[n++] = BQ_quantize(pre, 0, 0, 0, 0); // preamp only
+            else {
+                bq_coef_t* c = &bank->coef[0];
+                c->a0 = (int32_t)(((int64_t)c->a0 * preQ) >> BQ_COEF_SHIFT);
+                c->a1 = (int32_t)(((int64_t)c->a1 * preQ) >> BQ_COEF_SHIFT);
+                c->a2 = (int32_t)(((int64_t)c->a2 * preQ) >> BQ_COEF_SHIFT);
+            }
+        }
+        bank->numStages = n;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static const char* peq_skipSpace(const char* p) {
+    while(*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+static bool peq_parseType(const char* p, uint8_t* type, const char** end) {
+    static const struct { const char* name; uint8_t type; } types[] = {
+        {"peak", PEQ_PEAK}, {"pk", PEQ_PEAK}, {"lowshelf", PEQ_LOWSHELF}, {"ls", PEQ_LOWSHELF},
+        {"highshelf", PEQ_HIGHSHELF}, {"hs", PEQ_HIGHSHELF}};
+    const char* q = p;
+    while(isalpha((unsigned char)*q)) q++;
+    size_t len = q - p;
+    for(uint8_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if(strlen(types[i].name) == len && strncasecmp(p, types[i].name, len) == 0) {
+            *type = types[i].type;
+            *end = q;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t PEQ_parse(const char* text, peq_preset_t* presets, uint8_t maxPresets) {
+    int16_t cnt = -1; // index of the current preset
+    const char* p = text;
+
+    while(*p) {
+        const char* eol = p;
+        while(*eol && *eol != '\n') eol++;
+        p = peq_skipSpace(p);
+
+        if(*p == '[') { // new preset
+            if(cnt + 1 >= maxPresets) break;
+            peq_preset_t* ps = &presets[++cnt];
+            memset(ps, 0, sizeof(peq_preset_t));
+            p++;
+            uint8_t i = 0;
+            while(p < eol && *p != ']') {
+                if(i < PEQ_NAME_LEN - 1) ps->name[i++] = *p;
+                p++;
+            }
+            if(p < eol) p++; // ']'
+            char* end;
+            float pre = strtof(p, &end);
+            if(end != p && end <= eol) ps->preamp = pre;
+        }
+        else if(cnt >= 0 && isalpha((unsigned char)*p)) { // band
+            peq_preset_t* ps = &presets[cnt];
+            peq_band_t    b;
+            const char*   q;
+            char*         end;
+            if(ps->numBands < PEQ_MAX_BANDS && peq_parseType(p, &b.type, &q)) {
+                bool ok = true;
+                b.freq = strtof(q, &end); ok &= (end != q && end <= eol); q = end;
+                b.q    = strtof(q, &end); ok &= (end != q && end <= eol); q = end;
+                b.gain = strtof(q, &end); ok &= (end != q && end <= eol);
+                if(ok) ps->band[ps->numBands++] = b;
+            }
+        }
+        // anything else: empty line, comment or garbage
+        p = *eol ? eol + 1 : eol;
+    }
+    return cnt + 1;
+}
@@ -0,0 +1,58 @@
+/*
+ * param_eq.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  N-band parametric equalizer (RBJ audio EQ cookbook), up to PEQ_MAX_BANDS peak/shelf bands per preset
+ *  all transcendental math happens in PEQ_buildBanks(): one coefficient bank per supported sample rate,
+ *  the audio task only selects a bank (no float, no tanf/powf)
+ *
+ *  preset file format (plain text, one band per line, '#' starts a comment):
+ *
+ *      [PCM5101 Warm] -3          <- preset name and preamp in dB (optional, <= 0)
+ *      lowshelf   105  0.71  3.5  <- type, frequency [Hz], Q, gain [dB]
+ *      peak      2800  1.40 -1.5     types: peak, lowshelf, highshelf (pk, ls, hs)
+ *      highshelf 9000  0.71  2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "biquad_eq.h"
+
+#define PEQ_MAX_BANDS   BQ_MAX_STAGES
+#define PEQ_MAX_PRESETS 16
+#define PEQ_NUM_RATES   9
+#define PEQ_NAME_LEN    24
+
+enum : uint8_t { PEQ_PEAK = 0, PEQ_LOWSHELF = 1, PEQ_HIGHSHELF = 2 };
+
+typedef struct _peq_band{
+    uint8_t type;
+    float   freq;                   // [Hz] 20 ... 20000
+    float   q;                      // 0.1 ... 10
+    float   gain;                   // [dB] -15 ... +15
+} peq_band_t;
+
+typedef struct _peq_preset{
+    char       name[PEQ_NAME_LEN];
+    float      preamp;              // [dB] -24 ... 0, folded into the first stage
+    uint8_t    numBands;
+    peq_band_t band[PEQ_MAX_BANDS];
+} peq_preset_t;
+
+typedef struct _peq_bank{           // ready to use cascade for one sample rate
+    uint8_t   numStages;
+    bq_coef_t coef[PEQ_MAX_BANDS];
+} peq_bank_t;
+
+typedef struct _peq_bankset{        // one preset, all sample rates
+    char       name[PEQ_NAME_LEN];
+    peq_bank_t bank[PEQ_NUM_RATES];
+} peq_bankset_t;
+
+extern const uint32_t PEQ_rates[PEQ_NUM_RATES];   // 8000 ... 48000
+
+uint8_t   PEQ_rateIndex(uint32_t sampleRate);                                             // nearest supported rate
+bq_coef_t PEQ_design(const peq_band_t* band, float sampleRate, bool* valid);
+void      PEQ_buildBanks(const peq_preset_t* preset, peq_bankset_t* set);
+uint8_t   PEQ_parse(const char* text, peq_preset_t* presets, uint8_t maxPresets);          // returns the number of presets
@@ -0,0 +1,59 @@
+/*
+ * pcm_ring.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "pcm_ring.h"
+#include <string.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+void PR_init(pcm_ring_t* ring, int32_t* buff, uint32_t frames) {
+    ring->buff = buff;
+    ring->size = frames;
+    ring->rd.store(0, std::memory_order_relaxed);
+    ring->wr.store(0, std::memory_order_release);
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t PR_write(pcm_ring_t* ring, const int32_t* src, uint32_t frames) {
+    uint32_t wr = ring->wr.load(std::memory_order_relaxed);
+    uint32_t n = ring->size - (wr - ring->rd.load(std::memory_order_acquire));
+    if(frames > n) frames = n;
+    uint32_t pos = wr & (ring->size - 1);
+    uint32_t first = ring->size - pos;
+    if(first > frames) first = frames;
+    memcpy(ring->buff + 2 * pos, src, first * 2 * sizeof(int32_t));
+    memcpy(ring->buff, src + 2 * first, (frames - first) * 2 * sizeof(int32_t));
+    ring->wr.store(wr + frames, std::memory_order_release); // the frames are visible before the counter
+    return frames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t PR_write16(pcm_ring_t* ring, const int16_t* src, uint32_t frames) {
+    uint32_t wr = ring->wr.load(std::memory_order_relaxed);
+    uint32_t n = ring->size - (wr - ring->rd.load(std::memory_order_acquire));
+    if(frames > n) frames = n;
+    uint32_t pos = wr & (ring->size - 1);
+    for(uint32_t i = 0; i < frames; i++) {
+        ring->buff[2 * pos] = src[2 * i];
+        ring->buff[2 * pos + 1] = src[2 * i + 1];
+        if(++pos == ring->size) pos = 0;
+    }
+    ring->wr.store(wr + frames, std::memory_order_release);
+    return frames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t PR_read(pcm_ring_t* ring, int32_t* dst, uint32_t frames) {
+    uint32_t rd = ring->rd.load(std::memory_order_relaxed);
+    uint32_t n = ring->wr.load(std::memory_order_acquire) - rd;
+    if(frames > n) frames = n;
+    uint32_t pos = rd & (ring->size - 1);
+    uint32_t first = ring->size - pos;
+    if(first > frames) first = frames;
+    memcpy(dst, ring->buff + 2 * pos, first * 2 * sizeof(int32_t));
+    memcpy(dst + 2 * first, ring->buff, (frames - first) * 2 * sizeof(int32_t));
+    ring->rd.store(rd + frames, std::memory_order_release); // the producer may overwrite the frames now
+    return frames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void PR_drop(pcm_ring_t* ring) {
+    ring->rd.store(ring->wr.load(std::memory_order_acquire), std::memory_order_release);
+}
@@ -0,0 +1,32 @@
+/*
+ * pcm_ring.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  lock-free single producer / single consumer ring between the decoder task and the output task
+ *  interleaved L/R frames, 32 bit in 16 bit scale (EQ boosts above full scale reach the limiter)
+ *  the producer only moves wr, the consumer only moves rd, both are free running frame counters (the size is a
+ *  power of two, the position stays right when they wrap)
+ *  no Arduino dependencies, builds on a Linux host
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+typedef struct _pcm_ring{
+    int32_t*              buff;
+    uint32_t              size;     // frames, power of two
+    std::atomic<uint32_t> rd;
+    std::atomic<uint32_t> wr;
+} pcm_ring_t;
+
+void     PR_init(pcm_ring_t* ring, int32_t* buff, uint32_t frames);                  // power of two, both tasks idle
+inline uint32_t PR_fill(const pcm_ring_t* ring) {
+    return ring->wr.load(std::memory_order_acquire) - ring->rd.load(std::memory_order_acquire);
+}
+inline uint32_t PR_free(const pcm_ring_t* ring) { return ring->size - PR_fill(ring); }
+uint32_t PR_write(pcm_ring_t* ring, const int32_t* src, uint32_t frames);            // producer
+uint32_t PR_write16(pcm_ring_t* ring, const int16_t* src, uint32_t frames);          // producer, widened
+uint32_t PR_read(pcm_ring_t* ring, int32_t* dst, uint32_t frames);                   // consumer
+void     PR_drop(pcm_ring_t* ring);                                                  // consumer, rd = wr
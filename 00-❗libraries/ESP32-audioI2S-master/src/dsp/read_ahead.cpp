@@ -0,0 +1,52 @@
+/*
+ * read_ahead.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "read_ahead.h"
+#include <string.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+void RA_init(ra_ring_t* ring, uint8_t* buff, uint32_t size) {
+    ring->buff = buff;
+    ring->size = size;
+    RA_reset(ring, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void RA_reset(ra_ring_t* ring, uint32_t pos) {
+    ring->rd.store(pos, std::memory_order_relaxed);
+    ring->wr.store(pos, std::memory_order_release);
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t RA_write(ra_ring_t* ring, const uint8_t* src, uint32_t len) {
+    uint32_t wr = ring->wr.load(std::memory_order_relaxed);
+    uint32_t n = ring->size - (wr - ring->rd.load(std::memory_order_acquire));
+    if(len > n) len = n;
+    uint32_t pos = wr & (ring->size - 1);
+    uint32_t first = ring->size - pos;
+    if(first > len) first = len;
+    memcpy(ring->buff + pos, src, first);
+    memcpy(ring->buff, src + first, len - first);
+    ring->wr.store(wr + len, std::memory_order_release); // the bytes are visible before the offset
+    return len;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t RA_read(ra_ring_t* ring, uint8_t* dst, uint32_t len) {
+    uint32_t rd = ring->rd.load(std::memory_order_relaxed);
+    uint32_t n = ring->wr.load(std::memory_order_acquire) - rd;
+    if(len > n) len = n;
+    uint32_t pos = rd & (ring->size - 1);
+    uint32_t first = ring->size - pos;
+    if(first > len) first = len;
+    memcpy(dst, ring->buff + pos, first);
+    memcpy(dst + first, ring->buff, len - first);
+    ring->rd.store(rd + len, std::memory_order_release); // the producer may overwrite the bytes now
+    return len;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool RA_seek(ra_ring_t* ring, uint32_t pos) {
+    uint32_t rd = ring->rd.load(std::memory_order_relaxed);
+    if(pos - rd > ring->wr.load(std::memory_order_acquire) - rd) return false; // before rd or behind wr
+    ring->rd.store(pos, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,35 @@
+/*
+ * read_ahead.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  single producer / single consumer byte ring between the SD read-ahead task and loop()
+ *  rd and wr are file offsets (FAT files are below 4 GB), the ring position is the offset & (size - 1), so a read
+ *  that ends on a chunk boundary of the file never wraps inside the ring
+ *  the producer only moves wr, the consumer only moves rd, RA_reset() (new file or seek) is done by the producer
+ *  while the consumer waits for the acknowledge
+ *  no Arduino dependencies, builds on a Linux host
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#define RA_NO_POS UINT32_MAX
+
+typedef struct _ra_ring{
+    uint8_t*              buff;
+    uint32_t              size;     // bytes, power of two
+    std::atomic<uint32_t> rd;       // file offset of the next byte for the decoder
+    std::atomic<uint32_t> wr;       // file offset of the next byte from the card
+} ra_ring_t;
+
+void     RA_init(ra_ring_t* ring, uint8_t* buff, uint32_t size);                     // power of two, both tasks idle
+void     RA_reset(ra_ring_t* ring, uint32_t pos);                                    // producer, the ring is empty at pos
+inline uint32_t RA_fill(const ra_ring_t* ring) {
+    return ring->wr.load(std::memory_order_acquire) - ring->rd.load(std::memory_order_acquire);
+}
+inline uint32_t RA_free(const ra_ring_t* ring) { return ring->size - RA_fill(ring); }
+uint32_t RA_write(ra_ring_t* ring, const uint8_t* src, uint32_t len);                // producer
+uint32_t RA_read(ra_ring_t* ring, uint8_t* dst, uint32_t len);                       // consumer
+bool     RA_seek(ra_ring_t* ring, uint32_t pos);                                     // consumer, false if pos is not in the ring
@@ -0,0 +1,163 @@
+/*
+ * resampler.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "resampler.h"
+#include <string.h>
+#include <math.h>
+
+typedef struct _rs_quality{
+    uint8_t  taps;
+    uint16_t phases;
+    uint8_t  phaseBits;
+    float    beta;      // Kaiser
+    float    rolloff;
+} rs_quality_t;
+
+static const rs_quality_t rs_q[3] = {
+    { 8,  64, 6, 5.0f, 0.80f},  // LOW
+    {16, 128, 7, 7.0f, 0.88f},  // MEDIUM
+    {32, 256, 8, 8.5f, 0.92f},  // HIGH
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t RS_coefSize(uint8_t quality) {
+    if(quality > RS_QUALITY_HIGH) quality = RS_QUALITY_HIGH;
+    return (size_t)(rs_q[quality].phases + 1) * rs_q[quality].taps * sizeof(int16_t);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static float rs_besselI0(float x) {
+    float sum = 1, term = 1;
+    for(int k = 1; k < 25; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if(term < sum * 1e-7f) break;
+    }
+    return sum;
+}
+
+static void rs_buildTable(rs_t* rs, float cutoff) {
+    // row p: kernel for an output sample p/phases behind the middle of the window, every row normalized to 1 (DC)
+    const rs_quality_t* q = &rs_q[rs->quality];
+    float half = rs->taps / 2.0f;
+    float i0b = rs_besselI0(q->beta);
+    for(uint16_t p = 0; p <= rs->phases; p++) {
+        float   h[RS_MAX_TAPS];
+        float   sum = 0;
+        int16_t* row = rs->coef + p * rs->taps;
+        for(uint8_t t = 0; t < rs->taps; t++) {
+            float x = (float)t - (half - 1) - (float)p / rs->phases;     // distance in input samples
+            float s = (x == 0) ? 1 : sinf((float)M_PI * cutoff * x) / ((float)M_PI * cutoff * x);
+            float r = x / half;
+            float w = (r <= -1 || r >= 1) ? 0 : rs_besselI0(q->beta * sqrtf(1 - r * r)) / i0b;
+            h[t] = s * w;
+            sum += h[t];
+        }
+        for(uint8_t t = 0; t < rs->taps; t++) {
+            float v = h[t] / sum * 32768;
+            if(v > 32767) v = 32767;
+            if(v < -32768) v = -32768;
+            row[t] = (int16_t)lroundf(v);
+        }
+    }
+    rs->cutoff = cutoff;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void RS_init(rs_t* rs, uint8_t quality, int16_t* coef) {
+    if(quality > RS_QUALITY_HIGH) quality = RS_QUALITY_HIGH;
+    rs->quality = quality;
+    rs->taps = rs_q[quality].taps;
+    rs->phases = rs_q[quality].phases;
+    rs->phaseBits = rs_q[quality].phaseBits;
+    rs->coef = coef;
+    rs->cutoff = 0;
+    rs->stepInt = 1;
+    rs->stepFrac = 0;
+    rs->bypass = true;
+    RS_reset(rs);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void RS_reset(rs_t* rs) {
+    memset(rs->hist, 0, sizeof(rs->hist));
+    rs->histPos = 0;
+    rs->frac = 0;
+    rs->need = 1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void RS_setRatio(rs_t* rs, uint32_t inRate, uint32_t outRate, uint32_t speedQ16) {
+    if(!inRate || !outRate || !speedQ16) return;
+    uint64_t step = ((uint64_t)inRate << 32) / outRate;
+    step = (step >> 16) * speedQ16 + (((step & 0xffff) * speedQ16) >> 16);  // * speed, no 64 bit overflow
+    rs->stepInt = step >> 32;
+    rs->stepFrac = (uint32_t)step;
+    rs->bypass = (step == (1ULL << 32));
+
+    // the table depends on the cutoff only, it is rebuilt if the ratio moves it by more than 1%
+    float ratio = (float)step / 4294967296.0f;                          // input samples per output sample
+    float cutoff = rs_q[rs->quality].rolloff * ((ratio > 1) ? 1 / ratio : 1);
+    if(!rs->bypass && fabsf(cutoff - rs->cutoff) > rs->cutoff * 0.01f) rs_buildTable(rs, cutoff);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static inline void rs_push(rs_t* rs, const int16_t* frame) {
+    uint8_t p = rs->histPos;
+    rs->hist[0][p] = rs->hist[0][p + rs->taps] = frame[0];
+    rs->hist[1][p] = rs->hist[1][p + rs->taps] = frame[1];
+    rs->histPos = (p + 1 == rs->taps) ? 0 : p + 1;
+}
+
+static inline int32_t rs_dot(const int16_t* x, const int16_t* c, uint8_t taps) {
+    int32_t acc = 0; // sum |c| < 1.6 in Q15, no overflow
+    for(uint8_t t = 0; t < taps; t++) acc += x[t] * c[t];
+    return acc;
+}
+
+static inline int16_t rs_sat(int32_t v) {
+    if(v > 32767) return 32767;
+    if(v < -32768) return -32768;
+    return v;
+}
+
+uint16_t RS_process(rs_t* rs, const int16_t* in, uint16_t inFrames, uint16_t* consumed, int16_t* out, uint16_t maxOut) {
+    uint16_t i = 0, o = 0;
+
+    if(rs->bypass && rs->frac == 0) { // copy, the history is kept up to date for a later ratio change
+        uint16_t n = (inFrames < maxOut) ? inFrames : maxOut;
+        memcpy(out, in, n * 2 * sizeof(int16_t));
+        for(uint16_t k = (n > rs->taps) ? n - rs->taps : 0; k < n; k++) rs_push(rs, in + 2 * k);
+        *consumed = n;
+        return n;
+    }
+
+    const uint8_t taps = rs->taps;
+    const uint8_t shift = 32 - rs->phaseBits;
+    const bool    lerp = (rs->quality != RS_QUALITY_LOW);
+
+    while(o < maxOut) {
+        while(rs->need) {
+            if(i == inFrames) goto done;
+            rs_push(rs, in + 2 * i);
+            i++;
+            rs->need--;
+        }
+        uint32_t       phase = rs->frac >> shift;
+        const int16_t* c0 = rs->coef + phase * taps;
+        for(uint8_t ch = 0; ch < 2; ch++) {
+            const int16_t* x = &rs->hist[ch][rs->histPos];
+            int32_t        y = rs_dot(x, c0, taps);
+            if(lerp) {
+                int32_t  y1 = rs_dot(x, c0 + taps, taps);
+                uint32_t f = (rs->frac << rs->phaseBits) >> 17;             // Q15 position between the phases
+                y += (int32_t)(((int64_t)(y1 - y) * f) >> 15);
+            }
+            out[2 * o + ch] = rs_sat((y + (1 << 14)) >> 15);
+        }
+        o++;
+        uint64_t acc = (uint64_t)rs->frac + rs->stepFrac;
+        rs->frac = (uint32_t)acc;
+        rs->need = rs->stepInt + (uint32_t)(acc >> 32);
+    }
+done:
+    *consumed = i;
+    return o;
+}
@@ -0,0 +1,48 @@
+/*
+ * resampler.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  polyphase sample rate converter, Kaiser windowed sinc, interleaved stereo int16 in and out
+ *  the ratio is free (32.32 fixed point step), so the same engine does 44.1k <-> 48k and varispeed
+ *  no Arduino dependencies, builds on a Linux host
+ *
+ *  quality   taps  phases  interpolation  rolloff  measured 44.1k -> 48k, sine at -4 dBFS:
+ *                                                  -0.5 dB at   THD+N at 1k / 10k
+ *  LOW          8      64  nearest phase  0.80     11.7 kHz     -60 / -44 dB
+ *  MEDIUM      16     128  linear         0.88     16.0 kHz     -81 / -81 dB
+ *  HIGH        32     256  linear         0.92     18.5 kHz     -85 / -85 dB
+ *
+ *  the cost per output frame is stats.resamplerCyclesPerSample (Audio::getAudioStats())
+ */
+#pragma once
+#pragma GCC optimize ("O3")
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RS_MAX_TAPS 32
+
+enum : uint8_t { RS_QUALITY_LOW = 0, RS_QUALITY_MEDIUM = 1, RS_QUALITY_HIGH = 2 };
+
+typedef struct _rs{
+    uint8_t  quality;
+    uint8_t  taps;
+    uint16_t phases;
+    uint8_t  phaseBits;                 // log2(phases)
+    int16_t* coef;                      // [phases + 1][taps], Q15, RS_coefSize() bytes, owned by the caller
+    float    cutoff;                    // of the current table, relative to the input Nyquist frequency
+    int16_t  hist[2][2 * RS_MAX_TAPS];  // [LEFT/RIGHT], every sample twice, the window is always contiguous
+    uint8_t  histPos;                   // oldest sample of the window
+    uint32_t frac;                      // position of the next output sample between two input samples, Q32
+    uint32_t stepInt;                   // input samples per output sample
+    uint32_t stepFrac;
+    uint32_t need;                      // input samples to read before the next output sample
+    bool     bypass;                    // ratio 1:1, samples are copied
+} rs_t;
+
+size_t   RS_coefSize(uint8_t quality);
+void     RS_init(rs_t* rs, uint8_t quality, int16_t* coef);
+void     RS_reset(rs_t* rs);
+void     RS_setRatio(rs_t* rs, uint32_t inRate, uint32_t outRate, uint32_t speedQ16);     // speed 1.0 = 65536
+uint16_t RS_process(rs_t* rs, const int16_t* in, uint16_t inFrames, uint16_t* consumed, int16_t* out, uint16_t maxOut);
@@ -0,0 +1,240 @@
+/*
+ * seek_map.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "seek_map.h"
+#include "tag_reader.h"
+#include <string.h>
+
+static inline uint32_t sm_be16(const uint8_t* p) { return ((uint32_t)p[0] << 8) | p[1]; }
+static inline uint32_t sm_be32(const uint8_t* p) { return (sm_be16(p) << 16) | sm_be16(p + 2); }
+
+static inline uint64_t sm_entrySample(const sm_map_t* map, uint32_t i) {
+    uint64_t frame = map->framesPerEntry ? (uint64_t)i * map->framesPerEntry : (uint64_t)i * map->totalFrames / map->count;
+    return frame * map->samplesPerFrame;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void SM_reset(sm_map_t* map) {
+    memset(map, 0, offsetof(sm_map_t, pos));
+    map->version = SM_VERSION;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool SM_fromInfo(sm_map_t* map, const uint8_t* data, size_t len, uint32_t dataStart, uint32_t dataEnd, uint32_t fileSize) {
+    SM_reset(map);
+    size_t i = 0;
+    while(i + 4 <= len && !(data[i] == 0xFF && (data[i + 1] & 0xE0) == 0xE0)) i++;
+    tr_frame_t f;
+    if(i + 4 > len || !TR_frameHeader(data + i, &f) || f.layer != 3) return false;
+    const uint8_t* h = data + i;
+    uint32_t start = dataStart + i;
+    if(dataEnd > fileSize || dataEnd <= start) dataEnd = fileSize;
+    if(dataEnd <= start) return false;
+
+    size_t x = 4 + f.sideInfo;
+    if(i + x + 8 <= len && (!memcmp(h + x, "Xing", 4) || !memcmp(h + x, "Info", 4))) {
+        uint32_t flags = sm_be32(h + x + 4);
+        uint32_t frames = 0, bytes = 0;
+        size_t   o = x + 8;
+        if(flags & 1) { if(i + o + 4 > len) return false; frames = sm_be32(h + o); o += 4; }
+        if(flags & 2) { if(i + o + 4 > len) return false; bytes = sm_be32(h + o); o += 4; }
+        if(!(flags & 4) || !frames || i + o + 100 > len) return false; // no TOC (CBR files often have none)
+        if(!bytes || bytes > dataEnd - start) bytes = dataEnd - start;
+        for(uint32_t k = 0; k < 100; k++) map->pos[k] = start + (uint64_t)h[o + k] * bytes / 256; // TOC: 1/256 of the bytes per percent
+        map->count = 100;
+        map->framesPerEntry = 0;
+        map->totalFrames = frames + 1; // the Xing frame count is without the info frame
+    }
+    else if(i + 36 + 26 <= len && !memcmp(h + 36, "VBRI", 4)) {
+        const uint8_t* v = h + 36;
+        uint32_t frames = sm_be32(v + 14);
+        uint32_t entries = sm_be16(v + 18), scale = sm_be16(v + 20), size = sm_be16(v + 22), fpe = sm_be16(v + 24);
+        if(!frames || !entries || !fpe || size < 1 || size > 4 || i + 36 + 26 + entries * size > len) return false;
+        const uint8_t* t = v + 26;
+        uint32_t p = start + f.length;  // the table starts behind the VBRI frame
+        uint16_t n = 0;
+        map->pos[n++] = start;
+        for(uint32_t e = 0; e < entries && n < SM_MAX_ENTRIES; e++, t += size) {
+            uint32_t val = 0;
+            for(uint32_t b = 0; b < size; b++) val = (val << 8) | t[b];
+            p += val * scale;
+            if(p >= dataEnd) break;
+            map->pos[n++] = p;
+        }
+        map->count = n;
+        map->framesPerEntry = fpe;
+        map->totalFrames = frames + 1;
+    }
+    else return false;
+
+    map->kind = SM_TOC;
+    map->fileSize = fileSize;
+    map->dataStart = start;
+    map->dataEnd = dataEnd;
+    map->sampleRate = f.sampleRate;
+    map->samplesPerFrame = f.samples;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void SM_scanStart(sm_scan_t* s, sm_map_t* map, uint32_t dataStart, uint32_t dataEnd, uint32_t fileSize) {
+    SM_reset(map);
+    if(dataEnd > fileSize) dataEnd = fileSize;
+    map->fileSize = fileSize;
+    map->dataStart = dataStart;
+    map->dataEnd = dataEnd;
+    memset(s, 0, sizeof(sm_scan_t));
+    s->map = map;
+    s->pos = dataStart;
+    s->next = dataStart;
+    s->done = (dataStart >= dataEnd);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static bool sm_byte(const sm_scan_t* s, const uint8_t* data, uint32_t len, uint32_t at, uint8_t* b) {
+    if(at >= s->pos) {
+        if(at - s->pos >= len) return false;
+        *b = data[at - s->pos];
+        return true;
+    }
+    uint32_t back = s->pos - at;
+    if(back > s->tailLen) return false;
+    *b = s->tail[s->tailLen - back];
+    return true;
+}
+
+static void sm_addFrame(sm_scan_t* s, uint32_t at) {
+    sm_map_t* map = s->map;
+    if(s->frames % map->framesPerEntry == 0) {
+        if(map->count == SM_MAX_ENTRIES) { // full, every second entry is dropped
+            for(uint32_t i = 0; i < SM_MAX_ENTRIES / 2; i++) map->pos[i] = map->pos[2 * i];
+            map->count = SM_MAX_ENTRIES / 2;
+            map->framesPerEntry *= 2;
+        }
+        if(s->frames % map->framesPerEntry == 0) map->pos[map->count++] = at;
+    }
+    s->frames++;
+}
+
+bool SM_scan(sm_scan_t* s, const uint8_t* data, uint32_t len) {
+    sm_map_t* map = s->map;
+    while(!s->done) {
+        if(s->next + 4 > map->dataEnd) { s->done = true; break; }
+        uint8_t h[4];
+        uint8_t k = 0;
+        while(k < 4 && sm_byte(s, data, len, s->next + k, h + k)) k++;
+        if(k < 4) break; // in the next chunk
+        tr_frame_t f;
+        if(TR_frameHeader(h, &f)) {
+            if(!s->frames) { // the first frame sets the format
+                s->version = f.version;
+                s->layer = f.layer;
+                map->sampleRate = f.sampleRate;
+                map->samplesPerFrame = f.samples;
+                map->framesPerEntry = (f.sampleRate + f.samples / 2) / f.samples; // about one second
+                if(!map->framesPerEntry) map->framesPerEntry = 1;
+            }
+            if(f.version == s->version && f.layer == s->layer && f.sampleRate == map->sampleRate) {
+                sm_addFrame(s, s->next);
+                s->next += f.length;
+                s->lost = 0;
+                continue;
+            }
+        }
+        s->next++; // no frame here (junk, a damaged frame), search the sync word
+        if(++s->lost > SM_MAX_LOST) s->done = true;
+    }
+    if(len >= 3) {
+        memcpy(s->tail, data + len - 3, 3);
+        s->tailLen = 3;
+    }
+    else {
+        uint8_t t[6];
+        memcpy(t, s->tail, s->tailLen);
+        memcpy(t + s->tailLen, data, len);
+        uint8_t n = s->tailLen + len;
+        uint8_t keep = (n > 3) ? 3 : n;
+        memcpy(s->tail, t + n - keep, keep);
+        s->tailLen = keep;
+    }
+    s->pos += len;
+    return !s->done;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool SM_scanEnd(sm_scan_t* s) {
+    sm_map_t* map = s->map;
+    if(!s->frames) {
+        uint32_t fileSize = map->fileSize;
+        SM_reset(map);
+        map->fileSize = fileSize;
+        return false;
+    }
+    map->totalFrames = s->frames;
+    if(s->next < map->dataEnd) map->dataEnd = s->next;
+    map->kind = SM_FRAMES;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t SM_seek(const sm_map_t* map, uint64_t sample, uint32_t* skip) {
+    *skip = 0;
+    if(map->kind == SM_NONE || !map->count) return map->dataStart;
+    uint64_t total = SM_totalSamples(map);
+    if(sample > total) sample = total;
+
+    if(map->kind == SM_FRAMES) {
+        uint64_t preroll = (uint64_t)SM_PREROLL_FRAMES * map->samplesPerFrame;
+        uint64_t from = (sample > preroll) ? sample - preroll : 0;
+        uint32_t i = from / ((uint64_t)map->framesPerEntry * map->samplesPerFrame);
+        if(i >= map->count) i = map->count - 1;
+        *skip = sample - sm_entrySample(map, i);
+        return map->pos[i];
+    }
+    uint32_t lo = 0, hi = map->count - 1; // the last entry in front of the sample
+    while(lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if(sm_entrySample(map, mid) <= sample) lo = mid;
+        else hi = mid - 1;
+    }
+    uint64_t s0 = sm_entrySample(map, lo);
+    uint64_t s1 = (lo + 1 < map->count) ? sm_entrySample(map, lo + 1) : total;
+    uint32_t p0 = map->pos[lo];
+    uint32_t p1 = (lo + 1 < map->count) ? map->pos[lo + 1] : map->dataEnd;
+    if(s1 <= s0 || p1 <= p0) return p0;
+    return p0 + (uint64_t)(p1 - p0) * (sample - s0) / (s1 - s0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t SM_sample(const sm_map_t* map, uint32_t pos) {
+    if(map->kind == SM_NONE || !map->count || pos <= map->pos[0]) return 0;
+    uint32_t lo = 0, hi = map->count - 1; // the last entry in front of pos
+    while(lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if(map->pos[mid] <= pos) lo = mid;
+        else hi = mid - 1;
+    }
+    uint64_t s0 = sm_entrySample(map, lo);
+    uint64_t s1 = (lo + 1 < map->count) ? sm_entrySample(map, lo + 1) : SM_totalSamples(map);
+    uint32_t p0 = map->pos[lo];
+    uint32_t p1 = (lo + 1 < map->count) ? map->pos[lo + 1] : map->dataEnd;
+    if(pos >= p1 || p1 <= p0) return s1;
+    return s0 + (s1 - s0) * (pos - p0) / (p1 - p0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t SM_totalSamples(const sm_map_t* map) {
+    return (uint64_t)map->totalFrames * map->samplesPerFrame;
+}
+//----------------------------------------------------------------------------------------------------------------------
+size_t SM_size(const sm_map_t* map) {
+    return offsetof(sm_map_t, pos) + (size_t)map->count * sizeof(uint32_t);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool SM_load(sm_map_t* map, const uint8_t* data, size_t len) {
+    size_t head = offsetof(sm_map_t, pos);
+    if(len < head) return false;
+    memcpy(map, data, head);
+    if(map->version != SM_VERSION || map->kind == SM_NONE || map->kind > SM_FRAMES || !map->count ||
+       map->count > SM_MAX_ENTRIES || !map->sampleRate || !map->samplesPerFrame || len < SM_size(map) ||
+       (map->kind == SM_FRAMES && !map->framesPerEntry)) {
+        SM_reset(map);
+        return false;
+    }
+    memcpy(map->pos, data + head, (size_t)map->count * sizeof(uint32_t));
+    return true;
+}
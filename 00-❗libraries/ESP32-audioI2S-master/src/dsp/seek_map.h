@@ -0,0 +1,69 @@
+/*
+ * seek_map.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  MP3 seeking by time in VBR files: file offsets of frames, taken from the Xing/Info TOC or the VBRI table
+ *  of the first frame (approximate, 100 points), or from a scan of all frame headers (exact, an entry about
+ *  every second, a frame of the entry and the samples to drop behind it)
+ *  the map is a flat struct, the first SM_size() bytes are stored as they are (cache file)
+ *  no Arduino dependencies, builds on a Linux host
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SM_VERSION        1
+#define SM_MAX_ENTRIES    2048      // a full scan halves the density: 1 s per entry up to 34 min, 2 s up to 68 min...
+#define SM_PREROLL_FRAMES 4         // decoded in front of the target, the bit reservoir and the filterbank settle
+#define SM_MAX_LOST       65536     // bytes without a sync word, then the scan stops (not an MPEG audio file)
+
+enum : uint8_t {SM_NONE = 0, SM_TOC, SM_FRAMES};
+
+typedef struct _sm_map{
+    uint8_t  version;
+    uint8_t  kind;                  // SM_NONE: empty
+    uint16_t count;                 // entries
+    uint32_t fileSize;              // of the file the map belongs to
+    uint32_t dataStart;             // offset of the first frame (the info frame if there is one)
+    uint32_t dataEnd;               // behind the last frame
+    uint32_t sampleRate;
+    uint16_t samplesPerFrame;
+    uint16_t framesPerEntry;        // entry i is frame i * framesPerEntry, 0: the entries divide totalFrames (TOC)
+    uint32_t totalFrames;           // incl. the info frame, it is decoded to one frame of silence
+    uint32_t pos[SM_MAX_ENTRIES];   // file offsets
+} sm_map_t;
+
+typedef struct _sm_scan{
+    sm_map_t* map;
+    uint32_t  pos;                  // file offset of the next chunk
+    uint32_t  next;                 // of the next frame header
+    uint32_t  frames;
+    uint32_t  lost;                 // bytes skipped in search of a sync word
+    uint8_t   tail[3];              // the last bytes of the previous chunk, a header can span two chunks
+    uint8_t   tailLen;
+    uint8_t   version;              // of the first frame, the others must match
+    uint8_t   layer;
+    bool      done;
+} sm_scan_t;
+
+void     SM_reset(sm_map_t* map);
+
+// Xing/Info TOC or VBRI table, data: from the first frame on at file offset dataStart (the start of the stream),
+// dataEnd: behind the audio data (an ID3v1 tag excluded), false: no table, the map is empty
+bool     SM_fromInfo(sm_map_t* map, const uint8_t* data, size_t len, uint32_t dataStart, uint32_t dataEnd, uint32_t fileSize);
+
+// frame scan: the file from dataStart on in chunks of any size, in order, SM_scan() false: done (dataEnd or no sync)
+void     SM_scanStart(sm_scan_t* s, sm_map_t* map, uint32_t dataStart, uint32_t dataEnd, uint32_t fileSize);
+bool     SM_scan(sm_scan_t* s, const uint8_t* data, uint32_t len);
+bool     SM_scanEnd(sm_scan_t* s);   // false: no frames found, the map is empty
+
+// sample: of the decoded stream (counted from the first frame), returns the file offset to read from and the samples
+// to drop behind it (SM_FRAMES, the preroll included), a TOC is interpolated and *skip is 0
+uint32_t SM_seek(const sm_map_t* map, uint64_t sample, uint32_t* skip);
+uint64_t SM_sample(const sm_map_t* map, uint32_t pos);  // sample at a file offset, interpolated between entries
+uint64_t SM_totalSamples(const sm_map_t* map);
+
+size_t   SM_size(const sm_map_t* map);                          // bytes to store
+bool     SM_load(sm_map_t* map, const uint8_t* data, size_t len); // false: not a map of this version
@@ -0,0 +1,125 @@
+/*
+ * spectrum.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "spectrum.h"
+#include <string.h>
+#include <math.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SP_init(sp_fft_t* sp, uint16_t points, uint8_t numBands, uint32_t sampleRate) {
+    if(points != 256 && points != 512) return false;
+    if(numBands < 1 || numBands > SP_MAX_BANDS) return false;
+    sp->points = points;
+    sp->numBands = numBands;
+    for(uint16_t i = 0; i < points; i++) {
+        float w = 0.5f - 0.5f * cosf(2 * (float)M_PI * i / points);
+        sp->window[i] = (int16_t)lroundf(w * 32767);
+    }
+    for(uint16_t k = 0; k < points / 2; k++) {
+        sp->cosT[k] = (int16_t)lroundf(cosf(2 * (float)M_PI * k / points) * 32767);
+        sp->sinT[k] = (int16_t)lroundf(sinf(2 * (float)M_PI * k / points) * 32767);
+    }
+    sp->sampleRate = 0;
+    SP_setRate(sp, sampleRate);
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void SP_setRate(sp_fft_t* sp, uint32_t sampleRate) {
+    if(sp->sampleRate == sampleRate || sampleRate == 0) return;
+    sp->sampleRate = sampleRate;
+    uint16_t half = sp->points / 2;                         // bins 1 ... half - 1 are used, 0 is DC
+    float    fLow = SP_F_LOW;
+    float    fHigh = sampleRate / 2.0f;
+    float    binHz = (float)sampleRate / sp->points;
+    uint16_t last = 1;
+
+    sp->bandEdge[0] = 1;
+    for(uint8_t b = 1; b <= sp->numBands; b++) {
+        float    f = fLow * powf(fHigh / fLow, (float)b / sp->numBands);
+        uint16_t e = (uint16_t)lroundf(f / binHz);
+        uint16_t remaining = sp->numBands - b;              // every band gets one bin at least
+        if(e <= last) e = last + 1;
+        if(e > half - remaining) e = half - remaining;
+        sp->bandEdge[b] = e;
+        last = e;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void sp_cfft(sp_fft_t* sp, int16_t* x, uint16_t n) {
+    // in place radix-2 DIT over n complex Q15 values, every stage scales by 1/2 (no overflow)
+    uint16_t j = 0;
+    for(uint16_t i = 0; i < n - 1; i++) { // bit reversal
+        if(i < j) {
+            int16_t tr = x[2 * i], ti = x[2 * i + 1];
+            x[2 * i] = x[2 * j]; x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = tr; x[2 * j + 1] = ti;
+        }
+        uint16_t m = n >> 1;
+        while(m >= 1 && j >= m) { j -= m; m >>= 1; }
+        j += m;
+    }
+    for(uint16_t size = 2; size <= n; size <<= 1) {
+        uint16_t half = size >> 1;
+        uint16_t step = sp->points / size;                  // twiddle index stride, the tables cover N, not n
+        for(uint16_t start = 0; start < n; start += size) {
+            for(uint16_t k = 0; k < half; k++) {
+                int32_t c = sp->cosT[k * step], s = sp->sinT[k * step];
+                int16_t* a = x + 2 * (start + k);
+                int16_t* b = x + 2 * (start + k + half);
+                int32_t tr = (b[0] * c + b[1] * s) >> 15;   // b * e^(-j*phi)
+                int32_t ti = (b[1] * c - b[0] * s) >> 15;
+                int32_t ar = a[0], ai = a[1];
+                a[0] = (ar + tr) >> 1; a[1] = (ai + ti) >> 1;
+                b[0] = (ar - tr) >> 1; b[1] = (ai - ti) >> 1;
+            }
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static int32_t sp_log2q8(uint64_t v) { // log2(v) * 256, linear between the powers of two
+    if(!v) return 0;
+    int32_t  msb = 63 - __builtin_clzll(v);
+    uint32_t frac = (msb >= 8) ? (uint32_t)(v >> (msb - 8)) & 0xff : (uint32_t)(v << (8 - msb)) & 0xff;
+    return msb * 256 + frac;
+}
+
+void SP_compute(sp_fft_t* sp, const int16_t* in, uint8_t* bands) {
+    uint16_t n = sp->points;
+    uint16_t half = n / 2;
+    int16_t* z = sp->work;
+
+    // even samples -> re, odd samples -> im
+    for(uint16_t i = 0; i < half; i++) {
+        z[2 * i]     = (in[2 * i] * sp->window[2 * i]) >> 15;
+        z[2 * i + 1] = (in[2 * i + 1] * sp->window[2 * i + 1]) >> 15;
+    }
+    sp_cfft(sp, z, half);
+
+    // split: X[k] = (Z[k] + Z*[M-k]) / 2 - j * W^k * (Z[k] - Z*[M-k]) / 2, power per band
+    uint8_t  b = 0;
+    uint64_t acc = 0;
+    // the stages scale by 1/(N/2) in total, so a full scale sine ends up with the same band power for N = 256 and 512,
+    // Hann: amplitude / 4 in the peak bin, the main lobe (ENBW 1.5 bins) lands in one band
+    const int32_t ref = 7270; // log2(band power of a full scale sine) * 256
+    for(uint16_t k = 1; k < half && b < sp->numBands; k++) {
+        int32_t zr = z[2 * k], zi = z[2 * k + 1];
+        int32_t cr = z[2 * (half - k)], ci = -z[2 * (half - k) + 1];    // conj(Z[M-k])
+        int32_t er = (zr + cr) >> 1, ei = (zi + ci) >> 1;               // even part
+        int32_t dr = (zr - cr) >> 1, di = (zi - ci) >> 1;
+        int32_t orr = di, oi = -dr;                                     // odd part = -j * d
+        int32_t c = sp->cosT[k], s = sp->sinT[k];
+        int32_t xr = er + ((orr * c + oi * s) >> 15);                   // + W^k * odd, W = e^(-j*2*pi*k/N)
+        int32_t xi = ei + ((oi * c - orr * s) >> 15);
+        acc += (uint64_t)((int64_t)xr * xr + (int64_t)xi * xi);
+        if(k + 1 == sp->bandEdge[b + 1]) {
+            int32_t lvl = 255 + (((sp_log2q8(acc) - ref) * 2456) >> 16); // 10*log10(2) * 255 / 80 dB * 256 = 2456
+            if(!acc || lvl < 0) lvl = 0;
+            if(lvl > 255) lvl = 255;
+            bands[b++] = lvl;
+            acc = 0;
+        }
+    }
+    while(b < sp->numBands) bands[b++] = 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * spectrum.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  spectrum analyzer for visualizers: Hann window, fixed point radix-2 real FFT (N/2 complex FFT + split),
+ *  power summed in logarithmically spaced bands, 0 ... 255 per band over a range of 80 dB
+ *  no Arduino dependencies, builds on a Linux host
+ */
+#pragma once
+#pragma GCC optimize ("O3")
+
+#include <stdint.h>
+
+#define SP_MAX_POINTS   512
+#define SP_MAX_BANDS    32
+#define SP_DB_RANGE     80      // 0 -> -80 dBFS or less, 255 -> full scale sine
+#define SP_F_LOW        40      // lower edge of the first band [Hz]
+
+typedef struct _sp_fft{
+    uint16_t points;                        // 256 or 512
+    uint8_t  numBands;
+    uint32_t sampleRate;                    // rate of the (decimated) input
+    int16_t  window[SP_MAX_POINTS];         // Hann, Q15
+    int16_t  cosT[SP_MAX_POINTS / 2];       // cos(2*pi*k/N), Q15
+    int16_t  sinT[SP_MAX_POINTS / 2];
+    uint16_t bandEdge[SP_MAX_BANDS + 1];    // first bin of each band
+    int16_t  work[SP_MAX_POINTS];           // N/2 complex values, re/im interleaved
+} sp_fft_t;
+
+bool SP_init(sp_fft_t* sp, uint16_t points, uint8_t numBands, uint32_t sampleRate);      // float math, not in the audio task
+void SP_setRate(sp_fft_t* sp, uint32_t sampleRate);                                      // band edges only
+void SP_compute(sp_fft_t* sp, const int16_t* in, uint8_t* bands);                        // in: 'points' mono samples
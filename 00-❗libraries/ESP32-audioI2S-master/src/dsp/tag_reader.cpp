@@ -0,0 +1,547 @@
+/*
+ * tag_reader.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "tag_reader.h"
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+typedef struct _tr_ctx{
+    tr_read_t  read;
+    void*      user;
+    uint32_t   fileSize;
+    tr_tags_t* tags;
+    uint8_t    win[TR_WINDOW];      // the last read
+    uint32_t   winPos;
+    uint32_t   winLen;
+    bool       pinned;              // the window holds a resynchronized ID3 tag, nothing else is read
+} tr_ctx_t;
+
+enum {TR_TITLE = 0, TR_ARTIST, TR_ALBUM, TR_TRACK, TR_LENGTH};
+
+static inline uint32_t tr_be16(const uint8_t* p) { return ((uint32_t)p[0] << 8) | p[1]; }
+static inline uint32_t tr_be24(const uint8_t* p) { return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]; }
+static inline uint32_t tr_be32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | tr_be24(p + 1); }
+static inline uint32_t tr_le16(const uint8_t* p) { return ((uint32_t)p[1] << 8) | p[0]; }
+static inline uint32_t tr_le32(const uint8_t* p) { return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | tr_le16(p); }
+static inline uint32_t tr_syncsafe(const uint8_t* p) {
+    return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) | ((uint32_t)(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+//----------------------------------------------------------------------------------------------------------------------
+// len bytes at pos (len <= TR_WINDOW) from the window, a new window is read from pos on if they are not in it
+static bool tr_get(tr_ctx_t* c, uint32_t pos, uint8_t* dst, uint32_t len) {
+    if(len > TR_WINDOW) return false;
+    if(pos < c->winPos || (uint64_t)pos + len > (uint64_t)c->winPos + c->winLen) {
+        if(c->pinned || pos >= c->fileSize || c->tags->reads >= TR_MAX_READS) return false;
+        uint32_t n = (c->fileSize - pos < TR_WINDOW) ? c->fileSize - pos : TR_WINDOW;
+        int32_t  r = c->read(c->user, pos, c->win, n);
+        c->tags->reads++;
+        c->winPos = pos;
+        c->winLen = (r > 0) ? r : 0;
+        if(len > c->winLen) return false;
+    }
+    memcpy(dst, c->win + (pos - c->winPos), len);
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static uint8_t tr_utf8Len(uint8_t c) {
+    return (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+}
+
+static bool tr_isUtf8(const uint8_t* s, size_t len) {
+    for(size_t i = 0; i < len && s[i];) {
+        uint8_t k = tr_utf8Len(s[i]);
+        if(s[i] >= 0x80 && (k == 1 || i + k > len)) return false;
+        for(uint8_t j = 1; j < k; j++) {
+            if((s[i + j] & 0xC0) != 0x80) return false;
+        }
+        i += k;
+    }
+    return true;
+}
+
+size_t TR_text(char* dst, size_t dstLen, const uint8_t* src, size_t len, uint8_t encoding) {
+    if(!dstLen) return 0;
+    size_t n = 0, i = 0;
+    bool   wide = (encoding == 1 || encoding == 2);
+    bool   be = (encoding == 2);
+    while(i < len) {
+        uint32_t cp;
+        if(encoding == 3) {                 // UTF-8, copied, a sequence is not cut
+            uint8_t k = tr_utf8Len(src[i]);
+            if(!src[i] || i + k > len || n + k >= dstLen) break;
+            memcpy(dst + n, src + i, k);
+            n += k;
+            i += k;
+            continue;
+        }
+        if(wide) {
+            if(i + 1 >= len) break;
+            cp = be ? tr_be16(src + i) : tr_le16(src + i);
+            i += 2;
+            if(cp == 0xFEFF) continue;
+            if(cp == 0xFFFE) {              // BOM of the other byte order
+                be = !be;
+                continue;
+            }
+            if(cp >= 0xD800 && cp < 0xDC00 && i + 1 < len) {
+                uint32_t lo = be ? tr_be16(src + i) : tr_le16(src + i);
+                if(lo >= 0xDC00 && lo < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 2;
+                }
+            }
+        }
+        else {
+            cp = src[i++];                  // ISO-8859-1 is the first block of unicode
+        }
+        if(!cp) break;
+        uint8_t u[4], k;
+        if(cp < 0x80)         { u[0] = cp; k = 1; }
+        else if(cp < 0x800)   { u[0] = 0xC0 | (cp >> 6);  u[1] = 0x80 | (cp & 0x3F); k = 2; }
+        else if(cp < 0x10000) { u[0] = 0xE0 | (cp >> 12); u[1] = 0x80 | ((cp >> 6) & 0x3F); u[2] = 0x80 | (cp & 0x3F); k = 3; }
+        else {
+            u[0] = 0xF0 | (cp >> 18); u[1] = 0x80 | ((cp >> 12) & 0x3F); u[2] = 0x80 | ((cp >> 6) & 0x3F);
+            u[3] = 0x80 | (cp & 0x3F); k = 4;
+        }
+        if(n + k >= dstLen) break;
+        memcpy(dst + n, u, k);
+        n += k;
+    }
+    while(n && (dst[n - 1] == ' ' || dst[n - 1] == '\r' || dst[n - 1] == '\n')) n--;   // ID3v1 pads with spaces
+    dst[n] = 0;
+    return n;
+}
+
+// text without an encoding byte (ID3v1, RIFF INFO): UTF-8 if it is valid UTF-8, else ISO-8859-1
+static size_t tr_text8(char* dst, size_t dstLen, const uint8_t* src, size_t len) {
+    return TR_text(dst, dstLen, src, len, tr_isUtf8(src, len) ? 3 : 0);
+}
+
+// the first value found wins (ID3v2 before ID3v1)
+static void tr_set(tr_tags_t* tags, int field, const char* s) {
+    char* dst = (field == TR_TITLE) ? tags->title : (field == TR_ARTIST) ? tags->artist : tags->album;
+    if(field == TR_TRACK) {
+        if(!tags->trackNo) tags->trackNo = (uint16_t)atoi(s);  // "3/12"
+    }
+    else if(field == TR_LENGTH) {
+        if(!tags->duration) tags->duration = strtoul(s, NULL, 10);
+    }
+    else if(!dst[0]) {
+        strncpy(dst, s, TR_TEXT_LEN - 1);
+        dst[TR_TEXT_LEN - 1] = 0;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+// removes the zero bytes the unsynchronisation inserted behind 0xFF, returns the new length
+static uint32_t tr_resync(uint8_t* p, uint32_t len) {
+    uint32_t j = 0;
+    for(uint32_t i = 0; i < len; i++) {
+        p[j++] = p[i];
+        if(p[i] == 0xFF && i + 1 < len && p[i + 1] == 0) i++;
+    }
+    return j;
+}
+
+static int tr_id3Field(const uint8_t* id, uint8_t version) {
+    static const char* const v22[] = {"TT2", "TP1", "TAL", "TRK", "TLE"};
+    static const char* const v23[] = {"TIT2", "TPE1", "TALB", "TRCK", "TLEN"};
+    for(int i = 0; i <= TR_LENGTH; i++) {
+        if(version == 2 ? !memcmp(id, v22[i], 3) : !memcmp(id, v23[i], 4)) return i;
+    }
+    return -1;
+}
+
+// ID3v2 tag at pos, returns its size (0: no tag), only the text frames of interest are read, the pictures skipped
+static uint32_t tr_id3v2(tr_ctx_t* c, uint32_t pos) {
+    uint8_t h[10];
+    if(!tr_get(c, pos, h, 10) || memcmp(h, "ID3", 3) || h[3] < 2 || h[3] > 4) return 0;
+    if((h[6] | h[7] | h[8] | h[9]) & 0x80) return 0;
+    uint8_t  version = h[3];
+    uint8_t  flags = h[5];
+    uint32_t size = tr_syncsafe(h + 6);
+    uint32_t total = 10 + size + ((version == 4 && (flags & 0x10)) ? 10 : 0);  // footer
+    uint32_t p = pos + 10;
+    uint32_t end = p + size;
+
+    if((flags & 0x80) && version < 4) {
+        // the whole tag is unsynchronized, the frame sizes count the resynchronized bytes: the first window is
+        // resynchronized and parsed alone (the text frames come first in practice)
+        uint32_t n = (size < TR_WINDOW) ? size : TR_WINDOW;
+        if(c->tags->reads >= TR_MAX_READS) return total;
+        int32_t r = c->read(c->user, p, c->win, n);
+        c->tags->reads++;
+        c->winPos = p;
+        c->winLen = (r > 0) ? tr_resync(c->win, r) : 0;
+        c->pinned = true;
+        end = p + c->winLen;
+    }
+    if(version > 2 && (flags & 0x40)) {    // extended header
+        uint8_t e[4];
+        if(!tr_get(c, p, e, 4)) end = p;
+        else p += (version == 3) ? 4 + tr_be32(e) : tr_syncsafe(e);
+    }
+
+    uint8_t hdrLen = (version == 2) ? 6 : 10;
+    while((uint64_t)p + hdrLen <= end) {
+        uint8_t f[10];
+        if(!tr_get(c, p, f, hdrLen) || !f[0]) break;  // padding
+        uint32_t fsize;
+        uint16_t fflags = 0;
+        if(version == 2) fsize = tr_be24(f + 3);
+        else {
+            fsize = (version == 4) ? tr_syncsafe(f + 4) : tr_be32(f + 4);
+            fflags = tr_be16(f + 8);
+        }
+        p += hdrLen;
+        if(fsize > end - p) break;
+        int  field = tr_id3Field(f, version);
+        bool coded = (version == 3) ? (fflags & 0x00C0) : (version == 4) ? (fflags & 0x000C) : false; // compressed, encrypted
+        if(field >= 0 && !coded && fsize > 1) {
+            uint8_t  d[TR_TEXT_LEN * 2 + 8];  // UTF-16 needs two bytes per character
+            uint32_t n = (fsize < sizeof(d)) ? fsize : sizeof(d);
+            uint8_t* t = d;
+            if(tr_get(c, p, d, n)) {
+                if(version == 4 && (fflags & 0x0001) && n > 4) { t += 4; n -= 4; }   // data length indicator
+                if(version == 4 && (fflags & 0x0002)) n = tr_resync(t, n);
+                char s[TR_TEXT_LEN];
+                if(n > 1 && t[0] <= 3) {
+                    TR_text(s, sizeof(s), t + 1, n - 1, t[0]);
+                    tr_set(c->tags, field, s);
+                }
+            }
+        }
+        p += fsize;
+    }
+    if(c->pinned) {
+        c->pinned = false;
+        c->winLen = 0;
+    }
+    return total;
+}
+
+// ID3v1 in the last 128 bytes, fills what ID3v2 left empty, true: present
+static bool tr_id3v1(tr_ctx_t* c) {
+    uint8_t t[128];
+    char    s[TR_TEXT_LEN];
+    if(c->fileSize < 128 + c->tags->audioStart || !tr_get(c, c->fileSize - 128, t, 128) || memcmp(t, "TAG", 3)) return false;
+    static const uint8_t at[3] = {3, 33, 63};     // title, artist, album, 30 bytes each
+    for(int i = 0; i < 3; i++) {
+        if(tr_text8(s, sizeof(s), t + at[i], 30)) tr_set(c->tags, i, s);
+    }
+    if(!t[125] && t[126] && !c->tags->trackNo) c->tags->trackNo = t[126];   // ID3v1.1
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+// MPEG audio: the first frame behind the tags, frame count from the Xing/Info or VBRI header, else CBR
+static const uint16_t tr_bitrates[2][3][15] = {
+    {{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},      // MPEG2/2.5 layer I
+     {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},           // layer II
+     {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}},          // layer III
+    {{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},   // MPEG1 layer I
+     {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},      // layer II
+     {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}}       // layer III
+};
+
+bool TR_frameHeader(const uint8_t* h, tr_frame_t* f) {
+    if(h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) return false;
+    uint8_t version = (h[1] >> 3) & 3;      // 3: MPEG1, 2: MPEG2, 0: MPEG2.5
+    uint8_t layer = 4 - ((h[1] >> 1) & 3);  // 1...3
+    uint8_t br = h[2] >> 4;
+    uint8_t sr = (h[2] >> 2) & 3;
+    if(version == 1 || layer == 4 || br == 0 || br == 15 || sr == 3) return false;   // free format is not supported
+    static const uint32_t rates[3] = {44100, 48000, 32000};
+    bool mpeg1 = (version == 3);
+    bool mono = ((h[3] >> 6) == 3);
+    f->version = version;
+    f->layer = layer;
+    f->sampleRate = rates[sr] >> (mpeg1 ? 0 : (version == 2) ? 1 : 2);
+    f->bitRate = tr_bitrates[mpeg1][layer - 1][br];
+    f->samples = (layer == 1) ? 384 : (layer == 2 || mpeg1) ? 1152 : 576;
+    uint8_t pad = (h[2] >> 1) & 1;
+    if(layer == 1) f->length = (12000UL * f->bitRate / f->sampleRate + pad) * 4;
+    else f->length = (uint32_t)f->samples / 8 * 1000 * f->bitRate / f->sampleRate + pad;
+    f->sideInfo = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    return true;
+}
+
+static bool tr_mpeg(tr_ctx_t* c, uint32_t pos, bool id3v1) {
+    tr_tags_t* tags = c->tags;
+    uint32_t   end = c->fileSize - (id3v1 ? 128 : 0);
+    tr_frame_t f, g;
+    uint8_t    h[4];
+    uint32_t   limit = pos + 4096;          // junk in front of the first frame
+    for(; pos < limit && pos + 4 <= end; pos++) {
+        if(!tr_get(c, pos, h, 4)) return false;
+        if(h[0] != 0xFF) continue;
+        if((h[1] & 0xF6) == 0xF0) {         // ADTS (layer 0): AAC, no duration without reading every frame
+            tags->format = TR_AAC;
+            tags->audioStart = pos;
+            static const uint32_t aacRates[13] = {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350};
+            uint8_t sr;
+            if(tr_get(c, pos + 2, &sr, 1) && ((sr >> 2) & 0x0F) < 13) tags->sampleRate = aacRates[(sr >> 2) & 0x0F];
+            return true;
+        }
+        if(!TR_frameHeader(h, &f)) continue;
+        if(pos + f.length + 4 <= end) {     // a second frame of the same kind confirms the sync word
+            if(!tr_get(c, pos + f.length, h, 4) || !TR_frameHeader(h, &g) || g.version != f.version ||
+               g.layer != f.layer || g.sampleRate != f.sampleRate) continue;
+        }
+        break;
+    }
+    if(pos >= limit || pos + 4 > end) return false;
+    tags->format = TR_MP3;
+    tags->audioStart = pos;
+    tags->sampleRate = f.sampleRate;
+
+    uint8_t  x[18];
+    uint32_t frames = 0, bytes = 0;
+    if(f.layer == 3 && tr_get(c, pos + 4 + f.sideInfo, x, 16) && (!memcmp(x, "Xing", 4) || !memcmp(x, "Info", 4))) {
+        uint32_t flags = tr_be32(x + 4);
+        uint8_t  o = 8;
+        if(flags & 1) { frames = tr_be32(x + o); o += 4; }
+        if(flags & 2) bytes = tr_be32(x + o);
+    }
+    else if(tr_get(c, pos + 36, x, 18) && !memcmp(x, "VBRI", 4)) {
+        bytes = tr_be32(x + 10);
+        frames = tr_be32(x + 14);
+    }
+    if(frames) {
+        tags->duration = (uint64_t)frames * f.samples * 1000 / f.sampleRate;
+        if(!bytes || bytes > end - pos) bytes = end - pos;
+        if(tags->duration) tags->bitRate = (uint64_t)bytes * 8000 / tags->duration;
+    }
+    else {
+        tags->bitRate = f.bitRate * 1000;
+        if(!tags->duration) tags->duration = (uint64_t)(end - pos) * 8 / f.bitRate;   // ms, CBR, TLEN if present
+    }
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+// FLAC: STREAMINFO and VORBIS_COMMENT, the PICTURE blocks are skipped
+static void tr_vorbisComment(tr_ctx_t* c, uint32_t p, uint32_t len) {
+    static const char* const keys[] = {"TITLE=", "ARTIST=", "ALBUM=", "TRACKNUMBER="};
+    uint32_t end = p + len;
+    uint8_t  b[4];
+    if(!tr_get(c, p, b, 4)) return;
+    p += 4 + tr_le32(b);                    // vendor string
+    if(p + 4 > end || !tr_get(c, p, b, 4)) return;
+    uint32_t count = tr_le32(b);
+    p += 4;
+    for(uint32_t i = 0; i < count && p + 4 <= end; i++) {
+        if(!tr_get(c, p, b, 4)) return;
+        uint32_t n = tr_le32(b);
+        p += 4;
+        if(n > end - p) return;
+        uint8_t  d[TR_TEXT_LEN + 16];
+        uint32_t k = (n < sizeof(d)) ? n : sizeof(d);
+        if(k > 6 && tr_get(c, p, d, k)) {
+            for(int f = 0; f <= TR_TRACK; f++) {
+                size_t kl = strlen(keys[f]);
+                if(k > kl && !strncasecmp((const char*)d, keys[f], kl)) {
+                    char s[TR_TEXT_LEN];
+                    TR_text(s, sizeof(s), d + kl, k - kl, 3);
+                    tr_set(c->tags, f, s);
+                }
+            }
+        }
+        p += n;
+    }
+}
+
+static bool tr_flac(tr_ctx_t* c, uint32_t pos) {
+    tr_tags_t* tags = c->tags;
+    uint32_t   p = pos + 4;             // "fLaC"
+    uint64_t   samples = 0;
+    for(int i = 0; i < 64; i++) {
+        uint8_t h[4];
+        if(!tr_get(c, p, h, 4)) return false;
+        uint8_t  type = h[0] & 0x7F;
+        uint32_t len = tr_be24(h + 1);
+        p += 4;
+        if(type == 0 && len >= 18) {
+            uint8_t s[18];
+            if(!tr_get(c, p, s, 18)) return false;
+            tags->sampleRate = ((uint32_t)s[10] << 12) | ((uint32_t)s[11] << 4) | (s[12] >> 4);
+            samples = ((uint64_t)(s[13] & 0x0F) << 32) | tr_be32(s + 14);
+        }
+        if(type == 4) tr_vorbisComment(c, p, len);
+        p += len;
+        if(h[0] & 0x80) break;          // last block
+    }
+    tags->format = TR_FLAC;
+    tags->audioStart = p;
+    if(tags->sampleRate && samples) tags->duration = samples * 1000 / tags->sampleRate;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+// MP4: moov/mvhd (duration) and moov/udta/meta/ilst (tags), moov may be in front of or behind mdat
+static bool tr_atom(tr_ctx_t* c, uint32_t pos, uint32_t end, uint32_t* size, uint8_t* type, uint8_t* hdr) {
+    uint8_t a[16];
+    if((uint64_t)pos + 8 > end || !tr_get(c, pos, a, 8)) return false;
+    uint64_t s = tr_be32(a);
+    *hdr = 8;
+    if(s == 1) {                        // 64 bit size
+        if(!tr_get(c, pos + 8, a + 8, 8)) return false;
+        s = ((uint64_t)tr_be32(a + 8) << 32) | tr_be32(a + 12);
+        *hdr = 16;
+    }
+    else if(s == 0) s = end - pos;      // up to the end
+    if(s < *hdr || s > end - pos) return false;
+    *size = (uint32_t)s;
+    memcpy(type, a + 4, 4);
+    return true;
+}
+
+// the first child of the given type in [pos, end)
+static bool tr_child(tr_ctx_t* c, uint32_t pos, uint32_t end, const char* type, uint32_t* start, uint32_t* stop) {
+    uint32_t size;
+    uint8_t  t[4], hdr;
+    while(tr_atom(c, pos, end, &size, t, &hdr)) {
+        if(!memcmp(t, type, 4)) {
+            *start = pos + hdr;
+            *stop = pos + size;
+            return true;
+        }
+        pos += size;
+    }
+    return false;
+}
+
+static void tr_ilst(tr_ctx_t* c, uint32_t pos, uint32_t end) {
+    static const char* const items[] = {"\xA9nam", "\xA9" "ART", "\xA9" "alb", "trkn"};
+    uint32_t size;
+    uint8_t  t[4], hdr;
+    for(; tr_atom(c, pos, end, &size, t, &hdr); pos += size) {
+        int f = 0;
+        while(f <= TR_TRACK && memcmp(t, items[f], 4)) f++;
+        uint32_t d, dEnd;
+        if(f > TR_TRACK || !tr_child(c, pos + hdr, pos + size, "data", &d, &dEnd) || dEnd - d < 8) continue;
+        uint8_t  v[TR_TEXT_LEN + 8];    // type (4), locale (4), value
+        uint32_t n = (dEnd - d < sizeof(v)) ? dEnd - d : sizeof(v);
+        if(!tr_get(c, d, v, n)) continue;
+        if(f == TR_TRACK) {
+            if(n >= 12 && !c->tags->trackNo) c->tags->trackNo = tr_be16(v + 10);
+        }
+        else if((tr_be32(v) & 0xFFFFFF) == 1) {    // UTF-8
+            char s[TR_TEXT_LEN];
+            TR_text(s, sizeof(s), v + 8, n - 8, 3);
+            tr_set(c->tags, f, s);
+        }
+    }
+}
+
+static bool tr_mp4(tr_ctx_t* c) {
+    tr_tags_t* tags = c->tags;
+    uint32_t   moov, moovEnd, s, e, s2, e2;
+    if(!tr_child(c, 0, c->fileSize, "moov", &moov, &moovEnd)) return false;
+    tags->format = TR_M4A;
+    if(tr_child(c, moov, moovEnd, "mvhd", &s, &e)) {
+        uint8_t m[32];
+        if(e - s >= 32 && tr_get(c, s, m, 32)) {
+            uint32_t scale = m[0] ? tr_be32(m + 20) : tr_be32(m + 12);    // version 1: 64 bit times
+            uint64_t dur = m[0] ? ((uint64_t)tr_be32(m + 24) << 32) | tr_be32(m + 28) : tr_be32(m + 16);
+            if(scale) tags->duration = dur * 1000 / scale;
+        }
+    }
+    if(tr_child(c, moov, moovEnd, "trak", &s, &e) && tr_child(c, s, e, "mdia", &s, &e) && tr_child(c, s, e, "mdhd", &s2, &e2)) {
+        uint8_t m[24];                  // the time scale of the audio track is its sample rate
+        if(e2 - s2 >= 24 && tr_get(c, s2, m, 24)) tags->sampleRate = m[0] ? tr_be32(m + 20) : tr_be32(m + 12);
+    }
+    if(tr_child(c, moov, moovEnd, "udta", &s, &e) && tr_child(c, s, e, "meta", &s, &e)) {
+        uint8_t v[4];
+        if(tr_get(c, s, v, 4) && !tr_be32(v)) s += 4;     // full box (version, flags), not in QuickTime files
+        if(tr_child(c, s, e, "ilst", &s2, &e2)) tr_ilst(c, s2, e2);
+    }
+    if(tr_child(c, 0, c->fileSize, "mdat", &s, &e)) tags->audioStart = s;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+// WAV: fmt, data and LIST INFO, an "id3 " chunk is read as ID3v2
+static bool tr_wav(tr_ctx_t* c) {
+    tr_tags_t* tags = c->tags;
+    uint8_t    h[16];
+    if(!tr_get(c, 0, h, 12)) return false;
+    uint32_t end = tr_le32(h + 4) + 8;
+    if(end > c->fileSize || end < 12) end = c->fileSize;
+    uint32_t byteRate = 0, dataSize = 0;
+    for(uint32_t p = 12; p + 8 <= end;) {
+        if(!tr_get(c, p, h, 8)) break;
+        uint32_t size = tr_le32(h + 4);
+        uint32_t data = p + 8;
+        if(size > end - data) size = end - data;    // streamed files: 0xFFFFFFFF
+        if(!memcmp(h, "fmt ", 4) && size >= 12 && tr_get(c, data, h, 12)) {
+            tags->sampleRate = tr_le32(h + 4);
+            byteRate = tr_le32(h + 8);
+        }
+        else if(!memcmp(h, "data", 4)) {
+            tags->audioStart = data;
+            dataSize = size;
+        }
+        else if(!memcmp(h, "LIST", 4) && size >= 4 && tr_get(c, data, h, 4) && !memcmp(h, "INFO", 4)) {
+            static const char* const ids[] = {"INAM", "IART", "IPRD", "ITRK"};
+            for(uint32_t q = data + 4; q + 8 <= data + size;) {
+                if(!tr_get(c, q, h, 8)) break;
+                uint32_t n = tr_le32(h + 4);
+                int      f = 0;
+                while(f <= TR_TRACK && memcmp(h, ids[f], 4)) f++;
+                if(f > TR_TRACK && !memcmp(h, "IPRT", 4)) f = TR_TRACK;
+                uint8_t  t[TR_TEXT_LEN];
+                uint32_t k = (n < sizeof(t)) ? n : sizeof(t);
+                if(f <= TR_TRACK && k && tr_get(c, q + 8, t, k)) {
+                    char s[TR_TEXT_LEN];
+                    tr_text8(s, sizeof(s), t, k);
+                    tr_set(tags, f, s);
+                }
+                q += 8 + n + (n & 1);
+            }
+        }
+        else if(!memcmp(h, "id3 ", 4) || !memcmp(h, "ID3 ", 4)) {
+            tr_id3v2(c, data);
+        }
+        p = data + size + (size & 1);
+    }
+    tags->format = TR_WAV;
+    if(byteRate) {
+        tags->duration = (uint64_t)dataSize * 1000 / byteRate;
+        tags->bitRate = byteRate * 8;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool TR_read(tr_tags_t* tags, uint32_t fileSize, tr_read_t read, void* user) {
+    memset(tags, 0, sizeof(tr_tags_t));
+    tr_ctx_t* c = (tr_ctx_t*)calloc(1, sizeof(tr_ctx_t));     // the window is not on the stack of the caller
+    if(!c) return false;
+    c->read = read;
+    c->user = user;
+    c->fileSize = fileSize;
+    c->tags = tags;
+
+    uint32_t pos = 0, n;
+    bool     tagged = false;
+    while((n = tr_id3v2(c, pos)) != 0 && pos + n < fileSize) {   // more than one tag happens
+        pos += n;
+        tagged = true;
+    }
+    tags->audioStart = pos;
+    uint8_t m[12];
+    bool    known = false;
+    if(tr_get(c, pos, m, 12)) {
+        if(!memcmp(m, "fLaC", 4)) known = tr_flac(c, pos);
+        else if(pos == 0 && !memcmp(m + 4, "ftyp", 4)) known = tr_mp4(c);
+        else if(pos == 0 && !memcmp(m, "RIFF", 4) && !memcmp(m + 8, "WAVE", 4)) known = tr_wav(c);
+        else {
+            bool id3v1 = tr_id3v1(c);
+            tagged |= id3v1;
+            known = tr_mpeg(c, pos, id3v1);
+        }
+    }
+    if(tags->duration && !tags->bitRate && fileSize > tags->audioStart) {
+        tags->bitRate = (uint64_t)(fileSize - tags->audioStart) * 8000 / tags->duration;
+    }
+    free(c);
+    return known || tagged;
+}
@@ -0,0 +1,57 @@
+/*
+ * tag_reader.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  title, artist, album, track number and duration of a file without decoding it, for a library scan
+ *  ID3v2.2/2.3/2.4 and ID3v1, FLAC STREAMINFO + VORBIS_COMMENT, MP4 mvhd + ilst, WAV fmt/data + LIST INFO,
+ *  MP3 duration from the Xing/Info or VBRI header, else from the bitrate of the first frame (CBR)
+ *  the file is read through a callback in small targeted reads (a window of TR_WINDOW bytes), pictures and
+ *  the audio data are skipped, a typical file needs 2...6 reads
+ *  no Arduino dependencies, builds on a Linux host
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TR_TEXT_LEN 128             // bytes of a text field incl. the terminating zero, UTF-8
+#define TR_WINDOW   512             // bytes per read
+#define TR_MAX_READS 64             // a broken file can't keep the reader busy
+
+enum : uint8_t {TR_UNKNOWN = 0, TR_MP3, TR_AAC, TR_M4A, TR_FLAC, TR_WAV};
+
+// reads len bytes at pos of the file into dst, returns the bytes read (less at the end of the file), < 0: error
+typedef int32_t (*tr_read_t)(void* user, uint32_t pos, uint8_t* dst, uint32_t len);
+
+typedef struct _tr_tags{
+    char     title[TR_TEXT_LEN];    // "": not in the file
+    char     artist[TR_TEXT_LEN];
+    char     album[TR_TEXT_LEN];
+    uint16_t trackNo;               // 0: unknown
+    uint8_t  format;                // TR_MP3 ...
+    uint32_t duration;              // ms, 0: unknown
+    uint32_t sampleRate;
+    uint32_t bitRate;               // average, bit/s
+    uint32_t audioStart;            // file offset of the first audio frame (behind ID3v2 tags)
+    uint16_t reads;                 // calls of the read function
+} tr_tags_t;
+
+typedef struct _tr_frame{
+    uint32_t sampleRate;
+    uint16_t bitRate;               // kbit/s
+    uint16_t samples;               // per frame
+    uint32_t length;                // bytes
+    uint8_t  sideInfo;              // bytes behind the header (layer III)
+    uint8_t  version;               // 3: MPEG1, 2: MPEG2, 0: MPEG2.5
+    uint8_t  layer;
+} tr_frame_t;
+
+// false: no known container and no tag found, tags holds what was found anyway
+bool TR_read(tr_tags_t* tags, uint32_t fileSize, tr_read_t read, void* user);
+
+// ID3 text to UTF-8: encoding 0 ISO-8859-1, 1 UTF-16 with BOM, 2 UTF-16BE, 3 UTF-8, returns the length
+size_t TR_text(char* dst, size_t dstLen, const uint8_t* src, size_t len, uint8_t encoding);
+
+// MPEG audio frame header (4 bytes), false: no sync word, reserved values or free format
+bool TR_frameHeader(const uint8_t* h, tr_frame_t* f);
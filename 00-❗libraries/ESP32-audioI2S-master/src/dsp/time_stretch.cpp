@@ -0,0 +1,144 @@
+/*
+ * time_stretch.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "time_stretch.h"
+#include <string.h>
+#include <math.h>
+
+#define TS_CAP_MAX ((TS_MAX_RATE * (TS_SEGMENT_MS + TS_SEARCH_MS)) / 1000)
+#define TS_OV_MAX  ((TS_MAX_RATE * TS_OVERLAP_MS) / 1000)
+
+//----------------------------------------------------------------------------------------------------------------------
+size_t TS_bufSize() {
+    return (size_t)(TS_CAP_MAX + TS_OV_MAX) * 2 * sizeof(int16_t);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void TS_init(ts_t* ts, int16_t* buf, uint32_t rate) {
+    if(rate > TS_MAX_RATE) rate = TS_MAX_RATE;
+    if(rate < 8000) rate = 8000;
+    ts->buf = buf;
+    ts->mid = buf + 2 * TS_CAP_MAX;
+    ts->seg = rate * TS_SEGMENT_MS / 1000;
+    ts->ov = rate * TS_OVERLAP_MS / 1000;
+    ts->sr = rate * TS_SEARCH_MS / 1000;
+    ts->cap = ts->seg + ts->sr;
+    ts->speedQ16 = 65536;
+    ts->adv = (uint32_t)(ts->seg - ts->ov) << 16;
+    TS_reset(ts);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void TS_reset(ts_t* ts) {
+    ts->fill = 0;
+    ts->start = 0;
+    ts->pos = ts->seg - ts->ov; // no segment, search the first one
+    ts->next = 0;
+    ts->frac = 0;
+    ts->drop = 0;
+    ts->primed = false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void TS_setSpeed(ts_t* ts, uint32_t speedQ16) {
+    if(!speedQ16 || speedQ16 == ts->speedQ16) return;
+    if(speedQ16 == 65536 || ts->speedQ16 == 65536) TS_reset(ts); // from or to copying, the buffered input is dropped
+    ts->speedQ16 = speedQ16;
+    ts->adv = (ts->seg - ts->ov) * speedQ16;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static float ts_score(const ts_t* ts, uint16_t k, uint8_t step) {
+    // normalized cross correlation of the mono sums, |a * b| >> 8 < 2^22, ov <= 384: no overflow
+    const int16_t* x = ts->buf + 2 * k;
+    const int16_t* m = ts->mid;
+    int32_t        corr = 0, norm = 0;
+    for(uint16_t t = 0; t < ts->ov; t += step) {
+        int32_t a = (x[2 * t] + x[2 * t + 1]) >> 1;
+        int32_t b = (m[2 * t] + m[2 * t + 1]) >> 1;
+        corr += (a * b) >> 8;
+        norm += (a * a) >> 8;
+    }
+    return (float)corr / sqrtf((float)norm + 1);
+}
+
+static uint16_t ts_search(const ts_t* ts) {
+    // every 4th offset on every 2nd frame, then the neighbours of the best one on every frame
+    uint16_t best = 0;
+    float    top = -1e30f;
+    for(uint16_t k = 0; k < ts->sr; k += 4) {
+        float s = ts_score(ts, k, 2);
+        if(s > top) { top = s; best = k; }
+    }
+    uint16_t lo = (best > 3) ? best - 3 : 0;
+    uint16_t hi = (best + 3 < ts->sr) ? best + 3 : ts->sr - 1;
+    top = -1e30f;
+    for(uint16_t k = lo; k <= hi; k++) {
+        float s = ts_score(ts, k, 1);
+        if(s > top) { top = s; best = k; }
+    }
+    return best;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t TS_process(ts_t* ts, const int16_t* in, uint16_t inFrames, uint16_t* consumed, int16_t* out, uint16_t maxOut) {
+    uint16_t i = 0, o = 0;
+
+    if(ts->speedQ16 == 65536) { // copy
+        uint16_t n = (inFrames < maxOut) ? inFrames : maxOut;
+        memcpy(out, in, n * 2 * sizeof(int16_t));
+        *consumed = n;
+        return n;
+    }
+
+    const uint16_t body = ts->seg - ts->ov; // frames written per segment, its last ov frames go to mid
+    while(o < maxOut) {
+        if(ts->pos < body) {
+            uint16_t       n = (body - ts->pos < maxOut - o) ? body - ts->pos : maxOut - o;
+            const int16_t* s = ts->buf + 2 * ts->start;
+            uint16_t       k = ts->pos, end = ts->pos + n;
+            for(; k < end && k < ts->ov; k++, o++) { // crossfade, the last segment fades out
+                int32_t w = ((int32_t)k << 15) / ts->ov;
+                out[2 * o]     = (ts->mid[2 * k]     * (32768 - w) + s[2 * k]     * w) >> 15;
+                out[2 * o + 1] = (ts->mid[2 * k + 1] * (32768 - w) + s[2 * k + 1] * w) >> 15;
+            }
+            memcpy(out + 2 * o, s + 2 * k, (end - k) * 2 * sizeof(int16_t));
+            o += end - k;
+            ts->pos = end;
+            if(ts->pos == body) {
+                memcpy(ts->mid, s + 2 * body, ts->ov * 2 * sizeof(int16_t));
+                ts->primed = true;
+            }
+            continue;
+        }
+        // the next segment, buf must hold search range + segment frames from the nominal start
+        if(ts->next > ts->fill) {
+            ts->drop += ts->next - ts->fill;
+            ts->next = ts->fill;
+        }
+        if(ts->next) {
+            ts->fill -= ts->next;
+            memmove(ts->buf, ts->buf + 2 * ts->next, ts->fill * 2 * sizeof(int16_t));
+            ts->next = 0;
+        }
+        if(ts->drop) {
+            uint32_t n = (ts->drop < (uint32_t)(inFrames - i)) ? ts->drop : inFrames - i;
+            i += n;
+            ts->drop -= n;
+            if(ts->drop) break;
+        }
+        uint16_t n = (ts->cap - ts->fill < inFrames - i) ? ts->cap - ts->fill : inFrames - i;
+        memcpy(ts->buf + 2 * ts->fill, in + 2 * i, n * 2 * sizeof(int16_t));
+        ts->fill += n;
+        i += n;
+        if(ts->fill < ts->cap) break;
+        if(ts->primed) ts->start = ts_search(ts);
+        else { // first segment, nothing to continue: the crossfade with itself is a copy
+            ts->start = 0;
+            memcpy(ts->mid, ts->buf, ts->ov * 2 * sizeof(int16_t));
+        }
+        ts->pos = 0;
+        uint32_t a = ts->frac + ts->adv;
+        ts->next = a >> 16;
+        ts->frac = a & 0xffff;
+    }
+    *consumed = i;
+    return o;
+}
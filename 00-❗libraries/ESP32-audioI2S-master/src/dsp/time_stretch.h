@@ -0,0 +1,48 @@
+/*
+ * time_stretch.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  WSOLA time stretching, the speed changes and the pitch stays, interleaved stereo int16 in and out
+ *  segments of TS_SEGMENT_MS are copied from the input with a nominal advance of (segment - overlap) * speed,
+ *  every segment starts at the offset within TS_SEARCH_MS where it continues the last one best (cross correlation
+ *  of the mono sum, coarse search on every 4th offset, then refined) and is crossfaded over TS_OVERLAP_MS
+ *  no Arduino dependencies, builds on a Linux host
+ *
+ *  the windows are sized for the input rate, above 48 kHz for 48 kHz (shorter in ms), the caller owns the buffer
+ *  at the end of a stream the last segment and the search range (~50 ms) are not played
+ */
+#pragma once
+#pragma GCC optimize ("O3")
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TS_SEGMENT_MS   40
+#define TS_OVERLAP_MS    8
+#define TS_SEARCH_MS    12
+#define TS_MAX_RATE  48000
+
+typedef struct _ts{
+    int16_t* buf;       // input frames L/R, followed by the overlap tail, TS_bufSize() bytes, owned by the caller
+    int16_t* mid;       // the end of the last segment, crossfaded with the start of the next one
+    uint16_t seg;       // frames of a segment
+    uint16_t ov;        // frames of the overlap
+    uint16_t sr;        // frames of the search range
+    uint16_t cap;       // frames in buf
+    uint16_t fill;      // frames read into buf
+    uint16_t start;     // first frame of the current segment in buf
+    uint16_t pos;       // frames of the current segment written, seg - ov: the next segment is searched
+    uint32_t next;      // nominal start of the next segment in buf
+    uint32_t adv;       // nominal advance per segment, Q16 frames
+    uint32_t frac;
+    uint32_t drop;      // input frames to skip, the advance was larger than the input in buf
+    uint32_t speedQ16;
+    bool     primed;    // mid holds the end of a segment
+} ts_t;
+
+size_t   TS_bufSize();
+void     TS_init(ts_t* ts, int16_t* buf, uint32_t rate);
+void     TS_reset(ts_t* ts);
+void     TS_setSpeed(ts_t* ts, uint32_t speedQ16);       // 1.0 = 65536, copies the input
+uint16_t TS_process(ts_t* ts, const int16_t* in, uint16_t inFrames, uint16_t* consumed, int16_t* out, uint16_t maxOut);
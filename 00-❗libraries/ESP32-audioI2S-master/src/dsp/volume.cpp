@@ -0,0 +1,102 @@
+/*
+ * volume.cpp
+ *
+ *  Created on: Oct 17.2026
+ */
+#include "volume.h"
+#include <math.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+void VOL_buildTable(uint16_t* table, uint16_t steps, uint8_t curve) {
+    // the former computeLimit() curves: square v = (vol / steps)^2, logarithmic v = vol * steps^((vol - 1) / (steps - 1)) / steps^2
+    if(steps < 1) steps = 1;
+    if(steps > VOL_MAX_STEPS) steps = VOL_MAX_STEPS;
+    for(uint16_t vol = 0; vol <= steps; vol++) {
+        double v;
+        if(curve == VOL_CURVE_LOG) {
+            if(vol == 0) v = 0;
+            else if(steps == 1) v = 1;
+            else v = vol * exp((vol - 1) * log((double)steps) / (steps - 1)) / steps / steps;
+        }
+        else v = (double)vol * vol / ((double)steps * steps);
+        table[vol] = (uint16_t)lround(v * VOL_UNITY_Q15);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void VOL_setRamp(vol_ramp_t* r, uint32_t rate, uint16_t ms, uint8_t shape) {
+    r->frames = (uint32_t)ms * rate / 1000;
+    if(r->frames < 1) r->frames = 1;
+    r->shape = shape;
+    // exponential: time constant ms / 5, 99 % of the way after ms
+    double k = 1.0 - exp(-5.0 / r->frames);
+    r->coef = (uint32_t)(k * (1 << 30));
+    VOL_setTarget(r, r->target[0], r->target[1]);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void VOL_setTarget(vol_ramp_t* r, int32_t left, int32_t right) {
+    r->target[0] = left;
+    r->target[1] = right;
+    for(uint8_t ch = 0; ch < 2; ch++) { // rounded away from zero, the target is reached within r->frames
+        int32_t d = r->target[ch] - r->cur[ch];
+        int32_t n = (int32_t)r->frames;
+        r->step[ch] = (d >= 0) ? (d + n - 1) / n : (d - n + 1) / n;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void VOL_jump(vol_ramp_t* r) {
+    r->cur[0] = r->target[0];
+    r->cur[1] = r->target[1];
+    r->step[0] = r->step[1] = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static inline void vol_next(vol_ramp_t* r, uint8_t ch) {
+    int32_t d = r->target[ch] - r->cur[ch];
+    if(!d) return;
+    if(r->shape == VOL_RAMP_EXP) {
+        int32_t s = (int32_t)(((int64_t)d * r->coef) >> 30);
+        if(!s) s = (d > 0) ? 1 : -1; // the last few LSB
+        r->cur[ch] += s;
+        return;
+    }
+    if((d > 0) ? (r->step[ch] >= d) : (r->step[ch] <= d)) r->cur[ch] = r->target[ch];
+    else r->cur[ch] += r->step[ch];
+}
+
+void VOL_process16(vol_ramp_t* r, int16_t* buff, uint16_t frames) {
+    if(r->cur[0] == r->target[0] && r->cur[1] == r->target[1]) { // constant gain
+        int32_t gl = r->cur[0], gr = r->cur[1];
+        if(gl == VOL_UNITY_Q16 && gr == VOL_UNITY_Q16) return;
+        for(uint16_t i = 0; i < frames * 2; i += 2) {
+            int32_t l = ((int64_t)buff[i] * gl) >> 16;
+            int32_t rr = ((int64_t)buff[i + 1] * gr) >> 16;
+            buff[i] = (l > 32767) ? 32767 : (l < -32768) ? -32768 : l;
+            buff[i + 1] = (rr > 32767) ? 32767 : (rr < -32768) ? -32768 : rr;
+        }
+        return;
+    }
+    for(uint16_t i = 0; i < frames * 2; i += 2) {
+        vol_next(r, 0);
+        vol_next(r, 1);
+        int32_t l = ((int64_t)buff[i] * r->cur[0]) >> 16;
+        int32_t rr = ((int64_t)buff[i + 1] * r->cur[1]) >> 16;
+        buff[i] = (l > 32767) ? 32767 : (l < -32768) ? -32768 : l;
+        buff[i + 1] = (rr > 32767) ? 32767 : (rr < -32768) ? -32768 : rr;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void VOL_process32(vol_ramp_t* r, int32_t* buff, uint16_t frames) {
+    if(r->cur[0] == r->target[0] && r->cur[1] == r->target[1]) {
+        int32_t gl = r->cur[0], gr = r->cur[1];
+        for(uint16_t i = 0; i < frames * 2; i += 2) {
+            buff[i] = ((int64_t)buff[i] * gl) >> 16;
+            buff[i + 1] = ((int64_t)buff[i + 1] * gr) >> 16;
+        }
+        return;
+    }
+    for(uint16_t i = 0; i < frames * 2; i += 2) {
+        vol_next(r, 0);
+        vol_next(r, 1);
+        buff[i] = ((int64_t)buff[i] * r->cur[0]) >> 16;
+        buff[i + 1] = ((int64_t)buff[i + 1] * r->cur[1]) >> 16;
+    }
+}
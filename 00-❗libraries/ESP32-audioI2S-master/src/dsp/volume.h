@@ -0,0 +1,38 @@
+/*
+ * volume.h
+ *
+ *  Created on: Oct 17.2026
+ *
+ *  volume without FPU work in the setter: precomputed Q15 tables for both curves (up to 256 steps), integer balance
+ *  the output stage ramps the per channel gain (Q16, may exceed 1.0 in front of the limiter) to a new target,
+ *  linear over a fixed time or exponential (one pole), so a volume knob that changes every few ms causes no zipper
+ *  no Arduino dependencies, builds on a Linux host
+ */
+#pragma once
+#pragma GCC optimize ("O3")
+
+#include <stdint.h>
+
+#define VOL_MAX_STEPS   256
+#define VOL_UNITY_Q15   32768
+#define VOL_UNITY_Q16   65536
+
+enum : uint8_t { VOL_CURVE_SQUARE = 0, VOL_CURVE_LOG = 1 };
+enum : uint8_t { VOL_RAMP_LINEAR = 0, VOL_RAMP_EXP = 1 };
+
+typedef struct _vol_ramp{
+    int32_t  cur[2];            // [LEFT/RIGHT] applied gain, Q16
+    int32_t  target[2];
+    int32_t  step[2];           // linear: per frame
+    uint32_t frames;            // ramp length
+    uint32_t coef;              // exponential: per frame, Q30
+    uint8_t  shape;
+} vol_ramp_t;
+
+void    VOL_buildTable(uint16_t* table, uint16_t steps, uint8_t curve);     // steps + 1 gains, Q15
+inline uint16_t VOL_balance(int8_t bal) { return (16 - (bal < 0 ? -bal : bal)) << 11; } // -16 ... 16, Q15, 1.0 at 0
+void    VOL_setRamp(vol_ramp_t* r, uint32_t rate, uint16_t ms, uint8_t shape);
+void    VOL_setTarget(vol_ramp_t* r, int32_t left, int32_t right);          // Q16, between two blocks
+void    VOL_jump(vol_ramp_t* r);                                             // cur = target
+void    VOL_process16(vol_ramp_t* r, int16_t* buff, uint16_t frames);        // in place, saturated
+void    VOL_process32(vol_ramp_t* r, int32_t* buff, uint16_t frames);        // in place, 16 bit scale, not saturated
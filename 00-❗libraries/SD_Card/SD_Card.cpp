@@ -1,7 +1,11 @@
 #include "SD_Card.h"
+#include "FSImpl.h"
 
 bool SDCard_Flag = false;
 bool SDCard_Finish = false;
+static bool SDCard_Sleep = false;
+static uint32_t SDCard_Users = 0;            // SD_Acquire() calls and open files of SD_FS()
+static SemaphoreHandle_t SDCard_Mutex = NULL;
 
 uint16_t SDCard_Size = 0;
 uint16_t Flash_Size = 0;
@@ -20,6 +24,7 @@ esp_err_t SD_Init() {
   // Initialize flags to a safe state
   SDCard_Flag = false;
   SDCard_Finish = false;
+  if (!SDCard_Mutex) SDCard_Mutex = xSemaphoreCreateMutex();
   
   // SD MMC
   if(!SD_MMC.setPins(SD_CLK_PIN, SD_CMD_PIN, SD_D0_PIN, -1, -1, -1)){
@@ -35,7 +40,7 @@ esp_err_t SD_Init() {
   bool sd_initialized = false;
   
   while (retry_count < 3 && !sd_initialized) {
-    sd_initialized = SD_MMC.begin("/sdcard", true, true);
+    sd_initialized = SD_MMC.begin(SD_MOUNT_POINT, true, true);
     if (!sd_initialized) {
       printf("SD init attempt %d failed, retrying...\r\n", retry_count + 1);
       vTaskDelay(pdMS_TO_TICKS(100)); // Wait before retry
@@ -86,14 +91,168 @@ esp_err_t SD_Init() {
 }
 
 bool SD_IsAvailable() {
-  return SDCard_Flag && SD_MMC.cardType() != CARD_NONE;
+  return SDCard_Flag && (SDCard_Sleep || SD_MMC.cardType() != CARD_NONE);
 }
 
 void SD_End() {
   if (SDCard_Flag) {
-    SD_MMC.end();
+    if (!SDCard_Sleep) SD_MMC.end();
     SDCard_Flag = false;
+    SDCard_Sleep = false;
+  }
+}
+
+// Mount the card again after SD_Sleep() (SDCard_Mutex taken)
+static bool SD_Wake() {
+  if (SDCard_Flag && SDCard_Sleep) {
+    SD_D3_EN();
+    bool mounted = false;
+    for (int retry = 0; retry < 3 && !mounted; retry++) {
+      mounted = SD_MMC.begin(SD_MOUNT_POINT, true, true);
+      if (!mounted) vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (mounted) {
+      SDCard_Sleep = false;
+    } else {
+      printf("SD card wake up failed!\r\n");
+      SD_D3_Dis();
+    }
+  }
+  return SDCard_Flag && !SDCard_Sleep;
+}
+
+bool SD_Acquire() {
+  if (!SDCard_Mutex) return false;
+  xSemaphoreTake(SDCard_Mutex, portMAX_DELAY);
+  bool awake = SD_Wake();
+  if (awake) SDCard_Users++;
+  xSemaphoreGive(SDCard_Mutex);
+  return awake;
+}
+
+bool SD_AcquireAwake() {
+  if (!SDCard_Mutex) return false;
+  xSemaphoreTake(SDCard_Mutex, portMAX_DELAY);
+  bool awake = SDCard_Flag && !SDCard_Sleep;
+  if (awake) SDCard_Users++;
+  xSemaphoreGive(SDCard_Mutex);
+  return awake;
+}
+
+void SD_Release() {
+  if (!SDCard_Mutex) return;
+  xSemaphoreTake(SDCard_Mutex, portMAX_DELAY);
+  if (SDCard_Users) SDCard_Users--;
+  xSemaphoreGive(SDCard_Mutex);
+}
+
+bool SD_Sleep() {
+  if (!SDCard_Mutex) return false;
+  xSemaphoreTake(SDCard_Mutex, portMAX_DELAY);
+  if (SDCard_Flag && !SDCard_Sleep && SDCard_Users == 0) {
+    SD_MMC.end();
+    SD_D3_Dis();
+    SDCard_Sleep = true;
+  }
+  bool asleep = SDCard_Sleep;
+  xSemaphoreGive(SDCard_Mutex);
+  return asleep;
+}
+
+bool SD_IsSleeping() {
+  return SDCard_Sleep;
+}
+
+// A file of SD_MMC that holds the card from open to close
+class CardFileImpl : public fs::FileImpl {
+public:
+  CardFileImpl(File f) : _f(f), _open(true) {}    // SD_Acquire() was called for it
+  ~CardFileImpl() { close(); }
+  size_t write(const uint8_t* buf, size_t size) { return _f.write(buf, size); }
+  size_t read(uint8_t* buf, size_t size) { return _f.read(buf, size); }
+  void flush() { _f.flush(); }
+  bool seek(uint32_t pos, fs::SeekMode mode) { return _f.seek(pos, mode); }
+  size_t position() const { return _f.position(); }
+  size_t size() const { return _f.size(); }
+  bool setBufferSize(size_t size) { return _f.setBufferSize(size); }
+  void close() {
+    if (!_open) return;
+    _f.close();
+    _open = false;
+    SD_Release();
+  }
+  time_t getLastWrite() { return _f.getLastWrite(); }
+  const char* path() const { return _f.path(); }
+  const char* name() const { return _f.name(); }
+  boolean isDirectory(void) { return _f.isDirectory(); }
+  fs::FileImplPtr openNextFile(const char* mode);
+  boolean seekDir(long position) { return _f.seekDir(position); }
+  String getNextFileName(void) { return _f.getNextFileName(); }
+  String getNextFileName(bool* isDir) { return _f.getNextFileName(isDir); }
+  void rewindDirectory(void) { _f.rewindDirectory(); }
+  operator bool() { return _open && _f; }
+
+private:
+  File _f;
+  bool _open;
+};
+
+// The file of an SD_Acquire() call, the card is released again if it did not open
+static fs::FileImplPtr cardFile(File f) {
+  if (!f) {
+    SD_Release();
+    return fs::FileImplPtr();
   }
+  return std::make_shared<CardFileImpl>(f);
+}
+
+fs::FileImplPtr CardFileImpl::openNextFile(const char* mode) {
+  if (!SD_Acquire()) return fs::FileImplPtr();
+  return cardFile(_f.openNextFile(mode));
+}
+
+class CardFSImpl : public fs::FSImpl {
+public:
+  fs::FileImplPtr open(const char* path, const char* mode, const bool create) {
+    if (!SD_Acquire()) return fs::FileImplPtr();
+    return cardFile(SD_MMC.open(path, mode, create));
+  }
+  bool exists(const char* path) {
+    if (!SD_Acquire()) return false;
+    bool ret = SD_MMC.exists(path);
+    SD_Release();
+    return ret;
+  }
+  bool rename(const char* pathFrom, const char* pathTo) {
+    if (!SD_Acquire()) return false;
+    bool ret = SD_MMC.rename(pathFrom, pathTo);
+    SD_Release();
+    return ret;
+  }
+  bool remove(const char* path) {
+    if (!SD_Acquire()) return false;
+    bool ret = SD_MMC.remove(path);
+    SD_Release();
+    return ret;
+  }
+  bool mkdir(const char* path) {
+    if (!SD_Acquire()) return false;
+    bool ret = SD_MMC.mkdir(path);
+    SD_Release();
+    return ret;
+  }
+  bool rmdir(const char* path) {
+    if (!SD_Acquire()) return false;
+    bool ret = SD_MMC.rmdir(path);
+    SD_Release();
+    return ret;
+  }
+};
+
+static fs::FS cardFS(fs::FSImplPtr(new CardFSImpl()));
+
+fs::FS& SD_FS() {
+  return cardFS;
 }
 
 bool File_Search(const char* directory, const char* fileName) {
@@ -103,31 +262,18 @@ bool File_Search(const char* directory, const char* fileName) {
     return false;
   }
   
-  File Path = SD_MMC.open(directory);
-  if (!Path) {
-    printf("Path: <%s> does not exist\r\n", directory);
-    return false;
-  }
-  
-  File file = Path.openNextFile();
-  while (file) {
-    if (strcmp(file.name(), fileName) == 0) {
-      if (strcmp(directory, "/") == 0)
-        printf("File '%s%s' found in root directory.\r\n", directory, fileName);
-      else
-        printf("File '%s/%s' found in root directory.\r\n", directory, fileName);
-      Path.close();
-      return true;
-    }
-    file = Path.openNextFile();
-  }
-  
+  // One lookup of the path, the directory is not listed entry by entry
+  char filePath[256];
   if (strcmp(directory, "/") == 0)
-    printf("File '%s%s' not found in root directory.\r\n", directory, fileName);
+    snprintf(filePath, sizeof(filePath), "%s%s", directory, fileName);
   else
-    printf("File '%s/%s' not found in root directory.\r\n", directory, fileName);
+    snprintf(filePath, sizeof(filePath), "%s/%s", directory, fileName);
   
-  Path.close();
+  if (SD_FS().exists(filePath)) {
+    printf("File '%s' found.\r\n", filePath);
+    return true;
+  }
+  printf("File '%s' not found.\r\n", filePath);
   return false;
 }
 
@@ -138,7 +284,7 @@ uint16_t Folder_retrieval(const char* directory, const char* fileExtension, char
     return 0;
   }
   
-  File Path = SD_MMC.open(directory);
+  File Path = SD_FS().open(directory);
   if (!Path) {
     printf("Path: <%s> does not exist\r\n", directory);
     return 0;
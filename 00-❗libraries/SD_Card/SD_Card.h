@@ -10,6 +10,7 @@
 #define SD_CLK_PIN      14
 #define SD_CMD_PIN      17 
 #define SD_D0_PIN       16 
+#define SD_MOUNT_POINT  "/sdcard"   // SD_MMC files are also reachable with POSIX calls below this path
 
 extern bool SDCard_Flag;
 extern bool SDCard_Finish;
@@ -25,10 +26,29 @@ bool SD_IsAvailable();
 // End SD card operations and release resources
 void SD_End();
 
+// SD_MMC with a use count: every file opened through it holds the card awake until it is closed,
+// exists(), remove()... wake the card for the call. Open files through this, not through SD_MMC.
+fs::FS& SD_FS();
+
+// Hold the card (mounted again if it sleeps) for accesses outside SD_FS() (POSIX calls below SD_MOUNT_POINT),
+// false: not available, nothing to release
+bool SD_Acquire();
+
+// Hold the card only if it is awake (background work does not wake it), false: asleep or not available
+bool SD_AcquireAwake();
+
+void SD_Release();
+
+// Unmount the card and pull D3 low if nobody holds it (call from one task), true: it sleeps now.
+// The card stays available, SD_Acquire() and the next open mount it again.
+bool SD_Sleep();
+
+bool SD_IsSleeping();
+
 // Flash memory test function
 void Flash_test();
 
-// Search for a specific file in a directory
+// Check if a file exists in a directory (one path lookup)
 bool File_Search(const char* directory, const char* fileName);
 
 // Retrieve files with specific extension from a directory
@@ -646,8 +646,9 @@
 #define LV_USE_BMP 0
 
 /* JPG + split JPG decoder library.
- * Split JPG is a custom format optimized for embedded systems. */
-#define LV_USE_SJPG 0
+ * Split JPG is a custom format optimized for embedded systems.
+ * Its tjpgd decodes the cover art of the player (CoverArt.cpp). */
+#define LV_USE_SJPG 1
 
 /*GIF decoder library*/
 #define LV_USE_GIF 0
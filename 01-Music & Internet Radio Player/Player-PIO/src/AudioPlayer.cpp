@@ -1,20 +1,115 @@
 #include "AudioPlayer.h"
 #include "Audio_PCM5101.h"
 #include "SD_Card.h"
+#include "TrackCache.h"
+#include "MediaLibrary.h"
+#include "SeekIndex.h"
+#include "CoverArt.h"
+#include "Playlist.h"
+#include "Shuffle.h"
+#include <Preferences.h>
 #include "WiFiManager.h"
 
 // Audio player state
 static PlayerMode currentMode = MODE_MUSIC_PLAYER;
 static int currentTrackIndex = 0;
+
+// A place in the play order (Playlist: the library order or a playlist file), the position and the shuffle
+// cycle, every cycle has its own order
+typedef struct {
+    uint32_t pos;
+    uint32_t cycle;
+} play_pos_t;
+static play_pos_t currentAt = {0, 0};
 static int currentStationIndex = 0;
 static bool isPlaying = false;
-static char mp3FileList[MAX_MP3_FILES][64]; // Reduced buffer size
-static int mp3FileCount = 0;
+static int mp3FileCount = 0; // tracks in the library index (MediaLibrary), nothing else is kept in RAM
+static char currentPath[MEDIA_PATH_LEN]; // finds the current track again after a rescan
+static volatile uint32_t libraryVersion = 0;
+static volatile bool libraryChanged = false; // set by the scan task, applied in the audio task
+static void libraryRescanned(bool changed);
+static void libraryTagged(uint32_t tagged);
+static void queueNextTrack();
+static void relinkPlayOrder();
+static void loadShuffle();
+static void applySeekIndex(bool build);
 static uint32_t lastPlaybackUpdate = 0;
 static TaskHandle_t audioTaskHandle = NULL;
 
+// Gapless playback: the following track is opened while the current one plays, only the audio task opens it
+// and sets these (the end of file callback reads them in the same task)
+static int nextTrackIndex = -1;
+static play_pos_t nextAt = {0, 0};
+static char nextPath[MEDIA_PATH_LEN];
+static bool gaplessSwitched = false;
+
+// Tracks played from the PSRAM copy (TrackCache), the SD card sleeps while both come from there
+static bool currentFromCache = false;
+static bool nextFromCache = false;
+
+// The track to open as the next one, chosen in the UI or audio task and copied to PSRAM by the copy task first,
+// these are set under stateMutex, nextReady tells the audio task to open it (or to drop the next file)
+static int stagingTrackIndex = -1;
+static play_pos_t stagingAt = {0, 0};
+static volatile bool nextReady = false;
+static int readyTrackIndex = -1;
+static play_pos_t readyAt = {0, 0};
+static char readyPath[MEDIA_PATH_LEN];
+static bool readyFromCache = false;
+
+// Shuffle (Shuffle.h), mode, seed and cycle are kept in NVS, the order is the same after a restart (the cycle
+// of the current track is part of the session, the session task writes it)
+static ShuffleMode shuffleMode = SHUFFLE_OFF;
+static uint32_t shuffleSeed = 0;
+
+// Resume: the track that was stopped (or of the saved session) and its position, it plays on from there
+static char resumePath[MEDIA_PATH_LEN];
+static uint32_t resumeFilePos = 0;
+static uint32_t resumeFileSize = 0;
+
+// Decoder position in the playing track for the session, the audio task updates it about once a second
+static volatile uint32_t playFilePos = 0;
+static volatile uint32_t playFileSize = 0;
+
+// The current track (path, index, play order position) changes in the audio task at a gapless switch and in the
+// UI task, other tasks copy it under this lock, it is only held to copy (never for a file access)
+static SemaphoreHandle_t stateMutex = NULL;
+
+static void lockState() {
+    if (stateMutex) xSemaphoreTake(stateMutex, portMAX_DELAY);
+}
+
+static void unlockState() {
+    if (stateMutex) xSemaphoreGive(stateMutex);
+}
+
+static void copyCurrentPath(char* path, size_t len) {
+    lockState();
+    strlcpy(path, currentPath, len);
+    unlockState();
+}
+
 // Volume setting
-static uint8_t currentVolume = 10; // Added this variable definition
+static uint8_t currentVolume = 48; // of AUDIO_VOLUME_STEPS
+
+// Built-in equalizer curves, tuned for the PCM5101 and the small onboard speaker
+static const char defaultEqPresets[] =
+    "[Flat]\n"
+    "[PCM5101 Warm] -3\n"
+    "lowshelf   120 0.71  3.0\n"
+    "peak      3200 1.20 -1.5\n"
+    "highshelf 9000 0.71  1.5\n"
+    "[Bass Boost] -6\n"
+    "lowshelf    90 0.71  6.0\n"
+    "peak       250 1.00  1.5\n"
+    "[Voice] -3\n"
+    "lowshelf   150 0.71 -4.0\n"
+    "peak      2500 0.90  3.0\n"
+    "highshelf 8000 0.71 -2.0\n"
+    "[Small Speaker] -6\n"
+    "lowshelf   100 0.71 -6.0\n"
+    "peak       400 1.20  2.5\n"
+    "peak      5000 2.00 -2.0\n";
 
 // Function to free memory before audio playback
 void freeMemoryForDecoder() {
@@ -42,6 +137,7 @@ void freeMemoryForDecoder() {
 // Initialize the audio player
 bool AudioPlayer_Init() {
     Serial.println("Initializing audio player with minimal memory usage...");
+    if (!stateMutex) stateMutex = xSemaphoreCreateMutex();
     
     // Setup audio
     if (!audio.setPinout(I2S_BCLK, I2S_LRC, I2S_DOUT)) {
@@ -50,8 +146,31 @@ bool AudioPlayer_Init() {
     }
     
     // Set volume to medium
+    audio.setVolumeSteps(AUDIO_VOLUME_STEPS);
+    audio.setVolumeRamp(AUDIO_VOLUME_RAMP_MS, VOL_RAMP_LINEAR);
     audio.setVolume(currentVolume);
+
+    // Lock the DAC clock, tracks with other sample rates are resampled (no clock switch between tracks)
+    if (AUDIO_OUTPUT_RATE && !audio.setOutputRate(AUDIO_OUTPUT_RATE, RS_QUALITY_MEDIUM)) {
+        Serial.println("Resampler not available, I2S follows the stream");
+    }
+
+    // The decoder runs ahead by the crossfade length, the end of a track is mixed with the start of the next
+    if (AUDIO_CROSSFADE_SECONDS && !audio.setCrossfade(AUDIO_CROSSFADE_SECONDS, XF_EQUAL_POWER)) {
+        Serial.println("Crossfade not available, tracks are played gapless");
+    }
     
+    // Decoder and I2S output run in separate tasks, the output task (core 1) drains a PCM ring in PSRAM
+    if (AUDIO_RING_MS && !audio.startOutputTask(AUDIO_RING_MS, 1, AUDIO_OUTPUT_TASK_PRIO)) {
+        Serial.println("Output task not available, the audio task writes to I2S");
+    }
+
+    // SD card reads in their own task, FAT lookups and slow cards don't stall the decoder
+    if (AUDIO_READ_AHEAD_SECONDS && !audio.startReadAhead(AUDIO_READ_AHEAD_SECONDS, AUDIO_READ_AHEAD_CHUNK_KB, 0,
+                                                          AUDIO_READ_AHEAD_PRIO)) {
+        Serial.println("Read-ahead not available, the audio task reads the SD card");
+    }
+
     // Create dedicated audio task with smaller stack
     BaseType_t taskCreated = xTaskCreatePinnedToCore(
         AudioPlayer_Task,
@@ -68,26 +187,399 @@ bool AudioPlayer_Init() {
         return false;
     }
     
-    // Scan audio files only if SD card is available
+    // Open the library index, the folders are checked for changes in the background (all of them are
+    // read if there is no index yet), the list is updated when the scan has written a new index
     if (SD_IsAvailable()) {
-        mp3FileCount = AudioPlayer_ScanMP3Files();
+        MediaLibrary_Open(SD_FS(), MEDIA_LIBRARY_FILE);
+        mp3FileCount = MediaLibrary_Count();
         Serial.printf("Found %d valid audio files on SD card\n", mp3FileCount);
+        // Play order: the playlist file if there is one, else the library, and the queue of the journal
+        loadShuffle();
+        Playlist_Init(SD_FS(), PLAYLIST_QUEUE_FILE);
+        if (!PLAYLIST_FILE[0] || !SD_FS().exists(PLAYLIST_FILE) || !AudioPlayer_OpenPlaylist(PLAYLIST_FILE)) {
+            AudioPlayer_OpenPlaylist(NULL);
+        }
+        Serial.printf("Play order: %s, %lu entries\n", Playlist_GetPath()[0] ? Playlist_GetPath() : "library",
+                      (long unsigned int)Playlist_Length());
+        if (!MediaLibrary_RescanAsync(SD_FS(), SD_MOUNT_POINT, MEDIA_LIBRARY_ROOT, MEDIA_LIBRARY_FILE,
+                                      MEDIA_RESCAN_ENTRIES_PER_SEC, libraryRescanned)) {
+            Serial.println("Library scan not started");
+        }
+    }
+
+    // Equalizer presets: coefficients for all sample rates are computed here, not in the audio task
+    if (!SD_IsAvailable() || !audio.loadEqualizerPresets(SD_FS(), EQ_PRESET_FILE)) {
+        audio.setEqualizerPresets(defaultEqPresets);
+    }
+    Serial.printf("%d equalizer presets\n", audio.getEqualizerPresetCount());
+
+    // Limiter as the last stage, 2 ms look-ahead
+    if (!audio.setLimiter(true, AUDIO_LIMITER_CEILING_DB, 2, 80)) {
+        Serial.println("Limiter not available");
+    }
+
+    // Loudness normalization, the gain table holds the measured loudness of untagged files
+    audio.setReplayGain(REPLAYGAIN_MODE);
+    if (SD_IsAvailable() && !audio.setGainTable(SD_FS(), GAIN_TABLE_FILE)) {
+        Serial.println("Gain table not available, only tagged files are normalized");
+    }
+
+    // The current and the next track are copied to PSRAM, the SD card is only woken for the copy
+    if (TRACK_CACHE_BYTES && SD_IsAvailable() && !TrackCache_Init(TRACK_CACHE_BYTES)) {
+        Serial.println("Track cache not available, tracks are streamed from the SD card");
+    }
+
+    // Frame indexes for seeking in VBR files, the record directory is read in the background
+    if (SD_IsAvailable() && !SeekIndex_Init(SD_FS(), SEEK_INDEX_FILE, SEEK_INDEX_MAX_BYTES)) {
+        Serial.println("Seek index not available, MP3 files are seeked by their TOC or bitrate");
+    }
+
+    // Cover art, decoded in the background when a track with an embedded picture plays the first time
+    if (COVER_ART_SIZE && SD_IsAvailable() && !CoverArt_Init(SD_FS(), COVER_ART_DIR, COVER_ART_SIZE)) {
+        Serial.println("Cover art not available");
     }
     
     Serial.println("Audio player initialized successfully");
     return true;
 }
 
-// Audio task to process audio data - runs on Core 1
+// The background scan has written a new index (scan task), the track numbers have changed
+static void libraryRescanned(bool changed) {
+    // Tags of the new files (of all after the first scan) are read next
+    MediaLibrary_ReadTagsAsync(SD_FS(), MEDIA_TAG_FILES_PER_SEC, libraryTagged);
+    if (changed) {
+        libraryChanged = true; // the play state belongs to the audio task, it applies this on its next pass
+    }
+}
+
+// The new track numbers of the current and the next track (audio task)
+static void applyLibraryChange() {
+    char path[MEDIA_PATH_LEN];
+    copyCurrentPath(path, sizeof(path));
+    uint32_t track = MediaLibrary_Find(path);
+    mp3FileCount = MediaLibrary_Count();
+    if (track != UINT32_MAX) {
+        currentTrackIndex = track;
+    } else if (currentTrackIndex >= mp3FileCount) {
+        currentTrackIndex = 0;
+    }
+    if (nextTrackIndex >= 0) { // the file the library plays next, it is open already
+        uint32_t next = MediaLibrary_Find(nextPath);
+        if (next == UINT32_MAX) {
+            audio.clearNextFile();
+        }
+        nextTrackIndex = next != UINT32_MAX ? (int)next : -1;
+    }
+    relinkPlayOrder();
+    libraryVersion = libraryVersion + 1;
+    if (isPlaying && currentMode == MODE_MUSIC_PLAYER) {
+        queueNextTrack();
+    }
+}
+
+// The tag reader has written titles into the index (tag task), the track numbers are the same
+static void libraryTagged(uint32_t tagged) {
+    libraryVersion = libraryVersion + 1;
+}
+
+// One step through n items in the shuffled order of a cycle, the next cycle begins behind the last position
+static uint32_t stepShuffled(uint32_t item, uint32_t* cycle, uint32_t n, int dir) {
+    shuffle_t order;
+    Shuffle_Init(&order, n, shuffleSeed, *cycle);
+    uint32_t i = Shuffle_IndexOf(&order, item % n);
+    if (dir > 0 && ++i == n) {
+        i = 0;
+        Shuffle_Init(&order, n, shuffleSeed, ++*cycle);
+    } else if (dir < 0 && i-- == 0) {
+        i = n - 1;
+        Shuffle_Init(&order, n, shuffleSeed, --*cycle);
+    }
+    return Shuffle_At(&order, i);
+}
+
+static int placeTrack(play_pos_t* at, uint32_t track) {
+    uint32_t pos = Playlist_Locate(track, at->pos);
+    if (pos != UINT32_MAX) {
+        at->pos = pos;
+    }
+    return track;
+}
+
+// Shuffle by album: the folders of the library in shuffled order, the tracks of a folder in file order
+// (queued tracks are played in the folder they are from)
+static int stepAlbum(play_pos_t* at, int dir) {
+    uint32_t dirs = MediaLibrary_DirCount();
+    uint32_t track = Playlist_Track(at->pos);
+    uint32_t album = 0;
+    ml_track_t t;
+    ml_dir_t d;
+    if (track < (uint32_t)mp3FileCount && MediaLibrary_GetTrack(track, &t) && MediaLibrary_GetDir(t.dir, &d)) {
+        if (dir > 0 && track + 1 < d.firstTrack + d.trackCount) {
+            return placeTrack(at, track + 1);
+        }
+        if (dir < 0 && track > d.firstTrack) {
+            return placeTrack(at, track - 1);
+        }
+        album = t.dir;
+    }
+    uint32_t cycle = at->cycle;
+    for (uint32_t i = 0; i < dirs; i++) {
+        album = stepShuffled(album, &cycle, dirs, dir);
+        if (MediaLibrary_GetDir(album, &d) && d.trackCount > 0) {
+            at->cycle = cycle;
+            return placeTrack(at, dir > 0 ? d.firstTrack : d.firstTrack + d.trackCount - 1);
+        }
+    }
+    return -1;
+}
+
+// The next track of the play order from a place in a direction, in order or shuffled, entries without a track
+// (streams, files that are not in the library) are skipped, -1: none
+static int stepTrack(play_pos_t* at, int dir) {
+    if (shuffleMode == SHUFFLE_ALBUMS && !Playlist_GetPath()[0]) {
+        return stepAlbum(at, dir);
+    }
+    uint32_t length = Playlist_Length();
+    uint32_t tries = min(length, (uint32_t)PLAYLIST_SKIP_MAX);
+    play_pos_t p = *at;
+    for (uint32_t i = 0; i < tries; i++) {
+        if (shuffleMode == SHUFFLE_OFF) {
+            p.pos = (dir > 0) ? (p.pos + 1) % length : (p.pos + length - 1) % length;
+        } else {
+            p.pos = stepShuffled(p.pos, &p.cycle, length, dir);
+        }
+        uint32_t track = Playlist_Track(p.pos);
+        if (track < (uint32_t)mp3FileCount) {
+            *at = p;
+            return track;
+        }
+    }
+    return -1;
+}
+
+static void saveShuffle() {
+    Preferences prefs;
+    if (prefs.begin(PLAYER_NVS_NAMESPACE, false)) {
+        prefs.putUChar("shuffle", shuffleMode);
+        prefs.putUInt("seed", shuffleSeed);
+        prefs.putUInt("cycle", currentAt.cycle);
+        prefs.end();
+    }
+}
+
+static void loadShuffle() {
+    Preferences prefs;
+    if (prefs.begin(PLAYER_NVS_NAMESPACE, true)) {
+        uint8_t mode = prefs.getUChar("shuffle", SHUFFLE_OFF);
+        shuffleMode = mode <= SHUFFLE_ALBUMS ? (ShuffleMode)mode : SHUFFLE_OFF;
+        shuffleSeed = prefs.getUInt("seed", 0);
+        currentAt.cycle = prefs.getUInt("cycle", 0);
+        prefs.end();
+    }
+}
+
+// The library index has changed, the playlist is looked up again and the current track is found in it
+static void relinkPlayOrder() {
+    Playlist_Relink();
+    uint32_t pos = Playlist_Locate(currentTrackIndex, currentAt.pos);
+    if (pos != UINT32_MAX) {
+        lockState();
+        currentAt.pos = pos;
+        unlockState();
+    }
+}
+
+// Hand the next track to the audio task (the caller holds stateMutex), next < 0 drops the next file
+static void setReady(int next, play_pos_t at, const char* path, bool cached) {
+    readyTrackIndex = next;
+    readyAt = at;
+    strlcpy(readyPath, path, sizeof(readyPath));
+    readyFromCache = cached;
+    nextReady = true;
+}
+
+// The copy task has the next track in PSRAM (or gave up), the audio task queues it from there or from the card
+static void nextTrackStaged(const char* path, bool staged) {
+    lockState();
+    int next = stagingTrackIndex;
+    play_pos_t at = stagingAt;
+    unlockState();
+    char filePath[MEDIA_PATH_LEN];
+    if (next < 0 || next >= mp3FileCount || !MediaLibrary_GetPath(next, filePath, sizeof(filePath))) return;
+    if (strcmp(filePath, path) != 0) return; // a newer request follows
+
+    // The card may sleep after this, gain table entries, frame indexes and cover art of the last tracks are
+    // written now, the frame index and the cover art of the next track are read
+    audio.flushGainTable();
+    SeekIndex_Flush();
+    CoverArt_Flush();
+    ml_track_t t;
+    if (MediaLibrary_GetTrack(next, &t)) SeekIndex_Get(filePath, t.size, NULL);
+    CoverArt_Prefetch(filePath);
+    play_pos_t after = at;
+    stepTrack(&after, 1); // the playlist block of the track after it is read now
+    lockState();
+    if (stagingTrackIndex == next) { // not replaced or cancelled meanwhile
+        stagingTrackIndex = -1;
+        setReady(next, at, filePath, staged);
+    }
+    unlockState();
+}
+
+// Open the track after the current one (any task), the library switches to it without a gap. The next file that
+// is open now stays until the audio task replaces it, nextTrackIndex always names the file the library plays next
+static void queueNextTrack() {
+    lockState();
+    stagingTrackIndex = -1; // a copy in flight is dropped when it is done
+    nextReady = false;
+    unlockState();
+    play_pos_t at = currentAt;
+    int next = -1;
+    char filePath[MEDIA_PATH_LEN] = "";
+    if (currentMode == MODE_MUSIC_PLAYER && mp3FileCount > 0) {
+        next = stepTrack(&at, 1);
+        if (next >= 0 && !MediaLibrary_GetPath(next, filePath, sizeof(filePath))) next = -1;
+    }
+    lockState();
+    if (next >= 0 && TrackCache_Enabled()) {
+        stagingAt = at;
+        stagingTrackIndex = next;
+    } else {
+        setReady(next, at, filePath, false);
+    }
+    unlockState();
+    if (next >= 0 && TrackCache_Enabled()) {
+        TrackCache_StageAsync(filePath, nextTrackStaged);
+    }
+}
+
+// Open the next track handed over by queueNextTrack() or the copy task (audio task, between two audio.loop())
+static void applyNextTrack() {
+    char path[MEDIA_PATH_LEN];
+    lockState();
+    int next = readyTrackIndex;
+    play_pos_t at = readyAt;
+    bool cached = readyFromCache;
+    strlcpy(path, readyPath, sizeof(path));
+    nextReady = false;
+    unlockState();
+    if (next < 0 || !audio.setNextFile(cached ? TrackCache_FS() : SD_FS(), path)) {
+        audio.clearNextFile();
+        nextTrackIndex = -1;
+        return;
+    }
+    nextFromCache = cached;
+    nextAt = at;
+    strlcpy(nextPath, path, sizeof(nextPath));
+    nextTrackIndex = next;
+    // The sleep decision is made here only, SD_Sleep() unmounts the card when no file is open on it (the other
+    // tasks hold it while they read)
+    if (cached && currentFromCache && !MediaLibrary_Scanning()) {
+        MediaLibrary_Suspend(); // the index file is opened again (and the card woken up) on the next page miss
+        Playlist_Suspend();
+        SD_Sleep();
+    }
+}
+
+static bool applySeekMap(const uint8_t* map, size_t len) {
+    return audio.setSeekMap(map, len);
+}
+
+// The frame index of the current track is in PSRAM now, loaded or built (seek index task)
+static void seekIndexBuilt(const char* path, bool built) {
+    char current[MEDIA_PATH_LEN];
+    copyCurrentPath(current, sizeof(current));
+    if (built && strcmp(path, current) == 0) {
+        applySeekIndex(false);
+    }
+}
+
+// Exact seeking in the current MP3 track: its frame index from the seek index, or built now in the background.
+// build: audio or UI task, only a map in PSRAM is used at once, the seek index task reads or builds the others
+static void applySeekIndex(bool build) {
+    ml_track_t t;
+    char path[MEDIA_PATH_LEN];
+    copyCurrentPath(path, sizeof(path));
+    if (!MediaLibrary_GetTrack(currentTrackIndex, &t)) {
+        return;
+    }
+    if (!build) {
+        SeekIndex_Get(path, t.size, applySeekMap); // seek index task, it may read the index file
+    } else if (!SeekIndex_TryGet(path, t.size, applySeekMap)) {
+        SeekIndex_BuildAsync(path, t.size, seekIndexBuilt);
+    }
+}
+
+// Library callbacks with the position of an embedded picture (audio task, inside audio.loop()),
+// the cover art task reads it (streams are not a file)
+void audio_id3image(File& file, const size_t pos, const size_t size) {
+    if (file) CoverArt_Found(file.path(), pos, size);
+}
+
+void audio_oggimage(File& file, std::vector<uint32_t> v) {
+    if (file) CoverArt_FoundOgg(file.path(), v);
+}
+
+// Library callback at the end of every file (audio task, inside audio.loop())
+void audio_eof_mp3(const char* info) {
+    if (audio.isRunning() && nextTrackIndex >= 0) {
+        gaplessSwitched = true; // already playing the next file
+    }
+}
+
+// Audio task to read and decode audio data (the output task of the library feeds I2S) - runs on Core 1
 void AudioPlayer_Task(void *parameter) {
     Serial.println("Audio task started on Core 1");
     static bool wasPlaying = false;
     
     while (true) {
+        if (libraryChanged) {
+            libraryChanged = false;
+            applyLibraryChange();
+        }
+
         // Only process when running
         if (audio.isRunning()) {
+            if (nextReady) {
+                applyNextTrack();
+            }
             audio.loop();
             wasPlaying = true;
+
+            // The new track first, the position below is already from its file
+            if (gaplessSwitched) {
+                gaplessSwitched = false;
+                char path[MEDIA_PATH_LEN];
+                strlcpy(path, nextPath, sizeof(path));
+                lockState();
+                currentTrackIndex = nextTrackIndex;
+                currentAt = nextAt;
+                playFilePos = playFileSize = 0;
+                strlcpy(currentPath, path, sizeof(currentPath));
+                unlockState();
+                currentFromCache = nextFromCache;
+                nextTrackIndex = -1; // the library has no next file now
+                Serial.printf("Gapless: now playing %d - %s\n", currentTrackIndex, AudioPlayer_GetFileName(currentTrackIndex));
+                applySeekIndex(true);
+                CoverArt_Show(path);
+                queueNextTrack();
+            }
+
+            static uint32_t lastPositionUpdate = 0;
+            if (millis() - lastPositionUpdate >= 1000) {
+                uint32_t pos = audio.getFilePos(), buffered = audio.inBufferFilled();
+                playFilePos = pos > buffered ? pos - buffered : 0;
+                playFileSize = audio.getFileSize();
+                lastPositionUpdate = millis();
+            }
+            
+#if AUDIO_STATS_INTERVAL_MS > 0
+            static uint32_t lastStatsPrint = 0;
+            if (millis() - lastStatsPrint >= AUDIO_STATS_INTERVAL_MS) {
+                AudioPlayer_PrintStats();
+                lastStatsPrint = millis();
+            }
+#endif
         } else if (wasPlaying && isPlaying) {
             // Track just finished playing (was playing but audio stopped while isPlaying is still true)
             Serial.println("Audio playback ended");
@@ -99,12 +591,10 @@ void AudioPlayer_Task(void *parameter) {
                 // Mark current track as stopped
                 isPlaying = false;
                 
-                // Calculate next track index with loop
-                int nextTrack = (currentTrackIndex + 1) % mp3FileCount;
-                
-                // Set next track and play it
-                AudioPlayer_SetTrack(nextTrack);
-                AudioPlayer_Play();
+                // Next track of the play order, with loop
+                if (AudioPlayer_Next()) {
+                    AudioPlayer_Play();
+                }
             } else {
                 // For web radio, just mark as stopped
                 isPlaying = false;
@@ -112,8 +602,13 @@ void AudioPlayer_Task(void *parameter) {
             wasPlaying = false;
         }
         
+#if AUDIO_EVENT_WAKE
+        // Sleep until a quarter of the DMA is sent (or the PCM ring is half empty), the timeout serves the network
+        audio.waitForWork(audio.isRunning() ? AUDIO_WAKE_MAX_MS : 50);
+#else
         // Task period needs to be fast enough for audio decoding
         vTaskDelay(10); // Lower delay for smoother audio processing
+#endif
     }
 }
 
@@ -124,6 +619,9 @@ void AudioPlayer_SetMode(PlayerMode mode) {
     vTaskDelay(200);
     
     currentMode = mode;
+    if (mode == MODE_WEB_RADIO) {
+        CoverArt_Show(NULL);
+    }
     Serial.printf("Player mode changed to: %s\n", 
                  mode == MODE_MUSIC_PLAYER ? "Music Player" : "Internet Radio");
 }
@@ -151,6 +649,18 @@ bool AudioPlayer_Play() {
 
 // Stop playback
 void AudioPlayer_Stop() {
+    lockState();
+    stagingTrackIndex = -1;
+    nextReady = false;
+    unlockState();
+    nextTrackIndex = -1;
+    if (isPlaying && currentMode == MODE_MUSIC_PLAYER) {
+        lockState();
+        strlcpy(resumePath, currentPath, sizeof(resumePath));
+        resumeFilePos = playFilePos;
+        resumeFileSize = playFileSize;
+        unlockState();
+    }
     if (isPlaying) {
         audio.stopSong();
         isPlaying = false;
@@ -172,9 +682,14 @@ bool AudioPlayer_TogglePlayPause() {
 // Go to next track or station
 bool AudioPlayer_Next() {
     if (currentMode == MODE_MUSIC_PLAYER) {
-        if (mp3FileCount > 0) {
-            currentTrackIndex = (currentTrackIndex + 1) % mp3FileCount;
-            Serial.printf("Next track: %d - %s\n", currentTrackIndex, mp3FileList[currentTrackIndex]);
+        play_pos_t at = currentAt;
+        int track = stepTrack(&at, 1);
+        if (track >= 0) {
+            lockState();
+            currentAt = at;
+            currentTrackIndex = track;
+            unlockState();
+            Serial.printf("Next track: %d - %s\n", currentTrackIndex, AudioPlayer_GetFileName(currentTrackIndex));
             return true;
         }
     } else {
@@ -188,9 +703,14 @@ bool AudioPlayer_Next() {
 // Go to previous track or station
 bool AudioPlayer_Previous() {
     if (currentMode == MODE_MUSIC_PLAYER) {
-        if (mp3FileCount > 0) {
-            currentTrackIndex = (currentTrackIndex - 1 + mp3FileCount) % mp3FileCount;
-            Serial.printf("Previous track: %d - %s\n", currentTrackIndex, mp3FileList[currentTrackIndex]);
+        play_pos_t at = currentAt;
+        int track = stepTrack(&at, -1);
+        if (track >= 0) {
+            lockState();
+            currentAt = at;
+            currentTrackIndex = track;
+            unlockState();
+            Serial.printf("Previous track: %d - %s\n", currentTrackIndex, AudioPlayer_GetFileName(currentTrackIndex));
             return true;
         }
     } else {
@@ -214,31 +734,23 @@ bool AudioPlayer_PlayTrack(int index) {
         return false;
     }
     
+    // Build file path from the library index
+    char filePath[MEDIA_PATH_LEN];
+    bool found = MediaLibrary_GetPath(index, filePath, sizeof(filePath));
+    lockState();
     currentTrackIndex = index;
-    
-    // Build file path
-    const char* directory = "/";
-    const char* fileName = mp3FileList[currentTrackIndex];
-    
-    // Check if file exists
-    Serial.printf("Checking if file '%s%s' exists...\n", directory, fileName);
-    if (!SD_IsAvailable() || !File_Search(directory, fileName)) {
-        Serial.printf("Audio file not found: %s\n", fileName);
+    if (found) strlcpy(currentPath, filePath, sizeof(currentPath));
+    unlockState();
+    if (!found) {
+        Serial.printf("Track %d not in the library index\n", index);
         return false;
     }
+
+    // A track in PSRAM plays without the card, otherwise the open file holds the card awake (SD_FS()). The
+    // path from the index is opened directly, the folder is not searched for the file
+    bool cached = TrackCache_Contains(filePath);
     
-    Serial.printf("File '%s%s' found in root directory.\n", directory, fileName);
-    
-    // Build full path with reduced buffer size
-    const int maxPathLength = 80;
-    char filePath[maxPathLength];
-    if (strcmp(directory, "/") == 0) {                                               
-        snprintf(filePath, maxPathLength, "%s%s", directory, fileName);   
-    } else {                                                            
-        snprintf(filePath, maxPathLength, "%s/%s", directory, fileName);
-    }
-    
-    Serial.printf("Playing file: %s\n", filePath);
+    Serial.printf("Playing file: %s%s\n", filePath, cached ? " (PSRAM)" : "");
     Serial.printf("Free heap before playback: %d bytes\n", esp_get_free_heap_size());
     
     // Try simplified approach with memory handling
@@ -246,9 +758,26 @@ bool AudioPlayer_PlayTrack(int index) {
         // Call stopSong first to ensure clean start
         audio.stopSong();
         vTaskDelay(50);
+        audio.flushGainTable(); // loudness of the tracks that played to the end, the audio task does not write it
         
-        // Explicit connection to SD with proper file path
-        bool ret = audio.connecttoFS(SD_MMC, filePath);
+        // The stopped track plays on from where it was (the same file)
+        ml_track_t t;
+        int32_t resumePos = -1;
+        if (strcmp(filePath, resumePath) == 0 && MediaLibrary_GetTrack(index, &t) && t.size == resumeFileSize) {
+            resumePos = resumeFilePos;
+            Serial.printf("Resuming at byte %ld\n", (long)resumePos);
+        }
+        resumePath[0] = '\0';
+        playFilePos = resumePos > 0 ? resumePos : 0;
+        playFileSize = resumePos > 0 ? resumeFileSize : 0;
+
+        // Explicit connection to SD with proper file path, the PSRAM copy may have been replaced meanwhile
+        bool ret = cached && audio.connecttoFS(TrackCache_FS(), filePath, resumePos);
+        if (!ret) {
+            cached = false;
+            ret = audio.connecttoFS(SD_FS(), filePath, resumePos);
+        }
+        currentFromCache = cached;
         if (ret) {
             Serial.println("Audio file loaded successfully!");
             isPlaying = true;
@@ -256,8 +785,17 @@ bool AudioPlayer_PlayTrack(int index) {
             // Set volume again after connection
             audio.setVolume(currentVolume);
             Serial.println("Play");
+            applySeekIndex(true);
+            CoverArt_Show(filePath);
+            queueNextTrack();
             return true;
         } else {
+            // The file is gone (the index is older than the card), the folders are checked again
+            if (SD_IsAvailable() && !SD_FS().exists(filePath)) {
+                Serial.printf("Audio file not found: %s\n", filePath);
+                MediaLibrary_RescanAsync(SD_FS(), SD_MOUNT_POINT, MEDIA_LIBRARY_ROOT, MEDIA_LIBRARY_FILE,
+                                         MEDIA_RESCAN_ENTRIES_PER_SEC, libraryRescanned);
+            }
             Serial.println("Failed to load audio file");
             isPlaying = false;
             return false;
@@ -285,6 +823,12 @@ bool AudioPlayer_PlayStation(int index) {
     
     currentStationIndex = index;
     
+    // Fade the running stream out, the next one fades in
+    if (audio.isRunning()) {
+        audio.fadeOut(STATION_FADE_MS);
+        vTaskDelay((STATION_FADE_MS + 20) / portTICK_PERIOD_MS);
+    }
+
     // Complete stop of any current playback
     AudioPlayer_Stop();
     vTaskDelay(500 / portTICK_PERIOD_MS); // Longer wait for radio
@@ -295,7 +839,7 @@ bool AudioPlayer_PlayStation(int index) {
     freeMemoryForDecoder();
     
     // Set radio-specific volume (lower to prevent distortion)
-    audio.setVolume(15); // Reduced from 18
+    audio.setVolume(71); // Reduced from 86 (of AUDIO_VOLUME_STEPS)
     
     // Connect to the radio stream with timeout handling
     bool ret = false;
@@ -326,58 +870,29 @@ bool AudioPlayer_PlayStation(int index) {
     }
 }
 
-// Scan SD card for MP3 files only (no hidden files, no macOS metadata)
+// Scan the SD card for audio files (all folders, no hidden files, no macOS metadata) and rewrite the library index
 int AudioPlayer_ScanMP3Files() {
     if (!SD_IsAvailable()) {
         Serial.println("SD card not available for scanning audio files");
         return 0;
     }
     
-    // Clear existing files list
-    memset(mp3FileList, 0, sizeof(mp3FileList));
-    
     Serial.println("Starting SD card scan for audio files...");
-    
-    // Using direct file scanning (more memory efficient)
-    File root = SD_MMC.open("/");
-    if (root && root.isDirectory()) {
-        int fileIndex = 0;
-        
-        // Scan for MP3 files
-        File file = root.openNextFile();
-        while (file && fileIndex < MAX_MP3_FILES) {
-            if (!file.isDirectory()) {
-                String fileName = file.name();
-                
-                // Only include normal MP3 files (no metadata or hidden files)
-                if ((fileName.endsWith(".mp3") || fileName.endsWith(".MP3")) && 
-                    !fileName.startsWith("._") && !fileName.startsWith(".")) {
-                    
-                    Serial.printf("Valid MP3: %s (%d bytes)\n", file.name(), file.size());
-                    
-                    // Copy filename with length check
-                    strncpy(mp3FileList[fileIndex], file.name(), 63);
-                    mp3FileList[fileIndex][63] = '\0'; // Ensure null termination
-                    fileIndex++;
-                    
-                    // Release some CPU time after each file
-                    if (fileIndex % 2 == 0) { // More frequent yields
-                        vTaskDelay(1);
-                    }
-                }
-            }
-            file = root.openNextFile();
-        }
-        
-        file.close();
-        root.close();
-        
-        mp3FileCount = fileIndex;
-        Serial.printf("Found %d valid MP3 files\n", mp3FileCount);
-    } else {
-        Serial.println("Failed to open root directory");
+    int count = MediaLibrary_Build(SD_FS(), SD_MOUNT_POINT, MEDIA_LIBRARY_ROOT, MEDIA_LIBRARY_FILE);
+    if (count < 0) {
+        Serial.println("Failed to build the library index");
+        return mp3FileCount;
     }
     
+    mp3FileCount = count;
+    char path[MEDIA_PATH_LEN];
+    copyCurrentPath(path, sizeof(path));
+    uint32_t track = MediaLibrary_Find(path);
+    currentTrackIndex = (track != UINT32_MAX) ? track : (currentTrackIndex < mp3FileCount) ? currentTrackIndex : 0;
+    relinkPlayOrder();
+    libraryVersion = libraryVersion + 1;
+    Serial.printf("Found %d valid audio files\n", mp3FileCount);
+    MediaLibrary_ReadTagsAsync(SD_FS(), MEDIA_TAG_FILES_PER_SEC, libraryTagged);
     return mp3FileCount;
 }
 
@@ -386,12 +901,18 @@ bool AudioPlayer_IsPlaying() {
     return isPlaying && audio.isRunning();
 }
 
-// Get total duration of current track (applicable only in music mode)
+// Get total duration of current track (applicable only in music mode), from the library index until
+// the decoder knows it
 uint32_t AudioPlayer_GetTotalDuration() {
     if (currentMode != MODE_MUSIC_PLAYER) {
         return 0;
     }
-    return audio.getAudioFileDuration();
+    uint32_t duration = audio.getAudioFileDuration();
+    ml_track_t track;
+    if (duration == 0 && MediaLibrary_GetTrack(currentTrackIndex, &track)) {
+        duration = track.duration;
+    }
+    return duration;
 }
 
 // Get elapsed time
@@ -408,6 +929,14 @@ uint32_t AudioPlayer_GetElapsedTime() {
     }
 }
 
+// Jump to a time in the current track, the library finds the file position when it reads the next block
+bool AudioPlayer_Seek(uint32_t sec) {
+    if (currentMode != MODE_MUSIC_PLAYER || !isPlaying) {
+        return false;
+    }
+    return audio.setAudioPlayPosition(min(sec, (uint32_t)UINT16_MAX));
+}
+
 // Get track/station progress (0.0 to 1.0) - only meaningful for music
 float AudioPlayer_GetProgress() {
     if (currentMode != MODE_MUSIC_PLAYER) {
@@ -426,11 +955,32 @@ int AudioPlayer_GetFileCount() {
     return mp3FileCount;
 }
 
+// Progress of the library scan in percent of the known folders, -1: no scan running
+int AudioPlayer_GetScanProgress() {
+    ml_progress_t progress;
+    MediaLibrary_GetProgress(&progress);
+    if (!progress.running) {
+        return -1;
+    }
+    return progress.dirs * 100 / max(progress.knownDirs, progress.dirs + 1);
+}
+
+// Changes when the track list has changed (new library index)
+uint32_t AudioPlayer_GetLibraryVersion() {
+    return libraryVersion;
+}
+
 // Get the name of the current MP3 file or radio station
 const char* AudioPlayer_GetCurrentName() {
     if (currentMode == MODE_MUSIC_PLAYER) {
         if (mp3FileCount > 0) {
-            return mp3FileList[currentTrackIndex];
+            static char currentName[MEDIA_NAME_LEN];
+            ml_track_t track;
+            if (!MediaLibrary_GetTrack(currentTrackIndex, &track) ||
+                !MediaLibrary_GetString(track.name, currentName, sizeof(currentName))) {
+                return "Invalid index";
+            }
+            return currentName;
         } else {
             return "No audio files";
         }
@@ -439,12 +989,26 @@ const char* AudioPlayer_GetCurrentName() {
     }
 }
 
-// Get audio file name by index
+// Get audio file name by index, valid until the next call
 const char* AudioPlayer_GetFileName(int index) {
-    if (index < 0 || index >= mp3FileCount) {
+    static char fileName[MEDIA_NAME_LEN];
+    ml_track_t track;
+    if (index < 0 || index >= mp3FileCount || !MediaLibrary_GetTrack(index, &track) ||
+        !MediaLibrary_GetString(track.name, fileName, sizeof(fileName))) {
         return "Invalid index";
     }
-    return mp3FileList[index];
+    return fileName;
+}
+
+// Get the title of a track, valid until the next call
+const char* AudioPlayer_GetTrackTitle(int index) {
+    static char title[MEDIA_NAME_LEN];
+    ml_track_t track;
+    if (index < 0 || index >= mp3FileCount || !MediaLibrary_GetTrack(index, &track) ||
+        !MediaLibrary_GetString(track.title ? track.title : track.name, title, sizeof(title))) {
+        return "Invalid index";
+    }
+    return title;
 }
 
 // Get radio station name by index
@@ -465,16 +1029,159 @@ int AudioPlayer_GetCurrentStationIndex() {
     return currentStationIndex;
 }
 
-// Set track by index
+// Set track by index, the play order continues from it (from the current position if it is not in the
+// resident part of the playlist)
 bool AudioPlayer_SetTrack(int index) {
     if (index < 0 || index >= mp3FileCount) {
         return false;
     }
     
+    uint32_t pos = Playlist_Locate(index, currentAt.pos);
+    lockState();
     currentTrackIndex = index;
+    if (pos != UINT32_MAX) {
+        currentAt.pos = pos;
+    }
+    unlockState();
     return true;
 }
 
+// Play a playlist file instead of the library order (NULL), from its first track (after the one that plays)
+bool AudioPlayer_OpenPlaylist(const char* path) {
+    bool ok = Playlist_Open(path);
+    uint32_t length = Playlist_Length();
+    lockState();
+    currentAt.pos = length ? length - 1 : 0;
+    unlockState();
+    if (isPlaying && currentMode == MODE_MUSIC_PLAYER) {
+        queueNextTrack();
+        return ok;
+    }
+    play_pos_t at = currentAt;
+    int track = stepTrack(&at, 1);
+    if (track >= 0) {
+        lockState();
+        currentTrackIndex = track;
+        currentAt = at;
+        unlockState();
+    }
+    return ok;
+}
+
+// A queued track follows the current one, the track that was opened as the next one is replaced
+static bool playOrderEdited(bool ok) {
+    if (ok && isPlaying && currentMode == MODE_MUSIC_PLAYER) {
+        play_pos_t at = currentAt;
+        int next = stepTrack(&at, 1);
+        lockState();
+        bool queued = next == stagingTrackIndex || (nextReady && next == readyTrackIndex);
+        unlockState();
+        if (next != nextTrackIndex && !queued) {
+            queueNextTrack();
+        }
+    }
+    return ok;
+}
+
+bool AudioPlayer_QueueNext(int index) {
+    if (index < 0 || index >= mp3FileCount) {
+        return false;
+    }
+    return playOrderEdited(Playlist_Insert(currentAt.pos, index));
+}
+
+bool AudioPlayer_QueueAppend(int index) {
+    if (index < 0 || index >= mp3FileCount) {
+        return false;
+    }
+    return playOrderEdited(Playlist_Append(index));
+}
+
+void AudioPlayer_ClearQueue() {
+    Playlist_ClearQueue();
+    playOrderEdited(true);
+}
+
+// A new order (seed) every time shuffle is switched on, the track that plays stays
+void AudioPlayer_SetShuffle(ShuffleMode mode) {
+    if (mode == shuffleMode) {
+        return;
+    }
+    shuffleMode = mode;
+    if (mode != SHUFFLE_OFF) {
+        shuffleSeed = esp_random();
+        currentAt.cycle = 0;
+    }
+    saveShuffle();
+    Serial.printf("Shuffle: %s\n", mode == SHUFFLE_TRACKS ? "tracks" : mode == SHUFFLE_ALBUMS ? "albums" : "off");
+    playOrderEdited(true);
+}
+
+ShuffleMode AudioPlayer_GetShuffle() {
+    return shuffleMode;
+}
+
+// Continue the saved session: mode, station, volume, EQ preset, the track and its position (paused, Play
+// continues there)
+void AudioPlayer_Resume(const session_t* s) {
+    currentMode = (s->mode == MODE_WEB_RADIO) ? MODE_WEB_RADIO : MODE_MUSIC_PLAYER;
+    if (s->station < RADIO_STATION_COUNT) {
+        currentStationIndex = s->station;
+    }
+    AudioPlayer_SetVolume(s->volume);
+    if (s->eqPreset < audio.getEqualizerPresetCount()) {
+        audio.setEqualizerPreset(s->eqPreset);
+    }
+    uint32_t track = s->path[0] ? MediaLibrary_Find(s->path) : UINT32_MAX;
+    if (track >= (uint32_t)mp3FileCount) {
+        return;
+    }
+    uint32_t pos = (Playlist_Track(s->orderPos) == track) ? s->orderPos : Playlist_Locate(track, s->orderPos);
+    lockState();
+    currentTrackIndex = track;
+    strlcpy(currentPath, s->path, sizeof(currentPath));
+    if (pos != UINT32_MAX) {
+        currentAt.pos = pos;
+    }
+    strlcpy(resumePath, s->path, sizeof(resumePath));
+    resumeFilePos = s->filePos;
+    resumeFileSize = s->fileSize;
+    unlockState();
+    Serial.printf("Session: %s at byte %lu\n", s->path, (long unsigned int)s->filePos);
+}
+
+// The state for the session task, the position of the playing track is from the audio task. The current
+// track is copied under the lock, a gapless switch does not tear the path or pair it with the last position
+void AudioPlayer_GetSession(session_t* s) {
+    s->mode = currentMode;
+    s->station = currentStationIndex;
+    s->volume = currentVolume;
+    s->eqPreset = audio.getEqualizerPreset();
+    s->playing = isPlaying;
+    bool playing = isPlaying && currentMode == MODE_MUSIC_PLAYER;
+    lockState();
+    s->orderPos = currentAt.pos;
+    s->cycle = currentAt.cycle;
+    int track = currentTrackIndex;
+    if (playing) {
+        strlcpy(s->path, currentPath, sizeof(s->path));
+        s->filePos = playFilePos;
+        s->fileSize = playFileSize;
+    }
+    unlockState();
+    if (playing) {
+        return;
+    }
+    if (mp3FileCount == 0 || !MediaLibrary_GetPath(track, s->path, sizeof(s->path))) { // not under the lock
+        s->path[0] = '\0';
+    }
+    lockState();
+    bool stopped = strcmp(s->path, resumePath) == 0;
+    s->filePos = stopped ? resumeFilePos : 0;
+    s->fileSize = stopped ? resumeFileSize : 0;
+    unlockState();
+}
+
 // Set station by index
 bool AudioPlayer_SetStation(int index) {
     if (index < 0 || index >= RADIO_STATION_COUNT) {
@@ -485,9 +1192,100 @@ bool AudioPlayer_SetStation(int index) {
     return true;
 }
 
-// Set the volume level (0-21)
+// Print audio pipeline statistics (compare with audio.setBlockOutput(false) for the per-sample path)
+void AudioPlayer_PrintStats() {
+    audio_stats_t stats;
+    audio.getAudioStats(&stats);
+    Serial.printf("Audio: %u I2S writes/s, %u frames/s, %u us/frame (output %u us), EQ %u cycles/sample, "
+                  "resampler %u cycles/sample\n",
+                 stats.i2sWritesPerSec, stats.framesPerSec, stats.cpuUsPerFrame, stats.outputUsPerFrame,
+                 stats.eqCyclesPerSample, stats.resamplerCyclesPerSample);
+    Serial.printf("Last track change: next file ready after %u us, %u silent frames at the splice\n",
+                  stats.gaplessPrimeUs, stats.gaplessSilentFrames);
+    if (stats.loudnessCyclesPerSample) {
+        Serial.printf("Loudness meter: %u cycles/sample\n", stats.loudnessCyclesPerSample);
+    }
+    Serial.printf("Limiter: %u cycles/sample, max. gain reduction %u.%u dB\n", stats.limiterCyclesPerSample,
+                  stats.limiterMaxReduction / 10, stats.limiterMaxReduction % 10);
+    if (stats.mixCyclesPerBlock) {
+        Serial.printf("Crossfade: %u cycles per mixed block\n", stats.mixCyclesPerBlock);
+    }
+#if AUDIO_RING_MS > 0
+    Serial.printf("PCM ring: %u frames, decode ahead min. %u ms, %u underruns\n",
+                  stats.ringFrames, stats.decodeAheadMs, stats.ringUnderruns);
+#endif
+    Serial.printf("Audio task: %u wakeups/s (%u event, %u input, %u timeout), %u DMA underruns\n",
+                  stats.wakeupsPerSec, stats.wakeEventPerSec, stats.wakeInputPerSec, stats.wakeTimeoutPerSec,
+                  stats.dmaUnderruns);
+#if AUDIO_READ_AHEAD_SECONDS > 0
+    if (currentMode == MODE_MUSIC_PLAYER) {
+        Serial.printf("SD read-ahead: %u ms buffered, %u KB/s, slowest read %u us\n",
+                      stats.readAheadMs, stats.sdReadKBytesPerSec, stats.sdReadMaxUs);
+    }
+#endif
+    if (TrackCache_Enabled() && currentMode == MODE_MUSIC_PLAYER) {
+        Serial.printf("Track cache: %lu of %lu KB, SD card %s\n", (long unsigned int)(TrackCache_Used() / 1024),
+                      (long unsigned int)(TrackCache_ArenaSize() / 1024), SD_IsSleeping() ? "asleep" : "awake");
+    }
+}
+
+// Output level of the last audio block, does not wait for the audio task
+void AudioPlayer_GetLevels(uint16_t rms[2], uint16_t peak[2], uint16_t peakHold[2]) {
+    audio_level_t level;
+    audio.getAudioLevel(&level);
+    for (int ch = 0; ch < 2; ch++) {
+        if (rms) rms[ch] = level.rms[ch];
+        if (peak) peak[ch] = level.peak[ch];
+        if (peakHold) peakHold[ch] = level.peakHold[ch];
+    }
+}
+
+bool AudioPlayer_SetCrossfade(uint8_t seconds, uint8_t shape) {
+    return audio.setCrossfade(seconds, shape);
+}
+
+void AudioPlayer_SetReplayGain(uint8_t mode, int8_t preampDb) {
+    audio.setReplayGain(mode, preampDb);
+}
+
+float AudioPlayer_GetLimiterReduction() {
+    return audio.getLimiterReduction();
+}
+
+// The FFT runs in a low priority task of the audio library, never in the audio task
+bool AudioPlayer_EnableSpectrum(uint16_t points, uint8_t bands) {
+    return audio.setSpectrum(points, bands);
+}
+
+int AudioPlayer_GetSpectrum(uint8_t* bands, int maxBands) {
+    if (maxBands <= 0) return 0;
+    return audio.getSpectrum(bands, maxBands > 255 ? 255 : maxBands);
+}
+
+// Select an equalizer preset, takes effect with the next audio block
+bool AudioPlayer_SetEqPreset(int8_t preset) {
+    return audio.setEqualizerPreset(preset);
+}
+
+int8_t AudioPlayer_GetEqPreset() {
+    return audio.getEqualizerPreset();
+}
+
+int AudioPlayer_GetEqPresetCount() {
+    return audio.getEqualizerPresetCount();
+}
+
+bool AudioPlayer_GetEqPresetName(int preset, char* buf, size_t len) {
+    if (preset < 0 || preset > 255) {
+        if (buf && len) buf[0] = '\0';
+        return false;
+    }
+    return audio.getEqualizerPresetName(preset, buf, len);
+}
+
+// Set the volume level (0-AUDIO_VOLUME_STEPS)
 void AudioPlayer_SetVolume(uint8_t volume) {
-    if (volume > 21) volume = 21;
+    if (volume > AUDIO_VOLUME_STEPS) volume = AUDIO_VOLUME_STEPS;
     currentVolume = volume;
     audio.setVolume(currentVolume);
 }
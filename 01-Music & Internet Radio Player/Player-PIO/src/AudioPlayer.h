@@ -1,9 +1,106 @@
 #pragma once
 #include "Arduino.h"
 #include "RadioStations.h"
+#include "Session.h"
 
-// Reduce max files to handle to save memory
-#define MAX_MP3_FILES 50  // Reduced from 100
+// Library index of all audio files below MEDIA_LIBRARY_ROOT, built once and read page by page
+// (AudioPlayer_ScanMP3Files() rebuilds it)
+#define MEDIA_LIBRARY_ROOT "/"
+#define MEDIA_LIBRARY_FILE "/.medialib.idx"
+
+// The library is checked for changed folders in the background after every start, limited to this many
+// directory entries per second so playback and the UI keep the card (0 = no limit). The value is an estimate,
+// the time of a check and its effect on playback have not been measured on the card, the scan log shows how
+// much of the time was spent at the limit (raise it if the card keeps up)
+#define MEDIA_RESCAN_ENTRIES_PER_SEC 3000
+
+// Then the tags (title, artist, album, duration) of new files are read into the index, files per second
+#define MEDIA_TAG_FILES_PER_SEC 50
+
+// Frame indexes of MP3 files for exact seeking in VBR files, built when a track is played the first time
+// (files with a Xing/VBRI table are seeked by it until then), the file is started again at the size limit
+#define SEEK_INDEX_FILE "/.medialib.seek"
+#define SEEK_INDEX_MAX_BYTES (4 * 1024 * 1024)
+
+// Cover art decoded once from the embedded picture of a track and kept per album in this directory as a
+// ready-to-blit image, shown behind the controls (diameter in pixels, 0 = off)
+#define COVER_ART_DIR "/.medialib.art"
+#define COVER_ART_SIZE 360
+
+// Play order from a playlist on the SD card (M3U, M3U8 or PLS, paths relative to its folder) instead of the
+// library when the file exists ("" = the library in file order), tracks queued with AudioPlayer_QueueNext()
+// and AudioPlayer_QueueAppend() are kept in the journal file, entries that are not in the library are skipped
+// (at most this many in a row)
+#define PLAYLIST_FILE "/playlist.m3u"
+#define PLAYLIST_QUEUE_FILE "/.medialib.queue"
+#define PLAYLIST_SKIP_MAX 256
+
+// Player settings in NVS (Preferences): the session (Session.h), the shuffle mode and the seed of its order
+#define PLAYER_NVS_NAMESPACE "player"
+
+// The session (track, position, station, volume, EQ, mode) is written when it has not changed for
+// SESSION_SETTLE_MS, the position while playing every SESSION_CHECKPOINT_MS [ms]
+#define SESSION_SETTLE_MS 3000
+#define SESSION_CHECKPOINT_MS 60000
+
+// Print audio pipeline statistics every n ms while playing (0 = off)
+#define AUDIO_STATS_INTERVAL_MS 0
+
+// Equalizer presets on the SD card (format see ESP32-audioI2S src/dsp/param_eq.h),
+// the built-in PCM5101 curves are used if the file is missing
+#define EQ_PRESET_FILE "/eq_presets.txt"
+
+// Fixed I2S sample rate, other rates are converted (0 = I2S follows the stream),
+// 44.1 kHz material passes unchanged
+#define AUDIO_OUTPUT_RATE 44100
+
+// Crossfade between tracks in music mode, 0...12 s (0 = gapless), needs AUDIO_OUTPUT_RATE and PSRAM
+#define AUDIO_CROSSFADE_SECONDS 4
+
+// Fade-through when switching radio stations
+#define STATION_FADE_MS 300
+
+// Loudness normalization (RG_OFF, RG_TRACK, RG_ALBUM), files without ReplayGain tags are measured
+// while they play, the result is kept in this file on the SD card
+#define REPLAYGAIN_MODE RG_TRACK
+#define GAIN_TABLE_FILE "/replaygain.bin"
+
+// Peak limiter in front of the DAC, EQ boosts and ReplayGain never clip (ceiling in dBFS)
+#define AUDIO_LIMITER_CEILING_DB -1.0f
+
+// Decoded audio buffered between the decoder (AudioTask) and the I2S output task of the library [ms],
+// covers slow SD card and network reads (0 = the audio task writes to I2S itself)
+#define AUDIO_RING_MS 150
+#define AUDIO_OUTPUT_TASK_PRIO 18
+
+// Local files are read ahead by a low priority task (core 0) in large aligned chunks into PSRAM,
+// seconds of compressed audio kept ahead (0 = the audio task reads the SD card itself)
+#define AUDIO_READ_AHEAD_SECONDS 4
+#define AUDIO_READ_AHEAD_CHUNK_KB 32
+#define AUDIO_READ_AHEAD_PRIO 2
+
+// Whole tracks (current and next) are copied to PSRAM in one burst, the SD card sleeps in between [bytes],
+// longer tracks are streamed from the card (0 = off)
+#define TRACK_CACHE_BYTES (4 * 1024 * 1024)
+
+// The audio task sleeps until the I2S DMA or the PCM ring needs data (1), or polls every 10 ms (0),
+// compare stats.wakeupsPerSec and the underrun counters of both with AUDIO_STATS_INTERVAL_MS (e.g. 5000) while
+// the UI is busy (arc drags, list scrolling). The wakeups of 1 are split by cause: event, input low, timeout.
+// That comparison has not been made on the board yet, 1 is the default without numbers for either setting
+#define AUDIO_EVENT_WAKE 1
+#define AUDIO_WAKE_MAX_MS 20
+
+// Volume resolution, the volume arc maps 1:1 (0...100), changes are ramped by the library
+#define AUDIO_VOLUME_STEPS 100
+#define AUDIO_VOLUME_RAMP_MS 10
+
+// Shuffle, every track (album) once per cycle and a new order for each cycle, no table of the order is kept
+typedef enum {
+    SHUFFLE_OFF = 0,
+    SHUFFLE_TRACKS = 1,
+    SHUFFLE_ALBUMS = 2                  // the folders of the library shuffled, their tracks in order (a playlist:
+                                        // its tracks are shuffled)
+} ShuffleMode;
 
 // Player mode
 typedef enum {
@@ -32,7 +129,10 @@ bool AudioPlayer_Previous();
 bool AudioPlayer_PlayTrack(int index);
 bool AudioPlayer_PlayStation(int index);
 
-// Audio file management
+// Jump to a time in the current track (scrub bar), MP3 files to the exact frame once their frame index is built
+bool AudioPlayer_Seek(uint32_t sec);
+
+// Audio file management, rebuilds the library index
 int AudioPlayer_ScanMP3Files();
 
 // Status functions
@@ -41,8 +141,11 @@ uint32_t AudioPlayer_GetTotalDuration();
 uint32_t AudioPlayer_GetElapsedTime();
 float AudioPlayer_GetProgress();
 int AudioPlayer_GetFileCount();
+int AudioPlayer_GetScanProgress();        // library scan 0...99 %, -1: not scanning
+uint32_t AudioPlayer_GetLibraryVersion(); // changes with the track list
 const char* AudioPlayer_GetCurrentName();
 const char* AudioPlayer_GetFileName(int index);
+const char* AudioPlayer_GetTrackTitle(int index); // from the tags or the file name, valid until the next call
 const char* AudioPlayer_GetStationName(int index);
 int AudioPlayer_GetCurrentTrackIndex();
 int AudioPlayer_GetCurrentStationIndex();
@@ -51,6 +154,43 @@ int AudioPlayer_GetCurrentStationIndex();
 bool AudioPlayer_SetTrack(int index);
 bool AudioPlayer_SetStation(int index);
 
+// Play order: a playlist file (NULL = the library), tracks queued after the current one or at the end
+bool AudioPlayer_OpenPlaylist(const char* path);
+bool AudioPlayer_QueueNext(int index);
+bool AudioPlayer_QueueAppend(int index);
+void AudioPlayer_ClearQueue();
+void AudioPlayer_SetShuffle(ShuffleMode mode);
+ShuffleMode AudioPlayer_GetShuffle();
+
+// Session (Session.h): restore it after AudioPlayer_Init(), the snapshot for the session task
+void AudioPlayer_Resume(const session_t* s);
+void AudioPlayer_GetSession(session_t* s);
+
+// Print I2S driver calls per second and CPU time per decoded frame
+void AudioPlayer_PrintStats();
+
+// Output level per channel [left, right], linear 0...32767, lock-free, cheap enough to poll at 30 Hz
+void AudioPlayer_GetLevels(uint16_t rms[2], uint16_t peak[2], uint16_t peakHold[2]);
+
+// Gain reduction of the peak limiter in dB (0 = not limiting), for a meter
+float AudioPlayer_GetLimiterReduction();
+
+// Spectrum for a visualizer, 256 or 512 point FFT (0 = off), band values 0...255
+bool AudioPlayer_EnableSpectrum(uint16_t points, uint8_t bands);
+int AudioPlayer_GetSpectrum(uint8_t* bands, int maxBands);
+
+// Crossfade length 0...12 s (0 = gapless), shape XF_EQUAL_POWER, XF_LINEAR or XF_SCURVE
+bool AudioPlayer_SetCrossfade(uint8_t seconds, uint8_t shape);
+
+// ReplayGain mode RG_OFF, RG_TRACK or RG_ALBUM, from the next track on
+void AudioPlayer_SetReplayGain(uint8_t mode, int8_t preampDb);
+
+// Equalizer presets (-1 = flat / tone control)
+bool AudioPlayer_SetEqPreset(int8_t preset);
+int8_t AudioPlayer_GetEqPreset();
+int AudioPlayer_GetEqPresetCount();
+bool AudioPlayer_GetEqPresetName(int preset, char* buf, size_t len);
+
 // Volume control functions
-void AudioPlayer_SetVolume(uint8_t volume);
+void AudioPlayer_SetVolume(uint8_t volume); // 0...AUDIO_VOLUME_STEPS
 uint8_t AudioPlayer_GetVolume();
\ No newline at end of file
@@ -0,0 +1,503 @@
+#include "CoverArt.h"
+#include "SD_Card.h"
+#include "TrackCache.h"
+#include "MediaLibrary.h"
+#include "src/extra/libs/sjpg/tjpgd.h"
+
+#define COVER_ART_SLOTS 3               // shown, published and not shown yet, loaded or decoded
+#define COVER_ART_PATH_LEN 256          // MEDIA_PATH_LEN of the library
+#define COVER_ART_MAX_RANGES 64         // Ogg pages of a picture
+#define COVER_ART_HEAD 1024             // the image starts behind MIME type and description
+#define COVER_ART_JPEG_POOL 4096        // tjpgd work memory
+#define COVER_ART_MAX_STAGE (1536 * 1024) // scaled JPEG in RGB888
+
+typedef struct {
+    uint32_t key;                       // 0: free
+    uint32_t used;                      // last use, the oldest is replaced
+    bool dirty;                         // not in the directory yet
+    bool busy;                          // its file is read or written (without artMutex), it is not replaced
+    lv_img_dsc_t dsc;                   // data: PSRAM
+} ca_slot_t;
+
+typedef struct {
+    char path[COVER_ART_PATH_LEN];
+    uint32_t ranges[COVER_ART_MAX_RANGES * 2]; // file offset, length
+    uint32_t rangeCount;
+    bool base64;                        // Ogg: a FLAC PICTURE block in base64
+} ca_picture_t;
+
+// The picture bytes of a file, ranges are read in order, base64 is decoded on the fly
+typedef struct {
+    File f;
+    const ca_picture_t* pic;
+    uint32_t range;
+    uint32_t left;                      // bytes of the range
+    uint32_t bits;                      // base64 decoder
+    uint8_t nbits;
+    bool end;
+    uint8_t in[512];
+    uint16_t inPos, inLen;
+    uint8_t head[COVER_ART_HEAD];       // read ahead in search of the image start
+    uint16_t headPos, headLen;
+} ca_source_t;
+
+typedef struct {
+    ca_source_t* src;
+    uint8_t* rgb;                       // RGB888, w x h
+    uint32_t w, h;
+    uint32_t usedW, usedH;              // filled by tjpgd
+} ca_jpeg_t;
+
+static fs::FS* artFs = NULL;
+static char artDir[64];
+static uint16_t artSize = 0;
+static ca_slot_t slots[COVER_ART_SLOTS];
+static uint32_t slotTick = 0;
+static int published = -1;              // slot to show, -1: none
+static int displayed = -1;              // slot the UI has
+static int decoding = -1;               // slot the task decodes into
+static uint32_t artVersion = 0;
+static uint32_t wantedKey = 0;          // of the track that plays
+static SemaphoreHandle_t artMutex = NULL; // slots, never held for a file access
+static SemaphoreHandle_t requestMutex = NULL; // the pending requests, the audio task only takes this one
+static TaskHandle_t artTaskHandle = NULL;
+static char pendingShow[COVER_ART_PATH_LEN];
+static bool pendingShowRequest = false;
+static ca_picture_t pendingPicture;
+static bool pendingPictureRequest = false;
+static ca_picture_t picture;            // the one the task decodes
+static ca_source_t source;
+
+static uint32_t hashString(uint32_t h, const char* s) {
+    while (*s) h = (h ^ (uint8_t)*s++) * 16777619u; // FNV-1a
+    return h;
+}
+
+// Artist and album of the track in the library index, else its path
+static uint32_t artKey(const char* path) {
+    uint32_t h = 2166136261u;
+    char artist[MEDIA_NAME_LEN], album[MEDIA_NAME_LEN];
+    ml_track_t t;
+    uint32_t track = MediaLibrary_Find(path);
+    if (track != UINT32_MAX && MediaLibrary_GetTrack(track, &t) && (t.flags & ML_FLAG_TAGS) && t.album &&
+        MediaLibrary_GetString(t.album, album, sizeof(album)) && MediaLibrary_GetString(t.artist, artist, sizeof(artist))) {
+        h = hashString(hashString(hashString(h, artist), "\n"), album);
+    } else {
+        h = hashString(h, path);
+    }
+    return h ? h : 1;
+}
+
+static void artFileName(uint32_t key, char* buf, size_t len) {
+    snprintf(buf, len, "%s/%08lx.bin", artDir, (long unsigned int)key);
+}
+
+static int findSlot(uint32_t key) {
+    for (int i = 0; i < COVER_ART_SLOTS; i++) {
+        if (slots[i].key == key) return i;
+    }
+    return -1;
+}
+
+// The oldest slot that is not on the screen, it is emptied, -1: none
+static int freeSlot() {
+    int best = -1;
+    for (int i = 0; i < COVER_ART_SLOTS; i++) {
+        if (i == published || i == displayed || i == decoding || slots[i].busy) continue;
+        if (best < 0 || slots[i].used < slots[best].used) best = i;
+    }
+    if (best >= 0) {
+        slots[best].key = 0;
+        slots[best].dirty = false;
+    }
+    return best;
+}
+
+static void publish(int slot) {
+    if (slot == published) return;
+    published = slot;
+    artVersion++;
+}
+
+// Read a file of the directory into a free slot, -1: not there, not an image of this size or the card sleeps.
+// artMutex is taken on entry and on return, it is free while the file is read
+static int loadSlot(uint32_t key) {
+    char name[96];
+    artFileName(key, name, sizeof(name));
+    if (!SD_AcquireAwake()) return -1;
+    xSemaphoreGive(artMutex);
+    File f = artFs->open(name);
+    SD_Release(); // the open file holds the card
+    lv_img_header_t header;
+    bool ok = f && f.size() == sizeof(header) + slots[0].dsc.data_size &&
+              f.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.cf == LV_IMG_CF_TRUE_COLOR &&
+              header.w == artSize && header.h == artSize;
+    int slot = -1;
+    if (ok) {
+        xSemaphoreTake(artMutex, portMAX_DELAY);
+        if (findSlot(key) < 0 && (slot = freeSlot()) >= 0) slots[slot].busy = true; // else loaded meanwhile
+        xSemaphoreGive(artMutex);
+    }
+    ok = slot >= 0 && f.read((uint8_t*)slots[slot].dsc.data, slots[slot].dsc.data_size) == slots[slot].dsc.data_size;
+    if (f) f.close();
+    xSemaphoreTake(artMutex, portMAX_DELAY);
+    if (slot >= 0) {
+        slots[slot].busy = false;
+        if (ok) {
+            slots[slot].key = key;
+            slots[slot].used = ++slotTick;
+            return slot;
+        }
+    }
+    return findSlot(key); // by the other task
+}
+
+// Not while the card sleeps, the slot stays dirty. artMutex is taken on entry and on return, it is free while
+// the file is written
+static bool writeSlot(ca_slot_t* s) {
+    char name[96];
+    artFileName(s->key, name, sizeof(name));
+    if (s->busy || !SD_AcquireAwake()) return false;
+    s->busy = true;
+    xSemaphoreGive(artMutex);
+    File f = artFs->open(name, FILE_WRITE);
+    bool ok = f && f.write((const uint8_t*)&s->dsc.header, sizeof(lv_img_header_t)) == sizeof(lv_img_header_t) &&
+              f.write(s->dsc.data, s->dsc.data_size) == s->dsc.data_size;
+    if (f) f.close();
+    if (!ok) artFs->remove(name); // a short file would be read as missing anyway
+    SD_Release();
+    xSemaphoreTake(artMutex, portMAX_DELAY);
+    s->busy = false;
+    s->dirty = !ok;
+    return ok;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// Picture source
+
+static bool sourceRaw(ca_source_t* s, uint8_t* b) {
+    if (s->inPos == s->inLen) {
+        while (!s->left) {
+            if (s->range >= s->pic->rangeCount) return false;
+            if (!s->f.seek(s->pic->ranges[2 * s->range])) return false;
+            s->left = s->pic->ranges[2 * s->range + 1];
+            s->range++;
+        }
+        int32_t n = s->f.read(s->in, min((uint32_t)sizeof(s->in), s->left));
+        if (n <= 0) return false;
+        s->left -= n;
+        s->inPos = 0;
+        s->inLen = n;
+    }
+    *b = s->in[s->inPos++];
+    return true;
+}
+
+static bool sourceByte(ca_source_t* s, uint8_t* b) {
+    if (s->headPos < s->headLen) {
+        *b = s->head[s->headPos++];
+        return true;
+    }
+    if (s->end) return false;
+    if (!s->pic->base64) {
+        s->end = !sourceRaw(s, b);
+        return !s->end;
+    }
+    while (s->nbits < 8) {
+        uint8_t c;
+        if (!sourceRaw(s, &c) || c == '=') {
+            s->end = true;
+            return false;
+        }
+        int v = (c >= 'A' && c <= 'Z') ? c - 'A' : (c >= 'a' && c <= 'z') ? c - 'a' + 26 :
+                (c >= '0' && c <= '9') ? c - '0' + 52 : (c == '+') ? 62 : (c == '/') ? 63 : -1;
+        if (v < 0) continue; // line breaks
+        s->bits = (s->bits << 6) | v;
+        s->nbits += 6;
+    }
+    s->nbits -= 8;
+    *b = (uint8_t)(s->bits >> s->nbits);
+    return true;
+}
+
+static size_t sourceRead(ca_source_t* s, uint8_t* buf, size_t len) {
+    size_t n = 0;
+    uint8_t skip;
+    while (n < len && sourceByte(s, buf ? buf + n : &skip)) n++; // buf NULL: skip
+    return n;
+}
+
+// Open the file of the picture (from PSRAM if the track is there) and read up to the image, returns its type
+static char sourceOpen(ca_source_t* s, const ca_picture_t* pic) {
+    bool cached = TrackCache_Contains(pic->path);
+    if (!cached && !SD_AcquireAwake()) return 0; // the track plays from PSRAM, the card is not woken for this
+    s->f = cached ? TrackCache_FS().open(pic->path) : SD_FS().open(pic->path);
+    if (!cached) SD_Release(); // the open file holds the card
+    if (!s->f) return 0;
+    s->pic = pic;
+    s->range = 0;
+    s->left = 0;
+    s->bits = 0;
+    s->nbits = 0;
+    s->end = false;
+    s->inPos = s->inLen = 0;
+    s->headPos = s->headLen = 0;
+    uint16_t n = sourceRead(s, s->head, sizeof(s->head));
+    for (uint16_t i = 0; i + 8 <= n; i++) {
+        const uint8_t* p = s->head + i;
+        char type = (p[0] == 0xFF && p[1] == 0xD8 && p[2] == 0xFF) ? 'J' : (memcmp(p, "\x89PNG\r\n\x1a\n", 8) == 0) ? 'P' : 0;
+        if (type) {
+            s->headPos = i;
+            s->headLen = n;
+            return type;
+        }
+    }
+    return '?';
+}
+
+static void sourceClose(ca_source_t* s) {
+    s->f.close();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// JPEG
+
+static size_t jpegInput(JDEC* jd, uint8_t* buf, size_t len) {
+    ca_jpeg_t* j = (ca_jpeg_t*)jd->device;
+    return sourceRead(j->src, buf, len);
+}
+
+static int jpegOutput(JDEC* jd, void* bitmap, JRECT* rect) {
+    ca_jpeg_t* j = (ca_jpeg_t*)jd->device;
+    const uint8_t* p = (const uint8_t*)bitmap;
+    uint32_t rw = rect->right - rect->left + 1;
+    for (uint32_t y = rect->top; y <= rect->bottom; y++, p += rw * 3) {
+        if (y >= j->h || rect->left >= j->w) continue;
+        memcpy(j->rgb + (y * j->w + rect->left) * 3, p, min(rw, j->w - rect->left) * 3);
+    }
+    j->usedW = max(j->usedW, (uint32_t)min((uint32_t)rect->right + 1, j->w));
+    j->usedH = max(j->usedH, (uint32_t)min((uint32_t)rect->bottom + 1, j->h));
+    return 1;
+}
+
+// The centre square of an RGB888 image (stride: pixels per row), averaged down to the slot size and cut to
+// a circle on black
+static void render(const uint8_t* rgb, uint32_t stride, uint32_t w, uint32_t h, lv_color_t* out) {
+    uint32_t side = min(w, h);
+    uint32_t ox = (w - side) / 2, oy = (h - side) / 2;
+    float c = (artSize - 1) / 2.0f, r = artSize / 2.0f;
+    for (uint32_t y = 0; y < artSize; y++) {
+        uint32_t y0 = oy + y * side / artSize, y1 = max(oy + (y + 1) * side / artSize, y0 + 1);
+        for (uint32_t x = 0; x < artSize; x++) {
+            float dx = x - c, dy = y - c;
+            float a = r + 0.5f - sqrtf(dx * dx + dy * dy); // coverage of the edge pixels
+            if (a <= 0) {
+                *out++ = lv_color_black();
+                continue;
+            }
+            if (a > 1) a = 1;
+            uint32_t x0 = ox + x * side / artSize, x1 = max(ox + (x + 1) * side / artSize, x0 + 1);
+            uint32_t sr = 0, sg = 0, sb = 0;
+            for (uint32_t sy = y0; sy < y1; sy++) {
+                const uint8_t* p = rgb + (sy * stride + x0) * 3;
+                for (uint32_t sx = x0; sx < x1; sx++, p += 3) {
+                    sr += p[0];
+                    sg += p[1];
+                    sb += p[2];
+                }
+            }
+            float k = a / ((y1 - y0) * (x1 - x0));
+            *out++ = lv_color_make((uint8_t)(sr * k), (uint8_t)(sg * k), (uint8_t)(sb * k));
+        }
+    }
+}
+
+// Decode the picture at the 1/2...1/8 scale that is still at least the slot size, then average it down
+static bool decodeJpeg(ca_source_t* src, lv_color_t* out) {
+    void* pool = heap_caps_malloc(COVER_ART_JPEG_POOL, MALLOC_CAP_INTERNAL);
+    if (!pool) return false;
+    ca_jpeg_t j = {};
+    j.src = src;
+    JDEC jd;
+    JRESULT rc = jd_prepare(&jd, jpegInput, pool, COVER_ART_JPEG_POOL, &j);
+    if (rc == JDR_OK) {
+        uint8_t scale = 3;
+        while (scale && min(jd.width, jd.height) >> scale < artSize) scale--;
+        j.w = (jd.width + (1 << scale) - 1) >> scale;
+        j.h = (jd.height + (1 << scale) - 1) >> scale;
+        if (j.w * j.h * 3 <= COVER_ART_MAX_STAGE) {
+            j.rgb = (uint8_t*)heap_caps_calloc(j.w * j.h, 3, MALLOC_CAP_SPIRAM);
+        }
+        rc = j.rgb ? jd_decomp(&jd, jpegOutput, scale) : JDR_MEM1;
+        Serial.printf("Cover art: JPEG %ux%u, 1/%u\n", jd.width, jd.height, 1 << scale);
+    }
+    free(pool);
+    bool ok = (rc == JDR_OK && j.usedW && j.usedH);
+    if (ok) render(j.rgb, j.w, j.usedW, j.usedH, out);
+    if (j.rgb) free(j.rgb);
+    if (!ok) Serial.printf("Cover art: JPEG error %d\n", rc);
+    return ok;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// A track starts: its art from a slot or the directory, else nothing until its picture is decoded
+static void showArt(const char* path) {
+    uint32_t key = path[0] ? artKey(path) : 0;
+    xSemaphoreTake(artMutex, portMAX_DELAY);
+    wantedKey = key;
+    int slot = key ? findSlot(key) : -1;
+    if (key && slot < 0) slot = loadSlot(key);
+    if (slot >= 0) slots[slot].used = ++slotTick;
+    publish(slot);
+    xSemaphoreGive(artMutex);
+}
+
+// The library has seen a picture in a file: decode it unless the art of its album is there
+static void decodeArt(const ca_picture_t* pic) {
+    uint32_t key = artKey(pic->path);
+    xSemaphoreTake(artMutex, portMAX_DELAY);
+    int slot = findSlot(key);
+    if (slot < 0) slot = loadSlot(key);
+    if (slot >= 0) {
+        if (key == wantedKey) publish(slot);
+        xSemaphoreGive(artMutex);
+        return;
+    }
+    slot = decoding = freeSlot(); // the mutex is free while decoding
+    xSemaphoreGive(artMutex);
+    if (slot < 0) return;
+
+    uint32_t t0 = millis();
+    bool ok = false;
+    char type = sourceOpen(&source, pic);
+    if (type == 'J') ok = decodeJpeg(&source, (lv_color_t*)slots[slot].dsc.data);
+    if (type) sourceClose(&source);
+    if (type == 'P') Serial.printf("Cover art: %s, PNG is not decoded\n", pic->path);
+    if (ok) Serial.printf("Cover art: %s in %lu ms\n", pic->path, (long unsigned int)(millis() - t0));
+
+    xSemaphoreTake(artMutex, portMAX_DELAY);
+    decoding = -1;
+    if (!ok) {
+        xSemaphoreGive(artMutex);
+        return;
+    }
+    ca_slot_t* s = &slots[slot];
+    s->key = key;
+    s->used = ++slotTick;
+    s->dirty = true;
+    if (key == wantedKey) publish(slot); // shown before it is written
+    writeSlot(s);
+    xSemaphoreGive(artMutex);
+}
+
+static void CoverArt_Task(void* parameter) {
+    char path[COVER_ART_PATH_LEN];
+    artFs->mkdir(artDir);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (true) {
+            xSemaphoreTake(requestMutex, portMAX_DELAY);
+            bool show = pendingShowRequest, found = pendingPictureRequest;
+            if (show) strlcpy(path, pendingShow, sizeof(path));
+            if (found) picture = pendingPicture;
+            pendingShowRequest = pendingPictureRequest = false;
+            xSemaphoreGive(requestMutex);
+            if (!show && !found) break;
+
+            if (show) showArt(path);
+            if (found) decodeArt(&picture);
+        }
+    }
+}
+
+bool CoverArt_Init(fs::FS& fs, const char* dir, uint16_t size) {
+    if (artMutex) return true;
+    for (int i = 0; i < COVER_ART_SLOTS; i++) {
+        slots[i] = {};
+        slots[i].dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+        slots[i].dsc.header.w = size;
+        slots[i].dsc.header.h = size;
+        slots[i].dsc.data_size = (uint32_t)size * size * sizeof(lv_color_t);
+        slots[i].dsc.data = (const uint8_t*)heap_caps_malloc(slots[i].dsc.data_size, MALLOC_CAP_SPIRAM);
+        if (!slots[i].dsc.data) {
+            for (int k = 0; k < i; k++) free((void*)slots[k].dsc.data);
+            Serial.println("Cover art: no PSRAM");
+            return false;
+        }
+    }
+    artFs = &fs;
+    strlcpy(artDir, dir, sizeof(artDir));
+    artSize = size;
+    requestMutex = xSemaphoreCreateMutex();
+    artMutex = xSemaphoreCreateMutex();
+    if (xTaskCreatePinnedToCore(CoverArt_Task, "CoverArt", 6144, NULL, 1, &artTaskHandle, 0) != pdPASS) {
+        vSemaphoreDelete(artMutex);
+        vSemaphoreDelete(requestMutex);
+        artMutex = NULL;
+        Serial.println("Cover art: task not created");
+        return false;
+    }
+    return true;
+}
+
+void CoverArt_Show(const char* path) {
+    if (!artMutex) return;
+    xSemaphoreTake(requestMutex, portMAX_DELAY); // only held to copy a request
+    strlcpy(pendingShow, path ? path : "", sizeof(pendingShow));
+    pendingShowRequest = true;
+    xSemaphoreGive(requestMutex);
+    xTaskNotifyGive(artTaskHandle);
+}
+
+void CoverArt_Prefetch(const char* path) {
+    if (!artMutex || !path || SD_IsSleeping()) return; // loadSlot() would not read either
+    uint32_t key = artKey(path);
+    xSemaphoreTake(artMutex, portMAX_DELAY);
+    int slot = findSlot(key);
+    if (slot < 0) slot = loadSlot(key);
+    if (slot >= 0) slots[slot].used = ++slotTick;
+    xSemaphoreGive(artMutex);
+}
+
+static void queuePicture(const char* path, const uint32_t* ranges, uint32_t count, bool base64) {
+    if (!artMutex || !path || !count || count > COVER_ART_MAX_RANGES || strlen(path) >= COVER_ART_PATH_LEN) return;
+    xSemaphoreTake(requestMutex, portMAX_DELAY);
+    strlcpy(pendingPicture.path, path, sizeof(pendingPicture.path));
+    memcpy(pendingPicture.ranges, ranges, count * 2 * sizeof(uint32_t));
+    pendingPicture.rangeCount = count;
+    pendingPicture.base64 = base64;
+    pendingPictureRequest = true;
+    xSemaphoreGive(requestMutex);
+    xTaskNotifyGive(artTaskHandle);
+}
+
+void CoverArt_Found(const char* path, uint32_t pos, uint32_t len) {
+    uint32_t range[2] = {pos, len};
+    queuePicture(path, range, 1, false);
+}
+
+void CoverArt_FoundOgg(const char* path, const std::vector<uint32_t>& segments) {
+    queuePicture(path, segments.data(), segments.size() / 2, true);
+}
+
+bool CoverArt_Changed(uint32_t* version, const lv_img_dsc_t** art) {
+    if (!artMutex || xSemaphoreTake(artMutex, 0) != pdTRUE) return false; // the UI does not wait, next frame
+    bool changed = (*version != artVersion);
+    if (changed) {
+        *version = artVersion;
+        displayed = published;
+        *art = (published >= 0) ? &slots[published].dsc : NULL;
+    }
+    xSemaphoreGive(artMutex);
+    return changed;
+}
+
+void CoverArt_Flush() {
+    if (!artMutex) return;
+    xSemaphoreTake(artMutex, portMAX_DELAY);
+    for (int i = 0; i < COVER_ART_SLOTS; i++) {
+        if (slots[i].key && slots[i].dirty) writeSlot(&slots[i]); // busy: written by the task
+    }
+    xSemaphoreGive(artMutex);
+}
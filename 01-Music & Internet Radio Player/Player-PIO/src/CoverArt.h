@@ -0,0 +1,35 @@
+#pragma once
+#include "Arduino.h"
+#include "FS.h"
+#include "lvgl.h"
+#include <vector>
+
+// Cover art from the embedded picture of a track (ID3 APIC/PIC, FLAC PICTURE, Ogg METADATA_BLOCK_PICTURE, MP4 covr),
+// decoded once and kept in a directory on the SD card as a ready-to-blit image: LVGL's binary image format
+// (lv_img_header_t and RGB565 pixels), a square of size pixels cut to a circle on black (the screen background).
+// Later plays read one file, nothing is decoded. The files are named by artist and album of the track in the
+// library index (by the path for tracks without tags), the tracks of an album share one file.
+//
+// JPEG is decoded by tjpgd (LVGL's sjpg) with its 1/2...1/8 scaling, the full image is never in memory.
+// Progressive JPEG and PNG pictures are skipped (LVGL's lodepng holds the whole image in its 48 KB pool).
+
+// Create the directory and start the task (low priority, core 0), false: no PSRAM
+bool CoverArt_Init(fs::FS& fs, const char* dir, uint16_t size);
+
+// The art of the track that plays now (NULL: none, e.g. a radio station), from PSRAM or the directory, else it
+// is shown when the library reports the embedded picture
+void CoverArt_Show(const char* path);
+
+// Read the art of a track into PSRAM while the card is awake (the next track), returns at once if it is there
+void CoverArt_Prefetch(const char* path);
+
+// The position of an embedded picture, from the library callbacks audio_id3image() / audio_oggimage()
+// (audio task, the request is only queued), segments: file offset and length pairs of base64 text
+void CoverArt_Found(const char* path, uint32_t pos, uint32_t len);
+void CoverArt_FoundOgg(const char* path, const std::vector<uint32_t>& segments);
+
+// New art to show since *version (LVGL task), *art is NULL if there is none, it stays valid until the next change
+bool CoverArt_Changed(uint32_t* version, const lv_img_dsc_t** art);
+
+// Write the art that was decoded while the SD card was sleeping (nothing is written while it sleeps)
+void CoverArt_Flush();
@@ -0,0 +1,998 @@
+#include "MediaLibrary.h"
+#include "SD_Card.h"
+#include "dsp/tag_reader.h"
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define ML_PAGE_SIZE 512                // SD sector
+#define ML_PAGES 8                      // cached pages of the index file, internal RAM
+#define ML_TAG_WRITE_MS 20000           // the tag reader rewrites the index at most this often
+#define ML_TAG_PENDING_BYTES (128 * 1024) // or when this much is waiting (PSRAM)
+
+// Extensions of the files the audio library decodes, ml_track_t.codec is the position in this list
+static const char* const codecExt[] = {"", ".mp3", ".m4a", ".aac", ".flac", ".wav", ".ogg", ".opus"};
+#define ML_CODEC_COUNT (sizeof(codecExt) / sizeof(codecExt[0]))
+
+static_assert(sizeof(ml_track_t) == 32, "ml_track_t is a file record");
+static_assert(ML_PAGE_SIZE % sizeof(ml_track_t) == 0, "records must not span pages");
+
+// Open index
+static fs::FS* libFs = NULL;
+static char libPath[64];
+static File libFile;
+static ml_header_t header;
+static bool libOpen = false;
+static SemaphoreHandle_t libMutex = NULL;  // the index file and the page cache
+static volatile uint32_t libGeneration = 0; // counts the opened indexes, track numbers of one stay valid
+
+static struct {
+    uint32_t page;                      // UINT32_MAX: empty
+    uint32_t lastUse;
+    uint8_t data[ML_PAGE_SIZE];
+} pages[ML_PAGES];
+static uint32_t pageClock = 0;
+
+static void invalidatePages() {
+    for (int i = 0; i < ML_PAGES; i++) {
+        pages[i].page = UINT32_MAX;
+        pages[i].lastUse = 0;
+    }
+}
+
+// A page of the index file, the least recently used one is replaced, the file is opened again if it was
+// suspended or the card was unmounted meanwhile
+static const uint8_t* getPage(uint32_t page) {
+    int victim = 0;
+    for (int i = 0; i < ML_PAGES; i++) {
+        if (pages[i].page == page) {
+            pages[i].lastUse = ++pageClock;
+            return pages[i].data;
+        }
+        if (pages[i].lastUse < pages[victim].lastUse) victim = i;
+    }
+    pages[victim].page = UINT32_MAX;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!libFile) {
+            libFile = libFs->open(libPath);
+        }
+        if (libFile && libFile.seek(page * ML_PAGE_SIZE)) {
+            int n = libFile.read(pages[victim].data, ML_PAGE_SIZE);
+            if (n > 0) {
+                memset(pages[victim].data + n, 0, ML_PAGE_SIZE - n);
+                pages[victim].page = page;
+                pages[victim].lastUse = ++pageClock;
+                return pages[victim].data;
+            }
+        }
+        libFile.close();
+        libFile = File();
+    }
+    return NULL;
+}
+
+static bool readAt(uint32_t offset, void* dst, uint32_t len) {
+    uint8_t* p = (uint8_t*)dst;
+    while (len) {
+        const uint8_t* page = getPage(offset / ML_PAGE_SIZE);
+        if (!page) return false;
+        uint32_t pos = offset % ML_PAGE_SIZE;
+        uint32_t n = min(len, (uint32_t)(ML_PAGE_SIZE - pos));
+        memcpy(p, page + pos, n);
+        p += n;
+        offset += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool readString(uint32_t ref, char* buf, size_t len) {
+    if (!len) return false;
+    buf[0] = '\0';
+    if (ref >= header.poolSize) return false;
+    uint32_t n = min((uint32_t)len - 1, header.poolSize - ref);
+    if (!readAt(header.poolOffset + ref, buf, n)) return false;
+    buf[n] = '\0';
+    return true;
+}
+
+static bool openLocked(fs::FS& fs, const char* indexPath) {
+    libFile.close();
+    libFile = File();
+    libOpen = false;
+    invalidatePages();
+    libFs = &fs;
+    strlcpy(libPath, indexPath, sizeof(libPath));
+    if (!getPage(0)) return false;
+    memcpy(&header, pages[0].data, sizeof(header)); // the header fits into the first page
+    if (memcmp(header.magic, ML_MAGIC, 4) != 0 || header.version != ML_VERSION ||
+        header.trackSize != sizeof(ml_track_t)) {
+        Serial.printf("Media library: %s is not a version %d index\n", indexPath, ML_VERSION);
+        return false;
+    }
+    libOpen = true;
+    libGeneration = libGeneration + 1;
+    return true;
+}
+
+bool MediaLibrary_Open(fs::FS& fs, const char* indexPath) {
+    if (!libMutex) libMutex = xSemaphoreCreateMutex();
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    bool ret = openLocked(fs, indexPath);
+    xSemaphoreGive(libMutex);
+    if (ret) {
+        Serial.printf("Media library: %lu tracks in %lu directories\n", (long unsigned int)header.trackCount,
+                      (long unsigned int)header.dirCount);
+    }
+    return ret;
+}
+
+void MediaLibrary_Suspend() {
+    if (!libMutex) return;
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    libFile.close();
+    libFile = File();
+    xSemaphoreGive(libMutex);
+}
+
+uint32_t MediaLibrary_Count() {
+    return libOpen ? header.trackCount : 0;
+}
+
+uint32_t MediaLibrary_DirCount() {
+    return libOpen ? header.dirCount : 0;
+}
+
+uint32_t MediaLibrary_Sorted(MediaOrder order, uint32_t pos) {
+    if (!libOpen || pos >= header.trackCount || order >= ML_ORDER_COUNT) return UINT32_MAX;
+    if (order == ML_ORDER_FILE) return pos;
+    uint32_t track = UINT32_MAX;
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    if (!readAt(header.orderOffset[order] + pos * sizeof(uint32_t), &track, sizeof(track))) track = UINT32_MAX;
+    xSemaphoreGive(libMutex);
+    return track;
+}
+
+bool MediaLibrary_GetTrack(uint32_t track, ml_track_t* t) {
+    if (!libOpen || track >= header.trackCount) return false;
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    bool ret = readAt(header.trackOffset + track * sizeof(ml_track_t), t, sizeof(ml_track_t));
+    xSemaphoreGive(libMutex);
+    return ret;
+}
+
+bool MediaLibrary_GetDir(uint32_t dir, ml_dir_t* d) {
+    if (!libOpen || dir >= header.dirCount) return false;
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    bool ret = readAt(header.dirOffset + dir * sizeof(ml_dir_t), d, sizeof(ml_dir_t));
+    xSemaphoreGive(libMutex);
+    return ret;
+}
+
+bool MediaLibrary_GetString(uint32_t ref, char* buf, size_t len) {
+    if (!libOpen) return false;
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    bool ret = readString(ref, buf, len);
+    xSemaphoreGive(libMutex);
+    return ret;
+}
+
+bool MediaLibrary_GetPath(uint32_t track, char* buf, size_t len) {
+    ml_track_t t;
+    ml_dir_t d;
+    char name[MEDIA_NAME_LEN];
+    if (!libOpen || track >= header.trackCount || len < 2) return false;
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    bool ret = readAt(header.trackOffset + track * sizeof(ml_track_t), &t, sizeof(t)) &&
+               readAt(header.dirOffset + t.dir * sizeof(ml_dir_t), &d, sizeof(d)) &&
+               readString(d.path, buf, len) && readString(t.name, name, sizeof(name));
+    xSemaphoreGive(libMutex);
+    if (!ret) return false;
+    size_t n = strlen(buf);
+    if (n > 1) buf[n++] = '/'; // not the root
+    if (n + strlen(name) >= len) return false;
+    strcpy(buf + n, name);
+    return true;
+}
+
+// Directory record by path, binary search (libMutex taken)
+static bool findDirLocked(const char* path, ml_dir_t* d) {
+    char buf[MEDIA_PATH_LEN];
+    uint32_t lo = 0, hi = libOpen ? header.dirCount : 0;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (!readAt(header.dirOffset + mid * sizeof(ml_dir_t), d, sizeof(ml_dir_t)) ||
+            !readString(d->path, buf, sizeof(buf))) {
+            return false;
+        }
+        int r = strcasecmp(path, buf);
+        if (!r) return true;
+        if (r < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return false;
+}
+
+// Track of a directory by file name, binary search (libMutex taken)
+static uint32_t findTrackLocked(const ml_dir_t* d, const char* name, ml_track_t* t) {
+    char buf[MEDIA_PATH_LEN];
+    uint32_t lo = d->firstTrack, hi = d->firstTrack + d->trackCount;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (!readAt(header.trackOffset + mid * sizeof(ml_track_t), t, sizeof(ml_track_t)) ||
+            !readString(t->name, buf, sizeof(buf))) {
+            break;
+        }
+        int r = strcasecmp(name, buf);
+        if (!r) return mid;
+        if (r < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return UINT32_MAX;
+}
+
+// Track number of a path, binary search over the directories and the tracks of the directory
+uint32_t MediaLibrary_Find(const char* path) {
+    if (!libOpen || !path || path[0] != '/') return UINT32_MAX;
+    char dirPath[MEDIA_PATH_LEN];
+    strlcpy(dirPath, path, sizeof(dirPath));
+    char* slash = strrchr(dirPath, '/');
+    const char* name = path + (slash - dirPath) + 1;
+    slash[slash == dirPath ? 1 : 0] = '\0';
+
+    uint32_t track = UINT32_MAX;
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    ml_dir_t d;
+    ml_track_t t;
+    if (findDirLocked(dirPath, &d)) {
+        track = findTrackLocked(&d, name, &t);
+    }
+    xSemaphoreGive(libMutex);
+    return track;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// Build, everything in PSRAM until the file is written
+
+typedef struct {
+    uint8_t* data;
+    uint32_t len;
+    uint32_t cap;
+} ml_buf_t;
+
+typedef struct {
+    fs::FS* fs;
+    char mount[32];                     // directories are read with opendir(), files are not opened
+    char root[MEDIA_PATH_LEN];
+    char indexPath[64];
+    bool reuse;                         // tracks of unchanged directories are taken from the open index
+    uint32_t entriesPerSec;             // 0: no limit
+    void (*done)(bool changed);
+} ml_scan_t;
+
+typedef struct {
+    ml_buf_t pool;
+    ml_buf_t dirs;
+    ml_buf_t tracks;
+    ml_buf_t files;                     // audio file names of the directory that is read
+    uint32_t* slots;                    // hash table of the pool, offsets, 0: empty
+    uint32_t mask;
+    uint32_t count;
+    bool failed;                        // out of memory
+} ml_build_t;
+
+static SemaphoreHandle_t buildMutex = NULL;  // one build at a time, the sort context below
+static ml_scan_t asyncScan;
+
+// Progress of the running (or the last) scan
+static volatile bool scanRunning = false;
+static volatile uint32_t scanDirs = 0;
+static volatile uint32_t scanKnownDirs = 0;
+static volatile uint32_t scanChanged = 0;
+static volatile uint32_t scanTracks = 0;
+static volatile uint32_t scanMs = 0;
+static uint32_t scanEntries = 0;            // directory entries listed
+static uint32_t scanLimitMs = 0;            // of scanMs spent waiting for the bandwidth limit
+static volatile bool tagRunning = false;
+static volatile uint32_t tagFiles = 0;       // files read by the tag reader
+
+static bool bufReserve(ml_buf_t* b, uint32_t n) {
+    if (b->len + n > b->cap) {
+        uint32_t cap = b->cap ? b->cap : 4096;
+        while (cap < b->len + n) cap *= 2;
+        uint8_t* p = (uint8_t*)ps_realloc(b->data, cap);
+        if (!p) return false;
+        b->data = p;
+        b->cap = cap;
+    }
+    return true;
+}
+
+static bool bufAppend(ml_buf_t* b, const void* src, uint32_t n) {
+    if (!bufReserve(b, n)) return false;
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+    return true;
+}
+
+static uint32_t hashString(const char* s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+    return h;
+}
+
+static bool growSlots(ml_build_t* b) {
+    uint32_t size = b->slots ? (b->mask + 1) * 2 : 1024;
+    uint32_t* slots = (uint32_t*)ps_calloc(size, sizeof(uint32_t));
+    if (!slots) return false;
+    for (uint32_t i = 0; b->slots && i <= b->mask; i++) {
+        if (!b->slots[i]) continue;
+        uint32_t h = hashString((const char*)b->pool.data + b->slots[i]) & (size - 1);
+        while (slots[h]) h = (h + 1) & (size - 1);
+        slots[h] = b->slots[i];
+    }
+    free(b->slots);
+    b->slots = slots;
+    b->mask = size - 1;
+    return true;
+}
+
+// Offset of the string in the pool, every string is stored once
+static uint32_t intern(ml_build_t* b, const char* s) {
+    if (!*s || b->failed) return 0;
+    if ((b->count + 1) * 2 > b->mask + 1 && !growSlots(b)) {
+        b->failed = true;
+        return 0;
+    }
+    uint32_t h = hashString(s) & b->mask;
+    while (b->slots[h]) {
+        if (strcmp((const char*)b->pool.data + b->slots[h], s) == 0) return b->slots[h];
+        h = (h + 1) & b->mask;
+    }
+    uint32_t offset = b->pool.len;
+    if (!bufAppend(&b->pool, s, strlen(s) + 1)) {
+        b->failed = true;
+        return 0;
+    }
+    b->slots[h] = offset;
+    b->count++;
+    return offset;
+}
+
+static uint8_t codecFromName(const char* name) {
+    const char* dot = strrchr(name, '.');
+    if (!dot) return 0;
+    for (uint8_t i = 1; i < ML_CODEC_COUNT; i++) {
+        if (strcasecmp(dot, codecExt[i]) == 0) return i;
+    }
+    return 0;
+}
+
+static const char* baseName(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// qsort has no context pointer, the build runs under buildMutex
+static const char* sortPool;
+static const ml_dir_t* sortDirs;
+static const ml_track_t* sortTracks;
+
+#define POOL(ref) (sortPool + (ref))
+
+static int cmpDirs(const void* a, const void* b) {
+    return strcasecmp(POOL(sortDirs[*(const uint32_t*)a].path), POOL(sortDirs[*(const uint32_t*)b].path));
+}
+
+static int cmpFileOrder(const void* a, const void* b) {
+    const ml_track_t* ta = (const ml_track_t*)a;
+    const ml_track_t* tb = (const ml_track_t*)b;
+    if (ta->dir != tb->dir) return ta->dir < tb->dir ? -1 : 1;
+    return strcasecmp(POOL(ta->name), POOL(tb->name));
+}
+
+static int cmpNumbers(uint32_t a, uint32_t b) {
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static int cmpArtist(const void* a, const void* b) {
+    uint32_t na = *(const uint32_t*)a, nb = *(const uint32_t*)b;
+    const ml_track_t* ta = &sortTracks[na];
+    const ml_track_t* tb = &sortTracks[nb];
+    int r = strcasecmp(POOL(ta->artist), POOL(tb->artist));
+    if (!r) r = strcasecmp(POOL(ta->album), POOL(tb->album));
+    if (!r) r = cmpNumbers(ta->trackNo, tb->trackNo);
+    if (!r) r = strcasecmp(POOL(ta->title), POOL(tb->title));
+    return r ? r : cmpNumbers(na, nb);
+}
+
+static int cmpAlbum(const void* a, const void* b) {
+    uint32_t na = *(const uint32_t*)a, nb = *(const uint32_t*)b;
+    const ml_track_t* ta = &sortTracks[na];
+    const ml_track_t* tb = &sortTracks[nb];
+    int r = strcasecmp(POOL(ta->album), POOL(tb->album));
+    if (!r) r = strcasecmp(POOL(ta->artist), POOL(tb->artist)); // albums of the same name
+    if (!r) r = cmpNumbers(ta->trackNo, tb->trackNo);
+    if (!r) r = strcasecmp(POOL(ta->title), POOL(tb->title));
+    return r ? r : cmpNumbers(na, nb);
+}
+
+static int cmpTitle(const void* a, const void* b) {
+    uint32_t na = *(const uint32_t*)a, nb = *(const uint32_t*)b;
+    const ml_track_t* ta = &sortTracks[na];
+    const ml_track_t* tb = &sortTracks[nb];
+    int r = strcasecmp(POOL(ta->title), POOL(tb->title));
+    if (!r) r = strcasecmp(POOL(ta->artist), POOL(tb->artist));
+    return r ? r : cmpNumbers(na, nb);
+}
+
+// The directory record of the open index
+static bool findIndexDir(const char* path, ml_dir_t* d) {
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    bool found = findDirLocked(path, d);
+    xSemaphoreGive(libMutex);
+    return found;
+}
+
+// The strings of a record of the open index into the new pool
+static bool internIndexTrack(ml_build_t* b, ml_track_t* t) {
+    char buf[MEDIA_PATH_LEN];
+    uint32_t* refs[] = {&t->name, &t->title, &t->artist, &t->album};
+    for (uint32_t** ref = refs; ref < refs + 4; ref++) {
+        if (!MediaLibrary_GetString(**ref, buf, sizeof(buf))) return false;
+        **ref = intern(b, buf);
+    }
+    return true;
+}
+
+// The records of an unchanged directory from the open index
+static bool copyIndexTracks(ml_build_t* b, const ml_dir_t* old, uint32_t dir) {
+    for (uint32_t i = old->firstTrack; i < old->firstTrack + old->trackCount && !b->failed; i++) {
+        ml_track_t t;
+        if (!MediaLibrary_GetTrack(i, &t) || !internIndexTrack(b, &t)) return false;
+        t.dir = dir;
+        if (!bufAppend(&b->tracks, &t, sizeof(t))) b->failed = true;
+    }
+    return true;
+}
+
+// The record of a file of a changed directory from the open index if the size is the same, the tags stay
+static bool findIndexTrack(ml_build_t* b, const ml_dir_t* old, const char* name, uint32_t size, ml_track_t* t) {
+    xSemaphoreTake(libMutex, portMAX_DELAY);
+    bool found = findTrackLocked(old, name, t) != UINT32_MAX && t->size == size;
+    xSemaphoreGive(libMutex);
+    return found && internIndexTrack(b, t);
+}
+
+// dir + "/" + name into out (no "/" behind the root), the caller has checked that it fits
+static void joinPath(char* out, const char* dir, size_t dirLen, const char* name) {
+    memcpy(out, dir, dirLen);
+    if (dirLen > 1) out[dirLen++] = '/';
+    memcpy(out + dirLen, name, strlen(name) + 1);
+}
+
+// Read every directory once (breadth first, the directory list is the queue). The directories are listed
+// with readdir(), nothing is opened. Count and names of the entries are the fingerprint of a directory,
+// if it matches the open index, the tracks are copied from there, otherwise the audio files are read (stat).
+static bool walkTree(const ml_scan_t* scan, ml_build_t* b) {
+    ml_dir_t rootDir = {intern(b, scan->root), 0, 0, 0, 0, 0};
+    if (!bufAppend(&b->dirs, &rootDir, sizeof(rootDir))) return false;
+    uint32_t t0 = millis();
+    uint32_t entries = 0;
+    for (uint32_t d = 0; d < b->dirs.len / sizeof(ml_dir_t) && !b->failed; d++) {
+        char path[MEDIA_PATH_LEN];
+        char real[sizeof(scan->mount) + MEDIA_PATH_LEN]; // path + "/" + name fit into MEDIA_PATH_LEN
+        strlcpy(path, (const char*)b->pool.data + ((ml_dir_t*)b->dirs.data)[d].path, sizeof(path));
+        size_t pathLen = strlen(path);
+        size_t mountLen = strlcpy(real, scan->mount, sizeof(scan->mount));
+        strlcpy(real + mountLen, path, MEDIA_PATH_LEN);
+        DIR* dir = opendir(real);
+        if (!dir) continue;
+
+        uint32_t count = 0, namesHash = 0;
+        b->files.len = 0;
+        struct dirent* e;
+        while ((e = readdir(dir)) != NULL && !b->failed) {
+            const char* name = e->d_name;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+            bool isDir = e->d_type == DT_DIR;
+            if (name[0] == '.' || strcmp(name, "System Volume Information") == 0 ||
+                pathLen + strlen(name) + 2 > sizeof(path) || strlen(name) >= MEDIA_NAME_LEN) {
+                continue; // not in the fingerprint either (the index file itself)
+            }
+            count++;
+            namesHash += hashString(name) ^ (isDir ? 0x9e3779b9u : 0); // independent of the order
+            if (isDir) {
+                char child[MEDIA_PATH_LEN];
+                joinPath(child, path, pathLen, name);
+                ml_dir_t sub = {intern(b, child), d, 0, 0, 0, 0};
+                if (!bufAppend(&b->dirs, &sub, sizeof(sub))) b->failed = true;
+            } else if (codecFromName(name)) {
+                if (!bufAppend(&b->files, name, strlen(name) + 1)) b->failed = true;
+            }
+        }
+        closedir(dir);
+        ((ml_dir_t*)b->dirs.data)[d].entries = count;
+        ((ml_dir_t*)b->dirs.data)[d].namesHash = namesHash;
+
+        ml_dir_t old;
+        bool known = scan->reuse && findIndexDir(path, &old);
+        if (!(known && old.entries == count && old.namesHash == namesHash && copyIndexTracks(b, &old, d))) {
+            scanChanged = scanChanged + 1;
+            for (uint32_t pos = 0; pos < b->files.len && !b->failed;) {
+                const char* name = (const char*)b->files.data + pos;
+                pos += strlen(name) + 1;
+                struct stat st;
+                joinPath(real + mountLen, path, pathLen, name);
+                uint32_t size = stat(real, &st) == 0 ? st.st_size : 0;
+                ml_track_t t = {};
+                if (!(known && findIndexTrack(b, &old, name, size, &t))) {
+                    t = {};
+                    t.size = size;
+                    t.name = intern(b, name);
+                    t.codec = codecFromName(name);
+                }
+                t.dir = d;
+                if (!bufAppend(&b->tracks, &t, sizeof(t))) b->failed = true;
+            }
+        }
+        scanDirs = d + 1;
+        scanTracks = b->tracks.len / sizeof(ml_track_t);
+
+        // Bandwidth limit: entries per second, playback and the UI share the card
+        entries += count + 1;
+        uint32_t due = scan->entriesPerSec ? (uint64_t)entries * 1000 / scan->entriesPerSec : 0;
+        uint32_t elapsed = millis() - t0;
+        if (due > elapsed) {
+            scanLimitMs += due - elapsed;
+            vTaskDelay(pdMS_TO_TICKS(due - elapsed));
+        } else if (d % 8 == 7) {
+            vTaskDelay(1); // Release some CPU time
+        }
+    }
+    scanEntries = entries;
+    return !b->failed;
+}
+
+// Names from the folders (artist/album/nn title.ext) for the tracks that were read now
+static void nameTracks(ml_build_t* b, const ml_dir_t* dirs, ml_track_t* tracks, uint32_t trackCount) {
+    char buf[MEDIA_NAME_LEN];
+    for (uint32_t i = 0; i < trackCount && !b->failed; i++) {
+        ml_track_t* t = &tracks[i];
+        const ml_dir_t* d = &dirs[t->dir];
+        if (t->title) continue; // from the index
+        if (t->dir != 0) {
+            strlcpy(buf, baseName((const char*)b->pool.data + d->path), sizeof(buf));
+            t->album = intern(b, buf);
+            if (d->parent != 0) {
+                strlcpy(buf, baseName((const char*)b->pool.data + dirs[d->parent].path), sizeof(buf));
+                t->artist = intern(b, buf);
+            }
+        }
+        strlcpy(buf, (const char*)b->pool.data + t->name, sizeof(buf));
+        char* dot = strrchr(buf, '.');
+        if (dot) *dot = '\0';
+        char* title = buf;
+        if (isdigit((uint8_t)title[0])) {
+            char* end;
+            long n = strtol(title, &end, 10);
+            while (*end == ' ' || *end == '-' || *end == '.' || *end == '_') end++;
+            if (n > 0 && n < 1000 && *end) {
+                t->trackNo = n;
+                title = end;
+            }
+        }
+        t->title = intern(b, title);
+    }
+}
+
+static bool writeAll(File& f, const void* data, uint32_t len) {
+    return f.write((const uint8_t*)data, len) == len;
+}
+
+// Sort the orders, write the index to indexPath.tmp and replace the open index with it (buildMutex taken),
+// dirs and the tracks of b in file order
+static bool writeIndex(fs::FS& fs, const char* indexPath, ml_build_t* b, const ml_dir_t* dirs, uint32_t dirCount) {
+    uint32_t trackCount = b->tracks.len / sizeof(ml_track_t);
+    uint32_t* orders[ML_ORDER_COUNT] = {};
+    char tmpPath[72];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", indexPath);
+    bool ok = true;
+    for (int o = ML_ORDER_FILE + 1; o < ML_ORDER_COUNT; o++) {
+        orders[o] = (uint32_t*)ps_malloc(max(trackCount, (uint32_t)1) * sizeof(uint32_t));
+        if (!orders[o]) {
+            Serial.println("Media library: out of PSRAM");
+            ok = false;
+            break;
+        }
+        sortPool = (const char*)b->pool.data;
+        sortTracks = (const ml_track_t*)b->tracks.data;
+        for (uint32_t i = 0; i < trackCount; i++) orders[o][i] = i;
+        qsort(orders[o], trackCount, sizeof(uint32_t),
+              o == ML_ORDER_ARTIST ? cmpArtist : o == ML_ORDER_ALBUM ? cmpAlbum : cmpTitle);
+    }
+
+    if (ok) {
+        ml_header_t h = {};
+        memcpy(h.magic, ML_MAGIC, 4);
+        h.version = ML_VERSION;
+        h.trackSize = sizeof(ml_track_t);
+        h.trackCount = trackCount;
+        h.dirCount = dirCount;
+        h.dirOffset = sizeof(ml_header_t);
+        h.trackOffset = h.dirOffset + dirCount * sizeof(ml_dir_t);
+        uint32_t offset = h.trackOffset + trackCount * sizeof(ml_track_t);
+        for (int o = ML_ORDER_FILE + 1; o < ML_ORDER_COUNT; o++) {
+            h.orderOffset[o] = offset;
+            offset += trackCount * sizeof(uint32_t);
+        }
+        h.poolOffset = offset;
+        h.poolSize = b->pool.len;
+
+        File f = fs.open(tmpPath, FILE_WRITE);
+        ok = f && writeAll(f, &h, sizeof(h)) && writeAll(f, dirs, dirCount * sizeof(ml_dir_t)) &&
+             writeAll(f, b->tracks.data, trackCount * sizeof(ml_track_t));
+        for (int o = ML_ORDER_FILE + 1; ok && o < ML_ORDER_COUNT; o++) {
+            ok = writeAll(f, orders[o], trackCount * sizeof(uint32_t));
+        }
+        ok = ok && writeAll(f, b->pool.data, b->pool.len);
+        if (f) f.close();
+        if (!ok) {
+            Serial.printf("Media library: writing %s failed\n", tmpPath);
+            fs.remove(tmpPath);
+        }
+    }
+    if (ok) {
+        // Replace the old index, it is closed first
+        xSemaphoreTake(libMutex, portMAX_DELAY);
+        libFile.close();
+        libFile = File();
+        libOpen = false;
+        fs.remove(indexPath);
+        ok = fs.rename(tmpPath, indexPath) && openLocked(fs, indexPath);
+        xSemaphoreGive(libMutex);
+    }
+    for (int o = 0; o < ML_ORDER_COUNT; o++) free(orders[o]);
+    return ok;
+}
+
+// Returns the number of tracks or -1, *changed: a new index was written
+static int buildIndex(const ml_scan_t* scan, bool* changed) {
+    uint32_t t0 = millis();
+    ml_build_t b = {};
+    uint32_t* dirOrder = NULL;
+    uint32_t* dirRank = NULL;
+    ml_dir_t* dirs = NULL;
+    uint32_t trackCount = 0, dirCount = 0;
+    int result = -1;
+    *changed = false;
+
+    xSemaphoreTake(buildMutex, portMAX_DELAY);
+    scanKnownDirs = MediaLibrary_DirCount();
+    scanDirs = scanChanged = scanTracks = 0;
+    scanEntries = scanLimitMs = 0;
+    scanRunning = true;
+    uint8_t zero = 0;
+    // readdir() and stat() go past SD_FS(), the card is held for the walk
+    bool held = SD_Acquire();
+    bool ok = held && bufAppend(&b.pool, &zero, 1) && growSlots(&b) && walkTree(scan, &b); // offset 0: ""
+    if (held) SD_Release();
+    if (ok) {
+        trackCount = b.tracks.len / sizeof(ml_track_t);
+        dirCount = b.dirs.len / sizeof(ml_dir_t);
+        dirOrder = (uint32_t*)ps_malloc(dirCount * sizeof(uint32_t));
+        dirRank = (uint32_t*)ps_malloc(dirCount * sizeof(uint32_t));
+        dirs = (ml_dir_t*)ps_malloc(dirCount * sizeof(ml_dir_t));
+        ok = dirOrder && dirRank && dirs;
+    }
+    // Every directory was found in the index with the same fingerprint and none has gone: nothing to write
+    bool unchanged = ok && scan->reuse && libOpen && !scanChanged && dirCount == header.dirCount;
+    if (ok && !unchanged) {
+        // Directories by path, the tracks of a directory follow each other
+        const ml_dir_t* walked = (const ml_dir_t*)b.dirs.data;
+        ml_track_t* tracks = (ml_track_t*)b.tracks.data;
+        sortPool = (const char*)b.pool.data;
+        sortDirs = walked;
+        for (uint32_t i = 0; i < dirCount; i++) dirOrder[i] = i;
+        qsort(dirOrder + 1, dirCount - 1, sizeof(uint32_t), cmpDirs); // the root stays first
+        for (uint32_t i = 0; i < dirCount; i++) dirRank[dirOrder[i]] = i;
+        for (uint32_t i = 0; i < dirCount; i++) {
+            dirs[i] = walked[dirOrder[i]];
+            dirs[i].parent = dirRank[dirs[i].parent];
+            dirs[i].firstTrack = dirs[i].trackCount = 0;
+        }
+        for (uint32_t i = 0; i < trackCount; i++) tracks[i].dir = dirRank[tracks[i].dir];
+        qsort(tracks, trackCount, sizeof(ml_track_t), cmpFileOrder);
+        for (uint32_t i = trackCount; i-- > 0;) {
+            dirs[tracks[i].dir].firstTrack = i;
+            dirs[tracks[i].dir].trackCount++;
+        }
+        for (uint32_t i = 0; i < dirCount; i++) {
+            if (!dirs[i].trackCount) dirs[i].firstTrack = 0;
+        }
+
+        nameTracks(&b, dirs, tracks, trackCount);
+        ok = !b.failed;
+    }
+    if (!ok) {
+        Serial.println("Media library: out of PSRAM");
+    }
+    if (ok && !unchanged) {
+        ok = writeIndex(*scan->fs, scan->indexPath, &b, dirs, dirCount);
+        *changed = ok;
+    }
+    scanMs = millis() - t0;
+    scanRunning = false;
+    xSemaphoreGive(buildMutex);
+
+    free(dirOrder);
+    free(dirRank);
+    free(dirs);
+    free(b.slots);
+    free(b.pool.data);
+    free(b.dirs.data);
+    free(b.tracks.data);
+    free(b.files.data);
+    if (ok) {
+        result = trackCount;
+        Serial.printf("Media library: %lu tracks in %lu directories, %lu read again, %s in %lu ms "
+                      "(%lu entries, %lu ms of it at the bandwidth limit)\n",
+                      (long unsigned int)trackCount, (long unsigned int)dirCount, (long unsigned int)scanChanged,
+                      unchanged ? "no change" : "index written", (long unsigned int)scanMs,
+                      (long unsigned int)scanEntries, (long unsigned int)scanLimitMs);
+    }
+    return result;
+}
+
+static void setScan(ml_scan_t* scan, fs::FS& fs, const char* mount, const char* root, const char* indexPath) {
+    scan->fs = &fs;
+    strlcpy(scan->mount, mount, sizeof(scan->mount));
+    strlcpy(scan->root, root, sizeof(scan->root));
+    strlcpy(scan->indexPath, indexPath, sizeof(scan->indexPath));
+}
+
+int MediaLibrary_Build(fs::FS& fs, const char* mount, const char* root, const char* indexPath) {
+    if (!libMutex) libMutex = xSemaphoreCreateMutex();
+    if (!buildMutex) buildMutex = xSemaphoreCreateMutex();
+    ml_scan_t scan = {};
+    bool changed;
+    setScan(&scan, fs, mount, root, indexPath);
+    return buildIndex(&scan, &changed);
+}
+
+static void MediaLibrary_ScanTask(void* parameter) {
+    bool changed;
+    if (buildIndex(&asyncScan, &changed) < 0) changed = false;
+    if (asyncScan.done) asyncScan.done(changed);
+    vTaskDelete(NULL);
+}
+
+bool MediaLibrary_RescanAsync(fs::FS& fs, const char* mount, const char* root, const char* indexPath,
+                              uint32_t entriesPerSec, void (*done)(bool changed)) {
+    if (!libMutex) libMutex = xSemaphoreCreateMutex();
+    if (!buildMutex) buildMutex = xSemaphoreCreateMutex();
+    if (scanRunning) return false;
+    xSemaphoreTake(buildMutex, portMAX_DELAY); // asyncScan is not in use
+    setScan(&asyncScan, fs, mount, root, indexPath);
+    asyncScan.reuse = true;
+    asyncScan.entriesPerSec = entriesPerSec;
+    asyncScan.done = done;
+    scanRunning = true; // until the task has the mutex
+    xSemaphoreGive(buildMutex);
+    if (xTaskCreatePinnedToCore(MediaLibrary_ScanTask, "LibraryScan", 6144, NULL, 1, NULL, 0) != pdPASS) {
+        scanRunning = false;
+        Serial.println("Media library: scan task not created");
+        return false;
+    }
+    return true;
+}
+
+bool MediaLibrary_Scanning() {
+    return scanRunning || tagRunning;
+}
+
+void MediaLibrary_GetProgress(ml_progress_t* p) {
+    p->running = scanRunning;
+    p->dirs = scanDirs;
+    p->knownDirs = scanKnownDirs;
+    p->changedDirs = scanChanged;
+    p->tracks = scanTracks;
+    p->ms = scanMs;
+    p->tagging = tagRunning;
+    p->taggedFiles = tagFiles;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// Tags, read from the files by the tag reader of the audio library (a few small reads per file), collected in
+// PSRAM and written into the index every ML_TAG_WRITE_MS
+
+typedef struct {
+    uint32_t track;
+    uint32_t duration;                  // seconds
+    uint16_t trackNo;
+    uint16_t len;                       // title, artist and album follow, each with its zero
+} ml_tagged_t;
+
+static struct {
+    fs::FS* fs;
+    uint32_t filesPerSec;
+    void (*done)(uint32_t tagged);
+} asyncTags;
+
+static volatile bool tagRestart = false;     // a new index was opened meanwhile, start at the first track again
+
+// The open index into the build buffers (buildMutex taken), the hash table of the pool is built again
+static bool loadIndex(ml_build_t* b) {
+    uint32_t dirBytes = header.dirCount * sizeof(ml_dir_t);
+    uint32_t trackBytes = header.trackCount * sizeof(ml_track_t);
+    File f = libFs->open(libPath);
+    bool ok = f && bufReserve(&b->dirs, dirBytes) && bufReserve(&b->tracks, trackBytes) &&
+              bufReserve(&b->pool, header.poolSize) && header.poolSize > 0 &&
+              f.seek(header.dirOffset) && f.read(b->dirs.data, dirBytes) == dirBytes &&
+              f.seek(header.trackOffset) && f.read(b->tracks.data, trackBytes) == trackBytes &&
+              f.seek(header.poolOffset) && f.read(b->pool.data, header.poolSize) == header.poolSize &&
+              b->pool.data[header.poolSize - 1] == '\0';
+    if (f) f.close();
+    if (!ok) return false;
+    b->dirs.len = dirBytes;
+    b->tracks.len = trackBytes;
+    b->pool.len = header.poolSize;
+    for (uint32_t offset = 1; offset < b->pool.len;) {
+        const char* s = (const char*)b->pool.data + offset;
+        if ((b->count + 1) * 2 > b->mask + 1 && !growSlots(b)) return false;
+        uint32_t h = hashString(s) & b->mask;
+        while (b->slots[h]) h = (h + 1) & b->mask;
+        b->slots[h] = offset;
+        b->count++;
+        offset += strlen(s) + 1;
+    }
+    return true;
+}
+
+// The pending tags into the index, the track numbers don't change, false: the index was replaced meanwhile
+static bool applyTags(const ml_buf_t* pending, uint32_t generation) {
+    xSemaphoreTake(buildMutex, portMAX_DELAY);
+    if (generation != libGeneration || !libOpen) {
+        xSemaphoreGive(buildMutex);
+        return false;
+    }
+    char indexPath[sizeof(libPath)];
+    strlcpy(indexPath, libPath, sizeof(indexPath));
+    ml_build_t b = {};
+    bool ok = loadIndex(&b);
+    ml_track_t* tracks = (ml_track_t*)b.tracks.data;
+    for (uint32_t pos = 0; ok && pos < pending->len;) {
+        ml_tagged_t r;
+        memcpy(&r, pending->data + pos, sizeof(r));
+        const char* title = (const char*)pending->data + pos + sizeof(r);
+        const char* artist = title + strlen(title) + 1;
+        const char* album = artist + strlen(artist) + 1;
+        pos += sizeof(r) + r.len;
+        ml_track_t* t = &tracks[r.track];
+        if (*title) t->title = intern(&b, title); // otherwise the names from the folders stay
+        if (*artist) t->artist = intern(&b, artist);
+        if (*album) t->album = intern(&b, album);
+        if (r.trackNo) t->trackNo = r.trackNo;
+        t->duration = r.duration;
+        t->flags |= ML_FLAG_TAGS;
+    }
+    ok = ok && !b.failed && writeIndex(*libFs, indexPath, &b, (const ml_dir_t*)b.dirs.data, header.dirCount);
+    xSemaphoreGive(buildMutex);
+    free(b.slots);
+    free(b.pool.data);
+    free(b.dirs.data);
+    free(b.tracks.data);
+    if (!ok) {
+        Serial.println("Media library: tags not written");
+    }
+    return true;
+}
+
+static int32_t readTagBytes(void* user, uint32_t pos, uint8_t* dst, uint32_t len) {
+    File* f = (File*)user;
+    if (!f->seek(pos)) return -1;
+    return f->read(dst, len);
+}
+
+// The tags of a track, a file without tags (or that can't be read) gets an empty record and is not read again
+static bool readTags(uint32_t track, ml_buf_t* pending, uint32_t* reads) {
+    char path[MEDIA_PATH_LEN];
+    if (!MediaLibrary_GetPath(track, path, sizeof(path))) return true;
+    tr_tags_t* tags = (tr_tags_t*)calloc(1, sizeof(tr_tags_t)); // zero reads and tags if the file doesn't open
+    if (!tags) return false;
+    File f = asyncTags.fs->open(path);
+    bool found = f && TR_read(tags, f.size(), readTagBytes, &f);
+    *reads += tags->reads;
+    if (!found) memset(tags, 0, sizeof(tr_tags_t));
+    if (f) f.close();
+
+    uint32_t lens[3] = {(uint32_t)strlen(tags->title) + 1, (uint32_t)strlen(tags->artist) + 1, (uint32_t)strlen(tags->album) + 1};
+    ml_tagged_t r = {track, (tags->duration + 500) / 1000, tags->trackNo, (uint16_t)(lens[0] + lens[1] + lens[2])};
+    bool ok = bufAppend(pending, &r, sizeof(r)) && bufAppend(pending, tags->title, lens[0]) &&
+              bufAppend(pending, tags->artist, lens[1]) && bufAppend(pending, tags->album, lens[2]);
+    free(tags);
+    return ok;
+}
+
+// Every track without ML_FLAG_TAGS, the index is only locked while the collected tags are written
+static void MediaLibrary_TagTask(void* parameter) {
+    ml_buf_t pending = {};
+    uint32_t next = 0, files = 0, reads = 0;
+    uint32_t t0 = millis();
+    uint32_t lastWrite = t0;
+    uint32_t generation = libGeneration;
+    bool ok = true;
+    while (ok) {
+        uint32_t n = 0;
+        for (; next < MediaLibrary_Count() && generation == libGeneration && pending.len < ML_TAG_PENDING_BYTES &&
+               !(n && millis() - lastWrite >= ML_TAG_WRITE_MS);
+             next++) {
+            ml_track_t t;
+            if (!MediaLibrary_GetTrack(next, &t) || (t.flags & ML_FLAG_TAGS)) continue;
+            if (!(ok = readTags(next, &pending, &reads))) break;
+            n++;
+            tagFiles = ++files;
+
+            // Files per second, like the directory entries of the scan
+            uint32_t due = asyncTags.filesPerSec ? (uint64_t)files * 1000 / asyncTags.filesPerSec : 0;
+            uint32_t elapsed = millis() - t0;
+            if (due > elapsed) {
+                vTaskDelay(pdMS_TO_TICKS(due - elapsed));
+            } else if (files % 8 == 0) {
+                vTaskDelay(1); // Release some CPU time
+            }
+        }
+        if (!ok) {
+            Serial.println("Media library: out of memory for the tags");
+        }
+        if (n && applyTags(&pending, generation)) {
+            generation = libGeneration; // written by applyTags(), the same track numbers
+            lastWrite = millis();
+            pending.len = 0;
+            if (asyncTags.done) asyncTags.done(n);
+            continue;
+        }
+        pending.len = 0;
+        if (generation != libGeneration) {
+            generation = libGeneration; // a scan has written a new index, the tags read since are lost
+            next = 0;
+            continue;
+        }
+        // Done, unless a new index asks for another pass
+        xSemaphoreTake(buildMutex, portMAX_DELAY);
+        bool restart = tagRestart && ok;
+        tagRestart = false;
+        if (!restart) tagRunning = false;
+        xSemaphoreGive(buildMutex);
+        if (!restart) break;
+        next = 0;
+    }
+    tagRunning = false;
+    free(pending.data);
+    Serial.printf("Media library: tags of %lu files read (%lu reads) in %lu ms\n", (long unsigned int)files,
+                  (long unsigned int)reads, (long unsigned int)(millis() - t0));
+    vTaskDelete(NULL);
+}
+
+bool MediaLibrary_ReadTagsAsync(fs::FS& fs, uint32_t filesPerSec, void (*done)(uint32_t tagged)) {
+    if (!libMutex) libMutex = xSemaphoreCreateMutex();
+    if (!buildMutex) buildMutex = xSemaphoreCreateMutex();
+    xSemaphoreTake(buildMutex, portMAX_DELAY);
+    if (tagRunning) {
+        tagRestart = true; // the running task starts over
+        xSemaphoreGive(buildMutex);
+        return true;
+    }
+    asyncTags.fs = &fs;
+    asyncTags.filesPerSec = filesPerSec;
+    asyncTags.done = done;
+    tagRunning = true;
+    tagRestart = false;
+    tagFiles = 0;
+    xSemaphoreGive(buildMutex);
+    if (xTaskCreatePinnedToCore(MediaLibrary_TagTask, "LibraryTags", 4096, NULL, 1, NULL, 0) != pdPASS) {
+        tagRunning = false;
+        Serial.println("Media library: tag task not created");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "Arduino.h"
+#include "FS.h"
+
+// Library index on the SD card: every audio file below a root directory, in one binary file
+//
+//   header | directories | tracks (fixed size records) | sorted track numbers per order | string pool
+//
+// Names are stored once in the string pool and referenced by their offset (0 = empty string). Tracks are
+// sorted by directory path and file name, the other orders are arrays of track numbers. Nothing is held in
+// RAM but the header and a few pages of the file, the size of the library doesn't matter at runtime.
+
+#define MEDIA_PATH_LEN 256              // longest path of a track, longer ones are not indexed
+#define MEDIA_NAME_LEN 128
+
+#define ML_MAGIC "MLIB"
+#define ML_VERSION 2
+
+typedef enum {
+    ML_ORDER_FILE = 0,                  // directory path, file name (the track numbers themselves)
+    ML_ORDER_ARTIST,                    // artist, album, track number, title
+    ML_ORDER_ALBUM,                     // album, artist, track number, title
+    ML_ORDER_TITLE,                     // title, artist
+    ML_ORDER_COUNT
+} MediaOrder;
+
+typedef struct {
+    uint32_t name;                      // file name
+    uint32_t dir;                       // directory number
+    uint32_t title;                     // string pool offsets
+    uint32_t artist;
+    uint32_t album;
+    uint32_t size;                      // bytes
+    uint32_t duration;                  // seconds, 0: unknown
+    uint16_t trackNo;                   // 0: unknown
+    uint8_t codec;                      // extension, see MediaLibrary.cpp
+    uint8_t flags;                      // ML_FLAG_...
+} ml_track_t;                           // 32 bytes
+
+#define ML_FLAG_TAGS 0x01               // the tag reader has read the file, title... are from its tags where it has them
+
+typedef struct {
+    uint32_t path;                      // full path, "/" for the root
+    uint32_t parent;                    // directory number, the root is its own parent
+    uint32_t firstTrack;
+    uint32_t trackCount;
+    uint32_t entries;                   // fingerprint of the last scan: entries that are not hidden (readdir)
+    uint32_t namesHash;                 // and the sum of the hashes of their names
+} ml_dir_t;
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t trackSize;                 // sizeof(ml_track_t)
+    uint32_t trackCount;
+    uint32_t dirCount;
+    uint32_t dirOffset;                 // file offsets
+    uint32_t trackOffset;
+    uint32_t orderOffset[ML_ORDER_COUNT]; // [ML_ORDER_FILE] unused
+    uint32_t poolOffset;
+    uint32_t poolSize;
+} ml_header_t;
+
+typedef struct {
+    bool running;
+    uint32_t dirs;                      // directories read
+    uint32_t knownDirs;                 // in the index before the scan (0: first scan)
+    uint32_t changedDirs;               // new or changed directories, their files were read
+    uint32_t tracks;
+    uint32_t ms;                        // duration of the last scan
+    bool tagging;                       // the tag reader is running
+    uint32_t taggedFiles;               // files it has read
+} ml_progress_t;
+
+// Walk the tree below root (mount: the POSIX path of fs, e.g. "/sdcard") and write the index file, the
+// build runs in PSRAM and the file is replaced when it is complete, returns the number of tracks or -1
+int MediaLibrary_Build(fs::FS& fs, const char* mount, const char* root, const char* indexPath);
+
+// The same in a task (low priority, core 0) and incremental: directories with the fingerprint of the open
+// index are only listed, nothing is written if none has changed. At most entriesPerSec directory entries
+// per second (0: no limit), done() runs in the task, changed: a new index is open.
+bool MediaLibrary_RescanAsync(fs::FS& fs, const char* mount, const char* root, const char* indexPath,
+                              uint32_t entriesPerSec, void (*done)(bool changed));
+
+// Title, artist, album, track number and duration from the tags of every track that has not been read yet
+// (ML_FLAG_TAGS), in a task (low priority, core 0), at most filesPerSec files per second (0: no limit).
+// The tags are collected in PSRAM and written into the index every 20 s and at the end, done() runs in the
+// task after each write. A new index (scan) while the task runs is read from the first track again.
+bool MediaLibrary_ReadTagsAsync(fs::FS& fs, uint32_t filesPerSec, void (*done)(uint32_t tagged));
+
+// A scan or the tag reader is running (the card is in use)
+bool MediaLibrary_Scanning();
+void MediaLibrary_GetProgress(ml_progress_t* p);
+
+// Read the header of an index file, false: missing or from another version
+bool MediaLibrary_Open(fs::FS& fs, const char* indexPath);
+
+// Close the index file, the cached pages stay valid (before the card is unmounted)
+void MediaLibrary_Suspend();
+
+uint32_t MediaLibrary_Count();
+uint32_t MediaLibrary_DirCount();
+
+// Track number at position pos of an order (pos for ML_ORDER_FILE), UINT32_MAX if out of range
+uint32_t MediaLibrary_Sorted(MediaOrder order, uint32_t pos);
+
+bool MediaLibrary_GetTrack(uint32_t track, ml_track_t* t);
+bool MediaLibrary_GetDir(uint32_t dir, ml_dir_t* d);
+bool MediaLibrary_GetString(uint32_t ref, char* buf, size_t len);
+
+// Full path of a track for fs.open()
+bool MediaLibrary_GetPath(uint32_t track, char* buf, size_t len);
+
+// Track number of a full path, UINT32_MAX if it is not in the index
+uint32_t MediaLibrary_Find(const char* path);
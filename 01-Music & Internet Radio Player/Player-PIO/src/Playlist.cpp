@@ -0,0 +1,488 @@
+#include "Playlist.h"
+#include "MediaLibrary.h"
+
+#define PL_BLOCK 64                     // entries per block, the file offset of every block is kept
+#define PL_WINDOWS 2                    // resident blocks: the current one and the next (or previous)
+#define PL_QUEUE_MAX 256                // queued tracks, further edits are refused until the queue is cleared
+#define PL_LINE_LEN 512                 // longer lines are entries without a track
+#define PL_READ 512                     // SD sector
+#define PL_JOURNAL_MAGIC "PLQ1"
+
+typedef struct {
+    char magic[4];
+    uint32_t hash;                      // of the playlist path ("" for the library)
+    uint32_t size;                      // of the playlist file, a changed file starts an empty queue
+} pl_journal_t;
+
+typedef struct {
+    uint32_t pos;                       // of the queued track when it was queued
+    uint32_t len;                       // of the path behind the record
+} pl_record_t;
+
+typedef struct {
+    int32_t anchor;                     // queued after this entry of the playlist (-1: before the first)
+    uint32_t track;                     // UINT32_MAX: not in the library (any more)
+} pl_queued_t;
+
+static fs::FS* plFs = NULL;
+static char journalPath[64];
+static char listPath[MEDIA_PATH_LEN];   // "": the library
+static char listDir[MEDIA_PATH_LEN];    // "" for the root
+static bool listPls = false;
+static bool listLatin1 = false;         // .m3u may be in Windows-1252, .m3u8 is UTF-8
+static File listFile;
+static uint32_t listSize = 0;
+static uint32_t entryCount = 0;
+static uint32_t* blockOffset = NULL;
+static uint32_t blockCap = 0;
+static SemaphoreHandle_t plMutex = NULL; // everything here, the buffers below are used by every pass
+
+static struct {
+    uint32_t block;                     // UINT32_MAX: empty
+    uint32_t lastUse;
+    uint32_t track[PL_BLOCK];
+} windows[PL_WINDOWS];
+static uint32_t windowClock = 0;
+
+static pl_queued_t queue[PL_QUEUE_MAX]; // sorted by anchor, in the order they were queued
+static uint32_t queueLen = 0;
+
+// Not on the stack, the audio task looks up the next track
+static struct {
+    uint32_t offset;                    // file offset of buf[at]
+    int at;
+    int len;
+    uint8_t buf[PL_READ];
+} reader;
+static char line[PL_LINE_LEN];
+static char path[MEDIA_PATH_LEN];
+
+static void invalidateWindows() {
+    for (int i = 0; i < PL_WINDOWS; i++) {
+        windows[i].block = UINT32_MAX;
+        windows[i].lastUse = 0;
+    }
+}
+
+static uint32_t hashPath(const char* s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+    return h;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// Parser, a line at a time from a small buffer
+
+// The playlist file, opened again after Playlist_Suspend() (the open wakes the card up)
+static bool openList() {
+    if (!listFile) {
+        listFile = plFs->open(listPath);
+    }
+    return listFile;
+}
+
+static bool seekReader(uint32_t offset) {
+    reader.at = reader.len = 0;
+    reader.offset = offset;
+    return listFile.seek(offset);
+}
+
+static int readByte() {
+    if (reader.at == reader.len) {
+        reader.at = 0;
+        reader.len = listFile.read(reader.buf, PL_READ);
+        if (reader.len <= 0) {
+            reader.len = 0;
+            return -1;
+        }
+    }
+    reader.offset++;
+    return reader.buf[reader.at++];
+}
+
+// The next entry from the reader position, *start: the file offset of its line, false: end of the file.
+// A line that does not fit gives an empty entry, the entries are counted the same in every pass.
+static bool nextEntry(char* entry, size_t len, uint32_t* start) {
+    while (true) {
+        uint32_t lineStart = reader.offset;
+        size_t n = 0;
+        bool overflow = false;
+        int c = readByte();
+        if (c < 0) return false;
+        for (; c >= 0 && c != '\n'; c = readByte()) {
+            if (n < len - 1) entry[n++] = c;
+            else overflow = true;
+        }
+        entry[n] = '\0';
+
+        char* s = entry;
+        if (lineStart == 0 && memcmp(s, "\xEF\xBB\xBF", 3) == 0) s += 3; // UTF-8 BOM
+        while (*s == ' ' || *s == '\t') s++;
+        char* end = s + strlen(s);
+        while (end > s && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+
+        if (listPls) {
+            // [playlist], FileN=path, TitleN=..., LengthN=..., NumberOfEntries=..., Version=2
+            if (strncasecmp(s, "File", 4) != 0 || !isdigit((uint8_t)s[4])) continue;
+            char* eq = strchr(s, '=');
+            if (!eq) continue;
+            s = eq + 1;
+            while (*s == ' ' || *s == '\t') s++;
+        } else if (*s == '\0' || *s == '#') {
+            continue; // #EXTM3U, #EXTINF:... and comments
+        }
+        if (overflow) *s = '\0';
+        memmove(entry, s, strlen(s) + 1);
+        *start = lineStart;
+        return true;
+    }
+}
+
+static bool validUtf8(const char* s) {
+    while (*s) {
+        uint8_t c = *s++;
+        int follow = c < 0x80 ? 0 : (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : -1;
+        if (follow < 0) return false;
+        while (follow--) {
+            if (((uint8_t)*s++ & 0xC0) != 0x80) return false;
+        }
+    }
+    return true;
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+// Remove "." and "//", resolve "..", in place
+static void normalize(char* p) {
+    char* out = p;
+    const char* in = p;
+    while (*in) {
+        while (*in == '/') in++;
+        const char* seg = in;
+        while (*in && *in != '/') in++;
+        size_t n = in - seg;
+        if (n == 0 || (n == 1 && seg[0] == '.')) continue;
+        if (n == 2 && seg[0] == '.' && seg[1] == '.') {
+            while (out > p && *--out != '/') {}
+            continue;
+        }
+        *out++ = '/';
+        memmove(out, seg, n);
+        out += n;
+    }
+    if (out == p) *out++ = '/';
+    *out = '\0';
+}
+
+// Full path of an entry as in the library index, false: a stream or an empty entry
+static bool resolve(const char* entry, char* out, size_t len) {
+    bool uri = false;
+    if (strncasecmp(entry, "file://", 7) == 0) {
+        entry += 7;
+        if (*entry != '/') entry = strchr(entry, '/'); // file://localhost/...
+        if (!entry) return false;
+        uri = true;
+    } else if (strstr(entry, "://")) {
+        return false;
+    }
+    if (*entry == '\0') return false;
+    if (isalpha((uint8_t)entry[0]) && entry[1] == ':') entry += 2; // C:\Music\... from the card root
+
+    size_t n = 0;
+    if (*entry != '/' && *entry != '\\') {
+        n = strlcpy(out, listDir, len);
+        if (n + 1 < len) out[n++] = '/';
+    }
+    bool latin1 = listLatin1 && !validUtf8(entry);
+    for (const char* s = entry; *s && n + 2 < len; s++) {
+        uint8_t c = *s;
+        if (uri && c == '%' && hexDigit(s[1]) >= 0 && hexDigit(s[2]) >= 0) {
+            c = hexDigit(s[1]) * 16 + hexDigit(s[2]);
+            s += 2;
+        }
+        if (c == '\\') c = '/';
+        if (latin1 && c >= 0x80) {
+            out[n++] = 0xC0 | (c >> 6);
+            c = 0x80 | (c & 0x3F);
+        }
+        out[n++] = c;
+    }
+    out[n] = '\0';
+    if (n + 2 >= len) return false;
+    normalize(out);
+    return true;
+}
+
+static bool addBlock(uint32_t offset) {
+    uint32_t block = entryCount / PL_BLOCK;
+    if (block == blockCap) {
+        uint32_t cap = blockCap ? blockCap * 2 : 16;
+        uint32_t* p = (uint32_t*)realloc(blockOffset, cap * sizeof(uint32_t));
+        if (!p) return false;
+        blockOffset = p;
+        blockCap = cap;
+    }
+    blockOffset[block] = offset;
+    return true;
+}
+
+// One pass over the file, the offset of every PL_BLOCK-th entry is kept (plMutex taken)
+static bool readList(const char* p) {
+    if (strlen(p) >= sizeof(listPath) || !strchr(p, '/')) return false;
+    strlcpy(listPath, p, sizeof(listPath));
+    strlcpy(listDir, p, sizeof(listDir));
+    *strrchr(listDir, '/') = '\0';
+    const char* dot = strrchr(p, '.');
+    listPls = dot && strcasecmp(dot, ".pls") == 0;
+    listLatin1 = dot && strcasecmp(dot, ".m3u") == 0;
+
+    if (!openList() || !seekReader(0)) return false;
+    listSize = listFile.size();
+    uint32_t start;
+    while (nextEntry(line, sizeof(line), &start)) {
+        if (entryCount % PL_BLOCK == 0 && !addBlock(start)) return false;
+        entryCount++;
+    }
+    return entryCount > 0;
+}
+
+// The track numbers of a block, the least recently used window is replaced (plMutex taken)
+static const uint32_t* getWindow(uint32_t block) {
+    int victim = 0;
+    for (int i = 0; i < PL_WINDOWS; i++) {
+        if (windows[i].block == block) {
+            windows[i].lastUse = ++windowClock;
+            return windows[i].track;
+        }
+        if (windows[i].lastUse < windows[victim].lastUse) victim = i;
+    }
+    windows[victim].block = UINT32_MAX;
+    if (!openList() || !seekReader(blockOffset[block])) return NULL;
+    uint32_t start;
+    for (uint32_t k = 0; k < PL_BLOCK; k++) {
+        uint32_t entry = block * PL_BLOCK + k;
+        bool found = entry < entryCount && nextEntry(line, sizeof(line), &start);
+        windows[victim].track[k] = found && resolve(line, path, sizeof(path)) ? MediaLibrary_Find(path) : UINT32_MAX;
+    }
+    windows[victim].block = block;
+    windows[victim].lastUse = ++windowClock;
+    return windows[victim].track;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// Queue, queued track k is at position anchor + 1 + k
+
+static uint32_t entries() {
+    return listPath[0] ? entryCount : MediaLibrary_Count();
+}
+
+// The playlist entry at a position, UINT32_MAX and *queued: a queued track
+static uint32_t entryAt(uint32_t pos, int* queued) {
+    *queued = -1;
+    for (uint32_t k = 0; k < queueLen; k++) {
+        uint32_t at = queue[k].anchor + 1 + k;
+        if (at == pos) {
+            *queued = k;
+            return UINT32_MAX;
+        }
+        if (at > pos) return pos - k;
+    }
+    return pos - queueLen;
+}
+
+static uint32_t positionOf(uint32_t entry) {
+    uint32_t k = 0;
+    while (k < queueLen && queue[k].anchor < (int32_t)entry) k++;
+    return entry + k;
+}
+
+static bool insertAt(uint32_t pos, uint32_t track) {
+    if (queueLen == PL_QUEUE_MAX) return false;
+    uint32_t k = 0;
+    while (k < queueLen && queue[k].anchor + 1 + k < pos) k++;
+    memmove(&queue[k + 1], &queue[k], (queueLen - k) * sizeof(pl_queued_t));
+    queue[k].anchor = (int32_t)pos - (int32_t)k - 1;
+    queue[k].track = track;
+    queueLen++;
+    return true;
+}
+
+static bool writeJournalHeader() {
+    File f = plFs->open(journalPath, FILE_WRITE);
+    if (!f) return false;
+    pl_journal_t h;
+    memcpy(h.magic, PL_JOURNAL_MAGIC, 4);
+    h.hash = hashPath(listPath);
+    h.size = listSize;
+    bool ok = f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h);
+    f.close();
+    return ok;
+}
+
+// Replay the journal, the paths are looked up in the library index, a journal of another playlist is
+// started again (plMutex taken)
+static void loadJournal() {
+    queueLen = 0;
+    File f = plFs->open(journalPath);
+    pl_journal_t h;
+    if (!f || f.read((uint8_t*)&h, sizeof(h)) != sizeof(h) || memcmp(h.magic, PL_JOURNAL_MAGIC, 4) != 0 ||
+        h.hash != hashPath(listPath) || h.size != listSize) {
+        if (f) f.close();
+        writeJournalHeader();
+        return;
+    }
+    pl_record_t r;
+    while (f.read((uint8_t*)&r, sizeof(r)) == sizeof(r) && r.len < sizeof(path) &&
+           f.read((uint8_t*)path, r.len) == r.len) {
+        path[r.len] = '\0';
+        if (!insertAt(min(r.pos, entries() + queueLen), MediaLibrary_Find(path))) break;
+    }
+    f.close();
+}
+
+// One record at the end of the journal, the queue in RAM is only changed if it is written
+static bool queueTrack(uint32_t pos, uint32_t track) {
+    if (queueLen == PL_QUEUE_MAX || !MediaLibrary_GetPath(track, path, sizeof(path))) return false;
+    File f = plFs->open(journalPath, FILE_APPEND);
+    if (!f) return false;
+    pl_record_t r = {pos, (uint32_t)strlen(path)};
+    bool ok = f.write((const uint8_t*)&r, sizeof(r)) == sizeof(r) && f.write((const uint8_t*)path, r.len) == r.len;
+    f.close();
+    return ok && insertAt(pos, track);
+}
+
+static uint32_t nearer(uint32_t pos, uint32_t best, uint32_t near) {
+    if (best == UINT32_MAX) return pos;
+    uint32_t d = pos > near ? pos - near : near - pos;
+    return d < (best > near ? best - near : near - best) ? pos : best;
+}
+
+//------------------------------------------------------------------------------------------------------------
+
+bool Playlist_Init(fs::FS& fs, const char* journal) {
+    if (!plMutex) plMutex = xSemaphoreCreateMutex();
+    if (!plMutex) return false;
+    plFs = &fs;
+    strlcpy(journalPath, journal, sizeof(journalPath));
+    invalidateWindows();
+    return true;
+}
+
+bool Playlist_Open(const char* p) {
+    if (!plMutex) return false;
+    xSemaphoreTake(plMutex, portMAX_DELAY);
+    listFile.close();
+    invalidateWindows();
+    listPath[0] = listDir[0] = '\0';
+    listSize = entryCount = 0;
+    bool ok = !p || !*p || readList(p);
+    if (!ok) {
+        listFile.close();
+        listPath[0] = listDir[0] = '\0';
+        listSize = entryCount = 0;
+        log_e("playlist %s not read", p);
+    }
+    loadJournal();
+    xSemaphoreGive(plMutex);
+    return ok;
+}
+
+const char* Playlist_GetPath() {
+    return listPath;
+}
+
+uint32_t Playlist_Length() {
+    if (!plMutex) return 0;
+    xSemaphoreTake(plMutex, portMAX_DELAY);
+    uint32_t len = entries() + queueLen;
+    xSemaphoreGive(plMutex);
+    return len;
+}
+
+uint32_t Playlist_Track(uint32_t pos) {
+    if (!plMutex) return UINT32_MAX;
+    xSemaphoreTake(plMutex, portMAX_DELAY);
+    uint32_t track = UINT32_MAX;
+    int queued;
+    uint32_t entry = entryAt(pos, &queued);
+    if (pos >= entries() + queueLen) {
+        track = UINT32_MAX;
+    } else if (queued >= 0) {
+        track = queue[queued].track;
+    } else if (!listPath[0]) {
+        track = entry;
+    } else {
+        const uint32_t* window = getWindow(entry / PL_BLOCK);
+        if (window) track = window[entry % PL_BLOCK];
+    }
+    xSemaphoreGive(plMutex);
+    return track;
+}
+
+uint32_t Playlist_Locate(uint32_t track, uint32_t near) {
+    if (!plMutex || track == UINT32_MAX) return UINT32_MAX;
+    xSemaphoreTake(plMutex, portMAX_DELAY);
+    uint32_t best = UINT32_MAX;
+    if (!listPath[0]) {
+        if (track < MediaLibrary_Count()) best = positionOf(track);
+    } else {
+        for (int i = 0; i < PL_WINDOWS; i++) {
+            if (windows[i].block == UINT32_MAX) continue;
+            for (uint32_t k = 0; k < PL_BLOCK; k++) {
+                if (windows[i].track[k] == track) best = nearer(positionOf(windows[i].block * PL_BLOCK + k), best, near);
+            }
+        }
+        for (uint32_t k = 0; k < queueLen; k++) {
+            if (queue[k].track == track) best = nearer(queue[k].anchor + 1 + k, best, near);
+        }
+    }
+    xSemaphoreGive(plMutex);
+    return best;
+}
+
+bool Playlist_Insert(uint32_t pos, uint32_t track) {
+    if (!plMutex) return false;
+    xSemaphoreTake(plMutex, portMAX_DELAY);
+    bool ok = queueTrack(min(pos + 1, entries() + queueLen), track);
+    xSemaphoreGive(plMutex);
+    return ok;
+}
+
+bool Playlist_Append(uint32_t track) {
+    if (!plMutex) return false;
+    xSemaphoreTake(plMutex, portMAX_DELAY);
+    bool ok = queueTrack(entries() + queueLen, track);
+    xSemaphoreGive(plMutex);
+    return ok;
+}
+
+void Playlist_ClearQueue() {
+    if (!plMutex) return;
+    xSemaphoreTake(plMutex, portMAX_DELAY);
+    queueLen = 0;
+    writeJournalHeader();
+    xSemaphoreGive(plMutex);
+}
+
+uint32_t Playlist_QueueLength() {
+    return queueLen;
+}
+
+void Playlist_Relink() {
+    if (!plMutex) return;
+    xSemaphoreTake(plMutex, portMAX_DELAY);
+    invalidateWindows();
+    loadJournal();
+    xSemaphoreGive(plMutex);
+}
+
+void Playlist_Suspend() {
+    if (!plMutex) return;
+    xSemaphoreTake(plMutex, portMAX_DELAY);
+    listFile.close();
+    xSemaphoreGive(plMutex);
+}
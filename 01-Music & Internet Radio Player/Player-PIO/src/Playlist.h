@@ -0,0 +1,49 @@
+#pragma once
+#include "Arduino.h"
+#include "FS.h"
+
+// Play order of the music player: the entries of a playlist file (M3U, M3U8, PLS) or the library in file
+// order, and the tracks queued on top of it (play next, append).
+//
+// A playlist is read once when it is opened, only the file offset of every PL_BLOCK-th entry is kept. The
+// entries are parsed again block by block when they are needed, PL_WINDOWS blocks are resident as library
+// track numbers (10000 entries: 157 offsets and two windows, about 1 KB). Relative paths are resolved from
+// the folder of the playlist, entries that are not in the library index (streams, missing files) have no track.
+//
+// The queue is a journal file on the card, one record per edit is appended, nothing is rewritten:
+//
+//   header (the playlist the queue belongs to) | record: position, path | record ...
+//
+// It is replayed when the same playlist is opened again, another playlist starts an empty queue.
+
+// The file system of the playlists and the journal file of the queue, Playlist_Open() follows, false: no mutex
+bool Playlist_Init(fs::FS& fs, const char* journalPath);
+
+// Read a playlist file (NULL: the library), false: not readable or empty, the library order is used then
+bool Playlist_Open(const char* path);
+
+// The open playlist, "" for the library
+const char* Playlist_GetPath();
+
+// Entries and queued tracks
+uint32_t Playlist_Length();
+
+// Track number at a position, UINT32_MAX: out of range or not in the library, the card is woken up if the
+// block of the position is not resident
+uint32_t Playlist_Track(uint32_t pos);
+
+// Position of a track, the one nearest to near in the resident blocks (the library order: exact),
+// UINT32_MAX: not found
+uint32_t Playlist_Locate(uint32_t track, uint32_t near);
+
+// Queue a track after a position (play next) or at the end, false: the queue is full or not written
+bool Playlist_Insert(uint32_t pos, uint32_t track);
+bool Playlist_Append(uint32_t track);
+void Playlist_ClearQueue();
+uint32_t Playlist_QueueLength();
+
+// The library index has changed, the entries and the queued paths are looked up again (card awake)
+void Playlist_Relink();
+
+// Close the playlist file before the card sleeps, it is opened again on the next block miss
+void Playlist_Suspend();
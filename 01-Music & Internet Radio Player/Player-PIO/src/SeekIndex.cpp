@@ -0,0 +1,345 @@
+#include "SeekIndex.h"
+#include "SD_Card.h"
+#include "TrackCache.h"
+#include "dsp/seek_map.h"
+
+#define SEEK_INDEX_MAGIC "MSEK"
+#define SEEK_INDEX_PATH_LEN 256         // MEDIA_PATH_LEN of the library
+#define SEEK_INDEX_RESIDENT 4           // maps in PSRAM: current, next, built and not written yet
+#define SEEK_INDEX_CHUNK (16 * 1024)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;                   // SM_VERSION
+} si_header_t;
+
+typedef struct {
+    uint32_t hash;                      // of the path
+    uint32_t size;                      // of the MP3 file
+    uint32_t len;                       // bytes of the map behind the record
+} si_record_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t size;
+    uint32_t offset;                    // of the map in the index file
+    uint32_t len;
+} si_entry_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t size;
+    uint32_t len;                       // 0: free
+    uint32_t used;                      // last use, the oldest is replaced
+    bool dirty;                         // not in the index file yet
+    uint8_t* data;                      // sizeof(sm_map_t), PSRAM
+} si_resident_t;
+
+static fs::FS* indexFs = NULL;
+static char indexPath[64];
+static uint32_t maxFileBytes = 0;
+static uint32_t fileBytes = 0;          // end of the last complete record
+static bool dirLoaded = false;
+static si_entry_t* dir = NULL;          // record directory, PSRAM
+static uint32_t dirCount = 0;
+static uint32_t dirCap = 0;
+static si_resident_t resident[SEEK_INDEX_RESIDENT];
+static uint32_t residentTick = 0;
+static SemaphoreHandle_t indexMutex = NULL; // directory, residents and the index file
+static TaskHandle_t indexTaskHandle = NULL;
+static sm_map_t* scanMap = NULL;
+static sm_scan_t scan;
+static char pendingPath[SEEK_INDEX_PATH_LEN];
+static uint32_t pendingSize = 0;
+static void (*pendingDone)(const char* path, bool built) = NULL;
+static volatile bool pendingRequest = false;
+
+static uint32_t hashPath(const char* s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+    return h;
+}
+
+static bool isMp3(const char* path) {
+    const char* dot = strrchr(path, '.');
+    return dot && strcasecmp(dot, ".mp3") == 0;
+}
+
+// The last record of a file (indexMutex taken)
+static si_entry_t* findEntry(uint32_t hash, uint32_t size) {
+    for (uint32_t i = dirCount; i-- > 0;) {
+        if (dir[i].hash == hash && dir[i].size == size) return &dir[i];
+    }
+    return NULL;
+}
+
+static bool addEntry(uint32_t hash, uint32_t size, uint32_t offset, uint32_t len) {
+    if (dirCount == dirCap) {
+        uint32_t cap = dirCap ? dirCap * 2 : 256;
+        si_entry_t* p = (si_entry_t*)ps_realloc(dir, cap * sizeof(si_entry_t));
+        if (!p) return false;
+        dir = p;
+        dirCap = cap;
+    }
+    dir[dirCount++] = {hash, size, offset, len};
+    return true;
+}
+
+// Read the record headers, a damaged or old file is removed (indexMutex taken, card held)
+static void loadDirectory() {
+    dirCount = 0;
+    fileBytes = 0;
+    File f = indexFs->open(indexPath);
+    if (f) {
+        uint32_t fsize = f.size();
+        si_header_t h;
+        bool ok = f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && memcmp(h.magic, SEEK_INDEX_MAGIC, 4) == 0 &&
+                  h.version == SM_VERSION;
+        uint32_t pos = sizeof(h);
+        while (ok && pos < fsize) {
+            si_record_t r;
+            ok = f.seek(pos) && f.read((uint8_t*)&r, sizeof(r)) == sizeof(r) && r.len <= sizeof(sm_map_t) &&
+                 pos + sizeof(r) + r.len <= fsize && addEntry(r.hash, r.size, pos + sizeof(r), r.len);
+            pos += sizeof(r) + r.len;
+        }
+        f.close();
+        if (ok) {
+            fileBytes = fsize;
+        } else {
+            dirCount = 0;
+            indexFs->remove(indexPath);
+            Serial.println("Seek index: damaged file removed");
+        }
+    }
+    dirLoaded = true;
+    Serial.printf("Seek index: %lu maps, %lu KB\n", (long unsigned int)dirCount, (long unsigned int)(fileBytes / 1024));
+}
+
+// Append a resident map to the index file, not while the card sleeps (indexMutex taken)
+static bool writeRecord(si_resident_t* r) {
+    if (!dirLoaded || !SD_AcquireAwake()) return false;
+    si_record_t rec = {r->hash, r->size, r->len};
+    if (fileBytes && fileBytes + sizeof(rec) + r->len > maxFileBytes) { // full, start again
+        indexFs->remove(indexPath);
+        dirCount = 0;
+        fileBytes = 0;
+    }
+    File f = indexFs->open(indexPath, fileBytes ? FILE_APPEND : FILE_WRITE);
+    if (!f) {
+        SD_Release();
+        return false;
+    }
+    bool ok = true;
+    if (!fileBytes) {
+        si_header_t h = {{'M', 'S', 'E', 'K'}, SM_VERSION};
+        ok = f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h);
+        if (ok) fileBytes = sizeof(h);
+    }
+    ok = ok && f.write((const uint8_t*)&rec, sizeof(rec)) == sizeof(rec) && f.write(r->data, r->len) == r->len;
+    f.close();
+    SD_Release();
+    if (!ok) { // a partial record is found by loadDirectory() after the next start
+        Serial.println("Seek index: write error");
+        return false;
+    }
+    addEntry(r->hash, r->size, fileBytes + sizeof(rec), r->len);
+    fileBytes += sizeof(rec) + r->len;
+    r->dirty = false;
+    return true;
+}
+
+// A free or the least recently used slot, a map that is not written yet is kept if possible (indexMutex taken)
+static si_resident_t* residentSlot() {
+    si_resident_t* slot = NULL;
+    for (int pass = 0; pass < 2 && !slot; pass++) {
+        for (int i = 0; i < SEEK_INDEX_RESIDENT; i++) {
+            si_resident_t* r = &resident[i];
+            if (!r->len) return r;
+            if (pass == 0 && r->dirty) continue;
+            if (!slot || r->used < slot->used) slot = r;
+        }
+    }
+    if (slot->dirty) writeRecord(slot);
+    slot->len = 0;
+    slot->dirty = false;
+    return slot;
+}
+
+static si_resident_t* findResident(uint32_t hash, uint32_t size) {
+    for (int i = 0; i < SEEK_INDEX_RESIDENT; i++) {
+        si_resident_t* r = &resident[i];
+        if (r->len && r->hash == hash && r->size == size) return r;
+    }
+    return NULL;
+}
+
+// Scan the frame headers of an MP3 file into scanMap
+static bool buildMap(const char* path, uint32_t size) {
+    bool cached = TrackCache_Contains(path);
+    if (!cached && !SD_AcquireAwake()) return false; // the track plays from PSRAM, the card is not woken for this
+    File f = cached ? TrackCache_FS().open(path) : SD_FS().open(path);
+    if (!cached) SD_Release(); // the open file holds the card
+    if (!f || f.size() != size) {
+        if (f) f.close();
+        return false;
+    }
+
+    // Audio data behind the ID3v2 tag, in front of an ID3v1 tag
+    uint8_t h[10];
+    uint32_t start = 0, end = size;
+    if (f.read(h, 10) == 10 && memcmp(h, "ID3", 3) == 0) {
+        start = 10 + (((uint32_t)h[6] << 21) | ((uint32_t)h[7] << 14) | ((uint32_t)h[8] << 7) | h[9]);
+        if (h[5] & 0x10) start += 10; // footer
+    }
+    if (size >= 128 && f.seek(size - 128) && f.read(h, 3) == 3 && memcmp(h, "TAG", 3) == 0) end = size - 128;
+
+    uint32_t chunk = SEEK_INDEX_CHUNK;
+    uint8_t* buffer = NULL;
+    while (!(buffer = (uint8_t*)heap_caps_malloc(chunk, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL)) && chunk > 2048) {
+        chunk /= 2;
+    }
+    bool complete = false;
+    if (buffer && start < end && f.seek(start)) {
+        SM_scanStart(&scan, scanMap, start, end, size);
+        uint32_t pos = start;
+        while (pos < end && !pendingRequest) { // a newer request wins
+            int32_t n = f.read(buffer, min(chunk, end - pos));
+            if (n <= 0) break;
+            pos += n;
+            if (!SM_scan(&scan, buffer, n)) break;
+            vTaskDelay(1); // the audio task and its read-ahead come first
+        }
+        complete = !pendingRequest && (pos >= end || scan.done) && scan.lost <= SM_MAX_LOST; // not a broken file
+    }
+    f.close();
+    if (buffer) free(buffer);
+    return complete && SM_scanEnd(&scan);
+}
+
+static void SeekIndex_Task(void* parameter) {
+    char path[SEEK_INDEX_PATH_LEN];
+    xSemaphoreTake(indexMutex, portMAX_DELAY);
+    if (SD_Acquire()) {
+        loadDirectory();
+        SD_Release();
+    }
+    xSemaphoreGive(indexMutex);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (true) {
+            xSemaphoreTake(indexMutex, portMAX_DELAY);
+            bool request = pendingRequest;
+            uint32_t size = pendingSize;
+            void (*done)(const char* path, bool built) = pendingDone;
+            strlcpy(path, pendingPath, sizeof(path));
+            pendingRequest = false;
+            xSemaphoreGive(indexMutex);
+            if (!request) break;
+
+            if (SeekIndex_Get(path, size, NULL)) { // in PSRAM or in the index file, not scanned again
+                if (done) done(path, true);
+                continue;
+            }
+            uint32_t t0 = millis();
+            bool built = buildMap(path, size);
+            if (built) {
+                xSemaphoreTake(indexMutex, portMAX_DELAY);
+                si_resident_t* r = residentSlot();
+                r->hash = hashPath(path);
+                r->size = size;
+                r->len = SM_size(scanMap);
+                r->used = ++residentTick;
+                r->dirty = true;
+                memcpy(r->data, scanMap, r->len);
+                writeRecord(r);
+                xSemaphoreGive(indexMutex);
+                Serial.printf("Seek index: %s, %lu frames in %lu ms\n", path, (long unsigned int)scanMap->totalFrames,
+                              (long unsigned int)(millis() - t0));
+            }
+            if (done) done(path, built);
+        }
+    }
+}
+
+bool SeekIndex_Init(fs::FS& fs, const char* path, uint32_t maxBytes) {
+    if (indexMutex) return true;
+    scanMap = (sm_map_t*)heap_caps_malloc(sizeof(sm_map_t), MALLOC_CAP_SPIRAM);
+    for (int i = 0; i < SEEK_INDEX_RESIDENT && scanMap; i++) {
+        resident[i] = {};
+        resident[i].data = (uint8_t*)heap_caps_malloc(sizeof(sm_map_t), MALLOC_CAP_SPIRAM);
+        if (!resident[i].data) scanMap = NULL; // the few KB that were taken are not worth freeing
+    }
+    if (!scanMap) {
+        Serial.println("Seek index: no PSRAM");
+        return false;
+    }
+    indexFs = &fs;
+    strlcpy(indexPath, path, sizeof(indexPath));
+    maxFileBytes = maxBytes;
+    indexMutex = xSemaphoreCreateMutex();
+    if (xTaskCreatePinnedToCore(SeekIndex_Task, "SeekIndex", 4096, NULL, 1, &indexTaskHandle, 0) != pdPASS) {
+        vSemaphoreDelete(indexMutex);
+        indexMutex = NULL;
+        Serial.println("Seek index: task not created");
+        return false;
+    }
+    return true;
+}
+
+bool SeekIndex_Get(const char* path, uint32_t size, bool (*use)(const uint8_t* map, size_t len)) {
+    if (!indexMutex || !path) return false;
+    uint32_t hash = hashPath(path);
+    xSemaphoreTake(indexMutex, portMAX_DELAY);
+    si_resident_t* r = findResident(hash, size);
+    bool held = !r && dirLoaded && SD_AcquireAwake(); // the card is not woken for this
+    si_entry_t* e = held ? findEntry(hash, size) : NULL;
+    if (e) {
+        si_entry_t found = *e; // residentSlot() may write a record and move the directory
+        r = residentSlot();
+        File f = indexFs->open(indexPath);
+        if (f && f.seek(found.offset) && f.read(r->data, found.len) == found.len) {
+            r->hash = hash;
+            r->size = size;
+            r->len = found.len;
+        } else {
+            r = NULL;
+        }
+        if (f) f.close();
+    }
+    if (held) SD_Release();
+    bool ok = (r != NULL);
+    if (r) r->used = ++residentTick;
+    if (r && use) ok = use(r->data, r->len);
+    xSemaphoreGive(indexMutex);
+    return ok;
+}
+
+bool SeekIndex_TryGet(const char* path, uint32_t size, bool (*use)(const uint8_t* map, size_t len)) {
+    if (!indexMutex || !path || xSemaphoreTake(indexMutex, 0) != pdTRUE) return false; // the task writes a record
+    si_resident_t* r = findResident(hashPath(path), size);
+    if (r) r->used = ++residentTick;
+    bool ok = r && use(r->data, r->len);
+    xSemaphoreGive(indexMutex);
+    return ok;
+}
+
+bool SeekIndex_BuildAsync(const char* path, uint32_t size, void (*done)(const char* path, bool built)) {
+    if (!indexMutex || !path || !isMp3(path) || strlen(path) >= SEEK_INDEX_PATH_LEN) return false;
+    xSemaphoreTake(indexMutex, portMAX_DELAY);
+    strlcpy(pendingPath, path, sizeof(pendingPath));
+    pendingSize = size;
+    pendingDone = done;
+    pendingRequest = true;
+    xSemaphoreGive(indexMutex);
+    xTaskNotifyGive(indexTaskHandle);
+    return true;
+}
+
+void SeekIndex_Flush() {
+    if (!indexMutex) return;
+    xSemaphoreTake(indexMutex, portMAX_DELAY);
+    for (int i = 0; i < SEEK_INDEX_RESIDENT; i++) {
+        if (resident[i].len && resident[i].dirty) writeRecord(&resident[i]);
+    }
+    xSemaphoreGive(indexMutex);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Arduino.h"
+#include "FS.h"
+
+// Frame indexes of MP3 files (dsp/seek_map.h of the audio library) in one file next to the library index,
+// a VBR file is seeked to the exact frame with one read. The index of a file is built the first time it is
+// played, by a scan of its frame headers in a task, and handed to the library with audio.setSeekMap().
+//
+//   header | record: path hash, file size, map length | map | record | map ...
+//
+// Records are appended, the file is started again when it reaches maxBytes. The record directory and the
+// maps of the last tracks are held in PSRAM, a map built while the SD card sleeps is written by SeekIndex_Flush().
+
+// Start the task, it reads the record directory first, false: no PSRAM
+bool SeekIndex_Init(fs::FS& fs, const char* path, uint32_t maxBytes);
+
+// The map of a file (path and size as in the library index), from PSRAM or read from the index file if the card
+// is awake, use() is called with it (NULL: only load it, e.g. before the card sleeps), false: not built yet.
+// It waits for the task and may read the card, not for the audio task
+bool SeekIndex_Get(const char* path, uint32_t size, bool (*use)(const uint8_t* map, size_t len));
+
+// The map of a file if it is in PSRAM, for the audio task: the mutex is only tried and the card is not read,
+// false: not there or the task holds the mutex (SeekIndex_BuildAsync() gets it then)
+bool SeekIndex_TryGet(const char* path, uint32_t size, bool (*use)(const uint8_t* map, size_t len));
+
+// Get the map in the task (low priority, core 0): from PSRAM or the index file, else an MP3 file is scanned, from
+// the track cache if it is there, else from SD_FS(). A newer request stops a running scan, done() runs in the
+// task (built: the map is in PSRAM now), false: not an MP3 file or no task
+bool SeekIndex_BuildAsync(const char* path, uint32_t size, void (*done)(const char* path, bool built));
+
+// Write the maps that were built while the card was sleeping (nothing is written while it sleeps)
+void SeekIndex_Flush();
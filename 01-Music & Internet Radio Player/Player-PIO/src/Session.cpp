@@ -0,0 +1,100 @@
+#include "Session.h"
+#include "AudioPlayer.h"
+#include <Preferences.h>
+
+#define SESSION_POLL_MS 1000
+
+static void (*takeSnapshot)(session_t* s) = NULL;
+static session_t written;               // what NVS holds
+static bool stored = false;             // false: nothing yet, every key is written
+static TaskHandle_t sessionTaskHandle = NULL;
+
+static bool settingsDiffer(const session_t* a, const session_t* b) {
+    return a->mode != b->mode || a->station != b->station || a->volume != b->volume || a->eqPreset != b->eqPreset ||
+           a->brightness != b->brightness || a->orderPos != b->orderPos || a->cycle != b->cycle ||
+           strcmp(a->path, b->path) != 0;
+}
+
+// Only the keys that have changed, NVS appends an entry for every write
+static void writeSession(const session_t* s) {
+    Preferences prefs;
+    if (!prefs.begin(PLAYER_NVS_NAMESPACE, false)) {
+        return;
+    }
+    if (!stored || s->mode != written.mode) prefs.putUChar("mode", s->mode);
+    if (!stored || s->station != written.station) prefs.putUChar("station", s->station);
+    if (!stored || s->eqPreset != written.eqPreset) prefs.putChar("eq", s->eqPreset);
+    if (!stored || s->brightness != written.brightness) prefs.putUChar("bright", s->brightness);
+    if (!stored || s->orderPos != written.orderPos) prefs.putUInt("order", s->orderPos);
+    if (!stored || s->cycle != written.cycle) prefs.putUInt("cycle", s->cycle);
+    if (!stored || strcmp(s->path, written.path) != 0) prefs.putString("track", s->path);
+    if (!stored || s->fileSize != written.fileSize) prefs.putUInt("fsize", s->fileSize);
+    if (!stored || s->filePos != written.filePos) prefs.putUInt("fpos", s->filePos);
+    if (!stored || s->volume != written.volume) prefs.putUChar("volume", s->volume); // last: marks a session
+    prefs.end();
+    written = *s;
+    stored = true;
+}
+
+static void sessionTask(void* parameter) {
+    session_t last = written;
+    bool settling = false;              // a change is waiting for the settle time
+    uint32_t changedAt = 0;
+    uint32_t checkpointAt = millis();
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(SESSION_POLL_MS));
+        session_t now;
+        takeSnapshot(&now);
+        uint32_t ms = millis();
+
+        // A change (again) restarts the settle time, a stop is written with the position
+        if (settingsDiffer(&now, &last) || (last.playing && !now.playing)) {
+            changedAt = ms;
+            settling = true;
+        }
+        last = now;
+        bool moved = now.filePos != written.filePos || now.fileSize != written.fileSize;
+        if (settling && ms - changedAt >= SESSION_SETTLE_MS) {
+            if (!stored || settingsDiffer(&now, &written) || moved) {
+                writeSession(&now);
+            }
+            settling = false;
+            checkpointAt = ms;
+        } else if (now.playing && moved && ms - checkpointAt >= SESSION_CHECKPOINT_MS) {
+            writeSession(&now);
+            checkpointAt = ms;
+        }
+    }
+}
+
+bool Session_Load(session_t* s) {
+    Preferences prefs;
+    if (!prefs.begin(PLAYER_NVS_NAMESPACE, true)) {
+        return false;
+    }
+    bool found = stored = prefs.isKey("volume");
+    if (found) {
+        s->mode = prefs.getUChar("mode", s->mode);
+        s->station = prefs.getUChar("station", s->station);
+        s->volume = prefs.getUChar("volume", s->volume);
+        s->eqPreset = prefs.getChar("eq", s->eqPreset);
+        s->brightness = prefs.getUChar("bright", s->brightness);
+        s->orderPos = prefs.getUInt("order", s->orderPos);
+        s->cycle = prefs.getUInt("cycle", 0);
+        s->fileSize = prefs.getUInt("fsize", 0);
+        s->filePos = prefs.getUInt("fpos", 0);
+        if (!prefs.getString("track", s->path, sizeof(s->path))) s->path[0] = '\0';
+        s->playing = false;
+    }
+    prefs.end();
+    return found;
+}
+
+bool Session_Start(const session_t* s, void (*snapshot)(session_t* s)) {
+    if (sessionTaskHandle) {
+        return true;
+    }
+    written = *s;
+    takeSnapshot = snapshot;
+    return xTaskCreatePinnedToCore(sessionTask, "Session", 4096, NULL, 1, &sessionTaskHandle, 0) == pdPASS;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Arduino.h"
+#include "MediaLibrary.h"
+
+// The state of the player that survives a restart, in NVS (namespace PLAYER_NVS_NAMESPACE, one key per field).
+// A task compares a snapshot with what was written, only changed keys are written:
+//   - settings, mode, station and track when they have not changed for SESSION_SETTLE_MS (an arc drag is
+//     one write),
+//   - the position in the track every SESSION_CHECKPOINT_MS while playing and when playback stops.
+// Nothing is written by the audio task, a write is a few NVS entries.
+
+typedef struct {
+    uint8_t mode;                       // PlayerMode
+    uint8_t station;
+    uint8_t volume;                     // of AUDIO_VOLUME_STEPS
+    int8_t eqPreset;                    // -1: tone control
+    uint8_t brightness;
+    bool playing;                       // not saved, a stop saves the position at once
+    uint32_t orderPos;                  // position in the play order (Playlist)
+    uint32_t cycle;                     // shuffle cycle of the position (Shuffle.h), the key of the shuffle state
+    uint32_t fileSize;                  // of the track, the position is only used for the same file
+    uint32_t filePos;                   // byte position of the decoder in the track
+    char path[MEDIA_PATH_LEN];          // the track, "": none
+} session_t;
+
+// Read the saved session, false: there is none (first start), *s is not changed then
+bool Session_Load(session_t* s);
+
+// Start the writer task (low priority, core 0), snapshot() is called from it, s: the session as it was loaded
+bool Session_Start(const session_t* s, void (*snapshot)(session_t* s));
@@ -0,0 +1,64 @@
+#include "Shuffle.h"
+
+#define SHUFFLE_ROUNDS 4
+
+static uint32_t mix(uint32_t h) {
+    h ^= h >> 16; // murmur3 finalizer
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t feistelRound(const shuffle_t* s, int r, uint32_t half) {
+    return mix(half ^ s->key ^ (r + 1) * 0x9E3779B9u) & ((1u << s->halfBits) - 1);
+}
+
+static uint32_t encrypt(const shuffle_t* s, uint32_t x) {
+    uint32_t mask = (1u << s->halfBits) - 1;
+    uint32_t l = x >> s->halfBits, r = x & mask;
+    for (int i = 0; i < SHUFFLE_ROUNDS; i++) {
+        uint32_t t = l ^ feistelRound(s, i, r);
+        l = r;
+        r = t;
+    }
+    return (l << s->halfBits) | r;
+}
+
+static uint32_t decrypt(const shuffle_t* s, uint32_t x) {
+    uint32_t mask = (1u << s->halfBits) - 1;
+    uint32_t l = x >> s->halfBits, r = x & mask;
+    for (int i = SHUFFLE_ROUNDS - 1; i >= 0; i--) {
+        uint32_t t = r ^ feistelRound(s, i, l);
+        r = l;
+        l = t;
+    }
+    return (l << s->halfBits) | r;
+}
+
+void Shuffle_Init(shuffle_t* s, uint32_t n, uint32_t seed, uint32_t cycle) {
+    s->n = n;
+    s->key = mix(seed ^ mix(cycle + 0x6A09E667u));
+    s->halfBits = 0;
+    while (s->halfBits < 16 && ((uint64_t)1 << (2 * s->halfBits)) < n) s->halfBits++;
+}
+
+// Cycle walking: the permutation of the domain restricted to [0, n), the cycle of pos leads back into it
+uint32_t Shuffle_At(const shuffle_t* s, uint32_t pos) {
+    if (pos >= s->n) return pos;
+    uint32_t x = pos;
+    do {
+        x = encrypt(s, x);
+    } while (x >= s->n);
+    return x;
+}
+
+uint32_t Shuffle_IndexOf(const shuffle_t* s, uint32_t item) {
+    if (item >= s->n) return item;
+    uint32_t x = item;
+    do {
+        x = decrypt(s, x);
+    } while (x >= s->n);
+    return x;
+}
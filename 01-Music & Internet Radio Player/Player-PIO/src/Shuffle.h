@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+// Shuffled order of n items without a permutation table: a keyed 4 round Feistel network over the smallest
+// power of four >= n, values outside [0, n) are walked along their cycle until one is inside (less than
+// 4 steps on average). Nothing is stored but the key, the item at a position and the position of an item
+// are O(1), the order of a cycle visits every item once. Each cycle of a seed has its own order.
+//
+// No Arduino dependencies, builds on a Linux host.
+
+typedef struct {
+    uint32_t n;
+    uint32_t key;
+    uint8_t halfBits;                   // of the Feistel domain
+} shuffle_t;
+
+void Shuffle_Init(shuffle_t* s, uint32_t n, uint32_t seed, uint32_t cycle);
+
+// Item at position pos, position of item (the inverse), pos and item < n
+uint32_t Shuffle_At(const shuffle_t* s, uint32_t pos);
+uint32_t Shuffle_IndexOf(const shuffle_t* s, uint32_t item);
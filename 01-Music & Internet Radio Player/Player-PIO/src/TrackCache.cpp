@@ -0,0 +1,276 @@
+#include "TrackCache.h"
+#include "FSImpl.h"
+#include "SD_Card.h"
+
+#define TRACK_CACHE_ENTRIES 3           // current, next and the one that is replaced
+#define TRACK_CACHE_PATH_LEN 256        // MEDIA_PATH_LEN of the library
+#define TRACK_CACHE_COPY_CHUNK (32 * 1024)
+
+struct TrackCacheEntry {
+    char path[TRACK_CACHE_PATH_LEN];
+    uint32_t offset;                    // in the arena
+    uint32_t size;
+    bool used;                          // the space is taken
+    bool ready;                         // completely copied
+    int refs;                           // open files
+};
+
+static uint8_t* arena = NULL;
+static uint32_t arenaSize = 0;
+static TrackCacheEntry entries[TRACK_CACHE_ENTRIES];
+static SemaphoreHandle_t cacheMutex = NULL;   // entries and the pending request
+static TaskHandle_t cacheTaskHandle = NULL;
+static char pendingPath[TRACK_CACHE_PATH_LEN];
+static void (*pendingDone)(const char* path, bool staged) = NULL;
+static bool pendingRequest = false;
+
+static void releaseEntry(TrackCacheEntry* e) {
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    e->refs--;
+    xSemaphoreGive(cacheMutex);
+}
+
+// A staged track, read only, the entry can't be replaced while the file is open
+class MemFileImpl : public fs::FileImpl {
+public:
+    MemFileImpl(TrackCacheEntry* e) : _e(e), _pos(0), _size(e->size), _open(true) {
+        strlcpy(_path, e->path, sizeof(_path));
+    }
+    ~MemFileImpl() { close(); }
+    size_t write(const uint8_t* buf, size_t size) { return 0; }
+    size_t read(uint8_t* buf, size_t size) {
+        if (!_open) return 0;
+        if (size > _size - _pos) size = _size - _pos;
+        memcpy(buf, arena + _e->offset + _pos, size);
+        _pos += size;
+        return size;
+    }
+    void flush() {}
+    bool seek(uint32_t pos, fs::SeekMode mode) {
+        int64_t p = pos;
+        if (mode == fs::SeekCur) p = (int64_t)_pos + (int32_t)pos;
+        if (mode == fs::SeekEnd) p = (int64_t)_size + (int32_t)pos;
+        if (!_open || p < 0 || p > _size) return false;
+        _pos = p;
+        return true;
+    }
+    size_t position() const { return _pos; }
+    size_t size() const { return _size; }
+    bool setBufferSize(size_t size) { return true; }
+    void close() {
+        if (_open) releaseEntry(_e);
+        _open = false;
+    }
+    time_t getLastWrite() { return 0; }
+    const char* path() const { return _path; }
+    const char* name() const {
+        const char* slash = strrchr(_path, '/');
+        return slash ? slash + 1 : _path;
+    }
+    boolean isDirectory(void) { return false; }
+    fs::FileImplPtr openNextFile(const char* mode) { return fs::FileImplPtr(); }
+    boolean seekDir(long position) { return false; }
+    String getNextFileName(void) { return String(); }
+    String getNextFileName(bool* isDir) { return String(); }
+    void rewindDirectory(void) {}
+    operator bool() { return _open; }
+
+private:
+    TrackCacheEntry* _e;
+    uint32_t _pos;
+    uint32_t _size;
+    bool _open;
+    char _path[TRACK_CACHE_PATH_LEN];
+};
+
+class MemFSImpl : public fs::FSImpl {
+public:
+    fs::FileImplPtr open(const char* path, const char* mode, const bool create) {
+        if (!path || (mode && strcmp(mode, FILE_READ) != 0)) return fs::FileImplPtr();
+        fs::FileImplPtr file;
+        xSemaphoreTake(cacheMutex, portMAX_DELAY);
+        for (int i = 0; i < TRACK_CACHE_ENTRIES; i++) {
+            TrackCacheEntry* e = &entries[i];
+            if (e->used && e->ready && strcmp(e->path, path) == 0) {
+                e->refs++;
+                file = std::make_shared<MemFileImpl>(e);
+                break;
+            }
+        }
+        xSemaphoreGive(cacheMutex);
+        return file;
+    }
+    bool exists(const char* path) { return TrackCache_Contains(path); }
+    bool rename(const char* pathFrom, const char* pathTo) { return false; }
+    bool remove(const char* path) { return false; }
+    bool mkdir(const char* path) { return false; }
+    bool rmdir(const char* path) { return false; }
+};
+
+static fs::FS memFS(fs::FSImplPtr(new MemFSImpl()));
+
+// Space for a new track: tracks nobody reads are dropped, first fit in the arena, NULL if it doesn't fit
+static TrackCacheEntry* allocEntry(const char* path, uint32_t size) {
+    TrackCacheEntry* slot = NULL;
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    for (int i = 0; i < TRACK_CACHE_ENTRIES; i++) {
+        if (entries[i].used && entries[i].refs == 0) entries[i].used = false;
+        if (!entries[i].used && !slot) slot = &entries[i];
+    }
+    uint32_t start = 0;
+    while (slot) {
+        TrackCacheEntry* next = NULL; // the used entry behind start
+        for (int i = 0; i < TRACK_CACHE_ENTRIES; i++) {
+            TrackCacheEntry* e = &entries[i];
+            if (e->used && e->offset >= start && (!next || e->offset < next->offset)) next = e;
+        }
+        uint32_t end = next ? next->offset : arenaSize;
+        if (end - start >= size) break;
+        if (!next) slot = NULL;
+        else start = next->offset + next->size;
+    }
+    if (slot) {
+        strlcpy(slot->path, path, sizeof(slot->path));
+        slot->offset = start;
+        slot->size = size;
+        slot->used = true;
+        slot->ready = false;
+        slot->refs = 0;
+    }
+    xSemaphoreGive(cacheMutex);
+    return slot;
+}
+
+// Copy a file from the SD card into the arena in large reads
+static bool stageFile(const char* path) {
+    if (TrackCache_Contains(path)) return true;
+    if (strlen(path) >= TRACK_CACHE_PATH_LEN) return false;
+    File file = SD_FS().open(path); // wakes the card, holds it until closed
+    if (!file) return false;
+    uint32_t size = file.size();
+    TrackCacheEntry* e = allocEntry(path, size);
+    if (!e) {
+        file.close();
+        Serial.printf("Track cache: %s (%lu KB) does not fit\n", path, (long unsigned int)(size / 1024));
+        return false;
+    }
+
+    // The SD driver reads into PSRAM sector by sector, a DMA capable buffer takes whole chunks
+    uint32_t chunk = TRACK_CACHE_COPY_CHUNK;
+    uint8_t* buffer = NULL;
+    while (!(buffer = (uint8_t*)heap_caps_malloc(chunk, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL)) && chunk > 4096) {
+        chunk /= 2;
+    }
+    uint32_t t0 = millis();
+    uint32_t copied = 0;
+    while (copied < size) {
+        uint32_t n = min(size - copied, chunk);
+        uint8_t* dst = arena + e->offset + copied;
+        int32_t r = file.read(buffer ? buffer : dst, n);
+        if (r <= 0) break;
+        if (buffer) memcpy(dst, buffer, r);
+        copied += r;
+    }
+    file.close();
+    if (buffer) free(buffer);
+
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    if (copied == size) e->ready = true;
+    else e->used = false;
+    xSemaphoreGive(cacheMutex);
+    if (copied != size) {
+        Serial.printf("Track cache: read error in %s\n", path);
+        return false;
+    }
+    uint32_t ms = millis() - t0;
+    Serial.printf("Track cache: %s, %lu KB in %lu ms\n", path, (long unsigned int)(size / 1024), (long unsigned int)ms);
+    return true;
+}
+
+// Copy task, one request at a time, the newest wins
+static void TrackCache_Task(void* parameter) {
+    char path[TRACK_CACHE_PATH_LEN];
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (true) {
+            xSemaphoreTake(cacheMutex, portMAX_DELAY);
+            bool request = pendingRequest;
+            void (*done)(const char* path, bool staged) = pendingDone;
+            strlcpy(path, pendingPath, sizeof(path));
+            pendingRequest = false;
+            xSemaphoreGive(cacheMutex);
+            if (!request) break;
+            bool staged = stageFile(path);
+            if (done) done(path, staged);
+        }
+    }
+}
+
+bool TrackCache_Init(uint32_t arenaBytes) {
+    if (arena) return true;
+    while (arenaBytes >= 1024 * 1024 && !(arena = (uint8_t*)heap_caps_malloc(arenaBytes, MALLOC_CAP_SPIRAM))) {
+        arenaBytes /= 2;
+    }
+    if (!arena) {
+        Serial.println("Track cache: no PSRAM for the arena");
+        return false;
+    }
+    arenaSize = arenaBytes;
+    memset(entries, 0, sizeof(entries));
+    cacheMutex = xSemaphoreCreateMutex();
+    if (xTaskCreatePinnedToCore(TrackCache_Task, "TrackCache", 4096, NULL, 1, &cacheTaskHandle, 0) != pdPASS) {
+        free(arena);
+        arena = NULL;
+        Serial.println("Track cache: task not created");
+        return false;
+    }
+    Serial.printf("Track cache: %lu KB arena in PSRAM\n", (long unsigned int)(arenaSize / 1024));
+    return true;
+}
+
+bool TrackCache_Enabled() {
+    return arena != NULL;
+}
+
+fs::FS& TrackCache_FS() {
+    return memFS;
+}
+
+bool TrackCache_Contains(const char* path) {
+    if (!arena || !path) return false;
+    bool found = false;
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    for (int i = 0; i < TRACK_CACHE_ENTRIES && !found; i++) {
+        found = entries[i].used && entries[i].ready && strcmp(entries[i].path, path) == 0;
+    }
+    xSemaphoreGive(cacheMutex);
+    return found;
+}
+
+void TrackCache_StageAsync(const char* path, void (*done)(const char* path, bool staged)) {
+    if (!arena) {
+        if (done) done(path, false);
+        return;
+    }
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    strlcpy(pendingPath, path, sizeof(pendingPath));
+    pendingDone = done;
+    pendingRequest = true;
+    xSemaphoreGive(cacheMutex);
+    xTaskNotifyGive(cacheTaskHandle);
+}
+
+uint32_t TrackCache_ArenaSize() {
+    return arenaSize;
+}
+
+uint32_t TrackCache_Used() {
+    uint32_t used = 0;
+    if (!arena) return 0;
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+    for (int i = 0; i < TRACK_CACHE_ENTRIES; i++) {
+        if (entries[i].used) used += entries[i].size;
+    }
+    xSemaphoreGive(cacheMutex);
+    return used;
+}
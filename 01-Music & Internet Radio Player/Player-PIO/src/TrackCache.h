@@ -0,0 +1,26 @@
+#pragma once
+#include "Arduino.h"
+#include "FS.h"
+
+// Whole tracks copied from the SD card into one PSRAM arena (the current and the next one) and played
+// through an fs::FS in memory, the card is only needed for the copy and can sleep in between (SD_Sleep)
+// the files keep their SD path, ReplayGain and the gain table see the same names
+
+// Allocate the arena (halved down to 1 MB if PSRAM is short) and start the copy task, false: cache off
+bool TrackCache_Init(uint32_t arenaBytes);
+
+bool TrackCache_Enabled();
+
+// The file system of the staged tracks, read only
+fs::FS& TrackCache_FS();
+
+// The file is completely in the arena
+bool TrackCache_Contains(const char* path);
+
+// Copy the file from SD_FS() in the copy task (low priority, core 0), the open wakes the card,
+// a newer request replaces one that has not started yet, done() runs in the copy task
+void TrackCache_StageAsync(const char* path, void (*done)(const char* path, bool staged));
+
+// Bytes of the arena and of the staged tracks
+uint32_t TrackCache_ArenaSize();
+uint32_t TrackCache_Used();
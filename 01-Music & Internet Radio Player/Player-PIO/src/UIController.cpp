@@ -2,6 +2,7 @@
 #include "Audio_PCM5101.h"
 #include "Display_ST77916.h"
 #include "AudioPlayer.h" 
+#include "CoverArt.h"
 
 // Maximum number of files and stations to display
 const int MAX_FILES = 20;     // Increased to 10
@@ -30,13 +31,36 @@ static bool radioConnectionError = false;
 static uint32_t errorDisplayStartTime = 0;
 const uint32_t ERROR_DISPLAY_DURATION = 3000; // 3 seconds
 
+// The shuffle mode is shown in the time label for a moment after a long press on Next
+static uint32_t shuffleDisplayStartTime = 0;
+const uint32_t SHUFFLE_DISPLAY_DURATION = 1500;
+
+// Cover art of the playing track behind the controls, dimmed so the controls stay readable
+static lv_obj_t *coverArtImage = NULL;
+static uint32_t coverArtVersion = 0;
+const lv_opa_t COVER_ART_OPA = LV_OPA_40;
+
 // Forward declaration of timer callback
 static void UIController_TimerCallback(lv_timer_t *timer);
 
+// The session task takes the state of the player and the brightness from here
+static void sessionSnapshot(session_t *s) {
+    AudioPlayer_GetSession(s);
+    s->brightness = currentBrightness;
+}
+
 // Initialize the UI controller
 void UIController_Init() {
+    // The last session (volume, brightness, mode, station, EQ, track and position), the defaults on the first start
+    session_t session = {};
+    session.volume = 48;
+    session.eqPreset = -1;
+    session.brightness = currentBrightness;
+    bool restored = Session_Load(&session);
+    currentBrightness = max((int)session.brightness, 10);
+    
     // Set initial volume using audio object directly
-    AudioPlayer_SetVolume(10);
+    AudioPlayer_SetVolume(session.volume);
     
     // Set initial brightness
     Set_Backlight(currentBrightness);
@@ -44,6 +68,12 @@ void UIController_Init() {
     // Initialize the audio player with smaller buffers
     if (AudioPlayer_Init()) {
         Serial.println("Audio player initialized successfully");
+        if (restored) {
+            AudioPlayer_Resume(&session);
+            if (AudioPlayer_GetMode() == MODE_WEB_RADIO) {
+                lv_obj_add_state(ui_Button_Mode, LV_STATE_CHECKED);
+            }
+        }
         
         // Delay list update to separate initialization phases
         vTaskDelay(20);
@@ -55,6 +85,14 @@ void UIController_Init() {
     // Set up event handlers for UI elements
     UIController_SetupEvents();
     
+    // Cover art image, the bottom layer of the screen, hidden until a track has art
+    coverArtImage = lv_img_create(ui_Screen1);
+    lv_obj_center(coverArtImage);
+    lv_obj_move_background(coverArtImage);
+    lv_obj_clear_flag(coverArtImage, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_flag(coverArtImage, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_set_style_img_opa(coverArtImage, COVER_ART_OPA, LV_PART_MAIN | LV_STATE_DEFAULT);
+    
     // Create timer for UI updates with reduced frequency
     ui_update_timer = lv_timer_create(UIController_TimerCallback, 200, NULL);
     
@@ -66,8 +104,15 @@ void UIController_Init() {
     lv_obj_clear_state(ui_Button_PlayPause, LV_STATE_CHECKED);
     
     // Initialize volume and brightness arc controls
-    lv_arc_set_value(ui_Arc_Volume, AudioPlayer_GetVolume() * 100 / 21);
+    lv_arc_set_value(ui_Arc_Volume, AudioPlayer_GetVolume() * 100 / AUDIO_VOLUME_STEPS);
     lv_arc_set_value(ui_Arc_Brightness, currentBrightness);
+    
+    // Changes are written to NVS in the background, coalesced
+    AudioPlayer_GetSession(&session);
+    session.brightness = currentBrightness;
+    if (!Session_Start(&session, sessionSnapshot)) {
+        Serial.println("Session task not started, nothing is saved");
+    }
 }
 
 // Timer callback for UI updates
@@ -100,6 +145,26 @@ void UIController_UpdateUI() {
         lastStationIndex = currentStationIndex;
     }
     
+    // The library scan has changed the track list
+    static uint32_t lastLibraryVersion = 0;
+    if (AudioPlayer_GetLibraryVersion() != lastLibraryVersion) {
+        lastLibraryVersion = AudioPlayer_GetLibraryVersion();
+        if (AudioPlayer_GetMode() == MODE_MUSIC_PLAYER) {
+            UIController_UpdateList();
+        }
+    }
+    
+    // The cover art has changed (cover art task)
+    const lv_img_dsc_t *art;
+    if (coverArtImage && CoverArt_Changed(&coverArtVersion, &art)) {
+        if (art) {
+            lv_img_set_src(coverArtImage, art);
+            lv_obj_clear_flag(coverArtImage, LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_add_flag(coverArtImage, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+    
     // Update time display every 1 second
     if (currentMillis - lastTimeUpdate >= 1000) {
         UIController_UpdateTimeDisplay();
@@ -128,7 +193,8 @@ void UIController_SetupEvents() {
     lv_obj_add_event_cb(ui_Button_PlayPause, UI_PlayPauseButtonCallback, LV_EVENT_CLICKED, NULL);
     
     // Next button
-    lv_obj_add_event_cb(ui_Button_Next, UI_NextButtonCallback, LV_EVENT_CLICKED, NULL);
+    lv_obj_add_event_cb(ui_Button_Next, UI_NextButtonCallback, LV_EVENT_SHORT_CLICKED, NULL);
+    lv_obj_add_event_cb(ui_Button_Next, UI_NextLongPressCallback, LV_EVENT_LONG_PRESSED, NULL);
     
     // Previous button
     lv_obj_add_event_cb(ui_Button_Previous, UI_PreviousButtonCallback, LV_EVENT_CLICKED, NULL);
@@ -145,12 +211,24 @@ void UIController_SetupEvents() {
 
 // Update the time display - Now with error display
 void UIController_UpdateTimeDisplay() {
+    if (shuffleDisplayStartTime && millis() - shuffleDisplayStartTime < SHUFFLE_DISPLAY_DURATION) {
+        return;
+    }
+    shuffleDisplayStartTime = 0;
+    
     if (radioConnectionError && AudioPlayer_GetMode() == MODE_WEB_RADIO) {
         // Show error message for radio
         lv_label_set_text(ui_Label_Time, "Error !!!");
         // Don't reset - let other UI actions clear the error
     } else if (!AudioPlayer_IsPlaying()) {
-        lv_label_set_text(ui_Label_Time, "--:--");
+        int scan = AudioPlayer_GetScanProgress();
+        if (scan >= 0 && AudioPlayer_GetMode() == MODE_MUSIC_PLAYER) {
+            // Library scan running
+            snprintf(timeDisplayBuffer, sizeof(timeDisplayBuffer), "%d%%", scan);
+            lv_label_set_text(ui_Label_Time, timeDisplayBuffer);
+        } else {
+            lv_label_set_text(ui_Label_Time, "--:--");
+        }
     } else {
         uint32_t elapsed;
         if (AudioPlayer_GetMode() == MODE_MUSIC_PLAYER) {
@@ -209,20 +287,18 @@ void UIController_UpdateList() {
             // Create a temporary small buffer for each filename
             char tempName[32]; // Temp buffer for truncated filename
             
-            // Build the list with actual filenames (truncated if needed)
+            // Build the list with the track titles (truncated if needed)
             for (int i = 0; i < filesToShow; i++) {
-                const char* fileName = AudioPlayer_GetFileName(i);
+                const char* fileName = AudioPlayer_GetTrackTitle(i);
                 
-                // Get filename without extension
                 strncpy(tempName, fileName, sizeof(tempName) - 1);
                 tempName[sizeof(tempName) - 1] = '\0';
                 
-                // Truncate long filenames
+                // Truncate long titles, not inside a UTF-8 character
                 if (strlen(tempName) > 20) {
-                    tempName[17] = '.';
-                    tempName[18] = '.';
-                    tempName[19] = '.';
-                    tempName[20] = '\0';
+                    int cut = 17;
+                    while (cut > 0 && (tempName[cut] & 0xC0) == 0x80) cut--;
+                    strcpy(tempName + cut, "...");
                 }
                 
                 // Add to list buffer
@@ -365,6 +441,17 @@ void UI_NextButtonCallback(lv_event_t *e) {
     }
 }
 
+// Long press on Next: shuffle off, tracks, albums (music player only)
+void UI_NextLongPressCallback(lv_event_t *e) {
+    if (AudioPlayer_GetMode() != MODE_MUSIC_PLAYER) {
+        return;
+    }
+    ShuffleMode mode = (ShuffleMode)((AudioPlayer_GetShuffle() + 1) % 3);
+    AudioPlayer_SetShuffle(mode);
+    lv_label_set_text(ui_Label_Time, mode == SHUFFLE_TRACKS ? "Shuffle" : mode == SHUFFLE_ALBUMS ? "Albums" : "In order");
+    shuffleDisplayStartTime = millis();
+}
+
 // WITH FORCED AUTO-PLAY: Previous button definitely plays the previous track
 void UI_PreviousButtonCallback(lv_event_t *e) {
     // Stop current playback first
@@ -445,8 +532,8 @@ void UI_VolumeArcCallback(lv_event_t *e) {
     // Set indicator angles manually
     lv_arc_set_angles(arc, start_angle, end_angle);
 
-    // Convert value to volume scale (0-21)
-    uint8_t volume = (value * 21) / 100;
+    // Convert value to volume scale (0-AUDIO_VOLUME_STEPS), the library ramps to the new gain
+    uint8_t volume = (value * AUDIO_VOLUME_STEPS) / 100;
     AudioPlayer_SetVolume(volume);
 }
 
@@ -28,6 +28,7 @@ void UIController_UpdateList();
 void UI_ModeButtonCallback(lv_event_t *e);
 void UI_PlayPauseButtonCallback(lv_event_t *e);
 void UI_NextButtonCallback(lv_event_t *e);
+void UI_NextLongPressCallback(lv_event_t *e);
 void UI_PreviousButtonCallback(lv_event_t *e);
 void UI_ListCallback(lv_event_t *e);
 
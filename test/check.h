@@ -0,0 +1,21 @@
+// Checks for the host tests: CHECK() counts the failures, main() ends with return CHECK_RESULT();
+#pragma once
+#include <stdio.h>
+#include <chrono>
+
+static int checkFails = 0;
+
+#define CHECK(c)                                                             \
+    do {                                                                     \
+        if (!(c)) {                                                          \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c);              \
+            checkFails++;                                                    \
+        }                                                                    \
+    } while (0)
+
+#define CHECK_RESULT() (printf(checkFails ? "%d checks failed\n" : "ok\n", checkFails), checkFails ? 1 : 0)
+
+// Wall clock for the benchmarks [ns]
+static inline double nowNs() {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,147 @@
+// Host stand-in for the parts of Arduino-ESP32 and FreeRTOS the tested modules use
+//
+// Tasks are threads, semaphores and task notifications are counting semaphores. millis() and vTaskDelay() run on
+// the wall clock unless a test sets mock::fakeClock: then millis() returns mock::nowMs and vTaskDelay() calls
+// mock::onDelay (which advances the clock and drives the test).
+#pragma once
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using std::max;
+using std::min;
+
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+#define MALLOC_CAP_DMA      (1 << 3)
+
+inline bool  psramInit() { return true; }
+inline void* ps_malloc(size_t n) { return malloc(n); }
+inline void* ps_calloc(size_t n, size_t size) { return calloc(n, size); }
+inline void* ps_realloc(void* p, size_t n) { return realloc(p, n); }
+inline void* heap_caps_malloc(size_t n, uint32_t) { return malloc(n); }
+inline void* heap_caps_calloc(size_t n, size_t size, uint32_t) { return calloc(n, size); }
+
+#if !defined(__GLIBC__) || __GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+inline size_t strlcpy(char* dst, const char* src, size_t len) {
+    size_t n = strlen(src);
+    if (len) {
+        size_t c = (n < len - 1) ? n : len - 1;
+        memcpy(dst, src, c);
+        dst[c] = '\0';
+    }
+    return n;
+}
+#endif
+
+class String : public std::string {
+public:
+    String() {}
+    String(const char* s) : std::string(s ? s : "") {}
+};
+
+struct HardwareSerial {
+    template <class... A> int printf(const char* fmt, A... a) { return ::printf(fmt, a...); }
+    void println(const char* s) { puts(s); }
+};
+inline HardwareSerial Serial;
+
+#define log_e(fmt, ...) printf("E: " fmt "\n", ##__VA_ARGS__)
+#define log_w(fmt, ...) printf("W: " fmt "\n", ##__VA_ARGS__)
+#define log_i(fmt, ...)
+
+namespace mock {
+inline bool                          fakeClock = false;
+inline uint32_t                      nowMs = 0;
+inline std::function<void(uint32_t)> onDelay;
+} // namespace mock
+
+inline uint32_t millis() {
+    if (mock::fakeClock) return mock::nowMs;
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// FreeRTOS
+typedef int      BaseType_t;
+typedef uint32_t TickType_t;
+#define portMAX_DELAY    0xffffffffu
+#define pdMS_TO_TICKS(x) (x)
+#define pdTRUE           1
+#define pdFALSE          0
+#define pdPASS           1
+#define pdFAIL           0
+
+struct mock_sem_t {
+    std::mutex              m;
+    std::condition_variable cv;
+    uint32_t                count;
+};
+typedef mock_sem_t* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new mock_sem_t{{}, {}, 1}; }
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return new mock_sem_t{{}, {}, 0}; }
+inline void              vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
+inline BaseType_t        xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+    std::unique_lock<std::mutex> l(s->m);
+    auto                         ready = [s] { return s->count > 0; };
+    if (ticks == portMAX_DELAY) s->cv.wait(l, ready);
+    else if (!s->cv.wait_for(l, std::chrono::milliseconds(ticks), ready)) return pdFALSE;
+    s->count--;
+    return pdTRUE;
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    {
+        std::lock_guard<std::mutex> l(s->m);
+        s->count++;
+    }
+    s->cv.notify_one();
+    return pdTRUE;
+}
+
+struct mock_task_t {
+    mock_sem_t notify{{}, {}, 0};
+};
+typedef mock_task_t* TaskHandle_t;
+
+namespace mock {
+inline thread_local TaskHandle_t self = NULL;
+} // namespace mock
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char*, uint32_t, void* arg, int, TaskHandle_t* handle, int) {
+    TaskHandle_t t = new mock_task_t;
+    if (handle) *handle = t;
+    std::thread([=] {
+        mock::self = t;
+        fn(arg);
+    }).detach();
+    return pdPASS;
+}
+inline void     vTaskDelete(TaskHandle_t) {} // the tasks return after it
+inline void     xTaskNotifyGive(TaskHandle_t t) { xSemaphoreGive(&t->notify); }
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    mock_sem_t*                  s = &mock::self->notify;
+    std::unique_lock<std::mutex> l(s->m);
+    auto                         ready = [s] { return s->count > 0; };
+    if (ticks == portMAX_DELAY) s->cv.wait(l, ready);
+    else if (!s->cv.wait_for(l, std::chrono::milliseconds(ticks), ready)) return 0;
+    uint32_t n = s->count;
+    s->count = clear ? 0 : n - 1;
+    return n;
+}
+inline void vTaskDelay(TickType_t ticks) {
+    if (mock::onDelay) mock::onDelay(ticks);
+    else std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+inline void delay(uint32_t ms) { vTaskDelay(ms); }
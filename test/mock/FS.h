@@ -0,0 +1,63 @@
+// Host stand-in for Arduino-ESP32 FS.h, fs::File and fs::FS forward to an FSImpl
+#pragma once
+#include "FSImpl.h"
+
+typedef bool boolean;
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+class File {
+public:
+    File(FileImplPtr p = FileImplPtr()) : _p(p) {}
+    size_t      write(uint8_t c) { return write(&c, 1); }
+    size_t      write(const uint8_t* buf, size_t size) { return _p ? _p->write(buf, size) : 0; }
+    size_t      read(uint8_t* buf, size_t size) { return _p ? _p->read(buf, size) : 0; }
+    int         read() {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+    int         available() { return _p ? (int)(_p->size() - _p->position()) : 0; }
+    void        flush() { if (_p) _p->flush(); }
+    bool        seek(uint32_t pos, SeekMode mode = SeekSet) { return _p && _p->seek(pos, mode); }
+    size_t      position() const { return _p ? _p->position() : 0; }
+    size_t      size() const { return _p ? _p->size() : 0; }
+    void        close() {
+        if (_p) _p->close();
+        _p = FileImplPtr();
+    }
+    operator bool() const { return _p && (bool)*_p; }
+    time_t      getLastWrite() { return _p ? _p->getLastWrite() : 0; }
+    const char* path() const { return _p ? _p->path() : NULL; }
+    const char* name() const { return _p ? _p->name() : NULL; }
+    bool        isDirectory() { return _p && _p->isDirectory(); }
+    File        openNextFile(const char* mode = FILE_READ) { return _p ? File(_p->openNextFile(mode)) : File(); }
+    void        rewindDirectory() { if (_p) _p->rewindDirectory(); }
+
+protected:
+    FileImplPtr _p;
+};
+
+class FS {
+public:
+    FS(FSImplPtr impl) : _impl(impl) {}
+    File open(const char* path, const char* mode = FILE_READ, const bool create = false) {
+        return (_impl && path) ? File(_impl->open(path, mode, create)) : File();
+    }
+    bool exists(const char* path) { return _impl && _impl->exists(path); }
+    bool remove(const char* path) { return _impl && _impl->remove(path); }
+    bool rename(const char* pathFrom, const char* pathTo) { return _impl && _impl->rename(pathFrom, pathTo); }
+    bool mkdir(const char* path) { return _impl && _impl->mkdir(path); }
+    bool rmdir(const char* path) { return _impl && _impl->rmdir(path); }
+
+protected:
+    FSImplPtr _impl;
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
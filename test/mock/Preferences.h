@@ -0,0 +1,54 @@
+// Host stand-in for Preferences (NVS) of Arduino-ESP32: one map for all namespaces, mock::nvsWrites counts the
+// writes of every key
+#pragma once
+#include "Arduino.h"
+#include <map>
+#include <string>
+
+namespace mock {
+inline std::map<std::string, std::string> nvs;       // "namespace/key": value bytes
+inline std::map<std::string, int>         nvsWrites; // "namespace/key"
+} // namespace mock
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* = NULL) {
+        _ns = name;
+        _readOnly = readOnly;
+        return true;
+    }
+    void end() { _ns.clear(); }
+    bool isKey(const char* key) { return mock::nvs.count(_ns + "/" + key) != 0; }
+    bool remove(const char* key) { return mock::nvs.erase(_ns + "/" + key) != 0; }
+
+    size_t putChar(const char* key, int8_t value) { return put(key, &value, sizeof(value)); }
+    size_t putUChar(const char* key, uint8_t value) { return put(key, &value, sizeof(value)); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putString(const char* key, const char* value) { return put(key, value, strlen(value)); }
+
+    int8_t   getChar(const char* key, int8_t value = 0) { return get(key, value); }
+    uint8_t  getUChar(const char* key, uint8_t value = 0) { return get(key, value); }
+    uint32_t getUInt(const char* key, uint32_t value = 0) { return get(key, value); }
+    size_t   getString(const char* key, char* value, size_t maxLen) {
+        auto it = mock::nvs.find(_ns + "/" + key);
+        if (it == mock::nvs.end() || it->second.size() >= maxLen) return 0;
+        strlcpy(value, it->second.c_str(), maxLen);
+        return it->second.size() + 1;
+    }
+
+private:
+    std::string _ns;
+    bool        _readOnly = false;
+
+    size_t put(const char* key, const void* value, size_t len) {
+        if (_ns.empty() || _readOnly) return 0;
+        mock::nvs[_ns + "/" + key] = std::string((const char*)value, len);
+        mock::nvsWrites[_ns + "/" + key]++;
+        return len;
+    }
+    template <class T> T get(const char* key, T value) {
+        auto it = mock::nvs.find(_ns + "/" + key);
+        if (it != mock::nvs.end() && it->second.size() == sizeof(T)) memcpy(&value, it->second.data(), sizeof(T));
+        return value;
+    }
+};
@@ -0,0 +1,125 @@
+// Host stand-in for SD_Card.h: SD_FS() is a directory of the host (mock::sdRoot, relative to the working
+// directory of the test), SD_MOUNT_POINT is replaced by it for the POSIX calls
+#pragma once
+#include "FS.h"
+#include <atomic>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SD_MOUNT_POINT mock::sdRoot
+
+namespace mock {
+inline const char*           sdRoot = "card";
+inline std::atomic<uint32_t> fileOpens{0}, fileReads{0}; // through SD_FS()
+inline std::atomic<int>      sdHeld{0};                  // SD_Acquire() - SD_Release()
+inline std::atomic<bool>     sdSleeping{false};
+
+class HostFileImpl : public fs::FileImpl {
+public:
+    HostFileImpl(const std::string& path, FILE* f, DIR* d) : _path(path), _f(f), _d(d) {
+        if (_f) {
+            fseek(_f, 0, SEEK_END);
+            _size = ftell(_f);
+            fseek(_f, 0, SEEK_SET);
+        }
+    }
+    ~HostFileImpl() { close(); }
+    size_t write(const uint8_t* buf, size_t size) {
+        if (!_f) return 0;
+        size_t n = fwrite(buf, 1, size, _f);
+        _size = std::max(_size, (size_t)ftell(_f));
+        return n;
+    }
+    size_t read(uint8_t* buf, size_t size) {
+        fileReads++;
+        return _f ? fread(buf, 1, size, _f) : 0;
+    }
+    void flush() { if (_f) fflush(_f); }
+    bool seek(uint32_t pos, fs::SeekMode mode) {
+        if (!_f) return false;
+        long p = (mode == fs::SeekSet) ? (long)pos : (mode == fs::SeekCur) ? ftell(_f) + (int32_t)pos : (long)_size + (int32_t)pos;
+        return p >= 0 && (size_t)p <= _size && fseek(_f, p, SEEK_SET) == 0;
+    }
+    size_t      position() const { return _f ? ftell(_f) : 0; }
+    size_t      size() const { return _size; }
+    bool        setBufferSize(size_t) { return true; }
+    void        close() {
+        if (_f) fclose(_f);
+        if (_d) closedir(_d);
+        _f = NULL;
+        _d = NULL;
+    }
+    time_t      getLastWrite() { return 0; }
+    const char* path() const { return _path.c_str(); }
+    const char* name() const {
+        size_t s = _path.rfind('/');
+        return _path.c_str() + (s == std::string::npos ? 0 : s + 1);
+    }
+    bool            isDirectory(void) { return _d != NULL; }
+    fs::FileImplPtr openNextFile(const char* mode);
+    void            rewindDirectory(void) { if (_d) rewinddir(_d); }
+    operator bool() { return _f || _d; }
+
+private:
+    std::string _path;
+    FILE*       _f;
+    DIR*        _d;
+    size_t      _size = 0;
+};
+
+class HostFSImpl : public fs::FSImpl {
+public:
+    std::string     real(const char* path) { return std::string(sdRoot) + path; }
+    fs::FileImplPtr open(const char* path, const char* mode, const bool) {
+        fileOpens++;
+        std::string r = real(path);
+        struct stat st;
+        if (mode[0] == 'r' && stat(r.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            return std::make_shared<HostFileImpl>(path, (FILE*)NULL, opendir(r.c_str()));
+        FILE* f = fopen(r.c_str(), mode[0] == 'w' ? "w+b" : mode[0] == 'a' ? "a+b" : "rb");
+        return f ? std::make_shared<HostFileImpl>(path, f, (DIR*)NULL) : fs::FileImplPtr();
+    }
+    bool exists(const char* path) {
+        struct stat st;
+        return stat(real(path).c_str(), &st) == 0;
+    }
+    bool rename(const char* pathFrom, const char* pathTo) { return ::rename(real(pathFrom).c_str(), real(pathTo).c_str()) == 0; }
+    bool remove(const char* path) { return ::remove(real(path).c_str()) == 0; }
+    bool mkdir(const char* path) { return ::mkdir(real(path).c_str(), 0755) == 0; }
+    bool rmdir(const char* path) { return ::rmdir(real(path).c_str()) == 0; }
+};
+
+inline fs::FileImplPtr HostFileImpl::openNextFile(const char* mode) {
+    struct dirent* e;
+    while (_d && (e = readdir(_d)) != NULL) {
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+        std::string p = _path + (_path == "/" ? "" : "/") + e->d_name;
+        return HostFSImpl().open(p.c_str(), mode, false);
+    }
+    return fs::FileImplPtr();
+}
+} // namespace mock
+
+inline fs::FS& SD_FS() {
+    static fs::FS sd(std::make_shared<mock::HostFSImpl>());
+    return sd;
+}
+inline bool SD_IsAvailable() { return true; }
+inline bool SD_Acquire() {
+    mock::sdHeld++;
+    mock::sdSleeping = false;
+    return true;
+}
+inline bool SD_AcquireAwake() {
+    if (mock::sdSleeping) return false;
+    mock::sdHeld++;
+    return true;
+}
+inline void SD_Release() { mock::sdHeld--; }
+inline bool SD_Sleep() {
+    if (mock::sdHeld) return false;
+    mock::sdSleeping = true;
+    return true;
+}
+inline bool SD_IsSleeping() { return mock::sdSleeping; }
@@ -0,0 +1,37 @@
+// Host stand-in for the image types of LVGL 8 the player sources use (LV_COLOR_DEPTH 16, LV_COLOR_16_SWAP 0)
+#pragma once
+#include <stdint.h>
+
+enum { LV_IMG_CF_TRUE_COLOR = 4 };
+
+typedef struct {
+    uint32_t cf : 5;
+    uint32_t always_zero : 3;
+    uint32_t reserved : 2;
+    uint32_t w : 11;
+    uint32_t h : 11;
+} lv_img_header_t;
+
+typedef struct {
+    lv_img_header_t header;
+    uint32_t        data_size;
+    const uint8_t*  data;
+} lv_img_dsc_t;
+
+typedef union {
+    struct {
+        uint16_t blue : 5;
+        uint16_t green : 6;
+        uint16_t red : 5;
+    } ch;
+    uint16_t full;
+} lv_color_t;
+
+static inline lv_color_t lv_color_make(uint8_t r, uint8_t g, uint8_t b) {
+    lv_color_t c;
+    c.ch.red = r >> 3;
+    c.ch.green = g >> 2;
+    c.ch.blue = b >> 3;
+    return c;
+}
+static inline lv_color_t lv_color_black() { return lv_color_make(0, 0, 0); }
@@ -0,0 +1,90 @@
+// AudioBuffer: the window of getReadPtr() against the stream, and the throughput against the former getReadPtr()
+#include "check.h"
+#include "AudioBuffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+// counts the bytes getReadPtr() copies behind m_endPtr
+class CountingBuffer : public AudioBuffer {
+public:
+    size_t   copied = 0;
+    uint8_t* getReadPtr() {
+        size_t   m = m_mirrored;
+        uint8_t* r = AudioBuffer::getReadPtr();
+        if (m_mirrored > m) copied += m_mirrored - m;
+        return r;
+    }
+};
+
+// before the guard area was filled incrementally: maxBlockSize - len bytes copied on every call near the end
+class CopyAllBuffer : public AudioBuffer {
+public:
+    size_t   copied = 0;
+    uint8_t* getReadPtr() {
+        size_t len = m_endPtr - m_readPtr;
+        if (len < m_maxBlockSize) {
+            memcpy(m_endPtr, m_buffer, m_maxBlockSize - len);
+            copied += m_maxBlockSize - len;
+        }
+        return m_readPtr;
+    }
+};
+
+static uint8_t pattern[65536 + 4096]; // the stream repeats every 64 KiB, written with memcpy
+
+static inline uint8_t streamByte(uint32_t i) { return pattern[i & 0xffff]; }
+
+// random writes, decoder-like reads (getReadPtr() twice per frame), returns the bytes consumed per second
+template <class B> static double run(size_t mbs, unsigned seed, size_t total, bool verify, bool* same, double* copied) {
+    B b;
+    b.init();
+    b.changeMaxBlockSize(mbs);
+    srand(seed);
+    uint32_t wseq = 0, rseq = 0;
+    size_t   got = 0;
+    double   t0 = nowNs();
+    *same = true;
+    while (got < total) {
+        size_t   n = rand() % 4096, ws = b.writeSpace();
+        uint8_t* w = b.getWritePtr();
+        if (n > ws) n = ws;
+        memcpy(w, &pattern[wseq & 0xffff], n);
+        wseq += n;
+        b.bytesWritten(n);
+        for (int k = 0; k < 3 && b.bufferFilled() >= mbs; k++) {
+            uint8_t* r = b.getReadPtr();
+            if (verify)
+                for (size_t i = 0; i < mbs; i++) *same &= (r[i] == streamByte(rseq + i));
+            b.getReadPtr();
+            size_t c = mbs / 2 + rand() % (mbs / 2);
+            b.bytesWasRead(c);
+            rseq += c;
+            got += c;
+        }
+    }
+    double t = (nowNs() - t0) * 1e-9;
+    *copied = 100.0 * b.copied / got;
+    return total / t;
+}
+
+int main() {
+    for (uint32_t i = 0; i < sizeof(pattern); i++) pattern[i] = (uint8_t)((i & 0xffff) * 2654435761u >> 24);
+    const size_t sizes[] = {1600, 16384}; // mp3/aac, flac
+    for (size_t mbs : sizes) {
+        double copied, copiedBefore;
+        for (unsigned seed = 1; seed < 5; seed++) {
+            bool same;
+            run<CountingBuffer>(mbs, seed, 20000000, true, &same, &copied);
+            CHECK(same);
+            run<CopyAllBuffer>(mbs, seed, 20000000, false, &same, &copiedBefore);
+            CHECK(copied < copiedBefore);
+        }
+        bool   same;
+        double now = run<CountingBuffer>(mbs, 9, 500000000, false, &same, &copied);
+        double before = run<CopyAllBuffer>(mbs, 9, 500000000, false, &same, &copiedBefore);
+        printf("maxBlockSize %5zu: copied %.2f %% of the stream, %.2f %% with the whole guard area\n", mbs, copied, copiedBefore);
+        printf("benchmark: maxBlockSize %5zu, %.2f GB/s, %.2f GB/s with the whole guard area (host)\n", mbs, now * 1e-9,
+               before * 1e-9);
+    }
+    return CHECK_RESULT();
+}
@@ -0,0 +1,154 @@
+// biquad_eq against the float tone chain it replaced (IIR_filterChain0..2), and its cost per frame
+#include "check.h"
+#include "biquad_eq.h"
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+typedef struct {
+    float a0, a1, a2, b1, b2;
+} tone_t;
+
+// Audio::IIR_calculateCoefficients(), earlevel.com: low shelf 500 Hz, peak 3 kHz Q 2.5, high shelf 6 kHz
+static void toneDesign(int g[3], float rate, tone_t f[3]) {
+    const float FcLS = 500, FcPKEQ = 3000;
+    float       FcHS = 6000;
+    if (rate < FcHS * 2 - 100) FcHS = rate / 2 - 100;
+    float K, norm, Q = 2.5f, V;
+
+    K = tanf((float)M_PI * FcLS / rate);
+    V = powf(10, fabsf((float)g[0]) / 20);
+    if (g[0] >= 0) {
+        norm = 1 / (1 + sqrtf(2) * K + K * K);
+        f[0] = {(1 + sqrtf(2 * V) * K + V * K * K) * norm, 2 * (V * K * K - 1) * norm,
+                (1 - sqrtf(2 * V) * K + V * K * K) * norm, 2 * (K * K - 1) * norm, (1 - sqrtf(2) * K + K * K) * norm};
+    } else {
+        norm = 1 / (1 + sqrtf(2 * V) * K + V * K * K);
+        f[0] = {(1 + sqrtf(2) * K + K * K) * norm, 2 * (K * K - 1) * norm, (1 - sqrtf(2) * K + K * K) * norm,
+                2 * (V * K * K - 1) * norm, (1 - sqrtf(2 * V) * K + V * K * K) * norm};
+    }
+    K = tanf((float)M_PI * FcPKEQ / rate);
+    V = powf(10, fabsf((float)g[1]) / 20);
+    if (g[1] >= 0) {
+        norm = 1 / (1 + 1 / Q * K + K * K);
+        f[1] = {(1 + V / Q * K + K * K) * norm, 2 * (K * K - 1) * norm, (1 - V / Q * K + K * K) * norm,
+                2 * (K * K - 1) * norm, (1 - 1 / Q * K + K * K) * norm};
+    } else {
+        norm = 1 / (1 + V / Q * K + K * K);
+        f[1] = {(1 + 1 / Q * K + K * K) * norm, 2 * (K * K - 1) * norm, (1 - 1 / Q * K + K * K) * norm,
+                2 * (K * K - 1) * norm, (1 - V / Q * K + K * K) * norm};
+    }
+    K = tanf((float)M_PI * FcHS / rate);
+    V = powf(10, fabsf((float)g[2]) / 20);
+    if (g[2] >= 0) {
+        norm = 1 / (1 + sqrtf(2) * K + K * K);
+        f[2] = {(V + sqrtf(2 * V) * K + K * K) * norm, 2 * (K * K - V) * norm, (V - sqrtf(2 * V) * K + K * K) * norm,
+                2 * (K * K - 1) * norm, (1 - sqrtf(2) * K + K * K) * norm};
+    } else {
+        norm = 1 / (V + sqrtf(2 * V) * K + K * K);
+        f[2] = {(1 + sqrtf(2) * K + K * K) * norm, 2 * (K * K - 1) * norm, (1 - sqrtf(2) * K + K * K) * norm,
+                2 * (K * K - V) * norm, (V - sqrtf(2 * V) * K + K * K) * norm};
+    }
+}
+
+// The former per sample path: division by the correction factor, three float stages, truncation after each
+static void floatChain(const tone_t f[3], float corr, int16_t* buff, uint32_t frames) {
+    float z[3][2][4] = {}; // [stage][channel][x1 x2 y1 y2]
+    for (uint32_t i = 0; i < frames * 2; i++) {
+        float*  zc;
+        int16_t s = buff[i];
+        if (corr > 1) s = s / corr;
+        for (int k = 0; k < 3; k++) {
+            zc = z[k][i & 1];
+            float x = s;
+            float y = f[k].a0 * x + f[k].a1 * zc[0] + f[k].a2 * zc[1] - f[k].b1 * zc[2] - f[k].b2 * zc[3];
+            zc[1] = zc[0];
+            zc[0] = x;
+            zc[3] = zc[2];
+            zc[2] = y;
+            s = (int16_t)y;
+        }
+        buff[i] = s;
+    }
+}
+
+static void setTone(bq_eq_t* eq, int g[3], float rate) {
+    // Audio::setTone(): the correction for positive gains is folded into the first stage
+    tone_t f[3];
+    toneDesign(g, rate, f);
+    int       db = std::max(g[0], std::max(g[1], g[2]));
+    float     corr = powf(10, (float)db / 20);
+    bq_coef_t c[3];
+    for (int k = 0; k < 3; k++) {
+        float s = (k == 0 && corr > 1) ? 1 / corr : 1;
+        c[k] = BQ_quantize(f[k].a0 * s, f[k].a1 * s, f[k].a2 * s, f[k].b1, f[k].b2);
+    }
+    BQ_setStages(eq, c, 3);
+}
+
+static std::vector<int16_t> music(uint32_t frames, float rate) {
+    // a few partials and noise, up to -1 dBFS
+    std::vector<int16_t> v(frames * 2);
+    for (uint32_t i = 0; i < frames; i++) {
+        float t = i / rate;
+        float x = 0.35f * sinf(2 * (float)M_PI * 110 * t) + 0.2f * sinf(2 * (float)M_PI * 2900 * t) +
+                  0.15f * sinf(2 * (float)M_PI * 7000 * t) + 0.1f * ((rand() & 0xffff) / 32768.0f - 1);
+        v[2 * i] = (int16_t)(x * 32000);
+        v[2 * i + 1] = (int16_t)(-x * 25000);
+    }
+    return v;
+}
+
+int main() {
+    static bq_eq_t eq;
+    const float    rates[] = {8000, 11025, 16000, 22050, 32000, 44100, 48000};
+    const int      gains[] = {-40, -24, -12, -6, -3, 0, 3, 6};
+
+    // flat: no stage, the block is not touched
+    BQ_init(&eq);
+    int flat[3] = {0, 0, 0};
+    setTone(&eq, flat, 44100);
+    CHECK(eq.numStages == 0);
+    std::vector<int16_t> a = music(1000, 44100), b = a;
+    BQ_process(&eq, b.data(), 1000);
+    CHECK(a == b);
+
+    // every combination of the three gains at every rate: the output stays within 8 LSB of the float chain
+    int worst = 0;
+    for (float rate : rates) {
+        std::vector<int16_t> in = music(4096, rate);
+        for (int g0 : gains) for (int g1 : gains) for (int g2 : gains) {
+            int    g[3] = {g0, g1, g2};
+            tone_t f[3];
+            toneDesign(g, rate, f);
+            std::vector<int16_t> ref = in, out = in;
+            floatChain(f, powf(10, (float)std::max(g0, std::max(g1, g2)) / 20), ref.data(), 4096);
+            BQ_init(&eq);
+            setTone(&eq, g, rate);
+            BQ_process(&eq, out.data(), 4096);
+            for (size_t i = 0; i < ref.size(); i++) worst = std::max(worst, abs(ref[i] - out[i]));
+        }
+    }
+    printf("tone chain: largest difference to the float chain %d LSB\n", worst);
+    CHECK(worst <= 8);
+
+    // identity stages are dropped
+    int g[3] = {6, 0, -12};
+    BQ_init(&eq);
+    setTone(&eq, g, 48000);
+    CHECK(eq.numStages == 2);
+
+    // cost per stereo frame, three stages
+    int boost[3] = {6, -6, 3};
+    BQ_init(&eq);
+    setTone(&eq, boost, 44100);
+    std::vector<int16_t> blk = music(BQ_BLOCK_FRAMES, 44100);
+    const int            rounds = 2000;
+    double               t0 = nowNs();
+    for (int r = 0; r < rounds; r++) BQ_process(&eq, blk.data(), BQ_BLOCK_FRAMES);
+    double ns = (nowNs() - t0) / ((double)rounds * BQ_BLOCK_FRAMES);
+    printf("benchmark: %.1f ns per stereo frame for %u stages (host)\n", ns, eq.numStages);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,327 @@
+// CoverArt: generated JPEG pictures in an ID3 APIC frame and in base64 Ogg segments, decoded by the task, shared by
+// the tracks of an album, kept while the card sleeps, read from the art directory after a restart (a new process)
+#include "check.h"
+#include "CoverArt.h"
+#include "MediaLibrary.h"
+#include "SD_Card.h"
+#include "TrackCache.h"
+#include <math.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace fsys = std::filesystem;
+typedef std::vector<uint8_t> bytes;
+
+// the track cache holds the files in cached (the same directory)
+static std::atomic<bool> cached{false};
+bool                     TrackCache_Contains(const char*) { return cached; }
+fs::FS&                  TrackCache_FS() { return SD_FS(); }
+
+// the library index knows /a.mp3 and /a2.mp3, two tracks of one album
+uint32_t MediaLibrary_Find(const char* path) { return !strcmp(path, "/a.mp3") ? 0 : !strcmp(path, "/a2.mp3") ? 1 : UINT32_MAX; }
+bool     MediaLibrary_GetTrack(uint32_t track, ml_track_t* t) {
+    *t = {};
+    t->flags = ML_FLAG_TAGS;
+    t->artist = 1;
+    t->album = 2;
+    return track < 2;
+}
+bool MediaLibrary_GetString(uint32_t ref, char* buf, size_t len) {
+    strlcpy(buf, ref == 1 ? "Artist" : "Album", len);
+    return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// Baseline JPEG, 4:4:4, every coefficient quantized by 8, fixed length Huffman codes (DC: 4 bits, AC: 8 bits)
+
+static const uint8_t zigzag[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+                                   41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+                                   30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// a 1280x720 picture, gray around a centre square of four colours, the variant rotates them
+static const uint8_t quadrant[4][3] = {{200, 30, 30}, {30, 200, 30}, {30, 30, 200}, {220, 220, 220}};
+static const int     W = 1280, H = 720;
+
+static const uint8_t* pixel(int x, int y, int variant) {
+    static const uint8_t gray[3] = {128, 128, 128};
+    if (x < (W - H) / 2 || x >= (W + H) / 2) return gray;
+    return quadrant[((y >= H / 2) * 2 + (x >= W / 2) + variant) % 4];
+}
+
+struct BitWriter {
+    bytes*   out;
+    uint32_t acc = 0;
+    int      n = 0;
+    void     put(uint32_t v, int len) {
+        for (int i = len - 1; i >= 0; i--) {
+            acc = (acc << 1) | ((v >> i) & 1);
+            if (++n < 8) continue;
+            out->push_back(acc);
+            if (acc == 0xFF) out->push_back(0);
+            acc = n = 0;
+        }
+    }
+};
+
+static int category(int v) {
+    int n = 0;
+    for (int a = abs(v); a; a >>= 1) n++;
+    return n;
+}
+
+static bytes jpeg(int variant) {
+    uint8_t acVals[162], acCode[256];
+    int     k = 0;
+    acVals[k++] = 0x00; // EOB
+    acVals[k++] = 0xF0; // 16 zeros
+    for (int r = 0; r < 16; r++)
+        for (int s = 1; s <= 10; s++) acVals[k++] = (r << 4) | s;
+    for (int i = 0; i < 162; i++) acCode[acVals[i]] = i;
+
+    bytes out = {0xFF, 0xD8, 0xFF, 0xDB, 0, 67, 0};
+    out.insert(out.end(), 64, 8);
+    out.insert(out.end(), {0xFF, 0xC0, 0, 17, 8, H >> 8, H & 0xFF, W >> 8, W & 0xFF, 3, 1, 0x11, 0, 2, 0x11, 0, 3, 0x11, 0});
+    out.insert(out.end(), {0xFF, 0xC4, 418 >> 8, 418 & 0xFF});
+    bytes dcBits(16), acBits(16);
+    dcBits[3] = 12;
+    acBits[7] = 162;
+    for (int id = 0; id < 2; id++) { // the same tables for luma and chroma, tjpgd takes 0 for Y and 1 for Cb/Cr
+        out.push_back(0x00 | id);
+        out.insert(out.end(), dcBits.begin(), dcBits.end());
+        for (int i = 0; i < 12; i++) out.push_back(i);
+        out.push_back(0x10 | id);
+        out.insert(out.end(), acBits.begin(), acBits.end());
+        out.insert(out.end(), acVals, acVals + 162);
+    }
+    out.insert(out.end(), {0xFF, 0xDA, 0, 12, 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0});
+
+    double ct[8][8];
+    for (int x = 0; x < 8; x++)
+        for (int u = 0; u < 8; u++) ct[x][u] = cos((2 * x + 1) * u * M_PI / 16) * (u ? 0.5 : 0.5 / sqrt(2));
+    BitWriter bw{&out};
+    int       prevDc[3] = {0, 0, 0};
+    for (int by = 0; by < H; by += 8)
+        for (int bx = 0; bx < W; bx += 8)
+            for (int c = 0; c < 3; c++) {
+                double f[8][8], t[8][8];
+                for (int y = 0; y < 8; y++)
+                    for (int x = 0; x < 8; x++) {
+                        const uint8_t* p = pixel(bx + x, by + y, variant);
+                        double         v = (c == 0)   ? 0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2]
+                                           : (c == 1) ? -0.1687 * p[0] - 0.3313 * p[1] + 0.5 * p[2] + 128
+                                                      : 0.5 * p[0] - 0.4187 * p[1] - 0.0813 * p[2] + 128;
+                        f[y][x] = v - 128;
+                    }
+                for (int y = 0; y < 8; y++)
+                    for (int u = 0; u < 8; u++) {
+                        t[y][u] = 0;
+                        for (int x = 0; x < 8; x++) t[y][u] += f[y][x] * ct[x][u];
+                    }
+                int q[64];
+                for (int v = 0; v < 8; v++)
+                    for (int u = 0; u < 8; u++) {
+                        double s = 0;
+                        for (int y = 0; y < 8; y++) s += t[y][u] * ct[y][v];
+                        q[v * 8 + u] = (int)lround(s / 8);
+                    }
+                int diff = q[0] - prevDc[c], n = category(diff), run = 0;
+                prevDc[c] = q[0];
+                bw.put(n, 4);
+                bw.put(diff < 0 ? diff + (1 << n) - 1 : diff, n);
+                for (int i = 1; i < 64; i++) {
+                    int v = q[zigzag[i]];
+                    if (!v) {
+                        run++;
+                        continue;
+                    }
+                    for (; run > 15; run -= 16) bw.put(acCode[0xF0], 8);
+                    n = category(v);
+                    bw.put(acCode[(run << 4) | n], 8);
+                    bw.put(v < 0 ? v + (1 << n) - 1 : v, n);
+                    run = 0;
+                }
+                if (run) bw.put(acCode[0x00], 8);
+            }
+    if (bw.n) bw.put((1 << (8 - bw.n)) - 1, 8 - bw.n);
+    out.insert(out.end(), {0xFF, 0xD9});
+    return out;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+static void writeFile(const char* path, const bytes& b) {
+    std::ofstream(mock::sdRoot + std::string(path), std::ios::binary).write((const char*)b.data(), b.size());
+}
+
+static bytes be32(uint32_t v) { return {(uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v}; }
+
+static void append(bytes* b, const bytes& x) { b->insert(b->end(), x.begin(), x.end()); }
+static void append(bytes* b, const char* s) { b->insert(b->end(), s, s + strlen(s) + 1); }
+
+// ID3v2.3 tag with an APIC frame, then some audio, returns the offset of the frame content (audio_id3image())
+static uint32_t writeMp3(const char* path, int variant, uint32_t* len) {
+    bytes pic = {0}; // latin1
+    append(&pic, "image/jpeg");
+    pic.push_back(3); // front cover
+    append(&pic, "");
+    append(&pic, jpeg(variant));
+    uint32_t tag = 10 + pic.size();
+    bytes    file = {'I', 'D', '3', 3, 0, 0, (uint8_t)(tag >> 21 & 0x7F), (uint8_t)(tag >> 14 & 0x7F), (uint8_t)(tag >> 7 & 0x7F),
+                     (uint8_t)(tag & 0x7F), 'A', 'P', 'I', 'C'};
+    append(&file, be32(pic.size()));
+    file.insert(file.end(), {0, 0});
+    append(&file, pic);
+    file.insert(file.end(), 4096, 0x55);
+    writeFile(path, file);
+    *len = pic.size();
+    return 20;
+}
+
+// a FLAC PICTURE block in base64, split across three Ogg pages, returns the offset and length pairs (audio_oggimage())
+static std::vector<uint32_t> writeOgg(const char* path, int variant) {
+    bytes block = be32(3);
+    append(&block, be32(10));
+    block.insert(block.end(), {'i', 'm', 'a', 'g', 'e', '/', 'j', 'p', 'e', 'g'});
+    append(&block, be32(0));
+    for (uint32_t v : {W, H, 24, 0}) append(&block, be32(v));
+    bytes pic = jpeg(variant);
+    append(&block, be32(pic.size()));
+    append(&block, pic);
+    static const char* abc = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string        text;
+    for (size_t i = 0; i < block.size(); i += 3) {
+        uint32_t v = block[i] << 16 | (i + 1 < block.size() ? block[i + 1] << 8 : 0) | (i + 2 < block.size() ? block[i + 2] : 0);
+        for (size_t k = 0; k < 4; k++) text += (i + k <= block.size()) ? abc[v >> (18 - 6 * k) & 0x3F] : '=';
+    }
+    bytes                 file;
+    std::vector<uint32_t> segments;
+    for (size_t s = 0, part = text.size() / 3 + 1; s < text.size(); s += part) {
+        file.insert(file.end(), {'O', 'g', 'g', 'S'});
+        file.insert(file.end(), 23, 0xAA); // the rest of the page header
+        uint32_t n = std::min(part, text.size() - s);
+        segments.insert(segments.end(), {(uint32_t)file.size(), n});
+        file.insert(file.end(), text.begin() + s, text.begin() + s + n);
+    }
+    writeFile(path, file);
+    return segments;
+}
+
+static bool waitChanged(uint32_t* version, const lv_img_dsc_t** art) {
+    for (int i = 0; i < 5000; i++) {
+        if (CoverArt_Changed(version, art)) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+// the colours of the four quadrants and the black corners
+static bool shows(const lv_img_dsc_t* art, int variant) {
+    if (!art || art->header.w != 360 || art->header.h != 360) return false;
+    const lv_color_t* px = (const lv_color_t*)art->data;
+    bool              ok = px[0].full == 0 && px[359].full == 0 && px[359 * 360].full == 0 && px[360 * 360 - 1].full == 0;
+    for (int q = 0; q < 4; q++) {
+        lv_color_t     c = px[(90 + q / 2 * 180) * 360 + 90 + q % 2 * 180];
+        const uint8_t* want = quadrant[(q + variant) % 4];
+        ok &= abs(c.ch.red * 255 / 31 - want[0]) < 16 && abs(c.ch.green * 255 / 63 - want[1]) < 16 &&
+              abs(c.ch.blue * 255 / 31 - want[2]) < 16;
+    }
+    return ok;
+}
+
+static int artFiles() {
+    int n = 0;
+    for (auto& e : fsys::directory_iterator(mock::sdRoot + std::string("/art"))) n += (e.file_size() == 4 + 360 * 360 * 2);
+    return n;
+}
+
+static bool waitFiles(int n) {
+    for (int i = 0; i < 5000 && artFiles() != n; i++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return artFiles() == n;
+}
+
+// a start of the player, the statics of CoverArt begin again
+static int restart(int (*run)()) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fails = run();
+        fflush(stdout);
+        _exit(fails);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+static uint32_t posA, lenA, posC, lenC;
+
+static int firstStart() {
+    uint32_t            v = 0;
+    const lv_img_dsc_t* art = NULL;
+    CHECK(CoverArt_Init(SD_FS(), "/art", 360));
+    CHECK(!CoverArt_Changed(&v, &art));
+
+    // decoded when the library reports the picture, shown before it is written
+    double t0 = nowNs();
+    CoverArt_Show("/a.mp3");
+    CoverArt_Found("/a.mp3", posA, lenA);
+    CHECK(waitChanged(&v, &art) && shows(art, 0));
+    printf("benchmark: 1280x720 JPEG to a 360 pixel circle in %.1f ms (host)\n", (nowNs() - t0) * 1e-6);
+    CHECK(waitFiles(1));
+
+    // base64 across Ogg pages, nothing to show until it is decoded
+    CoverArt_Show("/b.ogg");
+    CHECK(waitChanged(&v, &art) && art == NULL);
+    CoverArt_FoundOgg("/b.ogg", writeOgg("/b.ogg", 1));
+    CHECK(waitChanged(&v, &art) && shows(art, 1));
+    CHECK(waitFiles(2));
+
+    // another track of the album of a.mp3: its art at once, nothing decoded or written
+    CoverArt_Show("/a2.mp3");
+    CHECK(waitChanged(&v, &art) && shows(art, 0));
+
+    // the card sleeps, c.mp3 plays from the track cache: shown, written by the flush after the wake up
+    CHECK(SD_Sleep());
+    cached = true;
+    CoverArt_Show("/c.mp3");
+    CHECK(waitChanged(&v, &art) && art == NULL);
+    CoverArt_Found("/c.mp3", posC, lenC);
+    CHECK(waitChanged(&v, &art) && shows(art, 2));
+    CoverArt_Flush();
+    CHECK(artFiles() == 2 && SD_IsSleeping());
+    cached = false;
+    SD_Acquire();
+    SD_Release();
+    CoverArt_Flush();
+    CHECK(artFiles() == 3 && mock::sdHeld == 0);
+    return CHECK_RESULT();
+}
+
+static int secondStart() {
+    // one file read for the album, no picture decoded
+    uint32_t            v = 0;
+    const lv_img_dsc_t* art = NULL;
+    CHECK(CoverArt_Init(SD_FS(), "/art", 360));
+    uint32_t reads = mock::fileReads;
+    CoverArt_Show("/a2.mp3");
+    CHECK(waitChanged(&v, &art) && shows(art, 0));
+    printf("art from the directory: %u reads\n", mock::fileReads - reads);
+    CHECK(mock::fileReads - reads <= 2);
+    CoverArt_Show("/b.ogg");
+    CHECK(waitChanged(&v, &art) && shows(art, 1));
+    return CHECK_RESULT();
+}
+
+int main() {
+    fsys::remove_all(mock::sdRoot);
+    fsys::create_directories(mock::sdRoot);
+    posA = writeMp3("/a.mp3", 0, &lenA);
+    posC = writeMp3("/c.mp3", 2, &lenC);
+    int fails = restart(firstStart);
+    fails += restart(secondStart);
+    printf(fails ? "failed\n" : "ok\n");
+    return fails ? 1 : 0;
+}
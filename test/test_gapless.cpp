@@ -0,0 +1,104 @@
+// gapless: an MP3 with a LAME tag spliced to an AAC with iTunSMPB, decoded streams with known delay and padding,
+// every original frame once at the join, no silence in between
+#include "check.h"
+#include "gapless.h"
+#include <algorithm>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// the original samples of a track: never zero, L and R differ, the tracks differ
+static int16_t sample(int track, uint32_t i, int ch) { return (int16_t)((ch ? -1 : 1) * (track * 10000 + i % 9000 + 1)); }
+
+// what the decoder outputs: lead frames of silence, the original frames, tail frames of silence
+static std::vector<int16_t> decoded(int track, uint32_t lead, uint32_t frames, uint32_t tail) {
+    std::vector<int16_t> v(2 * (lead + frames + tail), 0);
+    for (uint32_t i = 0; i < frames; i++)
+        for (int ch = 0; ch < 2; ch++) v[2 * (lead + i) + ch] = sample(track, i, ch);
+    return v;
+}
+
+// the decoder blocks through GL_trim(), appended to out
+static void play(const std::vector<int16_t>& in, const gl_info_t* info, uint16_t block, std::vector<int16_t>& out) {
+    gl_trim_t trim;
+    GL_start(&trim, info);
+    int16_t buff[2 * 1152];
+    for (size_t i = 0; i < in.size() / 2; i += block) {
+        uint16_t n = (uint16_t)std::min<size_t>(block, in.size() / 2 - i);
+        memcpy(buff, &in[2 * i], n * 4);
+        n = GL_trim(&trim, buff, n, 2);
+        out.insert(out.end(), buff, buff + 2 * n);
+    }
+}
+
+int main() {
+    // MP3, MPEG1 layer III 128 kbit/s stereo: 88 frames of 1152 for 100000 samples, encoder delay 576, padding 800
+    const uint32_t mp3Frames = 100000, delay = 576, padding = 800, frames = 88;
+    std::vector<uint8_t> info(417, 0);
+    const uint8_t header[] = {0xFF, 0xFB, 0x90, 0x00};
+    memcpy(&info[0], header, 4);
+    memcpy(&info[36], "Info\0\0\0\x0F", 8); // frames, bytes, TOC, quality
+    info[44 + 3] = frames;
+    memcpy(&info[156], "LAME3.100", 9);
+    info[156 + 21] = delay >> 4;
+    info[156 + 22] = ((delay & 0x0F) << 4) | (padding >> 8);
+    info[156 + 23] = padding & 0xFF;
+    gl_info_t mp3;
+    GL_reset(&mp3);
+    CHECK(GL_parseMP3Info(info.data(), info.size(), &mp3));
+    CHECK(mp3.skip == 1152 + delay + GL_MP3_DECODER_DELAY && mp3.total == mp3Frames);
+    // the decoder: a silent frame for the info frame, its own delay, the encoder output without the last 529 samples
+    std::vector<int16_t> a = decoded(1, 1152 + GL_MP3_DECODER_DELAY + delay, mp3Frames, padding - GL_MP3_DECODER_DELAY);
+    CHECK(a.size() / 2 == (frames + 1) * 1152);
+
+    // AAC in MP4, iTunSMPB in the ilst "----" atom: 51 blocks of 1024 for 50000 samples, delay 2112, padding 112
+    const uint32_t    aacFrames = 50000;
+    static const char ilst[] = "----\0\0\0\x1Cmean\0\0\0\0com.apple.iTunes\0\0\0\x14name\0\0\0\0iTunSMPB\0\0\0\x84"
+                               "data\0\0\0\x01\0\0\0\0 00000000 00000840 00000070 000000000000C350 00000000 00000000";
+    const std::string smpb(ilst, sizeof(ilst) - 1);
+    gl_info_t aac;
+    GL_reset(&aac);
+    CHECK(GL_parseSmpb((const uint8_t*)smpb.data(), smpb.size(), &aac));
+    CHECK(aac.skip == 2112 && aac.total == aacFrames);
+    std::vector<int16_t> b = decoded(2, 2112, aacFrames, 112);
+    CHECK(b.size() / 2 == 51 * 1024);
+
+    // the same value in an ID3 COMM frame as UTF-16
+    std::string comm("\x01\xFF\xFEi\0T\0u\0n\0S\0M\0P\0B\0\0\0", 21);
+    for (char c : std::string(" 00000000 00000840 00000070 000000000000C350")) comm += std::string(1, c) + '\0';
+    gl_info_t id3;
+    GL_reset(&id3);
+    CHECK(GL_parseSmpb((const uint8_t*)comm.data(), comm.size(), &id3) && id3.skip == 2112 && id3.total == aacFrames);
+
+    // the splice: A then B, each frame once, nothing added
+    std::vector<int16_t> out;
+    play(a, &mp3, 1152, out);
+    size_t join = out.size() / 2;
+    play(b, &aac, 1024, out);
+    CHECK(join == mp3Frames && out.size() / 2 == mp3Frames + aacFrames);
+    uint32_t wrong = 0, zeros = 0;
+    for (size_t i = 0; i < out.size() / 2; i++) {
+        int      track = i < join ? 1 : 2;
+        uint32_t j = i < join ? i : i - join;
+        wrong += (out[2 * i] != sample(track, j, 0) || out[2 * i + 1] != sample(track, j, 1));
+        zeros += (out[2 * i] == 0 && out[2 * i + 1] == 0);
+    }
+    printf("join at frame %zu: %d %d | %d %d\n", join, out[2 * join - 2], out[2 * join - 1], out[2 * join], out[2 * join + 1]);
+    CHECK(wrong == 0 && zeros == 0);
+
+    // small decoder blocks give the same stream, no trimming (after a seek) passes everything
+    std::vector<int16_t> small;
+    play(a, &mp3, 100, small);
+    CHECK(std::equal(small.begin(), small.end(), out.begin()) && small.size() / 2 == mp3Frames);
+    std::vector<int16_t> all;
+    play(b, NULL, 1024, all);
+    CHECK(all == b);
+
+    // not an info frame: a plain audio frame, a truncated one
+    info[36] = 'X';
+    info[37] = 'x';
+    GL_reset(&mp3);
+    CHECK(!GL_parseMP3Info(info.data(), info.size(), &mp3) && mp3.skip == 0);
+    CHECK(!GL_parseMP3Info(info.data(), 30, &mp3));
+    return CHECK_RESULT();
+}
@@ -0,0 +1,68 @@
+// limiter: signals 6...24 dB over full scale, no output sample above the ceiling, the delay, the cost per frame
+#include "check.h"
+#include "limiter.h"
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+static lim_t lim;
+
+static std::vector<int16_t> limit(const std::vector<int32_t>& in, uint32_t rate) {
+    LIM_init(&lim, rate, -1.0f, 2000, 80);
+    std::vector<int16_t> out(in.size());
+    size_t               frames = in.size() / 2;
+    for (size_t i = 0; i < frames; i += 512) {
+        uint16_t n = (uint16_t)std::min<size_t>(512, frames - i);
+        LIM_process(&lim, &in[2 * i], &out[2 * i], n);
+    }
+    return out;
+}
+
+static int peak(const std::vector<int16_t>& v) {
+    int p = 0;
+    for (int16_t s : v) p = std::max(p, abs(s));
+    return p;
+}
+
+int main() {
+    const uint32_t       rate = 44100, frames = rate * 2;
+    std::vector<int32_t> x(frames * 2);
+    struct {
+        const char* name;
+        int32_t (*gen)(uint32_t i, int ch);
+    } const signals[] = {
+        {"sine 1 kHz +12 dB", [](uint32_t i, int) { return (int32_t)lrint(4 * 32767 * sin(2 * M_PI * 1000 * i / 44100.0)); }},
+        {"sine fs/4 +6 dB", [](uint32_t i, int ch) { return (int32_t)lrint((ch ? -2 : 2) * 32767 * sin(M_PI / 2 * i + M_PI / 4)); }},
+        {"square +6 dB", [](uint32_t i, int) { return ((i / 20) & 1) ? 2 * 32767 : -2 * 32767; }},
+        {"noise +18 dB", [](uint32_t, int) { return (rand() % 65536 - 32768) * 8; }},
+        {"impulses +24 dB", [](uint32_t i, int) { return (i % 10000 == 0) ? 16 * 32767 : (int32_t)lrint(3000 * sin(2 * M_PI * 300 * i / 44100.0)); }},
+        {"bursts 60 Hz +10 dB", [](uint32_t i, int) { return (int32_t)lrint(((i % 22050) < 11025 ? 3 : 0.3) * 32767 * sin(2 * M_PI * 60 * i / 44100.0)); }},
+    };
+    srand(1);
+    for (const auto& s : signals) {
+        for (uint32_t i = 0; i < frames; i++) x[2 * i] = s.gen(i, 0), x[2 * i + 1] = s.gen(i, 1);
+        std::vector<int16_t> out = limit(x, rate);
+        uint16_t             g = LIM_takeMinGain(&lim);
+        printf("%-20s out peak %5d, ceiling %d, gain reduction %.1f dB\n", s.name, peak(out), lim.ceiling, -20 * log10f(g / (float)LIM_UNITY));
+        CHECK(peak(out) <= lim.ceiling);
+        CHECK(g < LIM_UNITY);
+    }
+
+    // below the knee: the input is passed, delayed by the look-ahead and the true peak interpolation
+    for (uint32_t i = 0; i < frames; i++) x[2 * i] = x[2 * i + 1] = (int32_t)lrint(16000 * sin(2 * M_PI * 1000 * i / 44100.0));
+    std::vector<int16_t> out = limit(x, rate);
+    bool                 same = true;
+    const uint32_t       delay = lim.len + LIM_TP_DELAY;
+    for (uint32_t i = delay; i < frames; i++) same &= (out[2 * i] == x[2 * (i - delay)]);
+    CHECK(same && LIM_takeMinGain(&lim) == LIM_UNITY && lim.clipped == 0);
+
+    // cost per stereo frame
+    for (uint32_t i = 0; i < frames; i++) x[2 * i] = x[2 * i + 1] = (int32_t)lrint(3 * 32767 * sin(2 * M_PI * 440 * i / 44100.0));
+    LIM_init(&lim, rate, -1.0f, 2000, 80);
+    const int rounds = 2000;
+    double    t0 = nowNs();
+    for (int r = 0; r < rounds; r++) LIM_process(&lim, &x[(r % 100) * 1024], &out[0], 512);
+    printf("benchmark: %.1f ns per stereo frame (host)\n", (nowNs() - t0) / (rounds * 512.0));
+    return CHECK_RESULT();
+}
@@ -0,0 +1,131 @@
+// loudness: the EBU Tech 3341 stereo sine cases (level and gating), ReplayGain tags in ID3 TXXX, Vorbis comments and
+// MP4 "----" atoms, the album loudness of the gain table, the cost per frame
+#include "check.h"
+#include "loudness.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static uint32_t hist[R128_HIST_BINS];
+
+// a stereo 1 kHz sine, the same in both channels, sections of level [dBFS] and length [s]
+struct section {
+    float dbfs, seconds;
+};
+
+static std::vector<int16_t> sine(std::initializer_list<section> sections, uint32_t rate = 48000) {
+    std::vector<int16_t> v;
+    uint64_t             n = 0;
+    for (const section& s : sections) {
+        double a = 32767 * pow(10.0, s.dbfs / 20.0);
+        for (uint32_t i = 0; i < (uint32_t)lrint(s.seconds * rate); i++, n++) {
+            int16_t x = (int16_t)lrint(a * sin(2 * M_PI * 1000.0 * n / rate));
+            v.push_back(x);
+            v.push_back(x);
+        }
+    }
+    return v;
+}
+
+static float measure(const std::vector<int16_t>& v, uint32_t rate = 48000, r128_t* out = NULL) {
+    r128_t r;
+    R128_init(&r, rate, 2, hist);
+    for (size_t i = 0; i < v.size() / 2; i += 1152) R128_process(&r, &v[2 * i], std::min<size_t>(1152, v.size() / 2 - i));
+    float lufs = NAN;
+    if (!R128_integrated(&r, &lufs)) lufs = NAN;
+    if (out) *out = r;
+    return lufs;
+}
+
+static rg_info_t parse(const std::string& s, bool* found) {
+    rg_info_t rg = {};
+    *found = RG_parse((const uint8_t*)s.data(), s.size(), &rg);
+    return rg;
+}
+
+static bool near(float a, float b, float d) { return fabsf(a - b) <= d; }
+
+int main() {
+    // Tech 3341 cases 1...5: all -23.0 LUFS but case 2 (-33.0), +-0.1 LU
+    const struct {
+        const char*                    name;
+        std::initializer_list<section> sections;
+        float                          lufs;
+    } cases[] = {
+        {"1: -23 dBFS 20 s", {{-23, 20}}, -23},
+        {"2: -33 dBFS 20 s", {{-33, 20}}, -33},
+        {"3: -36/-23/-36 dBFS 10/60/10 s", {{-36, 10}, {-23, 60}, {-36, 10}}, -23},
+        {"4: -72/-36/-23/-36/-72 dBFS 10/10/20/10/10 s", {{-72, 10}, {-36, 10}, {-23, 20}, {-36, 10}, {-72, 10}}, -23},
+        {"5: -26/-20/-26 dBFS 20/20.1/20 s", {{-26, 20}, {-20, 20.1f}, {-26, 20}}, -23},
+    };
+    for (const auto& c : cases) {
+        float lufs = measure(sine(c.sections));
+        printf("Tech 3341 case %s: %.2f LUFS\n", c.name, lufs);
+        CHECK(near(lufs, c.lufs, 0.1f));
+    }
+    // another samplerate, the gated length, silence only
+    r128_t r;
+    CHECK(near(measure(sine({{-23, 20}}, 44100), 44100, &r), -23, 0.1f));
+    CHECK(R128_seconds(&r) >= 19 && R128_seconds(&r) <= 20 && r.peak == (uint16_t)lrint(32767 * pow(10.0, -23 / 20.0)));
+    CHECK(isnan(measure(std::vector<int16_t>(2 * 48000 * 5, 0))));
+
+    // ID3v2.4 TXXX frames: ISO-8859-1 and UTF-16 with BOM
+    bool        found;
+    std::string txxx = std::string("TXXX\0\0\0\x22\0\0\0", 11) + "REPLAYGAIN_TRACK_GAIN" + std::string(1, '\0') + "-6.48 dB";
+    txxx += std::string("TXXX\0\0\0\x1A\0\0\0", 11) + "REPLAYGAIN_TRACK_PEAK" + std::string(1, '\0') + "0.988";
+    rg_info_t rg = parse(txxx, &found);
+    CHECK(found && rg.hasTrack && !rg.hasAlbum && near(rg.trackGain, -6.48f, 1e-4f) && near(rg.trackPeak, 0.988f, 1e-4f));
+    std::string utf16("TXXX\0\0\0\x4A\0\0\x01\xFF\xFE", 13);
+    for (char c : std::string("replaygain_album_gain")) utf16 += std::string(1, c) + '\0';
+    utf16 += std::string("\0\0\xFF\xFE", 4);
+    for (char c : std::string("+2.10 dB")) utf16 += std::string(1, c) + '\0';
+    rg = parse(utf16, &found);
+    CHECK(found && rg.hasAlbum && !rg.hasTrack && near(rg.albumGain, 2.1f, 1e-4f));
+
+    // Vorbis comments: lower case keys, a length before each
+    std::string vorbis;
+    for (const char* c : {"TITLE=x", "replaygain_track_gain=-3.25 dB", "replaygain_album_gain=-4.5 dB", "replaygain_album_peak=1.02"}) {
+        uint32_t n = strlen(c);
+        vorbis += std::string((const char*)&n, 4) + c;
+    }
+    rg = parse(vorbis, &found);
+    CHECK(found && rg.hasTrack && rg.hasAlbum && near(rg.trackGain, -3.25f, 1e-4f) && near(rg.albumGain, -4.5f, 1e-4f));
+    CHECK(near(rg.albumPeak, 1.02f, 1e-4f) && rg.trackPeak == 0);
+
+    // MP4 ilst "----" atom: mean, name, then the value in a data atom
+    static const char mp4[] = "\0\0\0\x4F----\0\0\0\x1Cmean\0\0\0\0com.apple.iTunes\0\0\0\x21name\0\0\0\0replaygain_track_gain"
+                              "\0\0\0\x18" "data\0\0\0\x01\0\0\0\0-7.89 dB";
+    rg = parse(std::string(mp4, sizeof(mp4) - 1), &found);
+    CHECK(found && rg.hasTrack && near(rg.trackGain, -7.89f, 1e-4f));
+    parse(std::string("TXXX\0\0\0\x0B\0\0\0MusicBrainz", 22), &found);
+    CHECK(!found);
+
+    // the gain table: two tracks of an album measured on their own, their album loudness is the one of both together
+    std::vector<int16_t> t1 = sine({{-20, 30}}), t2 = sine({{-26, 60}}), both = t1;
+    both.insert(both.end(), t2.begin(), t2.end());
+    r128_t   r1, r2;
+    float    l1 = measure(t1, 48000, &r1), l2 = measure(t2, 48000, &r2), whole = measure(both);
+    uint32_t album = LT_hash("/Music/A", 64), other = LT_hash("/Music/B", 64);
+    lt_entry_t t[] = {
+        {LT_hash("/Music/A/1.mp3", 64), album, -500, 1000, 40, 0}, // measured again below, the peak scaled to 65535
+        {LT_hash("/Music/A/1.mp3", 64), album, (int16_t)lrint(l1 * 100), (uint16_t)(r1.peak * 2), R128_seconds(&r1), 0},
+        {LT_hash("/Music/B/1.mp3", 64), other, -300, 65535, 100, 0},
+        {LT_hash("/Music/A/2.mp3", 64), album, (int16_t)lrint(l2 * 100), (uint16_t)(r2.peak * 2), R128_seconds(&r2), 0},
+        {LT_hash("/Music/A/3.mp3", 64), album, -100, 65535, 0, 0}, // too short to be gated
+    };
+    float lufs, peak;
+    CHECK(LT_find(t, 5, LT_hash("/Music/A/1.mp3", 64)) == &t[1] && !LT_find(t, 5, LT_hash("/Music/A/4.mp3", 64)));
+    CHECK(LT_album(t, 5, album, &lufs, &peak));
+    printf("album: tracks %.2f and %.2f LUFS, table %.2f LUFS, measured together %.2f LUFS\n", l1, l2, lufs, whole);
+    CHECK(near(lufs, whole, 0.1f) && near(peak, r1.peak * 2 / 65535.0f, 1e-6f));
+    CHECK(!LT_album(t, 5, LT_hash("/Music/C", 64), &lufs, &peak));
+
+    r128_t b;
+    R128_init(&b, 48000, 2, hist);
+    double t0 = nowNs();
+    for (size_t i = 0; i < both.size() / 2; i += 1152) R128_process(&b, &both[2 * i], std::min<size_t>(1152, both.size() / 2 - i));
+    printf("benchmark: %.1f ns per stereo frame of R128_process() (host)\n", (nowNs() - t0) / (both.size() / 2));
+    return CHECK_RESULT();
+}
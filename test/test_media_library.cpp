@@ -0,0 +1,134 @@
+// MediaLibrary: the index of a generated directory tree, its paths and sort orders, page reads, incremental rescans
+#include "check.h"
+#include "MediaLibrary.h"
+#include "SD_Card.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+
+namespace fsys = std::filesystem;
+
+static std::set<std::string> expected;
+static std::atomic<int>      scans{0};
+static std::atomic<bool>     lastChanged{false};
+
+static void touch(const std::string& path, bool track) {
+    std::ofstream(std::string(mock::sdRoot) + path) << "xy";
+    if (track) expected.insert(path);
+}
+
+// every track once, found by its path, every order sorted by its key (case-insensitive)
+static void checkIndex() {
+    char                  path[MEDIA_PATH_LEN];
+    std::set<std::string> paths;
+    bool                  found = true;
+    for (uint32_t i = 0; i < MediaLibrary_Count(); i++) {
+        found &= MediaLibrary_GetPath(i, path, sizeof(path)) && MediaLibrary_Find(path) == i;
+        paths.insert(path);
+    }
+    CHECK(found && paths == expected);
+    CHECK(MediaLibrary_Find("/nowhere/x.mp3") == UINT32_MAX);
+    CHECK(MediaLibrary_Sorted(ML_ORDER_TITLE, MediaLibrary_Count()) == UINT32_MAX);
+    for (int o = ML_ORDER_ARTIST; o < ML_ORDER_COUNT; o++) {
+        std::set<uint32_t> tracks;
+        std::string        prev;
+        bool               sorted = true;
+        for (uint32_t p = 0; p < MediaLibrary_Count(); p++) {
+            uint32_t   t = MediaLibrary_Sorted((MediaOrder)o, p);
+            ml_track_t r;
+            char       key[MEDIA_NAME_LEN];
+            tracks.insert(t);
+            sorted &= MediaLibrary_GetTrack(t, &r);
+            MediaLibrary_GetString(o == ML_ORDER_ARTIST ? r.artist : o == ML_ORDER_ALBUM ? r.album : r.title, key, sizeof(key));
+            std::string k = key;
+            for (char& c : k) c = tolower(c);
+            sorted &= (prev <= k);
+            prev = k;
+        }
+        CHECK(sorted && tracks.size() == MediaLibrary_Count());
+    }
+}
+
+static void rescan(uint32_t entriesPerSec) {
+    int n = scans;
+    CHECK(MediaLibrary_RescanAsync(SD_FS(), SD_MOUNT_POINT, "/", "/.medialib.idx", entriesPerSec, [](bool changed) {
+        lastChanged = changed;
+        scans++;
+    }));
+    while (scans == n || MediaLibrary_Scanning()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+int main() {
+    // artist/album folders with tracks, a cover, a macOS resource file and a hidden folder that are not indexed
+    const int   artists = 200, albums = 10, tracks = 12;
+    const char* ext[] = {".mp3", ".FLAC", ".m4a", ".ogg"};
+    fsys::remove_all(mock::sdRoot);
+    fsys::create_directories(mock::sdRoot);
+    for (int a = 0; a < artists; a++)
+        for (int b = 0; b < albums; b++) {
+            std::string dir = "/Artist " + std::to_string(a) + "/Album " + std::to_string(b);
+            fsys::create_directories(mock::sdRoot + dir);
+            for (int t = 1; t <= tracks; t++) {
+                char name[64];
+                snprintf(name, sizeof(name), "%02d - Song %d%s", t, (a * 7 + b * 3 + t) % 50, ext[t % 4]);
+                touch(dir + "/" + name, true);
+            }
+            touch(dir + "/cover.jpg", false);
+            touch(dir + "/._01 - junk.mp3", false);
+        }
+    touch("/root.mp3", true);
+    fsys::create_directories(std::string(mock::sdRoot) + "/.hidden");
+    touch("/.hidden/h.mp3", false);
+
+    double t0 = nowNs();
+    int    n = MediaLibrary_Build(SD_FS(), SD_MOUNT_POINT, "/", "/.medialib.idx");
+    printf("build: %d tracks in %u directories, %.0f ms, index %ju bytes (host)\n", n, MediaLibrary_DirCount(),
+           (nowNs() - t0) * 1e-6, (uintmax_t)fsys::file_size(std::string(mock::sdRoot) + "/.medialib.idx"));
+    CHECK(n == (int)expected.size() && MediaLibrary_Count() == expected.size());
+    CHECK(mock::sdHeld == 0);
+    checkIndex();
+
+    // boot: the header only, a track reads a few pages, not the index
+    CHECK(MediaLibrary_Open(SD_FS(), "/.medialib.idx") && MediaLibrary_Count() == expected.size());
+    uint32_t reads = mock::fileReads;
+    char     path[MEDIA_PATH_LEN];
+    CHECK(MediaLibrary_GetPath(MediaLibrary_Sorted(ML_ORDER_TITLE, 1000), path, sizeof(path)));
+    printf("one path after the boot: %u page reads\n", mock::fileReads - reads);
+    CHECK(mock::fileReads - reads <= 6);
+
+    // nothing changed: the directories are listed, nothing is written
+    auto mtime = fsys::last_write_time(std::string(mock::sdRoot) + "/.medialib.idx");
+    reads = mock::fileReads;
+    rescan(0);
+    ml_progress_t pr;
+    MediaLibrary_GetProgress(&pr);
+    printf("rescan without a change: %u directories listed in %u ms, %u page reads\n", pr.dirs, pr.ms, mock::fileReads - reads);
+    CHECK(!lastChanged && pr.changedDirs == 0 && !pr.running);
+    CHECK(mtime == fsys::last_write_time(std::string(mock::sdRoot) + "/.medialib.idx"));
+
+    // a new file, a removed album, a new folder, a renamed file: only these directories are read again
+    touch("/Artist 3/Album 1/99 - New.mp3", true);
+    for (auto it = expected.begin(); it != expected.end();) it = (it->rfind("/Artist 5/Album 2/", 0) == 0) ? expected.erase(it) : ++it;
+    fsys::remove_all(std::string(mock::sdRoot) + "/Artist 5/Album 2");
+    fsys::create_directories(std::string(mock::sdRoot) + "/Zed/Fresh");
+    touch("/Zed/Fresh/a.opus", true);
+    std::string from = *expected.lower_bound("/Artist 7/Album 0/");
+    fsys::rename(mock::sdRoot + from, std::string(mock::sdRoot) + "/Artist 7/Album 0/renamed.mp3");
+    expected.erase(from);
+    expected.insert("/Artist 7/Album 0/renamed.mp3");
+    rescan(0);
+    MediaLibrary_GetProgress(&pr);
+    printf("rescan with changes: %u of %u directories read again, %u tracks, %u ms\n", pr.changedDirs, pr.dirs, pr.tracks, pr.ms);
+    CHECK(lastChanged && pr.changedDirs == 6); // root, Artist 3/Album 1, Artist 5, Artist 7/Album 0, Zed, Zed/Fresh
+    CHECK(mock::sdHeld == 0);
+    checkIndex();
+
+    // the bandwidth limit stretches the listing
+    rescan(20000);
+    MediaLibrary_GetProgress(&pr);
+    printf("rescan at 20000 entries/s: %u ms\n", pr.ms);
+    CHECK(pr.ms >= 1400); // 30393 entries
+    return CHECK_RESULT();
+}
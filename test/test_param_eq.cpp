@@ -0,0 +1,78 @@
+// param_eq: preset parser, coefficient range over all accepted parameters, gain of the quantized banks
+#include "check.h"
+#include "param_eq.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+static float gainAt(const bq_coef_t* c, uint8_t n, float f, float rate) {
+    // a sine through the cascade, peak of the second half [dB]
+    static bq_eq_t       eq;
+    const uint32_t       frames = (uint32_t)rate;
+    std::vector<int16_t> x(frames * 2);
+    const float          amp = 1000;
+    BQ_init(&eq);
+    BQ_setStages(&eq, c, n);
+    for (uint32_t i = 0; i < frames; i++) x[2 * i] = x[2 * i + 1] = (int16_t)(amp * sinf(2 * (float)M_PI * f * i / rate));
+    BQ_process(&eq, x.data(), frames);
+    float peak = 0;
+    for (uint32_t i = frames / 2; i < frames; i++) peak = fmaxf(peak, fabsf(x[2 * i]));
+    return 20 * log10f(peak / amp);
+}
+
+int main() {
+    const char* text =
+        "# tuned for the PCM5101\n"
+        "[PCM5101 Warm] -3\n"
+        "lowshelf   105  0.71  3.5\n"
+        "peak      2800  1.40 -1.5\n"
+        "HS 9000 0.71 2.0   # short names, any case\n"
+        "garbage line\n"
+        "\n"
+        "[Flat]\n"
+        "pk 1000 1 0\n";
+    peq_preset_t presets[PEQ_MAX_PRESETS];
+    CHECK(PEQ_parse(text, presets, PEQ_MAX_PRESETS) == 2);
+    CHECK(!strcmp(presets[0].name, "PCM5101 Warm") && presets[0].preamp == -3 && presets[0].numBands == 3);
+    CHECK(presets[0].band[2].type == PEQ_HIGHSHELF && presets[0].band[2].freq == 9000);
+    CHECK(!strcmp(presets[1].name, "Flat") && presets[1].numBands == 1);
+
+    static peq_bankset_t set;
+    PEQ_buildBanks(&presets[1], &set);
+    for (uint8_t r = 0; r < PEQ_NUM_RATES; r++) CHECK(set.bank[r].numStages == 0); // 0 dB: bypass
+
+    PEQ_buildBanks(&presets[0], &set);
+    const peq_bank_t* b48 = &set.bank[PEQ_rateIndex(48000)];
+    CHECK(b48->numStages == 3);
+    CHECK(fabsf(gainAt(b48->coef, b48->numStages, 30, 48000) - (3.5f - 3)) < 0.3f);
+
+    // every type, gain, Q, frequency and bank rate the parser accepts: no coefficient saturates
+    uint32_t saturated = 0, designs = 0;
+    for (uint8_t type = PEQ_PEAK; type <= PEQ_HIGHSHELF; type++)
+        for (float g = -15; g <= 15; g += 1)
+            for (float q = 0.1f; q <= 10.01f; q *= 1.25f)
+                for (float f = 20; f <= 20000; f *= 1.15f)
+                    for (uint8_t r = 0; r < PEQ_NUM_RATES; r++) {
+                        peq_band_t band = {type, f, q, g};
+                        bool       valid;
+                        bq_coef_t  c = PEQ_design(&band, (float)PEQ_rates[r], &valid);
+                        if (!valid) continue;
+                        designs++;
+                        const int32_t v[5] = {c.a0, c.a1, c.a2, c.b1, c.b2};
+                        for (int k = 0; k < 5; k++) if (v[k] == INT32_MAX || v[k] == INT32_MIN) saturated++;
+                    }
+    printf("%u designs, %u saturated coefficients\n", designs, saturated);
+    CHECK(designs > 100000 && saturated == 0);
+
+    // the worst cases of the range reach the designed gain
+    const peq_band_t worst[] = {{PEQ_HIGHSHELF, 20, 9.8f, 15}, {PEQ_LOWSHELF, 5500, 9.8f, 15}, {PEQ_PEAK, 2800, 0.1f, 15}};
+    const float      probe[] = {10000, 100, 2800};
+    for (int i = 0; i < 3; i++) {
+        bool      valid;
+        bq_coef_t c = PEQ_design(&worst[i], 48000, &valid);
+        float     g = gainAt(&c, 1, probe[i], 48000);
+        printf("type %u +15 dB: %.2f dB at %.0f Hz\n", worst[i].type, g, probe[i]);
+        CHECK(valid && fabsf(g - 15) < 0.2f);
+    }
+    return CHECK_RESULT();
+}
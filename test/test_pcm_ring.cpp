@@ -0,0 +1,64 @@
+// pcm_ring: full and empty, PR_drop, a producer and a consumer thread through the ring across the counter wrap
+#include "check.h"
+#include "pcm_ring.h"
+#include <random>
+#include <thread>
+
+// frame n: the low and the high half of n, both fit 16 bits (PR_write16)
+static inline int32_t left(uint32_t n) { return (int16_t)n; }
+static inline int32_t right(uint32_t n) { return (int16_t)(n >> 16); }
+
+int main() {
+    static int32_t buf[2 * 1024];
+    pcm_ring_t     ring;
+    PR_init(&ring, buf, 1024);
+
+    // the producer gets no space until the consumer reads, the consumer nothing from an empty ring
+    static int32_t x[2 * 1100] = {0};
+    CHECK(PR_fill(&ring) == 0 && PR_read(&ring, x, 10) == 0);
+    CHECK(PR_write(&ring, x, 1100) == 1024 && PR_free(&ring) == 0);
+    CHECK(PR_read(&ring, x, 10) == 10 && PR_write(&ring, x, 100) == 10);
+    PR_drop(&ring);
+    CHECK(PR_fill(&ring) == 0 && PR_free(&ring) == 1024);
+
+    // random block sizes on both sides, 32 and 16 bit writes, the frame counters wrap after 256 frames
+    const uint32_t base = 0xFFFFFF00u, total = 10000000;
+    ring.rd.store(base);
+    ring.wr.store(base);
+    std::thread producer([&] {
+        std::mt19937 rnd(1);
+        int32_t      s[2 * 700];
+        int16_t      s16[2 * 700];
+        uint32_t     n = 0;
+        while (n < total) {
+            uint32_t len = 1 + rnd() % 700;
+            if (len > total - n) len = total - n;
+            bool wide = rnd() & 1;
+            for (uint32_t i = 0; i < len; i++) {
+                s[2 * i] = s16[2 * i] = left(n + i);
+                s[2 * i + 1] = s16[2 * i + 1] = right(n + i);
+            }
+            for (uint32_t w = 0; w < len;) {
+                uint32_t k = wide ? PR_write(&ring, s + 2 * w, len - w) : PR_write16(&ring, s16 + 2 * w, len - w);
+                if (!k) std::this_thread::yield(); // full
+                w += k;
+            }
+            n += len;
+        }
+    });
+    std::mt19937 rnd(2);
+    int32_t      d[2 * 600];
+    uint32_t     n = 0, wrong = 0, maxFill = 0;
+    while (n < total) {
+        uint32_t fill = PR_fill(&ring);
+        if (fill > maxFill) maxFill = fill;
+        uint32_t got = PR_read(&ring, d, 1 + rnd() % 600);
+        for (uint32_t i = 0; i < got; i++) wrong += (d[2 * i] != left(n + i) || d[2 * i + 1] != right(n + i));
+        if (!got) std::this_thread::yield(); // empty
+        n += got;
+    }
+    producer.join();
+    printf("%u frames through the ring, %u wrong, fill up to %u\n", n, wrong, maxFill);
+    CHECK(wrong == 0 && maxFill <= 1024 && ring.rd.load() == base + total && PR_fill(&ring) == 0);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,98 @@
+// Playlist: a 10000 entry M3U8 file read in blocks, the queue and its journal, PLS, Latin-1 M3U, the library order
+#include "check.h"
+#include "Playlist.h"
+#include "MediaLibrary.h"
+#include "SD_Card.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fsys = std::filesystem;
+
+// the library index: /Music/Album <n>/<nn> Song.mp3 for tracks 0...9999, then two more
+static std::vector<std::string> library;
+uint32_t                        MediaLibrary_Count() { return library.size(); }
+uint32_t                        MediaLibrary_Find(const char* path) {
+    for (size_t i = 0; i < library.size(); i++)
+        if (library[i] == path) return i;
+    return UINT32_MAX;
+}
+bool MediaLibrary_GetPath(uint32_t track, char* buf, size_t len) {
+    if (track >= library.size()) return false;
+    strlcpy(buf, library[track].c_str(), len);
+    return true;
+}
+
+static void put(const char* path, const std::string& text) { std::ofstream(mock::sdRoot + std::string(path), std::ios::binary) << text; }
+
+static std::vector<uint32_t> tracks(uint32_t from, uint32_t to) {
+    std::vector<uint32_t> t;
+    for (uint32_t p = from; p < to; p++) t.push_back(Playlist_Track(p));
+    return t;
+}
+
+int main() {
+    fsys::remove_all(mock::sdRoot);
+    fsys::create_directories(mock::sdRoot + std::string("/Lists"));
+    for (int i = 0; i < 10000; i++) library.push_back("/Music/Album " + std::to_string(i / 10) + "/0" + std::to_string(i % 10) + " Song.mp3");
+    library.push_back("/Music/Caf\xC3\xA9/a b.flac");
+    library.push_back("/top.mp3");
+
+    // BOM, EXTINF, CRLF, empty lines, paths relative to the folder of the list, the library in reverse
+    std::string m3u = "\xEF\xBB\xBF#EXTM3U\r\n";
+    for (int i = 9999; i >= 0; i--)
+        m3u += "#EXTINF:123,Artist - Title " + std::to_string(i) + "\r\n.." + library[i] + "\r\n\r\n";
+    put("/Lists/big.m3u8", m3u);
+    CHECK(Playlist_Init(SD_FS(), "/.medialib.queue"));
+    uint32_t reads = mock::fileReads;
+    double   t0 = nowNs();
+    CHECK(Playlist_Open("/Lists/big.m3u8") && Playlist_Length() == 10000);
+    uint32_t openReads = mock::fileReads - reads;
+    printf("benchmark: open a 10000 entry list (%zu KB) in %.1f ms, %u reads (host)\n", m3u.size() / 1024, (nowNs() - t0) * 1e-6,
+           openReads);
+
+    // in order: every block is parsed once, about the reads of the open
+    bool inOrder = true;
+    reads = mock::fileReads;
+    for (uint32_t p = 0; p < 10000; p++) inOrder &= (Playlist_Track(p) == 9999 - p);
+    printf("10000 entries in order: %u reads\n", mock::fileReads - reads);
+    CHECK(inOrder && mock::fileReads - reads < openReads * 5 / 4);
+    CHECK(Playlist_Track(5000) == 4999 && Playlist_Track(10000) == UINT32_MAX);
+    CHECK(Playlist_Locate(4999, 5000) == 5000);
+
+    // play next after 5000 twice (the second one first), append, play next after a queued track
+    CHECK(Playlist_Insert(5000, 10000) && Playlist_Insert(5000, 10001) && Playlist_Append(7));
+    CHECK(Playlist_Length() == 10003 && Playlist_QueueLength() == 3);
+    CHECK(tracks(5000, 5004) == std::vector<uint32_t>({4999, 10001, 10000, 4998}));
+    CHECK(Playlist_Track(10002) == 7 && Playlist_Track(0) == 9999);
+    CHECK(Playlist_Locate(4998, 5003) == 5003);
+    CHECK(Playlist_Insert(5001, 3) && tracks(5002, 5005) == std::vector<uint32_t>({3, 10000, 4998}));
+
+    // the same list again: the journal is replayed
+    std::vector<uint32_t> before = tracks(4990, 5010);
+    Playlist_Suspend();
+    CHECK(Playlist_Open("/Lists/big.m3u8") && Playlist_Length() == 10004);
+    CHECK(tracks(4990, 5010) == before && Playlist_Track(10003) == 7);
+
+    // PLS: a stream, a Windows path, a file URI, a relative path
+    put("/Lists/a.pls", "[playlist]\nFile1=http://radio/x\nTitle1=x\nFile2=C:\\Music\\Album 0\\01 Song.mp3\n"
+                        "File3 = file:///Music/Caf%C3%A9/a%20b.flac\nFile4=../top.mp3\nNumberOfEntries=4\n");
+    CHECK(Playlist_Open("/Lists/a.pls") && Playlist_Length() == 4 && Playlist_QueueLength() == 0);
+    CHECK(tracks(0, 4) == std::vector<uint32_t>({UINT32_MAX, 1, 10000, 10001}));
+
+    // Latin-1 M3U, dot segments
+    put("/l.m3u", "Music/Caf\xE9/a b.flac\n./Music/./Album 2/../Album 1/03 Song.mp3\n");
+    CHECK(Playlist_Open("/l.m3u") && tracks(0, 2) == std::vector<uint32_t>({10000, 13}));
+
+    // the library order, a full queue
+    CHECK(Playlist_Open(NULL) && Playlist_Length() == 10002 && Playlist_Track(5) == 5 && !strcmp(Playlist_GetPath(), ""));
+    CHECK(Playlist_Insert(5, 10001) && tracks(5, 8) == std::vector<uint32_t>({5, 10001, 6}) && Playlist_Locate(6, 0) == 7);
+    bool queued = true;
+    for (int i = 1; i < 256; i++) queued &= Playlist_Append(i);
+    CHECK(queued && !Playlist_Append(0) && Playlist_QueueLength() == 256);
+    Playlist_ClearQueue();
+    CHECK(Playlist_Length() == 10002 && Playlist_QueueLength() == 0);
+    CHECK(!Playlist_Open("/none.m3u") && Playlist_Length() == 10002);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,57 @@
+// read_ahead: RA_seek bounds, a producer and a consumer thread through the ring across the 4 GB offset wrap
+#include "check.h"
+#include "read_ahead.h"
+#include <random>
+#include <thread>
+
+static inline uint8_t fileByte(uint32_t off) { return (uint8_t)((off * 2654435761u) >> 24); }
+
+int main() {
+    static uint8_t buf[1 << 16];
+    ra_ring_t      ring;
+    RA_init(&ring, buf, sizeof(buf));
+
+    // the bytes from rd to wr can be sought, a seek frees the bytes before it
+    uint8_t x[100] = {0};
+    RA_reset(&ring, 1000);
+    CHECK(RA_write(&ring, x, 100) == 100);
+    CHECK(!RA_seek(&ring, 999) && !RA_seek(&ring, 1101));
+    CHECK(RA_seek(&ring, 1000) && RA_seek(&ring, 1050) && RA_fill(&ring) == 50);
+    CHECK(!RA_seek(&ring, 1049) && RA_seek(&ring, 1100) && RA_fill(&ring) == 0);
+
+    // full ring: the producer gets no space until the consumer reads
+    RA_reset(&ring, 0);
+    static uint8_t big[sizeof(buf) + 1];
+    CHECK(RA_write(&ring, big, sizeof(big)) == sizeof(buf) && RA_free(&ring) == 0);
+    CHECK(RA_read(&ring, big, 10) == 10 && RA_write(&ring, big, 100) == 10);
+
+    // random chunk sizes on both sides, the offsets wrap after 256 bytes
+    const uint32_t base = 0xFFFFFF00u, total = 10000000;
+    RA_reset(&ring, base);
+    std::thread producer([&] {
+        std::mt19937 rnd(1);
+        uint8_t      s[4096];
+        uint32_t     off = base, done = 0;
+        while (done < total) {
+            uint32_t n = 1 + rnd() % 4096;
+            if (n > total - done) n = total - done;
+            for (uint32_t i = 0; i < n; i++) s[i] = fileByte(off + i);
+            for (uint32_t w = 0; w < n;) w += RA_write(&ring, s + w, n - w);
+            off += n;
+            done += n;
+        }
+    });
+    std::mt19937 rnd(2);
+    uint8_t      d[3000];
+    uint32_t     off = base, got = 0, wrong = 0;
+    while (got < total) {
+        uint32_t n = RA_read(&ring, d, 1 + rnd() % 3000);
+        for (uint32_t i = 0; i < n; i++) wrong += (d[i] != fileByte(off + i));
+        off += n;
+        got += n;
+    }
+    producer.join();
+    printf("%u bytes through the ring, %u wrong\n", got, wrong);
+    CHECK(wrong == 0 && ring.rd.load() == base + total && RA_fill(&ring) == 0);
+    return CHECK_RESULT();
+}
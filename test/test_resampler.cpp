@@ -0,0 +1,119 @@
+// resampler: response of the quality presets and their cost per output frame
+// time_stretch: speed without a pitch change (audioFileSeek() in fixed-rate mode)
+#include "check.h"
+#include "resampler.h"
+#include "time_stretch.h"
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+static std::vector<int16_t> sine(float f, float rate, uint32_t frames, float amp) {
+    // in double, the phase error of sinf() at 10 kHz after a second is a -50 dB residual
+    std::vector<int16_t> v(frames * 2);
+    for (uint32_t i = 0; i < frames; i++) v[2 * i] = v[2 * i + 1] = (int16_t)lrint(amp * sin(2 * M_PI * f * i / rate));
+    return v;
+}
+
+static std::vector<int16_t> resample(rs_t* rs, const std::vector<int16_t>& in, uint16_t chunk) {
+    std::vector<int16_t> out;
+    int16_t              blk[2 * 512];
+    size_t               pos = 0, frames = in.size() / 2;
+    while (pos < frames) {
+        uint16_t n = (frames - pos < chunk) ? frames - pos : chunk, used = 0;
+        uint16_t o = RS_process(rs, &in[2 * pos], n, &used, blk, 512);
+        out.insert(out.end(), blk, blk + 2 * o);
+        pos += used;
+    }
+    return out;
+}
+
+static float thdn(const std::vector<int16_t>& v, float f, float rate, uint32_t skip) {
+    // least squares fit of a sine at f, THD+N = residual / fit [dB]
+    double ss = 0, cc = 0, sc = 0, sy = 0, cy = 0;
+    size_t n = v.size() / 2;
+    for (size_t i = skip; i < n; i++) {
+        double s = sin(2 * M_PI * f * i / rate), c = cos(2 * M_PI * f * i / rate), y = v[2 * i];
+        ss += s * s; cc += c * c; sc += s * c; sy += s * y; cy += c * y;
+    }
+    double det = ss * cc - sc * sc, a = (sy * cc - cy * sc) / det, b = (cy * ss - sy * sc) / det;
+    double res = 0, sig = 0;
+    for (size_t i = skip; i < n; i++) {
+        double fit = a * sin(2 * M_PI * f * i / rate) + b * cos(2 * M_PI * f * i / rate);
+        res += (v[2 * i] - fit) * (v[2 * i] - fit);
+        sig += fit * fit;
+    }
+    return (float)(10 * log10(res / sig));
+}
+
+int main() {
+    // 1:1 is a copy
+    std::vector<int16_t> coef(RS_coefSize(RS_QUALITY_HIGH) / 2);
+    rs_t                 rs;
+    RS_init(&rs, RS_QUALITY_MEDIUM, coef.data());
+    RS_setRatio(&rs, 44100, 44100, 65536);
+    std::vector<int16_t> x = sine(997, 44100, 10000, 20000);
+    CHECK(rs.bypass && resample(&rs, x, 300) == x);
+
+    // 44.1k -> 48k at -4 dBFS, the THD+N of the table in resampler.h
+    const float limit1k[3] = {-57, -78, -82}, limit10k[3] = {-41, -78, -82}; // table + 3 dB
+    for (uint8_t q = RS_QUALITY_LOW; q <= RS_QUALITY_HIGH; q++) {
+        const float f[2] = {1000, 10000};
+        for (int k = 0; k < 2; k++) {
+            RS_init(&rs, q, coef.data());
+            RS_setRatio(&rs, 44100, 48000, 65536);
+            std::vector<int16_t> out = resample(&rs, sine(f[k], 44100, 44100, 20700), 441);
+            float                d = thdn(out, f[k], 48000, 1000);
+            printf("quality %u, %5.0f Hz: THD+N %.1f dB, %zu frames\n", q, f[k], d, out.size() / 2);
+            CHECK(d < (k ? limit10k[q] : limit1k[q]));
+            CHECK(labs((long)out.size() / 2 - 48000) <= 2);
+        }
+    }
+
+    // cost per output frame
+    for (uint8_t q = RS_QUALITY_LOW; q <= RS_QUALITY_HIGH; q++) {
+        RS_init(&rs, q, coef.data());
+        RS_setRatio(&rs, 44100, 48000, 65536);
+        std::vector<int16_t> in = sine(1000, 44100, 441000, 20000);
+        double               t0 = nowNs();
+        std::vector<int16_t> out = resample(&rs, in, 512);
+        printf("benchmark: quality %u %.1f ns per output frame (host)\n", q, (nowNs() - t0) / (out.size() / 2));
+    }
+
+    // time stretching: the length follows the speed, the pitch stays, no step larger than the slope of the sine
+    std::vector<int16_t> buf(TS_bufSize() / 2);
+    const float          speeds[] = {0.5f, 0.8f, 1.25f, 1.5f};
+    const uint32_t       rates[] = {22050, 44100, 48000};
+    for (uint32_t rate : rates) {
+        for (float speed : speeds) {
+            ts_t ts;
+            TS_init(&ts, buf.data(), rate);
+            TS_setSpeed(&ts, (uint32_t)lrintf(speed * 65536));
+            uint32_t             frames = rate * 4;
+            std::vector<int16_t> in = sine(1000, rate, frames, 12000), out;
+            int16_t              blk[2 * 512];
+            size_t               pos = 0;
+            double               t0 = nowNs();
+            while (pos < frames) {
+                uint16_t n = (frames - pos < 700) ? frames - pos : 700, used = 0;
+                uint16_t o = TS_process(&ts, &in[2 * pos], n, &used, blk, 512);
+                out.insert(out.end(), blk, blk + 2 * o);
+                pos += used;
+            }
+            double   ns = (nowNs() - t0) / (out.size() / 2);
+            uint32_t m = out.size() / 2, zc = 0;
+            int      step = 0;
+            for (uint32_t i = 1; i < m; i++) {
+                if (out[2 * i - 2] < 0 && out[2 * i] >= 0) zc++;
+                step = std::max(step, abs(out[2 * i] - out[2 * i - 2]));
+            }
+            float f = zc / ((float)m / rate), len = (float)frames / m, slope = 12000 * 2 * (float)M_PI * 1000 / rate;
+            printf("stretch %5u Hz x%.2f: %.1f Hz, length 1/%.3f, largest step %.2f of the sine, %.1f ns per frame\n", rate,
+                   speed, f, len, step / slope, ns);
+            CHECK(fabsf(f - 1000) < 3);
+            CHECK(fabsf(len - speed) < 0.02f * speed);
+            CHECK(step <= slope * 1.05f + 2);
+        }
+    }
+    return CHECK_RESULT();
+}
@@ -0,0 +1,166 @@
+// SeekIndex: maps built by the task from generated MP3 files, kept while the card sleeps, read back after a restart
+// (a new process), the size limit of the index file and a damaged one
+#include "check.h"
+#include "SeekIndex.h"
+#include "SD_Card.h"
+#include "TrackCache.h"
+#include "seek_map.h"
+#include "tag_reader.h"
+#include <sys/wait.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <vector>
+
+namespace fsys = std::filesystem;
+
+// the track cache holds the files in cached (the same directory)
+static std::atomic<bool> cached{false};
+bool                     TrackCache_Contains(const char*) { return cached; }
+fs::FS&                  TrackCache_FS() { return SD_FS(); }
+
+static std::map<std::string, std::vector<uint32_t>> frameOffsets;
+static std::atomic<int>                             builds{0}, built{0};
+static sm_map_t                                     got;
+
+// ID3v2 tag, VBR frames, ID3v1 tag
+static uint32_t writeMp3(const std::string& path, uint32_t frames) {
+    std::vector<uint8_t>   file = {'I', 'D', '3', 3, 0, 0, 0, 0, 0, 100};
+    std::vector<uint32_t>& offs = frameOffsets[path];
+    file.resize(110);
+    for (uint32_t i = 0; i < frames; i++) {
+        uint8_t    h[4] = {0xFF, 0xFB, (uint8_t)(((1 + rand() % 14) << 4) | ((rand() & 1) << 1)), 0x44};
+        tr_frame_t f;
+        TR_frameHeader(h, &f);
+        offs.push_back(file.size());
+        file.insert(file.end(), h, h + 4);
+        for (uint32_t k = 4; k < f.length; k++) file.push_back(rand() & 0xFF);
+    }
+    file.insert(file.end(), {'T', 'A', 'G'});
+    file.resize(file.size() + 125);
+    std::ofstream(mock::sdRoot + path, std::ios::binary).write((const char*)file.data(), file.size());
+    return file.size();
+}
+
+static uint32_t fileSize(const char* path) {
+    std::error_code e;
+    uint32_t        n = fsys::file_size(mock::sdRoot + std::string(path), e);
+    return e ? 0 : n;
+}
+
+static bool use(const uint8_t* m, size_t len) { return SM_load(&got, m, len); }
+
+// the map of a file against the frames it was written with
+static bool exact(const char* path) {
+    const std::vector<uint32_t>& offs = frameOffsets[path];
+    if (got.kind != SM_FRAMES || got.totalFrames != offs.size() || got.dataStart != offs[0]) return false;
+    for (uint32_t i = 0; i < got.count; i++)
+        if (got.pos[i] != offs[(size_t)i * got.framesPerEntry]) return false;
+    return true;
+}
+
+// a request to the task, waits for done()
+static bool build(const char* path, uint32_t size) {
+    int n = builds;
+    if (!SeekIndex_BuildAsync(path, size, [](const char*, bool ok) {
+            built += ok;
+            builds++;
+        }))
+        return false;
+    while (builds == n) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return true;
+}
+
+// a start of the player, the statics of SeekIndex begin again
+static int restart(int (*run)()) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fails = run();
+        fflush(stdout);
+        _exit(fails);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+static const uint32_t maxBytes = 8000;
+static uint32_t       sizeA, sizeB;
+
+static int firstStart() {
+    CHECK(SeekIndex_Init(SD_FS(), "/.seek", maxBytes));
+    CHECK(!SeekIndex_BuildAsync("/a.flac", 1000, NULL));
+
+    // built and written at once
+    int n = built;
+    CHECK(build("/a.mp3", sizeA) && built == n + 1);
+    CHECK(SeekIndex_TryGet("/a.mp3", sizeA, use) && exact("/a.mp3"));
+    CHECK(!SeekIndex_TryGet("/a.mp3", sizeA + 1, use));
+    uint32_t indexBytes = fileSize("/.seek");
+    CHECK(indexBytes > 8 + SM_size(&got));
+
+    // the card sleeps, b.mp3 plays from the track cache: the map is kept in PSRAM until the flush after the wake up
+    CHECK(SD_Sleep());
+    cached = true;
+    CHECK(build("/b.mp3", sizeB) && built == n + 2);
+    CHECK(SeekIndex_Get("/b.mp3", sizeB, use) && exact("/b.mp3"));
+    SeekIndex_Flush();
+    CHECK(fileSize("/.seek") == indexBytes && SD_IsSleeping());
+    cached = false;
+    SD_Acquire();
+    SD_Release();
+    SeekIndex_Flush();
+    CHECK(fileSize("/.seek") > indexBytes);
+    CHECK(mock::sdHeld == 0);
+    return CHECK_RESULT();
+}
+
+static int secondStart() {
+    // from the index file, the MP3 file is not read again
+    CHECK(SeekIndex_Init(SD_FS(), "/.seek", maxBytes));
+    uint32_t reads = mock::fileReads;
+    int      n = built;
+    CHECK(build("/b.mp3", sizeB) && built == n + 1);
+    CHECK(SeekIndex_TryGet("/b.mp3", sizeB, use) && exact("/b.mp3"));
+    printf("map from the index file: %u reads\n", mock::fileReads - reads);
+    CHECK(mock::fileReads - reads < 10);
+    CHECK(SeekIndex_Get("/a.mp3", sizeA, use) && exact("/a.mp3"));
+
+    // more maps than fit: the file starts again and stays below the limit
+    uint32_t largest = 0;
+    for (int i = 0; i < 30; i++) {
+        std::string path = "/c" + std::to_string(i) + ".mp3";
+        CHECK(build(path.c_str(), fileSize(path.c_str())));
+        largest = std::max(largest, fileSize("/.seek"));
+    }
+    printf("30 more maps: index file at most %u bytes\n", largest);
+    CHECK(largest <= maxBytes);
+    CHECK(SeekIndex_Get("/c29.mp3", fileSize("/c29.mp3"), use) && exact("/c29.mp3"));
+    return CHECK_RESULT();
+}
+
+static int damagedStart() {
+    // a record cut short: the file is removed when the task starts
+    CHECK(SeekIndex_Init(SD_FS(), "/.seek", maxBytes));
+    build("/none.mp3", 1000); // waits until the directory is read
+    CHECK(!fsys::exists(mock::sdRoot + std::string("/.seek")));
+    CHECK(!SeekIndex_Get("/c29.mp3", fileSize("/c29.mp3"), use));
+    return CHECK_RESULT();
+}
+
+int main() {
+    srand(1);
+    fsys::remove_all(mock::sdRoot);
+    fsys::create_directories(mock::sdRoot);
+    sizeA = writeMp3("/a.mp3", 9000);
+    sizeB = writeMp3("/b.mp3", 3000);
+    for (int i = 0; i < 30; i++) writeMp3("/c" + std::to_string(i) + ".mp3", 2000);
+    int fails = restart(firstStart);
+    fails += restart(secondStart);
+    std::ofstream(mock::sdRoot + std::string("/.seek"), std::ios::binary | std::ios::app) << "xxxxxxx";
+    fails += restart(damagedStart);
+    printf(fails ? "failed\n" : "ok\n");
+    return fails ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+// seek_map: the frame index of generated VBR streams (chunk borders, junk, decimation), seeks and their inverse,
+// the Xing TOC and the VBRI table, store and load
+#include "check.h"
+#include "seek_map.h"
+#include "tag_reader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+static sm_map_t map, loaded;
+
+// MPEG-1 layer III frames, 44.1 kHz, random bitrates and padding, random payload; offs: the frame offsets
+static void vbrFrames(std::vector<uint8_t>* file, std::vector<uint32_t>* offs, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t    h[4] = {0xFF, 0xFB, (uint8_t)(((1 + rand() % 14) << 4) | ((rand() & 1) << 1)), 0x44};
+        tr_frame_t f;
+        TR_frameHeader(h, &f);
+        offs->push_back(file->size());
+        file->insert(file->end(), h, h + 4);
+        for (uint32_t k = 4; k < f.length; k++) file->push_back(rand() & 0xFF);
+    }
+}
+
+int main() {
+    srand(1);
+    // 5000 frames in large chunks, 100000 frames (decimated) with junk in the middle, 3 frames in 1..3 byte chunks
+    const uint32_t frames[] = {5000, 100000, 3}, maxChunk[] = {40000, 40000, 3};
+    for (int run = 0; run < 3; run++) {
+        std::vector<uint8_t>  file;
+        std::vector<uint32_t> offs;
+        for (int i = 0; i < 300; i++) file.push_back(i & 0x7F); // a tag in front, no sync word
+        uint32_t start = file.size();
+        vbrFrames(&file, &offs, frames[run]);
+        uint32_t end = file.size();
+        if (run == 1) {
+            file.insert(file.begin() + offs[50000], 777, 0x11);
+            for (size_t i = 50000; i < offs.size(); i++) offs[i] += 777;
+            end += 777;
+        }
+        file.insert(file.end(), 128, 'T'); // ID3v1
+
+        sm_scan_t s;
+        double    t0 = nowNs();
+        SM_scanStart(&s, &map, start, end, file.size());
+        for (uint32_t p = start; p < file.size();) {
+            uint32_t n = std::min<uint32_t>(1 + rand() % maxChunk[run], file.size() - p);
+            if (!SM_scan(&s, file.data() + p, n)) break;
+            p += n;
+        }
+        CHECK(SM_scanEnd(&s));
+        double t = (nowNs() - t0) * 1e-9;
+        printf("%u frames: %u entries, %u frames per entry\n", map.totalFrames, map.count, map.framesPerEntry);
+        if (run == 1) printf("benchmark: frame scan %.0f MB/s (host)\n", file.size() / t * 1e-6);
+        CHECK(map.kind == SM_FRAMES && map.totalFrames == frames[run] && map.dataStart == start && map.sampleRate == 44100);
+        CHECK(map.count <= SM_MAX_ENTRIES && (run != 1 || map.framesPerEntry > 38)); // 38 frames: 1 s
+        bool exact = true;
+        for (uint32_t i = 0; i < map.count; i++) exact &= (map.pos[i] == offs[(size_t)i * map.framesPerEntry]);
+        CHECK(exact);
+
+        // a seek lands on a frame with the preroll in front of the target, SM_sample() is its inverse
+        bool onFrame = true, sample = true, preroll = true, inverse = true;
+        for (int k = 0; k < 1000; k++) {
+            uint64_t smp = (uint64_t)rand() * rand() % (frames[run] * 1152ULL);
+            uint32_t skip, pos = SM_seek(&map, smp, &skip);
+            size_t   fi = std::lower_bound(offs.begin(), offs.end(), pos) - offs.begin();
+            onFrame &= (fi < offs.size() && offs[fi] == pos);
+            sample &= (fi * 1152 + skip == smp);
+            preroll &= (smp < SM_PREROLL_FRAMES * 1152 || skip >= SM_PREROLL_FRAMES * 1152);
+            inverse &= (SM_sample(&map, pos) == fi * 1152);
+        }
+        CHECK(onFrame && sample && preroll && inverse);
+
+        // the cache file: the first SM_size() bytes, a short one is refused
+        std::vector<uint8_t> b(SM_size(&map));
+        memcpy(b.data(), &map, b.size());
+        CHECK(!SM_load(&loaded, b.data(), b.size() - 1));
+        CHECK(SM_load(&loaded, b.data(), b.size()) && loaded.count == map.count && !memcmp(loaded.pos, map.pos, map.count * 4));
+    }
+
+    // not an MPEG file: the scan gives up after SM_MAX_LOST bytes
+    {
+        std::vector<uint8_t> noise(SM_MAX_LOST * 2, 0x11);
+        sm_scan_t            s;
+        SM_scanStart(&s, &map, 0, noise.size(), noise.size());
+        SM_scan(&s, noise.data(), noise.size());
+        CHECK(s.done && !SM_scanEnd(&s) && map.kind == SM_NONE);
+    }
+
+    // Xing TOC: 4096 frames in 1000000 bytes, a linear table
+    uint8_t        fr[1000] = {0};
+    const uint8_t  h[4] = {0xFF, 0xFB, 0x90, 0x44}; // 128 kbit/s, 417 bytes
+    const uint32_t bytes = 1000000;
+    memcpy(fr + 10, h, 4);
+    uint8_t* x = fr + 10 + 4 + 32;
+    memcpy(x, "Xing", 4);
+    x[7] = 7; // frames, bytes, TOC
+    x[10] = 0x10;
+    x[12] = (uint8_t)(bytes >> 24);
+    x[13] = (uint8_t)(bytes >> 16);
+    x[14] = (uint8_t)(bytes >> 8);
+    x[15] = (uint8_t)bytes;
+    for (int k = 0; k < 100; k++) x[16 + k] = k * 256 / 100;
+    CHECK(SM_fromInfo(&map, fr, sizeof(fr), 5000, 5000 + 10 + bytes, 5000 + 10 + bytes + 128));
+    CHECK(map.kind == SM_TOC && map.count == 100 && map.totalFrames == 4097 && map.dataStart == 5010);
+    uint32_t skip, pos = SM_seek(&map, SM_totalSamples(&map) / 2, &skip);
+    printf("TOC: half of the samples at %u, half of the bytes at %u\n", pos, 5010 + bytes / 2);
+    CHECK(pos > 5010 + bytes / 2 - 5000 && pos < 5010 + bytes / 2 + 5000 && skip == 0);
+    uint64_t back = SM_sample(&map, pos), half = SM_totalSamples(&map) / 2;
+    CHECK(back + 1152 * 8 > half && back < half + 1152 * 8);
+    x[7] = 3; // no TOC
+    CHECK(!SM_fromInfo(&map, fr, sizeof(fr), 5000, 0, 2000000) && map.kind == SM_NONE);
+
+    // VBRI: 10 entries of 10 frames, 417 bytes each
+    memset(fr, 0, sizeof(fr));
+    memcpy(fr, h, 4);
+    uint8_t* v = fr + 36;
+    memcpy(v, "VBRI", 4);
+    v[17] = 100; // frames
+    v[19] = 10;  // entries
+    v[21] = 1;   // scale
+    v[23] = 2;   // bytes per entry
+    v[25] = 10;  // frames per entry
+    for (int e = 0; e < 10; e++) {
+        v[26 + e * 2] = 0x01;
+        v[27 + e * 2] = 0xA1;
+    }
+    CHECK(SM_fromInfo(&map, fr, sizeof(fr), 0, 0, 200000));
+    CHECK(map.count == 11 && map.pos[1] == 417 + 0x1A1 && map.framesPerEntry == 10);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,66 @@
+// Session: the writer task on a fake clock (a volume drag, a track that plays, a pause, a new shuffle cycle),
+// which keys are written how often, and the session that is loaded after it
+#include "check.h"
+#include "Session.h"
+#include "AudioPlayer.h"
+#include "Preferences.h"
+#include <atomic>
+
+static session_t         cur; // the state of the player, changed by the script between the polls
+static std::atomic<bool> finished{false};
+static int               volumeAfterDrag = -1, writesBeforeSettle = -1;
+
+static void snapshot(session_t* s) { *s = cur; }
+
+static int writes(const char* key) { return mock::nvsWrites[std::string(PLAYER_NVS_NAMESPACE "/") + key]; }
+
+// runs in the task before every poll, one step a second
+static void script(uint32_t ms) {
+    mock::nowMs += ms;
+    uint32_t t = mock::nowMs / 1000;
+    if (t >= 2 && t <= 6) cur.volume = 48 + t; // an arc drag to 54, one step a second
+    if (t == 8) writesBeforeSettle = writes("volume");
+    if (t == 10) volumeAfterDrag = mock::nvs.count(PLAYER_NVS_NAMESPACE "/volume") ? (uint8_t)mock::nvs[PLAYER_NVS_NAMESPACE "/volume"][0] : -1;
+    if (t == 20) {
+        cur.playing = true;
+        strlcpy(cur.path, "/a.mp3", sizeof(cur.path));
+        cur.fileSize = 1000000;
+    }
+    if (cur.playing) cur.filePos += 4000;
+    if (t == 200) cur.playing = false; // pause
+    if (t == 230) {                    // the shuffle order starts its next cycle
+        cur.orderPos = 17;
+        cur.cycle = 3;
+    }
+    if (t >= 260) {
+        finished = true;
+        while (true) std::this_thread::sleep_for(std::chrono::hours(1));
+    }
+}
+
+int main() {
+    session_t s = {};
+    s.volume = 48;
+    s.eqPreset = -1;
+    s.brightness = 40;
+    CHECK(!Session_Load(&s)); // the first start
+    cur = s;
+    mock::fakeClock = true;
+    mock::onDelay = script;
+    CHECK(Session_Start(&s, snapshot));
+    while (!finished) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // the drag is one write after the settle time, every key the first time, then only the changed ones
+    CHECK(writesBeforeSettle == 0 && volumeAfterDrag == 54);
+    CHECK(writes("volume") == 1 && writes("eq") == 1 && writes("bright") == 1);
+    printf("after 260 s: track %d, position %d, cycle %d writes\n", writes("track"), writes("fpos"), writes("cycle"));
+    CHECK(writes("track") == 2); // none, /a.mp3
+    CHECK(writes("fpos") == 5);  // the first write, the track, two checkpoints, the pause
+    CHECK(writes("cycle") == 2 && writes("order") == 2);
+
+    session_t l = {};
+    CHECK(Session_Load(&l));
+    CHECK(l.volume == 54 && l.eqPreset == -1 && l.brightness == 40 && !strcmp(l.path, "/a.mp3") && !l.playing);
+    CHECK(l.fileSize == 1000000 && l.filePos == cur.filePos && l.orderPos == 17 && l.cycle == 3);
+    return CHECK_RESULT();
+}
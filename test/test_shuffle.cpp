@@ -0,0 +1,56 @@
+// Shuffle: every order a permutation with its inverse, cycles and seeds, how even and how scattered, the lookup cost
+#include "check.h"
+#include "Shuffle.h"
+#include <vector>
+
+int main() {
+    // sizes around the powers of four of the Feistel domain
+    const uint32_t ns[] = {0, 1, 2, 3, 4, 5, 7, 16, 17, 100, 1000, 4097, 65535, 65536, 65537, 200000};
+    for (uint32_t n : ns)
+        for (uint32_t cycle = 0; cycle < 3; cycle++) {
+            shuffle_t s;
+            Shuffle_Init(&s, n, 12345, cycle);
+            std::vector<bool> seen(n);
+            bool              perm = true, inverse = true;
+            uint32_t          fixed = 0;
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t x = Shuffle_At(&s, i);
+                perm &= (x < n && !seen[x]);
+                if (x < n) seen[x] = true;
+                inverse &= (Shuffle_IndexOf(&s, x) == i);
+                fixed += (x == i);
+            }
+            CHECK(perm && inverse);
+            CHECK(n < 1000 || fixed < 20);
+        }
+
+    // the same seed and cycle: the same order, another cycle: another one, neighbours are not neighbours
+    shuffle_t a, b, c;
+    Shuffle_Init(&a, 30000, 7, 0);
+    Shuffle_Init(&b, 30000, 7, 1);
+    Shuffle_Init(&c, 30000, 7, 0);
+    uint32_t same = 0, again = 0, adjacent = 0;
+    for (uint32_t i = 0; i < 30000; i++) {
+        same += (Shuffle_At(&a, i) == Shuffle_At(&b, i));
+        again += (Shuffle_At(&a, i) == Shuffle_At(&c, i));
+        adjacent += (i + 1 < 30000 && Shuffle_At(&a, i + 1) == Shuffle_At(&a, i) + 1);
+    }
+    CHECK(again == 30000 && same < 20 && adjacent < 20);
+
+    // the first item over 100000 seeds, 10 items: each about 10000 times
+    uint32_t hist[10] = {0};
+    for (uint32_t seed = 0; seed < 100000; seed++) {
+        shuffle_t s;
+        Shuffle_Init(&s, 10, seed, 0);
+        hist[Shuffle_At(&s, 0)]++;
+    }
+    bool even = true;
+    for (uint32_t h : hist) even &= (h > 9000 && h < 11000);
+    CHECK(even);
+
+    uint32_t sum = 0;
+    double   t0 = nowNs();
+    for (uint32_t i = 0; i < 1000000; i++) sum += Shuffle_At(&a, i % 30000) + Shuffle_IndexOf(&a, i % 30000);
+    printf("benchmark: %.1f ns per Shuffle_At() and Shuffle_IndexOf() of 30000 items (host, %u)\n", (nowNs() - t0) / 1e6, sum);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,75 @@
+// spectrum: full scale sines at bin centres land in their log band near 255, the other bands stay low, a sine
+// 40 dB down, silence, the cost per 256 and 512 point frame
+#include "check.h"
+#include "spectrum.h"
+#include <math.h>
+#include <vector>
+
+static sp_fft_t sp;
+
+static std::vector<int16_t> sine(uint16_t points, double bin, double dbfs) {
+    std::vector<int16_t> v(points);
+    double               a = 32767 * pow(10.0, dbfs / 20.0);
+    for (uint16_t i = 0; i < points; i++) v[i] = (int16_t)lrint(a * sin(2 * M_PI * bin * i / points + 0.3));
+    return v;
+}
+
+// the band of a bin, the bands that the Hann main lobe (k - 1 ... k + 1) touches
+static int bandOf(uint16_t k) {
+    for (int b = 0; b < sp.numBands; b++)
+        if (k >= sp.bandEdge[b] && k < sp.bandEdge[b + 1]) return b;
+    return -1;
+}
+
+int main() {
+    const uint32_t rate = 44100;
+    for (uint16_t points : {256, 512})
+        for (uint8_t numBands : {16, 32}) {
+            CHECK(SP_init(&sp, points, numBands, rate));
+            bool edges = sp.bandEdge[0] == 1 && sp.bandEdge[numBands] <= points / 2;
+            for (int b = 0; b < numBands; b++) edges &= sp.bandEdge[b + 1] > sp.bandEdge[b];
+            CHECK(edges);
+
+            // every bin from 2 up: the band of the bin near full scale, the bands outside the main lobe 60 dB down at least
+            // (the rounding of the fixed point stages, summed over the wide bands at the top)
+            int     minPeak = 255, maxOther = 0;
+            uint8_t bands[SP_MAX_BANDS];
+            for (uint16_t k = 2; k < points / 2 - 1; k++) {
+                std::vector<int16_t> x = sine(points, k, -0.1);
+                SP_compute(&sp, x.data(), bands);
+                int b = bandOf(k);
+                if (bands[b] < minPeak) minPeak = bands[b];
+                for (int i = 0; i < numBands; i++)
+                    if (i != b && i != bandOf(k - 1) && i != bandOf(k + 1) && bands[i] > maxOther) maxOther = bands[i];
+            }
+            printf("%u points, %u bands: peak band at least %d, others up to %d\n", points, numBands, minPeak, maxOther);
+            CHECK(minPeak >= 245 && maxOther <= 64);
+
+            // -40 dBFS: 40 / 80 * 255 down, silence: nothing
+            uint16_t             k = points / 8;
+            std::vector<int16_t> x = sine(points, k, -40);
+            SP_compute(&sp, x.data(), bands);
+            printf("  -40 dBFS at bin %u: %d\n", k, bands[bandOf(k)]);
+            CHECK(abs(bands[bandOf(k)] - (255 - 128)) <= 6);
+            x.assign(points, 0);
+            SP_compute(&sp, x.data(), bands);
+            bool silent = true;
+            for (int i = 0; i < numBands; i++) silent &= bands[i] == 0;
+            CHECK(silent);
+        }
+    CHECK(!SP_init(&sp, 1024, 16, rate) && !SP_init(&sp, 256, 0, rate) && !SP_init(&sp, 256, SP_MAX_BANDS + 1, rate));
+
+    for (uint16_t points : {256, 512}) {
+        SP_init(&sp, points, 32, rate);
+        std::vector<int16_t> x = sine(points, 10.5, -6);
+        uint8_t              bands[SP_MAX_BANDS];
+        const int            rounds = 100000;
+        double               t0 = nowNs();
+        for (int i = 0; i < rounds; i++) {
+            x[i % points] ^= 1;
+            SP_compute(&sp, x.data(), bands);
+        }
+        printf("benchmark: %.0f ns per %u point frame (host, %d)\n", (nowNs() - t0) / rounds, points, bands[0]);
+    }
+    return CHECK_RESULT();
+}
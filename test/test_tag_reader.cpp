@@ -0,0 +1,217 @@
+// tag_reader: generated files of every format, their tags, durations and reads, the parse rate, and the tags in
+// the library index through MediaLibrary_ReadTagsAsync()
+#include "check.h"
+#include "MediaLibrary.h"
+#include "SD_Card.h"
+#include "tag_reader.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> bytes;
+
+static bytes operator+(bytes a, const bytes& b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+static bytes str(const std::string& s) { return bytes(s.begin(), s.end()); }
+static bytes fill(size_t n, uint8_t v = 0) { return bytes(n, v); }
+static bytes noise(size_t n) {
+    bytes b(n);
+    for (auto& c : b) c = rand();
+    return b;
+}
+static bytes be32(uint32_t v) { return {(uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v}; }
+static bytes be24(uint32_t v) { return {(uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v}; }
+static bytes le32(uint32_t v) { return {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)}; }
+static bytes le16(uint16_t v) { return {(uint8_t)v, (uint8_t)(v >> 8)}; }
+static bytes syncsafe(uint32_t v) { return {(uint8_t)((v >> 21) & 0x7f), (uint8_t)((v >> 14) & 0x7f), (uint8_t)((v >> 7) & 0x7f), (uint8_t)(v & 0x7f)}; }
+
+// ID3v2
+static bytes frame(const char* id, const bytes& data, int version = 3, uint16_t flags = 0) {
+    if (version == 2) return str(id) + be24(data.size()) + data;
+    return str(id) + (version == 4 ? syncsafe(data.size()) : be32(data.size())) + bytes{(uint8_t)(flags >> 8), (uint8_t)flags} + data;
+}
+static bytes id3(const std::vector<bytes>& frames, int version = 3, size_t pad = 100) {
+    bytes body;
+    for (const bytes& f : frames) body = body + f;
+    body = body + fill(pad);
+    return str("ID3") + bytes{(uint8_t)version, 0, 0} + syncsafe(body.size()) + body;
+}
+static bytes latin1(const char* s) { return bytes{0} + str(s); }
+static bytes utf16(const char16_t* s) {
+    bytes b = {1, 0xff, 0xfe};
+    for (; *s; s++) b = b + le16(*s);
+    return b + bytes{0, 0};
+}
+static bytes id3v1(const char* title, const char* artist, const char* album, uint8_t track) {
+    auto field = [](const char* s, size_t n, uint8_t pad) { bytes b = str(s); b.resize(n, pad); return b; };
+    return str("TAG") + field(title, 30, ' ') + field(artist, 30, 0) + field(album, 30, 0) + str("1999") + fill(28) +
+           bytes{0, track, 12};
+}
+
+// MPEG1 layer III, 128 kbit/s, 44.1 kHz: 417 bytes, 1152 samples
+static bytes mp3Frames(int n) {
+    bytes f = bytes{0xff, 0xfb, 0x90, 0x00} + fill(413), all;
+    for (int i = 0; i < n; i++) all = all + f;
+    return all;
+}
+static bytes vbrFrame(const char* magic, uint32_t frames, uint32_t size) {
+    bytes f = bytes{0xff, 0xfb, 0x90, 0x00} + fill(413), x;
+    if (!strcmp(magic, "Xing")) x = str("Xing") + be32(3) + be32(frames) + be32(size);
+    else x = str("VBRI") + bytes{0, 1, 0, 0, 0, 75} + be32(size) + be32(frames);
+    std::copy(x.begin(), x.end(), f.begin() + 36);
+    return f;
+}
+
+// FLAC
+static bytes block(uint8_t type, const bytes& d, bool last = false) {
+    return bytes{(uint8_t)(type | (last ? 0x80 : 0))} + be24(d.size()) + d;
+}
+static bytes streamInfo(uint32_t rate, uint64_t samples) {
+    bytes si = fill(34);
+    si[10] = rate >> 12;
+    si[11] = rate >> 4;
+    si[12] = ((rate & 0xf) << 4) | (1 << 1); // 2 channels
+    si[13] = (15 << 4) | ((samples >> 32) & 0xf); // 16 bit
+    bytes s = be32((uint32_t)samples);
+    std::copy(s.begin(), s.end(), si.begin() + 14);
+    return si;
+}
+static bytes comments(const std::vector<const char*>& items) {
+    bytes d = le32(3) + str("ref") + le32(items.size());
+    for (const char* s : items) d = d + le32(strlen(s)) + str(s);
+    return d;
+}
+
+// MP4
+static bytes atom(const char* type, const bytes& d) { return be32(8 + d.size()) + str(type) + d; }
+static bytes data(uint32_t type, const bytes& v) { return atom("data", be32(type) + fill(4) + v); }
+
+struct sample_t {
+    const char* name;
+    bytes       file;
+    bool        found;
+    const char *title, *artist, *album;
+    uint16_t    trackNo;
+    uint32_t    durationMs;
+};
+
+static std::vector<sample_t> samples() {
+    std::vector<sample_t> s;
+    // ID3v2.3, UTF-16 title behind a 200 KB picture, Xing: 1000 frames = 26.122 s
+    bytes apic = frame("APIC", bytes{0} + str("image/jpeg") + bytes{0, 3, 0} + noise(200000));
+    s.push_back({"a.mp3",
+                 id3({apic, frame("TIT2", utf16(u"Größe \xd83d\xde00")), frame("TPE1", latin1("Bj\xf6rk")), frame("TALB", latin1("Homogenic")),
+                      frame("TRCK", latin1("3/10"))}) +
+                     vbrFrame("Xing", 1000, 417 * 1000) + mp3Frames(999),
+                 true, "Größe 😀", "Björk", "Homogenic", 3, 26122});
+    // ID3v2.4 UTF-8 with a data length indicator, junk before the first frame, CBR, ID3v1 at the end
+    bytes tit = bytes{3} + str("Caf\xc3\xa9");
+    s.push_back({"b.mp3",
+                 id3({frame("TIT2", be32(tit.size()) + tit, 4, 0x0001), frame("TPE1", bytes{3} + str("Artist"), 4),
+                      frame("TALB", bytes{3} + str("Alb"), 4), frame("TRCK", bytes{3} + str("7"), 4)},
+                     4) +
+                     str(std::string("\0\0junk", 6)) + mp3Frames(500) + id3v1("V1 title", "V1 artist", "V1 album", 9),
+                 true, "Café", "Artist", "Alb", 7, 13031});
+    // ID3v1 only, VBRI: 2000 frames
+    s.push_back({"c.mp3", vbrFrame("VBRI", 2000, 417 * 2000) + mp3Frames(50) + id3v1("V1 title", "V1 artist", "V1 album", 9), true,
+                 "V1 title", "V1 artist", "V1 album", 9, 52244});
+    // ID3v2.2
+    s.push_back({"d.mp3",
+                 id3({frame("TT2", latin1("Old title"), 2), frame("TP1", latin1("Old artist"), 2), frame("TAL", latin1("Old album"), 2),
+                      frame("TRK", latin1("12"), 2)},
+                     2) +
+                     mp3Frames(100),
+                 true, "Old title", "Old artist", "Old album", 12, 2606});
+    // FLAC, a 300 KB picture before the comments: 185.5 s
+    s.push_back({"f.flac",
+                 str("fLaC") + block(0, streamInfo(44100, 44100ull * 185 + 22050)) + block(6, noise(300000)) +
+                     block(4, comments({"title=Flac Title", "ARTIST=Flac Artist", "Album=Flac Album", "TRACKNUMBER=04"})) +
+                     block(1, fill(100), true) + noise(50000),
+                 true, "Flac Title", "Flac Artist", "Flac Album", 4, 185500});
+    // M4A, moov behind a 400 KB mdat, a cover between the strings: 241.5 s
+    bytes ilst = atom("ilst", atom("\xa9nam", data(1, str("Mp4 T\xc3\xaftle"))) + atom("covr", data(13, noise(5000))) +
+                                  atom("\xa9" "ART", data(1, str("Mp4 Artist"))) + atom("\xa9" "alb", data(1, str("Mp4 Album"))) +
+                                  atom("trkn", data(0, bytes{0, 0, 0, 11, 0, 12, 0, 0})));
+    bytes moov = atom("moov", atom("mvhd", fill(12) + be32(1000) + be32(241500) + fill(80)) +
+                                  atom("udta", atom("meta", fill(4) + atom("hdlr", fill(25)) + ilst)));
+    s.push_back({"g.m4a", atom("ftyp", str("M4A ") + fill(4)) + atom("mdat", noise(400000)) + moov, true, "Mp4 Tïtle", "Mp4 Artist",
+                 "Mp4 Album", 11, 241500});
+    // WAV, LIST INFO behind the data: 3 s + 1000 bytes
+    bytes fmt = le16(1) + le16(2) + le32(44100) + le32(176400) + le16(4) + le16(16);
+    bytes info = str("INFOINAM") + le32(9) + str("Wav Nam\xe9") + bytes{0, 0} + str("IART") + le32(4) + str("Who") + bytes{0} +
+                 str("ITRK") + le32(2) + str("5") + bytes{0};
+    bytes wav = str("WAVEfmt ") + le32(fmt.size()) + fmt + str("data") + le32(176400 * 3 + 1000) + fill(176400 * 3 + 1000) +
+                str("LIST") + le32(info.size()) + info;
+    s.push_back({"h.wav", str("RIFF") + le32(wav.size()) + wav, true, "Wav Namé", "Who", "", 5, 3005});
+    // not an audio file
+    s.push_back({"i.mp3", noise(3000), false, "", "", "", 0, 0});
+    return s;
+}
+
+static int32_t readMem(void* user, uint32_t pos, uint8_t* dst, uint32_t len) {
+    const bytes* b = (const bytes*)user;
+    if (pos >= b->size()) return 0;
+    len = std::min<uint32_t>(len, b->size() - pos);
+    memcpy(dst, b->data() + pos, len);
+    return len;
+}
+
+int main() {
+    srand(1);
+    std::vector<sample_t> files = samples();
+    tr_tags_t             t;
+    for (const sample_t& s : files) {
+        bool found = TR_read(&t, s.file.size(), readMem, (void*)&s.file);
+        printf("%-6s '%s' '%s' '%s' #%u, %u ms, %u reads\n", s.name, t.title, t.artist, t.album, t.trackNo, t.duration, t.reads);
+        CHECK(found == s.found);
+        CHECK(!strcmp(t.title, s.title) && !strcmp(t.artist, s.artist) && !strcmp(t.album, s.album));
+        CHECK(t.trackNo == s.trackNo && labs((long)t.duration - (long)s.durationMs) <= 1);
+        CHECK(t.reads <= (s.found ? 6 : TR_MAX_READS));
+    }
+
+    // ID3v1 text is ISO-8859-1, UTF-16 surrogates are combined
+    char         out[16];
+    const uint8_t u16[] = {0xff, 0xfe, 0x3d, 0xd8, 0x00, 0xde};
+    CHECK(TR_text(out, sizeof(out), (const uint8_t*)"\xe9t\xe9", 3, 0) == 5 && !strcmp(out, "été"));
+    CHECK(TR_text(out, sizeof(out), u16, sizeof(u16), 1) == 4 && !strcmp(out, "😀"));
+
+    // parse rate, the files in memory
+    const int rounds = 20000;
+    double    t0 = nowNs();
+    for (int r = 0; r < rounds; r++) TR_read(&t, files[r % files.size()].file.size(), readMem, (void*)&files[r % files.size()].file);
+    printf("benchmark: %.0f files/s parsed (host, in memory)\n", rounds / ((nowNs() - t0) * 1e-9));
+
+    // the files on the card: the tag task writes them into the index, a file without tags keeps its folder names
+    std::filesystem::remove_all(mock::sdRoot);
+    std::filesystem::create_directories(std::string(mock::sdRoot) + "/Tagged/Mixed");
+    for (const sample_t& s : files) {
+        std::ofstream f(std::string(mock::sdRoot) + "/Tagged/Mixed/" + s.name, std::ios::binary);
+        f.write((const char*)s.file.data(), s.file.size());
+    }
+    CHECK(MediaLibrary_Build(SD_FS(), SD_MOUNT_POINT, "/", "/.medialib.idx") == (int)files.size());
+    static std::atomic<int> writes{0};
+    uint32_t                opens = mock::fileOpens, reads = mock::fileReads;
+    t0 = nowNs();
+    CHECK(MediaLibrary_ReadTagsAsync(SD_FS(), 0, [](uint32_t) { writes++; }));
+    ml_progress_t pr;
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        MediaLibrary_GetProgress(&pr);
+    } while (pr.tagging || writes == 0);
+    printf("tag task: %u files, %u index writes, %u opens, %u reads, %.1f ms (host)\n", pr.taggedFiles, writes.load(),
+           mock::fileOpens - opens, mock::fileReads - reads, (nowNs() - t0) * 1e-6);
+    CHECK(pr.taggedFiles == files.size());
+    for (const sample_t& s : files) {
+        ml_track_t r;
+        char       title[MEDIA_NAME_LEN], artist[MEDIA_NAME_LEN];
+        bool       ok = MediaLibrary_GetTrack(MediaLibrary_Find(("/Tagged/Mixed/" + std::string(s.name)).c_str()), &r) &&
+                  MediaLibrary_GetString(r.title, title, sizeof(title)) && MediaLibrary_GetString(r.artist, artist, sizeof(artist));
+        CHECK(ok && (r.flags & ML_FLAG_TAGS) && r.duration == (s.durationMs + 500) / 1000);
+        CHECK(s.found ? !strcmp(title, s.title) && !strcmp(artist, s.artist) : !strcmp(title, "i") && !strcmp(artist, "Tagged"));
+    }
+    return CHECK_RESULT();
+}
@@ -0,0 +1,82 @@
+// volume: the Q15 tables against the former double curves, the balance, both ramps from one gain to another
+#include "check.h"
+#include "volume.h"
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+// computeLimit() before the tables: square and logarithmic curve in double
+static double formerCurve(uint16_t vol, uint16_t steps, uint8_t curve) {
+    if (curve == VOL_CURVE_SQUARE) return (double)pow(vol, 2) / pow(steps, 2);
+    double log1 = log(1);
+    if (vol == 0) return 0;
+    return vol * ((exp(log1 + (vol - 1) * (log(steps) - log1) / (steps - 1))) / steps) / steps;
+}
+
+// one block of a constant signal through the ramp, the gain of every frame (left)
+static std::vector<int32_t> ramp(vol_ramp_t* r, uint16_t frames) {
+    std::vector<int32_t> buff(2 * frames, 1 << 16), gain(frames);
+    VOL_process32(r, buff.data(), frames);
+    for (uint16_t i = 0; i < frames; i++) gain[i] = buff[2 * i];
+    return gain;
+}
+
+int main() {
+    static uint16_t table[VOL_MAX_STEPS + 1];
+    for (uint16_t steps : {21, 64, 100, 256})
+        for (uint8_t curve : {VOL_CURVE_SQUARE, VOL_CURVE_LOG}) {
+            VOL_buildTable(table, steps, curve);
+            int maxErr = 0;
+            for (uint16_t vol = 0; vol <= steps; vol++) {
+                int err = abs((int)table[vol] - (int)lrint(formerCurve(vol, steps, curve) * VOL_UNITY_Q15));
+                if (err > maxErr) maxErr = err;
+            }
+            printf("%3u steps, %s curve: error up to %d LSB\n", steps, curve == VOL_CURVE_LOG ? "log" : "square", maxErr);
+            CHECK(maxErr <= 1 && table[0] == 0 && table[steps] == VOL_UNITY_Q15);
+        }
+    bool balance = true;
+    for (int b = -16; b <= 16; b++) balance &= VOL_balance(b) == lrint((1.0 - abs(b) / 16.0) * VOL_UNITY_Q15);
+    CHECK(balance);
+
+    // linear: every ramp length and direction ends at the target with the last frame of its length, monotonic
+    const int32_t gains[] = {0, 1, 479, 8191, VOL_UNITY_Q16, 3 * VOL_UNITY_Q16 + 7, 16 * VOL_UNITY_Q16};
+    vol_ramp_t    r = {};
+    bool          exact = true, monotonic = true;
+    for (uint16_t ms : {1, 10, 50})
+        for (int32_t from : gains)
+            for (int32_t to : gains) {
+                VOL_setRamp(&r, 48000, ms, VOL_RAMP_LINEAR);
+                VOL_setTarget(&r, from, from);
+                VOL_jump(&r);
+                VOL_setTarget(&r, to, to);
+                std::vector<int32_t> g = ramp(&r, r.frames);
+                exact &= g.back() == to && r.cur[0] == to && r.cur[1] == to;
+                for (size_t i = 1; i < g.size(); i++) monotonic &= (to > from) ? g[i] >= g[i - 1] : g[i] <= g[i - 1];
+            }
+    CHECK(exact && monotonic);
+
+    // exponential: 99 % of the way after the ramp time, the target soon after, no overshoot
+    VOL_setRamp(&r, 48000, 10, VOL_RAMP_EXP);
+    VOL_setTarget(&r, 0, 0);
+    VOL_jump(&r);
+    VOL_setTarget(&r, VOL_UNITY_Q16, VOL_UNITY_Q16);
+    std::vector<int32_t> g = ramp(&r, r.frames);
+    int32_t after = g.back();
+    CHECK(after >= VOL_UNITY_Q16 * 99 / 100 && after < VOL_UNITY_Q16);
+    g = ramp(&r, 4 * r.frames);
+    printf("exponential: %.2f %% after 10 ms, the target %s after 50 ms\n", 100.0 * after / VOL_UNITY_Q16,
+           g.back() == VOL_UNITY_Q16 ? "reached" : "not reached");
+    CHECK(g.back() == VOL_UNITY_Q16 && *std::max_element(g.begin(), g.end()) == VOL_UNITY_Q16);
+
+    // a constant gain: 16 bit saturates, 32 bit does not
+    int16_t s16[4] = {20000, -20000, 100, -100};
+    int32_t s32[4] = {20000, -20000, 100, -100};
+    VOL_setTarget(&r, 2 * VOL_UNITY_Q16, VOL_UNITY_Q16 / 2);
+    VOL_jump(&r);
+    VOL_process16(&r, s16, 2);
+    VOL_process32(&r, s32, 2);
+    CHECK(s16[0] == 32767 && s16[1] == -10000 && s16[2] == 200 && s16[3] == -50);
+    CHECK(s32[0] == 40000 && s32[1] == -10000);
+    return CHECK_RESULT();
+}